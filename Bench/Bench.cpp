@@ -0,0 +1,637 @@
+// ============================================================
+// File: Bench.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Command-line benchmark suite for the native tone mapping
+// library (Clib). Every command runs on a deterministic
+// synthetic HDR image so results are comparable between
+// machines.
+//
+// Usage:
+//   Bench <command> [width] [height] [iterations]
+//         [--shaders <dir>] [--slo <ms>] [--profile <file>]
+//
+// Commands:
+//   readback - Upload, tone map and read back once per output
+//              format. Reports the average call time and the
+//              readback throughput (output bytes per second).
+//   latency  - Replays a slider drag (a new exposure per request,
+//              then the same drag again) through ToneMapCached on
+//              every native backend and dumps the request latency
+//              percentiles for rendered and cached requests, with
+//              the count over the latency target (--slo, 100 ms).
+//   autotune - Searches tile size, thread count, kernel variant,
+//              unroll factor and streaming-store threshold of the
+//              native CPU pipeline (one dimension at a time, two
+//              rounds) and saves the fastest setting as this CPU
+//              model's tune profile, which Clib loads at start-up.
+//              --profile overrides the profile file location.
+//   quality  - Renders the synthetic image with a dark ramp band
+//              crossing the crush level on the CPU and on GL with
+//              quality counters on, and checks that both backends
+//              report the same crushed and clipped channel counts
+//              (exit code 1 if they differ by more than a column).
+//   seam     - Renders the synthetic image [iterations] times with
+//              ToneMapSplit and compares every frame with
+//              ToneMapCPU. GPU bands use the CPU's gamma math, so
+//              only GPU float rounding may move a channel by one
+//              code (exit code 1 on any larger difference or on
+//              more than 0.01% of channels off by one).
+//
+// Readback notes:
+//   BGRA8    - RGBA8 FBO read as GL_BGRA. Native surface order
+//              on Windows drivers, the fastest 8-bit path.
+//   RGBA8    - RGBA8 FBO read as GL_RGBA. Fast on drivers that
+//              store RGBA; may swizzle on others.
+//   RGB10A2  - RGB10_A2 FBO read as packed 2_10_10_10_REV.
+//              Same byte count as BGRA8 with 10-bit precision.
+//   RGBA16F  - RGBA16F FBO read as GL_HALF_FLOAT, linear. Twice
+//              the bytes of the 8-bit formats.
+//   LUMA8    - R8 FBO read as GL_RED. A quarter of the bytes;
+//              usually the fastest when only luminance is used.
+//   A format that is much slower than its byte count suggests is
+//   being converted by the driver on the CPU.
+// ============================================================
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HDR.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gFormatNames
+ * Printable names indexed by HDROutputFormat.
+ */
+static const char* gFormatNames[HDR_OUTPUT_FORMAT_COUNT] = {
+    "BGRA8", "RGBA8", "RGB10A2", "RGBA16F", "LUMA8"
+};
+
+/*
+ * gBackendNames
+ * Printable names indexed by HDRBackend.
+ */
+static const char* gBackendNames[HDR_BACKEND_COUNT] = {
+    "GL", "CPU", "Split", "ASM"
+};
+
+/*
+ * BenchOptions
+ * Parsed command line shared by all commands.
+ *
+ * width, height - Synthetic image size in pixels (> 0)
+ * iterations    - Timed repetitions per measurement (> 0)
+ * profilePath   - Tune profile file (nullptr = library default)
+ */
+struct BenchOptions
+{
+    int width = 3840;
+    int height = 2160;
+    int iterations = 10;
+    const char* profilePath = nullptr;
+};
+
+/* ============================================================
+   Procedure: NowMs
+   ------------------------------------------------------------
+   Description:
+   Returns a monotonic timestamp in milliseconds.
+   ============================================================ */
+static double NowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+/* ============================================================
+   Procedure: MakeSyntheticImage
+   ------------------------------------------------------------
+   Description:
+   Builds a deterministic linear RGB test image: a horizontal
+   exposure ramp spanning several stops, a vertical hue sweep
+   and a grid of bright specular spots above 1.0.
+
+   Input parameters:
+   width, height - Image size in pixels
+
+   Output parameters:
+   Returns interleaved RGB floats (RGBRGB...).
+   ============================================================ */
+static std::vector<float> MakeSyntheticImage(int width, int height)
+{
+    std::vector<float> rgb((size_t)width * height * 3);
+
+    for (int y = 0; y < height; y++)
+    {
+        float v = (float)y / (float)(height > 1 ? height - 1 : 1);
+        for (int x = 0; x < width; x++)
+        {
+            float u = (float)x / (float)(width > 1 ? width - 1 : 1);
+
+            // Ramp from 1/64 to 16 (10 stops)
+            float level = std::exp2(u * 10.0f - 6.0f);
+
+            float r = level * (0.6f + 0.4f * std::sin(v * 6.2831f));
+            float g = level * (0.6f + 0.4f * std::sin(v * 6.2831f + 2.094f));
+            float b = level * (0.6f + 0.4f * std::sin(v * 6.2831f + 4.188f));
+
+            // Specular spots every 64 pixels
+            if ((x & 63) < 3 && (y & 63) < 3)
+                r = g = b = 50.0f;
+
+            size_t i = ((size_t)y * width + x) * 3;
+            rgb[i + 0] = r;
+            rgb[i + 1] = g;
+            rgb[i + 2] = b;
+        }
+    }
+
+    return rgb;
+}
+
+/* ============================================================
+   Procedure: BenchReadback
+   ------------------------------------------------------------
+   Description:
+   Measures UploadToGLFormat for every output format. The first
+   call per format is a warm-up and is not timed.
+
+   Input parameters:
+   opt - Parsed benchmark options
+
+   Output parameters:
+   Returns 0 on success, 1 if OpenGL could not be initialized.
+   ============================================================ */
+static int BenchReadback(const BenchOptions& opt)
+{
+    if (!InitGLFW())
+    {
+        std::printf("OpenGL initialization failed\n");
+        return 1;
+    }
+
+    std::vector<float> image = MakeSyntheticImage(opt.width, opt.height);
+    size_t pixels = (size_t)opt.width * opt.height;
+
+    std::printf("readback %dx%d, %d iterations\n",
+        opt.width, opt.height, opt.iterations);
+    std::printf("%-10s %10s %12s\n", "format", "ms/call", "MB/s out");
+
+    for (int format = 0; format < HDR_OUTPUT_FORMAT_COUNT; format++)
+    {
+        size_t bytes = pixels * GetOutputBytesPerPixel(format);
+        std::vector<unsigned char> output(bytes);
+
+        // Warm-up (shader compile, driver allocations)
+        UploadToGLFormat(image.data(), opt.width, opt.height,
+            output.data(), format, 1.0f, 4.0f);
+
+        double start = NowMs();
+        for (int i = 0; i < opt.iterations; i++)
+        {
+            UploadToGLFormat(image.data(), opt.width, opt.height,
+                output.data(), format, 1.0f, 4.0f);
+        }
+        double ms = (NowMs() - start) / opt.iterations;
+
+        std::printf("%-10s %10.2f %12.1f\n",
+            gFormatNames[format], ms, (bytes / (1024.0 * 1024.0)) / (ms / 1000.0));
+    }
+
+    CleanupGLFW();
+    return 0;
+}
+
+/* ============================================================
+   Procedure: BenchLatency
+   ------------------------------------------------------------
+   Description:
+   Replays an exposure drag of opt.iterations steps twice per
+   backend: the first sweep renders every request, the second
+   finds them all in the render cache. Prints the latency
+   distribution of both. GL is skipped if OpenGL is missing.
+
+   Input parameters:
+   opt - Parsed benchmark options
+
+   Output parameters:
+   Returns 0.
+   ============================================================ */
+static int BenchLatency(const BenchOptions& opt)
+{
+    std::vector<float> image = MakeSyntheticImage(opt.width, opt.height);
+    std::vector<unsigned char> output((size_t)opt.width * opt.height * 4);
+    bool gl = InitGLFW();
+
+    RenderCacheKey key = {};
+    key.imageHash = HashLinearRGB(image.data(), (long long)image.size());
+    key.width = opt.width;
+    key.height = opt.height;
+    key.boost = 1.0f;
+    key.whitePoint = 4.0f;
+    key.op = HDR_OPERATOR_REINHARD;
+    key.format = HDR_OUTPUT_BGRA8;
+
+    RenderCacheClear();
+    ResetLatencyStats();
+
+    std::printf("latency %dx%d, %d requests per sweep\n",
+        opt.width, opt.height, opt.iterations);
+
+    for (int backend = HDR_BACKEND_GL; backend <= HDR_BACKEND_SPLIT; backend++)
+    {
+        if (!gl && backend != HDR_BACKEND_CPU)
+            continue;
+
+        key.backend = backend;
+        for (int sweep = 0; sweep < 2; sweep++)
+        {
+            for (int i = 0; i < opt.iterations; i++)
+            {
+                key.exposure = 0.5f + 0.01f * i;
+                ToneMapCached(&key, image.data(), output.data());
+            }
+        }
+    }
+
+    std::printf("%-7s %-5s %7s %9s %9s %9s %9s %9s %8s\n",
+        "backend", "cache", "count", "p50 ms", "p95 ms", "p99 ms", "max ms", "mean ms", "over SLO");
+
+    for (int backend = 0; backend < HDR_BACKEND_COUNT; backend++)
+    {
+        for (int hit = 0; hit < 2; hit++)
+        {
+            HDRLatencyStats s;
+            if (!GetLatencyStats(backend, hit, &s) || s.count == 0)
+                continue;
+
+            std::printf("%-7s %-5s %7lld %9.2f %9.2f %9.2f %9.2f %9.2f %8lld\n",
+                gBackendNames[backend], hit ? "hit" : "miss", s.count,
+                s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs, s.meanMs, s.overSlo);
+        }
+    }
+
+    HDRLatencyStats any;
+    GetLatencyStats(0, 0, &any);
+    std::printf("SLO %.1f ms\n", any.sloMs);
+
+    if (gl)
+        CleanupGLFW();
+    return 0;
+}
+
+/* ============================================================
+   Procedure: BenchQuality
+   ------------------------------------------------------------
+   Description:
+   Tone maps the synthetic image to BGRA8 on the CPU and on GL
+   and compares the crushed and full-scale channel counts. The
+   top eighth is replaced by a grey ramp from 0 to 0.001, whose
+   codes run from black (3) across the crush level to about 11,
+   so the crushed count tests where each backend puts the step
+   from code 3 to 4, not just black. Both backends truncate to
+   a code, but GL uploads half floats and has its own pow, so a
+   pixel right at a code step may land on either side: crushed
+   counts may differ by one ramp column (the band's rows), the
+   full-scale counts of the main ramp by one pixel per row.
+
+   Input parameters:
+   opt - Parsed benchmark options
+
+   Output parameters:
+   Returns 0 if the counts agree, 1 if they differ by more or
+   OpenGL could not be initialized.
+   ============================================================ */
+static int BenchQuality(const BenchOptions& opt)
+{
+    if (!InitGLFW())
+    {
+        std::printf("OpenGL initialization failed\n");
+        return 1;
+    }
+
+    std::vector<float> image = MakeSyntheticImage(opt.width, opt.height);
+    int bandRows = opt.height / 8;
+    for (int y = 0; y < bandRows; y++)
+    {
+        for (int x = 0; x < opt.width; x++)
+        {
+            float level = 0.001f * (float)x / (float)(opt.width > 1 ? opt.width - 1 : 1);
+            size_t i = ((size_t)y * opt.width + x) * 3;
+            image[i + 0] = image[i + 1] = image[i + 2] = level;
+        }
+    }
+    std::vector<unsigned char> output((size_t)opt.width * opt.height * 4);
+
+    EnableQualityStats(true);
+
+    HDRQualityStats cpu = {};
+    ToneMapCPU(image.data(), opt.width, opt.height, output.data(), 1.0f, 4.0f);
+    GetQualityStats(&cpu);
+
+    HDRQualityStats gl = {};
+    UploadToGLFormat(image.data(), opt.width, opt.height, output.data(), HDR_OUTPUT_BGRA8, 1.0f, 4.0f);
+    GetQualityStats(&gl);
+
+    EnableQualityStats(false);
+    CleanupGLFW();
+
+    std::printf("quality %dx%d, dark ramp rows %d\n", opt.width, opt.height, bandRows);
+    std::printf("%-7s %12s %12s %12s %12s %12s %12s\n",
+        "backend", "high R", "high G", "high B", "low R", "low G", "low B");
+
+    bool same = true;
+    for (const HDRQualityStats* q : { &cpu, &gl })
+    {
+        std::printf("%-7s %12lld %12lld %12lld %12lld %12lld %12lld\n", q == &cpu ? "CPU" : "GL",
+            q->clipHigh[0], q->clipHigh[1], q->clipHigh[2], q->clipLow[0], q->clipLow[1], q->clipLow[2]);
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        same = same && std::llabs(cpu.clipLow[c] - gl.clipLow[c]) <= bandRows;
+        same = same && std::llabs(cpu.clipHigh[c] - gl.clipHigh[c]) <= opt.height;
+    }
+
+    std::printf(same ? "crushed and clipped counts match\n" : "crushed or clipped counts differ\n");
+    return same ? 0 : 1;
+}
+
+/* ============================================================
+   Procedure: BenchSeam
+   ------------------------------------------------------------
+   Description:
+   Tone maps the synthetic image with ToneMapSplit, the GPU
+   taking bands from the top and the CPU from the bottom, and
+   compares each frame with a ToneMapCPU render. The GPU bands
+   raise to the gamma with the CPU kernel's log2 / exp2
+   approximation, but the GPU rounds its float arithmetic its
+   own way (no fused multiply-add, division to 2.5 ulp), so a
+   value within about 1e-6 of a code step may still land on the
+   other code. That tolerance is what this checks: one code at
+   most, on at most kSeamShare of the channels. The split share
+   adapts between frames, so later frames meet at other rows.
+
+   Input parameters:
+   opt - Parsed benchmark options
+
+   Output parameters:
+   Returns 0 within the tolerance, 1 beyond it or if OpenGL
+   could not be initialized.
+   ============================================================ */
+static int BenchSeam(const BenchOptions& opt)
+{
+    // Largest share of channels allowed to differ by one code
+    const double kSeamShare = 1e-4;
+
+    if (!InitGLFW())
+    {
+        std::printf("OpenGL initialization failed\n");
+        return 1;
+    }
+
+    std::vector<float> image = MakeSyntheticImage(opt.width, opt.height);
+    size_t bytes = (size_t)opt.width * opt.height * 4;
+    std::vector<unsigned char> cpu(bytes);
+    std::vector<unsigned char> split(bytes);
+
+    ToneMapCPU(image.data(), opt.width, opt.height, cpu.data(), 1.0f, 4.0f);
+
+    std::printf("seam %dx%d, %d frames\n", opt.width, opt.height, opt.iterations);
+    std::printf("%5s %10s %12s %8s\n", "frame", "gpu rows", "off by one", "max");
+
+    bool within = true;
+    for (int i = 0; i < opt.iterations; i++)
+    {
+        ToneMapSplit(image.data(), opt.width, opt.height, split.data(), 1.0f, 4.0f);
+
+        HDRStats stats = {};
+        GetHDRStats(&stats);
+
+        long long offByOne = 0;
+        int maxDiff = 0;
+        for (size_t p = 0; p < bytes; p++)
+        {
+            int diff = std::abs((int)split[p] - (int)cpu[p]);
+            offByOne += diff == 1;
+            maxDiff = std::max(maxDiff, diff);
+        }
+
+        std::printf("%5d %10d %12lld %8d\n", i, stats.splitGpuRows, offByOne, maxDiff);
+        within = within && maxDiff <= 1 && offByOne <= (long long)(kSeamShare * (double)bytes);
+    }
+
+    CleanupGLFW();
+
+    std::printf(within ? "split frames match the CPU within one code\n" : "split frames differ from the CPU\n");
+    return within ? 0 : 1;
+}
+
+/* ============================================================
+   Procedure: TimeProfile
+   ------------------------------------------------------------
+   Description:
+   Median ToneMapCPU time with a tune profile applied, after
+   one untimed warm-up call.
+
+   Input parameters:
+   opt           - Parsed benchmark options (iterations)
+   image         - Synthetic input
+   width, height - Size of image
+   profile       - Settings to measure
+
+   Output parameters:
+   Returns milliseconds per call.
+   ============================================================ */
+static double TimeProfile(const BenchOptions& opt, const std::vector<float>& image,
+    int width, int height, const HDRTuneProfile& profile)
+{
+    std::vector<unsigned char> output((size_t)width * height * 4);
+    float* input = const_cast<float*>(image.data());
+
+    SetTuneProfile(&profile);
+    ToneMapCPU(input, width, height, output.data(), 1.0f, 4.0f);
+
+    std::vector<double> times;
+    for (int i = 0; i < opt.iterations; i++)
+    {
+        double start = NowMs();
+        ToneMapCPU(input, width, height, output.data(), 1.0f, 4.0f);
+        times.push_back(NowMs() - start);
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+/* ============================================================
+   Procedure: BenchAutotune
+   ------------------------------------------------------------
+   Description:
+   Coordinate search over the tune profile: each dimension is
+   swept with the others fixed at their best value so far, in
+   two rounds. The streaming threshold is then set to the
+   smaller of the two tested output sizes (full and quarter
+   image) at which streaming stores win by more than 2%, or
+   left off. The result is applied and saved for this CPU.
+
+   Input parameters:
+   opt - Parsed benchmark options
+
+   Output parameters:
+   Returns 0 on success, 1 if the profile could not be saved.
+   ============================================================ */
+static int BenchAutotune(const BenchOptions& opt)
+{
+    char model[128];
+    GetCpuModel(model, sizeof(model));
+
+    std::vector<float> image = MakeSyntheticImage(opt.width, opt.height);
+
+    int hardware = (int)std::thread::hardware_concurrency();
+    std::vector<int> threadCounts;
+    for (int t = 1; t < hardware; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(std::max(hardware, 1));
+
+    struct Axis
+    {
+        const char* name;
+        int HDRTuneProfile::* field;
+        std::vector<int> values;
+    };
+    std::vector<Axis> axes = {
+        { "kernelVariant", &HDRTuneProfile::kernelVariant, { HDR_KERNEL_SCALAR, HDR_KERNEL_AVX2 } },
+        { "unroll", &HDRTuneProfile::unroll, { 1, 2 } },
+        { "tileWidth", &HDRTuneProfile::tileWidth, { 64, 128, 256, 512, 1024 } },
+        { "tileHeight", &HDRTuneProfile::tileHeight, { 4, 8, 16, 32, 64 } },
+        { "threads", &HDRTuneProfile::threads, threadCounts },
+    };
+
+    std::printf("autotune %dx%d, %d iterations, CPU: %s\n",
+        opt.width, opt.height, opt.iterations, model);
+
+    HDRTuneProfile best = { 256, 16, 0, HDR_KERNEL_AUTO, 1, 0 };
+    double bestMs = TimeProfile(opt, image, opt.width, opt.height, best);
+    std::printf("  default                 %8.2f ms\n", bestMs);
+
+    for (int round = 0; round < 2; round++)
+    {
+        for (const Axis& axis : axes)
+        {
+            for (int value : axis.values)
+            {
+                HDRTuneProfile trial = best;
+                trial.*axis.field = value;
+                double ms = TimeProfile(opt, image, opt.width, opt.height, trial);
+                std::printf("  %-14s = %-6d %8.2f ms\n", axis.name, value, ms);
+
+                if (ms < bestMs)
+                {
+                    bestMs = ms;
+                    best = trial;
+                }
+            }
+        }
+    }
+
+    // Streaming stores: full image, then a quarter of it
+    int sizes[2][2] = { { opt.width, opt.height }, { std::max(opt.width / 2, 1), std::max(opt.height / 2, 1) } };
+    for (auto& size : sizes)
+    {
+        std::vector<float> part = MakeSyntheticImage(size[0], size[1]);
+        HDRTuneProfile off = best;
+        HDRTuneProfile on = best;
+        off.streamThreshold = 0;
+        on.streamThreshold = 1;
+
+        double offMs = TimeProfile(opt, part, size[0], size[1], off);
+        double onMs = TimeProfile(opt, part, size[0], size[1], on);
+        std::printf("  stream %dx%d          %8.2f ms (off %.2f ms)\n", size[0], size[1], onMs, offMs);
+
+        if (onMs < offMs * 0.98)
+            best.streamThreshold = (long long)size[0] * size[1] * 4;
+    }
+
+    SetTuneProfile(&best);
+    bool saved = SaveTuneProfile(opt.profilePath);
+
+    std::printf("best: tile %dx%d, %d threads, variant %d, unroll %d, stream from %lld bytes, %.2f ms\n",
+        best.tileWidth, best.tileHeight, best.threads, best.kernelVariant, best.unroll,
+        best.streamThreshold, bestMs);
+    std::printf(saved ? "profile saved\n" : "could not save the profile\n");
+    return saved ? 0 : 1;
+}
+
+/* ============================================================
+   Procedure: main
+   ------------------------------------------------------------
+   Description:
+   Parses the command line and dispatches to a benchmark.
+   ============================================================ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::printf("usage: Bench <readback|latency|autotune|quality|seam> [width] [height] [iterations] [--shaders <dir>] [--slo <ms>] [--profile <file>]\n");
+        return 1;
+    }
+
+    BenchOptions opt;
+    std::string command = argv[1];
+
+    // Positional size arguments followed by optional flags
+    int positional = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--shaders") == 0 && i + 1 < argc)
+        {
+            SetShaderDirectory(argv[++i]);
+            continue;
+        }
+        if (std::strcmp(argv[i], "--slo") == 0 && i + 1 < argc)
+        {
+            SetLatencySLO(std::atof(argv[++i]));
+            continue;
+        }
+        if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            opt.profilePath = argv[++i];
+            continue;
+        }
+
+        int value = std::atoi(argv[i]);
+        if (value <= 0)
+            continue;
+
+        if (positional == 0) opt.width = value;
+        else if (positional == 1) opt.height = value;
+        else if (positional == 2) opt.iterations = value;
+        positional++;
+    }
+
+    if (command == "readback")
+        return BenchReadback(opt);
+    if (command == "latency")
+        return BenchLatency(opt);
+    if (command == "autotune")
+        return BenchAutotune(opt);
+    if (command == "quality")
+        return BenchQuality(opt);
+    if (command == "seam")
+        return BenchSeam(opt);
+
+    std::printf("unknown command: %s\n", command.c_str());
+    return 1;
+}
@@ -0,0 +1,298 @@
+// ============================================================
+// File: Batch.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Batch tone mapping of a whole shoot with consistent exposure,
+// in two phases. Phase one decodes every file in parallel, one
+// file per worker, and reduces it to its luminance figures as
+// soon as it is decoded; no image outlives its own analysis, so
+// memory stays at one decoded image per thread and the phase
+// runs at decoding speed. The exposures are then solved across
+// the set from those figures alone. Phase two decodes each file
+// again and tone maps it with its exposure, decoding the next
+// file while the current one is tone mapped.
+// ============================================================
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <string>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#include "HDR.h"
+#include "CpuPipeline.h"
+#include "Exposure.h"
+#include "Png.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Gamma 8-bit files are linearized with (as the app and stb_image)
+static const float kDecodeGamma = 2.2f;
+
+// Rank of HDRBatchImage::highlight
+static const float kHighlightRank = 0.99f;
+
+// Largest exposure correction of one image, in stops
+static const float kMaxCorrectionStops = 4.0f;
+
+/* ============================================================
+   DecodedImage
+   ------------------------------------------------------------
+   Linear RGB floats of one file (empty if unreadable).
+   ============================================================ */
+struct DecodedImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<float> linearRGB;
+};
+
+/* ============================================================
+   Procedure: DecodeLinear
+   ------------------------------------------------------------
+   Description:
+   Decodes a file to linear RGB floats: HDR formats as stored,
+   8-bit ones linearized with kDecodeGamma.
+   ============================================================ */
+static DecodedImage DecodeLinear(const char* path)
+{
+    DecodedImage image;
+    int channels;
+    float* data = stbi_loadf(path, &image.width, &image.height, &channels, 3);
+    if (!data)
+        return image;
+
+    image.linearRGB.assign(data, data + (size_t)image.width * image.height * 3);
+    stbi_image_free(data);
+    return image;
+}
+
+/* ============================================================
+   Procedure: AnalyzeFile
+   ------------------------------------------------------------
+   Description:
+   Decodes one file and fills its size and luminance figures.
+   8-bit files are decoded as bytes and linearized through a
+   table, which keeps the analysis far cheaper than decoding.
+   ============================================================ */
+static void AnalyzeFile(const char* path, HDRBatchImage& image)
+{
+    image = {};
+    LogLuminanceStats stats;
+    int width, height, channels;
+
+    if (stbi_is_hdr(path))
+    {
+        float* data = stbi_loadf(path, &width, &height, &channels, 3);
+        if (!data)
+            return;
+
+        size_t pixels = (size_t)width * height;
+        for (size_t i = 0; i < pixels; i++)
+        {
+            float logLum;
+            if (LogLuminance(data + i * 3, logLum))
+                stats.Add(logLum);
+        }
+        stbi_image_free(data);
+    }
+    else
+    {
+        unsigned char* data = stbi_load(path, &width, &height, &channels, 3);
+        if (!data)
+            return;
+
+        float linear[256];
+        for (int v = 0; v < 256; v++)
+            linear[v] = std::pow(v / 255.0f, kDecodeGamma);
+
+        size_t pixels = (size_t)width * height;
+        for (size_t i = 0; i < pixels; i++)
+        {
+            const unsigned char* p = data + i * 3;
+            float rgb[3] = { linear[p[0]], linear[p[1]], linear[p[2]] };
+
+            float logLum;
+            if (LogLuminance(rgb, logLum))
+                stats.Add(logLum);
+        }
+        stbi_image_free(data);
+    }
+
+    image.width = width;
+    image.height = height;
+    if (stats.count == 0)
+        return;
+
+    float low, high;
+    stats.Percentile(kHighlightRank, low, high);
+    image.logAverage = std::exp2(stats.LogAverage());
+    image.highlight = std::exp2(0.5f * (low + high));
+    image.exposure = kExposureKey / image.logAverage;
+    image.status = 1;
+}
+
+/* ============================================================
+   Procedure: BatchAnalyze
+   ------------------------------------------------------------
+   Description:
+   Phase one: decodes every file, in parallel, and measures its
+   luminance. Only the figures are kept. exposure is set to the
+   image's own auto exposure (log average on middle grey).
+
+   Input parameters:
+   paths  - File names (any format stb_image reads)
+   count  - Number of files
+
+   Output parameters:
+   images - count entries, status 0 for unreadable files
+   Returns the number of files read.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int BatchAnalyze(const char* const* paths, int count, HDRBatchImage* images)
+{
+    if (!paths || !images || count <= 0)
+        return 0;
+
+    ThreadPool::Instance().ParallelFor(count, [&](int i)
+    {
+        AnalyzeFile(paths[i], images[i]);
+    });
+
+    int read = 0;
+    for (int i = 0; i < count; i++)
+        read += images[i].status;
+    return read;
+}
+
+/* ============================================================
+   Procedure: BatchSolveExposure
+   ------------------------------------------------------------
+   Description:
+   Chooses consistent exposures for an analysed set. The image
+   with the median log average gets the given exposure; every
+   other image is corrected towards the median brightness by
+   strength times its distance from it in stops (at most
+   kMaxCorrectionStops), so strength 1 renders every image at
+   the same mean brightness and 0 leaves one exposure for all.
+   A correction that brightens an image never pushes its
+   highlights past the white point further than the given
+   exposure already would.
+
+   Input parameters:
+   images     - Entries filled by BatchAnalyze
+   count      - Number of entries
+   exposure   - Exposure of the median image
+   strength   - Share of each image's deviation corrected [0, 1]
+   whitePoint - White point the set will be tone mapped with
+
+   Output parameters:
+   images     - exposure of every read entry
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void BatchSolveExposure(HDRBatchImage* images, int count, float exposure, float strength, float whitePoint)
+{
+    if (!images || count <= 0)
+        return;
+
+    std::vector<float> logs;
+    for (int i = 0; i < count; i++)
+    {
+        if (images[i].status)
+            logs.push_back(std::log2(images[i].logAverage));
+    }
+
+    if (logs.empty())
+        return;
+
+    std::nth_element(logs.begin(), logs.begin() + logs.size() / 2, logs.end());
+    float median = logs[logs.size() / 2];
+    strength = std::clamp(strength, 0.0f, 1.0f);
+
+    for (int i = 0; i < count; i++)
+    {
+        HDRBatchImage& image = images[i];
+        if (!image.status)
+            continue;
+
+        float stops = strength * (median - std::log2(image.logAverage));
+        stops = std::clamp(stops, -kMaxCorrectionStops, kMaxCorrectionStops);
+        image.exposure = exposure * std::exp2(stops);
+
+        if (stops > 0.0f && whitePoint > 0.0f)
+            image.exposure = std::min(image.exposure, std::max(exposure, whitePoint / image.highlight));
+    }
+}
+
+/* ============================================================
+   Procedure: BatchToneMap
+   ------------------------------------------------------------
+   Description:
+   Phase two: tone maps every read file on the CPU with its
+   solved exposure and writes it as an RGB PNG. The next file
+   is decoded while the current one is tone mapped.
+
+   Input parameters:
+   paths      - File names, as given to BatchAnalyze
+   outputs    - PNG file names to write
+   images     - Entries filled by BatchSolveExposure
+   count      - Number of files
+   whitePoint - White point value for tone mapping
+
+   Output parameters:
+   Returns the number of files written.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int BatchToneMap(const char* const* paths, const char* const* outputs, const HDRBatchImage* images,
+    int count, float whitePoint)
+{
+    if (!paths || !outputs || !images || count <= 0)
+        return 0;
+
+    auto decode = [&](int i)
+    {
+        return std::async(std::launch::async, [path = paths[i], read = images[i].status]
+        {
+            return read ? DecodeLinear(path) : DecodedImage();
+        });
+    };
+
+    int written = 0;
+    std::future<DecodedImage> next = decode(0);
+    std::vector<unsigned char> bgra;
+    std::vector<unsigned char> rgb;
+
+    for (int i = 0; i < count; i++)
+    {
+        DecodedImage image = next.get();
+        if (i + 1 < count)
+            next = decode(i + 1);
+
+        if (image.linearRGB.empty())
+            continue;
+
+        size_t pixels = (size_t)image.width * image.height;
+        bgra.resize(pixels * 4);
+        ToneMapCPURun(image.linearRGB.data(), image.width, image.height, bgra.data(),
+            images[i].exposure, whitePoint, nullptr);
+
+        rgb.resize(pixels * 3);
+        for (size_t p = 0; p < pixels; p++)
+        {
+            rgb[3 * p + 0] = bgra[4 * p + 2];
+            rgb[3 * p + 1] = bgra[4 * p + 1];
+            rgb[3 * p + 2] = bgra[4 * p + 0];
+        }
+
+        if (WriteFileBytes(outputs[i], EncodePNG(rgb.data(), image.width, image.height, 3)))
+            written++;
+    }
+
+    return written;
+}
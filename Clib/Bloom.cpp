@@ -0,0 +1,334 @@
+// ============================================================
+// File: Bloom.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Bloom: light above a threshold spreads around highlights the
+// way a lens and the eye scatter it, added to the linear HDR
+// image before the tone curve. The light above the threshold is
+// taken per pixel (so a small specular highlight keeps all of
+// its light) and reduced to a chain of levels, each half the
+// size of the one before, starting at a quarter of the image.
+// Every level is blurred a little and the levels are summed
+// from the coarsest up; the sum of Gaussians of doubling width
+// gives the long tail of real glare at the cost of blurring a
+// sixteenth of the image. The CPU path does this once per
+// render and adds the result inside the fused tile sweep as a
+// pointwise stage, so the image is read one extra time and no
+// full-size buffer is allocated. The GL path runs the same
+// chain as render graph passes (HDR.cpp, bloom.frag).
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "HDR.h"
+#include "Bloom.h"
+#include "Gaussian.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Most levels of the chain (the last one spans 512 image pixels
+// per level pixel)
+static const int kMaxLevels = 8;
+
+// Largest radius setting (fraction of the longer side)
+static const float kMaxRadius = 0.5f;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gThreshold, gIntensity, gRadius
+ * Bloom settings (SetBloomParams).
+ * Range: threshold >= 0 (default 1), intensity >= 0 (default 0,
+ * off), radius (0, kMaxRadius] (default 0.05)
+ */
+static std::atomic<float> gThreshold{ 1.0f };
+static std::atomic<float> gIntensity{ 0.0f };
+static std::atomic<float> gRadius{ 0.05f };
+
+/* ============================================================
+   BloomLevel
+   ------------------------------------------------------------
+   Three planes (R, G, B) of one level of the chain.
+   ============================================================ */
+struct BloomLevel
+{
+    int width = 0;
+    int height = 0;
+    std::vector<float> planes;
+
+    float* Row(int c, int y) { return planes.data() + ((size_t)c * height + y) * width; }
+    const float* Row(int c, int y) const { return planes.data() + ((size_t)c * height + y) * width; }
+};
+
+/* ============================================================
+   Procedure: GetBloomSettings / BloomEnabled
+   ============================================================ */
+BloomSettings GetBloomSettings()
+{
+    BloomSettings settings;
+    settings.threshold = gThreshold;
+    settings.intensity = gIntensity;
+    settings.radius = gRadius;
+    return settings;
+}
+
+bool BloomEnabled()
+{
+    return gIntensity > 0.0f;
+}
+
+/* ============================================================
+   Procedure: BloomLevels
+   ------------------------------------------------------------
+   Description:
+   Fewest levels whose coarsest blur (kBloomSigma pixels of
+   that level) reaches the radius, stopping early once a level
+   is a single pixel.
+   ============================================================ */
+int BloomLevels(int width, int height, const BloomSettings& settings)
+{
+    float reach = settings.radius * std::max(width, height);
+    int side = (std::max(width, height) + kBloomFactor - 1) / kBloomFactor;
+
+    int levels = 1;
+    float sigma = kBloomSigma * kBloomFactor;
+    while (levels < kMaxLevels && sigma < reach && side > 1)
+    {
+        levels++;
+        sigma *= 2.0f;
+        side = (side + 1) / 2;
+    }
+    return levels;
+}
+
+/* ============================================================
+   Procedure: FirstLevel
+   ------------------------------------------------------------
+   Description:
+   Light above the threshold at a quarter of the image size:
+   each output row reads 4 image rows through the source,
+   thresholds every pixel and halves them twice. Rows are
+   built in parallel.
+   ============================================================ */
+static BloomLevel FirstLevel(const StageSource& source, int width, int height, float threshold)
+{
+    int halfWidth = (width + 1) / 2;
+
+    BloomLevel level;
+    level.width = (halfWidth + 1) / 2;
+    level.height = (((height + 1) / 2) + 1) / 2;
+    level.planes.resize((size_t)level.width * level.height * 3);
+
+    ThreadPool::Instance().ParallelFor(level.height, [&](int y)
+    {
+        int y0 = y * kBloomFactor;
+        int rows = std::min(kBloomFactor, height - y0);
+
+        std::vector<float> buffer((size_t)width * rows * 3 + (size_t)halfWidth * 2);
+        TileBuf tile;
+        tile.channels = 3;
+        tile.x0 = 0;
+        tile.y0 = y0;
+        tile.width = width;
+        tile.height = rows;
+        tile.stride = width;
+        for (int c = 0; c < 3; c++)
+            tile.planes[c] = buffer.data() + (size_t)c * width * rows;
+        tile.planes[3] = nullptr;
+        source(tile);
+
+        for (int r = 0; r < rows; r++)
+            BloomThreshold(tile.Row(0, y0 + r), tile.Row(1, y0 + r), tile.Row(2, y0 + r), width, threshold);
+
+        // Missing rows at the bottom edge repeat the last one
+        auto row = [&](int c, int r) { return tile.Row(c, y0 + std::min(r, rows - 1)); };
+        float* half0 = buffer.data() + (size_t)width * rows * 3;
+        float* half1 = half0 + halfWidth;
+        for (int c = 0; c < 3; c++)
+        {
+            DownsampleRow2x2(row(c, 0), row(c, 1), width, half0);
+            if (rows > 2)
+            {
+                DownsampleRow2x2(row(c, 2), row(c, 3), width, half1);
+                DownsampleRow2x2(half0, half1, halfWidth, level.Row(c, y));
+            }
+            else
+            {
+                DownsampleRow2x2(half0, half0, halfWidth, level.Row(c, y));
+            }
+        }
+    });
+
+    return level;
+}
+
+/* ============================================================
+   Procedure: Downsample
+   ------------------------------------------------------------
+   Description:
+   Next level of the chain: 2 x 2 means of the level below.
+   ============================================================ */
+static BloomLevel Downsample(const BloomLevel& fine)
+{
+    BloomLevel coarse;
+    coarse.width = (fine.width + 1) / 2;
+    coarse.height = (fine.height + 1) / 2;
+    coarse.planes.resize((size_t)coarse.width * coarse.height * 3);
+
+    ThreadPool::Instance().ParallelFor(coarse.height, [&](int y)
+    {
+        int y1 = std::min(2 * y + 1, fine.height - 1);
+        for (int c = 0; c < 3; c++)
+            DownsampleRow2x2(fine.Row(c, 2 * y), fine.Row(c, y1), fine.width, coarse.Row(c, y));
+    });
+
+    return coarse;
+}
+
+/* ============================================================
+   Procedure: CoarseRows
+   ------------------------------------------------------------
+   Description:
+   Rows of a plane factor times coarser above and below fine
+   row y, and the weight of the lower one (edges repeated).
+   ============================================================ */
+static void CoarseRows(int y, int factor, int coarseHeight, int& row0, int& row1, float& wy)
+{
+    float fy = (y + 0.5f) / factor - 0.5f;
+    float fl = std::floor(fy);
+    wy = fy - fl;
+    row0 = std::clamp((int)fl, 0, coarseHeight - 1);
+    row1 = std::clamp((int)fl + 1, 0, coarseHeight - 1);
+}
+
+/* ============================================================
+   Procedure: BuildBloom
+   ------------------------------------------------------------
+   Description:
+   The whole chain: first level, further levels, a blur of
+   each (recursive Gaussian, so its cost does not grow with the
+   level's reach) and the sum of all levels, upsampled level by
+   level into the first. Runs on the thread pool.
+   ============================================================ */
+static BloomLevel BuildBloom(const StageSource& source, int width, int height, float exposure,
+    const BloomSettings& settings)
+{
+    int count = BloomLevels(width, height, settings);
+
+    // The threshold is on exposed luminance; the image is linear
+    std::vector<BloomLevel> levels;
+    levels.push_back(FirstLevel(source, width, height, settings.threshold / exposure));
+    while ((int)levels.size() < count)
+        levels.push_back(Downsample(levels.back()));
+
+    for (BloomLevel& level : levels)
+        for (int c = 0; c < 3; c++)
+            GaussianBlurPlane(level.Row(c, 0), level.width, level.height, kBloomSigma);
+
+    for (int k = count - 2; k >= 0; k--)
+    {
+        BloomLevel& fine = levels[k];
+        const BloomLevel& coarse = levels[k + 1];
+
+        ThreadPool::Instance().ParallelFor(fine.height, [&](int y)
+        {
+            int row0, row1;
+            float wy;
+            CoarseRows(y, 2, coarse.height, row0, row1, wy);
+            for (int c = 0; c < 3; c++)
+                UpsampleAddRow(coarse.Row(c, row0), coarse.Row(c, row1), wy, coarse.width, 2,
+                    0, fine.width, 1.0f, fine.Row(c, y));
+        });
+    }
+
+    return std::move(levels[0]);
+}
+
+/* ============================================================
+   Procedure: BloomStage
+   ------------------------------------------------------------
+   Description:
+   Builds the bloom of the image and returns the stage adding
+   it, upsampled from the first level, to every tile. The sum
+   of the levels is divided by their number, so intensity 1
+   adds back about as much light as was above the threshold.
+
+   Input parameters:
+   source        - Source of the image
+   width, height - Image size in pixels
+   exposure      - Exposure the image will be tone mapped with
+   settings      - Bloom settings (intensity > 0)
+   ============================================================ */
+Stage BloomStage(const StageSource& source, int width, int height, float exposure,
+    const BloomSettings& settings)
+{
+    auto bloom = std::make_shared<BloomLevel>(BuildBloom(source, width, height, exposure, settings));
+    float scale = settings.intensity / BloomLevels(width, height, settings);
+
+    Stage stage;
+    stage.name = "Bloom";
+    stage.channels = 3;
+    stage.run = [bloom, scale](const TileBuf&, TileBuf& out)
+    {
+        for (int y = out.y0; y < out.y0 + out.height; y++)
+        {
+            int row0, row1;
+            float wy;
+            CoarseRows(y, kBloomFactor, bloom->height, row0, row1, wy);
+            for (int c = 0; c < 3; c++)
+                UpsampleAddRow(bloom->Row(c, row0), bloom->Row(c, row1), wy, bloom->width, kBloomFactor,
+                    out.x0, out.width, scale, out.Row(c, y));
+        }
+    };
+    return stage;
+}
+
+/* ============================================================
+   Procedure: SetBloomParams
+   ------------------------------------------------------------
+   Description:
+   Sets the bloom added before the Extended Reinhard curve by
+   following CPU and GL renders (ToneMapCPU, UploadToGL and
+   the renders built on them). Tiled viewers (deep zoom, tile
+   server) and the CLAHE and local operators render without
+   it. Split renders go to the CPU while bloom is on, since it
+   crosses their bands. GL blurs each level with a sampled
+   kernel and the CPU recursively, so the two differ by a
+   little. Cached renders made with other settings are
+   dropped.
+
+   Input parameters:
+   threshold - Exposed luminance above which light blooms
+               (>= 0; 1 is the white the curve maps near 0.5
+               at white point 4)
+   intensity - Share of that light added back (0 turns bloom
+               off, 1 adds it all)
+   radius    - Reach of the glare as a fraction of the longer
+               image side (0, 0.5]
+   ============================================================ */
+extern "C" __declspec(dllexport) void SetBloomParams(float threshold, float intensity, float radius)
+{
+    threshold = std::max(threshold, 0.0f);
+    intensity = std::max(intensity, 0.0f);
+    radius = std::clamp(radius, 1.0e-4f, kMaxRadius);
+
+    bool changed = gThreshold.exchange(threshold) != threshold;
+    changed |= gIntensity.exchange(intensity) != intensity;
+    changed |= gRadius.exchange(radius) != radius;
+    if (!changed)
+        return;
+
+    SpeculateCancel();
+    RenderCacheClear();
+}
@@ -0,0 +1,35 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "StageGraph.h"
+
+// Bloom settings (SetBloomParams)
+struct BloomSettings
+{
+	// Exposed luminance above which light blooms
+	float threshold;
+	// Share of the bloomed light added back (0 = bloom off)
+	float intensity;
+	// Reach of the widest level as a fraction of the longer side
+	float radius;
+};
+
+// The first bloom level has one pixel per kBloomFactor x kBloomFactor
+// image pixels, each further level half as many per side; every
+// level is blurred with kBloomSigma of its own pixels
+const int kBloomFactor = 4;
+const float kBloomSigma = 2.0f;
+
+// Current settings; bloom is on while intensity > 0
+BloomSettings GetBloomSettings();
+bool BloomEnabled();
+
+// Levels of the bloom chain of an image of this size
+int BloomLevels(int width, int height, const BloomSettings& settings);
+
+// Pointwise CPU stage adding the bloom of the whole image (built from
+// source when the stage is made) to linear RGB before the tone map
+Stage BloomStage(const StageSource& source, int width, int height, float exposure,
+	const BloomSettings& settings);
+
+#endif
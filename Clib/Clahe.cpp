@@ -0,0 +1,359 @@
+// ============================================================
+// File: Clahe.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Contrast-limited adaptive histogram equalization (CLAHE) as
+// an alternative tone mapping operator. It works on the display
+// luminance of the Extended Reinhard result, which is bounded,
+// so exposure and white point still set the base curve and
+// CLAHE redistributes contrast within each region. The image is
+// cut into a grid of tiles; each tile's luminance histogram is
+// clipped at the clip limit, the excess spread over all bins,
+// and its running sum becomes the tile's curve. Every pixel
+// blends the curves of its four nearest tile centres, so there
+// are no seams between tiles.
+//
+// The CPU version builds the histograms in parallel row bands
+// and applies the curves in parallel row bands, each a single
+// read of the input; the GL version (RenderToneMap with
+// HDR_OPERATOR_CLAHE) builds them on the GPU.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "HDR.h"
+#include "Clahe.h"
+#include "Dither.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Grade.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "ThreadPool.h"
+#include "Tune.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Rows per band of both passes
+static const int kBandRows = 64;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gClipLimit
+ * Largest bin of a tile histogram, as a multiple of the mean
+ * bin (SetCLAHEParams). 1 keeps close to the base curve.
+ * Range: >= 1, default 2
+ */
+static std::atomic<float> gClipLimit{ 2.0f };
+
+/*
+ * gTiles
+ * Tiles along the longer side of the image (SetCLAHEParams).
+ * Range: 1 .. 64, default 8
+ */
+static std::atomic<int> gTiles{ 8 };
+
+/* ============================================================
+   Procedure: ClaheGridFor
+   ============================================================ */
+ClaheGrid ClaheGridFor(int width, int height)
+{
+    int tiles = gTiles;
+    int longer = std::max(width, height);
+    int shorter = std::min(width, height);
+
+    // Never more tiles than pixels, at least one
+    int along = std::min(tiles, longer);
+    int across = std::clamp((int)((long long)tiles * shorter / longer), 1, shorter);
+
+    ClaheGrid grid;
+    grid.tilesX = width >= height ? along : across;
+    grid.tilesY = width >= height ? across : along;
+    grid.clipLimit = gClipLimit;
+    return grid;
+}
+
+/* ============================================================
+   Procedure: ClipCurve
+   ------------------------------------------------------------
+   Description:
+   Turns one tile histogram into its curve: bins above the
+   limit are cut to it, the cut counts spread evenly over all
+   bins, and the running sum, normalized to [0, 1], is taken at
+   every bin edge.
+   ============================================================ */
+static void ClipCurve(const uint32_t* histogram, float clipLimit, float* curve)
+{
+    double total = 0.0;
+    for (int k = 0; k < kClaheBins; k++)
+        total += histogram[k];
+
+    double limit = std::max(1.0, clipLimit * total / kClaheBins);
+    double excess = 0.0;
+    for (int k = 0; k < kClaheBins; k++)
+        excess += std::max(0.0, histogram[k] - limit);
+
+    double share = excess / kClaheBins;
+    double sum = 0.0;
+    curve[0] = 0.0f;
+    for (int k = 0; k < kClaheBins; k++)
+    {
+        sum += std::min((double)histogram[k], limit) + share;
+        curve[k + 1] = total > 0.0 ? (float)(sum / total) : (k + 1) / (float)kClaheBins;
+    }
+}
+
+/* ============================================================
+   Procedure: BuildTileCurves
+   ------------------------------------------------------------
+   Description:
+   First pass: tone maps the image band by band, bins every
+   pixel into its tile's histogram and turns the histograms
+   into curves. A band never spans two tile rows; it counts
+   into its own histograms, which are added to the tiles' at
+   its end.
+
+   Output parameters:
+   Returns tilesX * tilesY curves of kClaheEdges values, row
+   by row.
+   ============================================================ */
+static std::vector<float> BuildTileCurves(const float* linearRGB, int width, int height, float exposure,
+    float whitePoint, const ClaheGrid& grid)
+{
+    int tiles = grid.tilesX * grid.tilesY;
+
+    // Histogram offset of every column's tile
+    std::vector<int> columnOffset(width);
+    for (int x = 0; x < width; x++)
+        columnOffset[x] = (int)((long long)x * grid.tilesX / width) * kClaheBins;
+
+    struct Band { int y0, y1, tileRow; };
+    std::vector<Band> bands;
+    for (int ty = 0; ty < grid.tilesY; ty++)
+    {
+        int top = (int)((long long)ty * height / grid.tilesY);
+        int bottom = (int)((long long)(ty + 1) * height / grid.tilesY);
+        for (int y = top; y < bottom; y += kBandRows)
+            bands.push_back({ y, std::min(y + kBandRows, bottom), ty });
+    }
+
+    std::vector<uint32_t> histograms((size_t)tiles * kClaheBins, 0);
+    std::mutex mutex;
+    ColorGrade grade = GetColorGrade();
+
+    ThreadPool::Instance().ParallelFor((int)bands.size(), [&](int i)
+    {
+        const Band& band = bands[i];
+        std::vector<uint32_t> local((size_t)grid.tilesX * kClaheBins, 0);
+        std::vector<float> planes((size_t)width * 3);
+        std::vector<int> index(width);
+        float* r = planes.data();
+        float* g = r + width;
+        float* b = g + width;
+
+        for (int y = band.y0; y < band.y1; y++)
+        {
+            DeinterleaveRGB(linearRGB + (size_t)y * width * 3, width, r, g, b);
+            ToneMapPlanar(r, g, b, width, exposure, whitePoint, nullptr, grade);
+            ClaheBins(r, g, b, width, kClaheBins, index.data());
+
+            for (int x = 0; x < width; x++)
+                local[columnOffset[x] + index[x]]++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t* row = histograms.data() + (size_t)band.tileRow * grid.tilesX * kClaheBins;
+        for (size_t k = 0; k < local.size(); k++)
+            row[k] += local[k];
+    });
+
+    std::vector<float> curves((size_t)tiles * kClaheEdges);
+    for (int t = 0; t < tiles; t++)
+        ClipCurve(histograms.data() + (size_t)t * kClaheBins, grid.clipLimit, curves.data() + (size_t)t * kClaheEdges);
+    return curves;
+}
+
+/* ============================================================
+   Procedure: ApplyTileCurves
+   ------------------------------------------------------------
+   Description:
+   Second pass: tone maps the image again, band by band, and
+   maps every pixel through the curves of its four nearest tile
+   centres. Each row first blends the curves of its two tile
+   rows into one row of curves; the pixels then only blend two
+   tile columns (ClahePlanar). Pixels outside the outer centres
+   use the nearest curves alone.
+   ============================================================ */
+static void ApplyTileCurves(const float* linearRGB, int width, int height, unsigned char* outputBGRA,
+    float exposure, float whitePoint, const ClaheGrid& grid, const std::vector<float>& curves)
+{
+    // Left tile column and weight of the right one, per column
+    std::vector<int> tileBase(width);
+    std::vector<float> tileWeight(width);
+    for (int x = 0; x < width; x++)
+    {
+        float t = std::clamp((x + 0.5f) * grid.tilesX / width - 0.5f, 0.0f, (float)(grid.tilesX - 1));
+        int t0 = (int)t;
+        tileBase[x] = t0 * kClaheEdges;
+        tileWeight[x] = t - t0;
+    }
+
+    long long threshold = GetKernelConfig().streamThreshold;
+    bool stream = threshold > 0 && (long long)width * height * 4 >= threshold;
+    int bands = (height + kBandRows - 1) / kBandRows;
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+
+    ThreadPool::Instance().ParallelFor(bands, [&](int band)
+    {
+        // One padding column: the right column of the last tile
+        std::vector<float> rowCurves((size_t)(grid.tilesX + 1) * kClaheEdges);
+        std::vector<float> planes((size_t)width * 3);
+        float* r = planes.data();
+        float* g = r + width;
+        float* b = g + width;
+
+        int y1 = std::min(height, (band + 1) * kBandRows);
+        for (int y = band * kBandRows; y < y1; y++)
+        {
+            float t = std::clamp((y + 0.5f) * grid.tilesY / height - 0.5f, 0.0f, (float)(grid.tilesY - 1));
+            int t0 = (int)t;
+            int t1 = std::min(t0 + 1, grid.tilesY - 1);
+            float w = t - t0;
+
+            const float* upper = curves.data() + (size_t)t0 * grid.tilesX * kClaheEdges;
+            const float* lower = curves.data() + (size_t)t1 * grid.tilesX * kClaheEdges;
+            size_t count = (size_t)grid.tilesX * kClaheEdges;
+            for (size_t k = 0; k < count; k++)
+                rowCurves[k] = upper[k] + w * (lower[k] - upper[k]);
+            std::copy(rowCurves.begin() + count - kClaheEdges, rowCurves.begin() + count, rowCurves.begin() + count);
+
+            DeinterleaveRGB(linearRGB + (size_t)y * width * 3, width, r, g, b);
+            ToneMapPlanar(r, g, b, width, exposure, whitePoint, nullptr, grade);
+            ClahePlanar(r, g, b, width, rowCurves.data(), tileBase.data(), tileWeight.data(), kClaheBins);
+            if (lut)
+                CubeLutPlanar(r, g, b, width, *lut);
+            StoreBGRA8(r, g, b, width, outputBGRA + (size_t)y * width * 4, stream, nullptr, DitherAt(0, y));
+        }
+    });
+}
+
+/* ============================================================
+   Procedure: ToneMapCLAHECPU
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image with CLAHE on the CPU (see
+   the file description and SetCLAHEParams). Both passes run in
+   parallel row bands on the thread pool, so the time scales
+   with the cores and the memory used is a few rows per thread
+   beyond the output. Quality counters are not gathered.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier of the base curve
+   whitePoint  - White point of the base curve
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapCLAHECPU(
+    float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint)
+{
+    if (!linearRGB || !outputBGRA || width <= 0 || height <= 0)
+        return;
+
+    TuneEnsureLoaded();
+
+    ClaheGrid grid = ClaheGridFor(width, height);
+    std::vector<float> curves = BuildTileCurves(linearRGB, width, height, exposure, whitePoint, grid);
+    ApplyTileCurves(linearRGB, width, height, outputBGRA, exposure, whitePoint, grid, curves);
+}
+
+/* ============================================================
+   Procedure: ToneMapCLAHEGL
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image with CLAHE on the GPU and
+   reads back the result in the requested output format. The
+   tile histograms and curves are built by GPU passes before
+   the tone mapping pass. Quality counters are not gathered.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   format      - HDROutputFormat of the output buffer
+   exposure    - Exposure multiplier of the base curve
+   whitePoint  - White point of the base curve
+
+   Output parameters:
+   output      - Pointer to a tightly packed output buffer of
+                 width * height * GetOutputBytesPerPixel(format)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapCLAHEGL(
+    float* linearRGB,
+    int width,
+    int height,
+    void* output,
+    int format,
+    float exposure,
+    float whitePoint)
+{
+    GLToneMapParams params;
+    params.format = format;
+    params.exposure = exposure;
+    params.whitePoint = whitePoint;
+    params.op = HDR_OPERATOR_CLAHE;
+
+    GLThreadRun([&]
+    {
+        RenderToneMap(linearRGB, width, height, output, params);
+    });
+}
+
+/* ============================================================
+   Procedure: SetCLAHEParams
+   ------------------------------------------------------------
+   Description:
+   Sets the CLAHE tile grid and clip limit of following CLAHE
+   renders. Fewer, larger tiles give a gentler, more global
+   result; a higher clip limit more local contrast (and more
+   noise). Cached renders made with other settings are dropped.
+
+   Input parameters:
+   clipLimit - Largest histogram bin as a multiple of the mean
+               bin (>= 1; 1 keeps close to the base curve)
+   tiles     - Tiles along the longer image side (1 .. 64)
+   ============================================================ */
+extern "C" __declspec(dllexport) void SetCLAHEParams(float clipLimit, int tiles)
+{
+    clipLimit = std::max(clipLimit, 1.0f);
+    tiles = std::clamp(tiles, 1, 64);
+
+    bool changed = gClipLimit.exchange(clipLimit) != clipLimit;
+    changed |= gTiles.exchange(tiles) != tiles;
+    if (!changed)
+        return;
+
+    SpeculateCancel();
+    RenderCacheClear();
+}
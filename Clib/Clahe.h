@@ -0,0 +1,21 @@
+#ifndef CLAHE_H
+#define CLAHE_H
+
+// Histogram bins of one CLAHE tile; a tile curve holds the display
+// luminance at the kClaheEdges bin edges
+const int kClaheBins = 256;
+const int kClaheEdges = kClaheBins + 1;
+
+// Tile grid and clip limit of a CLAHE render (SetCLAHEParams)
+struct ClaheGrid
+{
+	int tilesX;
+	int tilesY;
+	float clipLimit;
+};
+
+// The grid for an image of this size: the set number of tiles along
+// the longer side, as many of the same shape along the other
+ClaheGrid ClaheGridFor(int width, int height);
+
+#endif
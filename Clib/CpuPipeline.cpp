@@ -0,0 +1,190 @@
+// ============================================================
+// File: CpuPipeline.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Native CPU tone mapping entry points. Builds the stage graph
+// for a request and runs it on the thread pool.
+// ============================================================
+#include "HDR.h"
+#include "Bloom.h"
+#include "CpuPipeline.h"
+#include "Grade.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "StageGraph.h"
+#include "Stats.h"
+#include "Tune.h"
+
+/* ============================================================
+   Procedure: ToneMapStage
+   ------------------------------------------------------------
+   Description:
+   Pointwise Extended Reinhard stage on a planar RGB tile,
+   with the current color grade and LUT applied in the same
+   kernel.
+
+   Input parameters:
+   exposure   - Exposure multiplier (> 0.0)
+   whitePoint - White point (> 0.0)
+   quality    - Total to add the tile's luminance counters to
+                (may be nullptr)
+   ============================================================ */
+static Stage ToneMapStage(float exposure, float whitePoint, QualityTotal* quality)
+{
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+
+    Stage stage;
+    stage.name = "ToneMap";
+    stage.channels = 3;
+    stage.run = [exposure, whitePoint, quality, grade, lut](const TileBuf&, TileBuf& out)
+    {
+        QualityAccum tile;
+        for (int y = out.y0; y < out.y0 + out.height; y++)
+            ToneMapPlanar(out.Row(0, y), out.Row(1, y), out.Row(2, y),
+                out.width, exposure, whitePoint, quality ? &tile : nullptr, grade, lut.get());
+        if (quality)
+            quality->Add(tile);
+    };
+    return stage;
+}
+
+/* ============================================================
+   Procedure: ToneMapCPURun
+   ------------------------------------------------------------
+   Description:
+   Builds and runs the fused pipeline. Quality counters are
+   gathered by the same kernels that tone map and quantize,
+   per tile, so enabling them adds no pass over the image.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+   region      - Rectangle to render (nullptr = whole image)
+   filter      - Tiles to render (empty = all)
+   bloom       - Bloom settings (nullptr = the current ones)
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   quality     - Total to add counters to (may be nullptr)
+   ============================================================ */
+void ToneMapCPURun(
+    const float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint,
+    QualityTotal* quality,
+    const HDRRect* region,
+    const StageTileFilter& filter,
+    const BloomSettings* bloom)
+{
+    ToneMapCPURunSource(StageGraph::InterleavedRGBSource(linearRGB, width), width, height,
+        outputBGRA, exposure, whitePoint, quality, region, filter, bloom);
+}
+
+/* ============================================================
+   Procedure: ToneMapCPURunSource
+   ------------------------------------------------------------
+   Description:
+   ToneMapCPURun with the image read through a stage source.
+   With bloom on the source is read once more, whole, to build
+   the bloom before the sweep.
+   ============================================================ */
+void ToneMapCPURunSource(
+    const StageSource& source,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint,
+    QualityTotal* quality,
+    const HDRRect* region,
+    const StageTileFilter& filter,
+    const BloomSettings* bloomOverride)
+{
+    TuneEnsureLoaded();
+
+    long long pixels = region ? (long long)region->width * region->height : (long long)width * height;
+    long long threshold = GetKernelConfig().streamThreshold;
+    bool stream = threshold > 0 && pixels * 4 >= threshold;
+
+    StageGraph graph(width, height, 3, source);
+    BloomSettings bloom = bloomOverride ? *bloomOverride : GetBloomSettings();
+    if (bloom.intensity > 0.0f)
+        graph.AddStage(BloomStage(source, width, height, exposure, bloom));
+    graph.AddStage(ToneMapStage(exposure, whitePoint, quality));
+    graph.SetSink(StageGraph::BGRA8Sink(outputBGRA, width, stream, quality));
+    if (region)
+        graph.SetRegion(region->x, region->y, region->width, region->height);
+    if (filter)
+        graph.SetTileFilter(filter);
+    graph.Run();
+
+    StatsCpuRun(graph.Passes(), graph.PeakBytes());
+}
+
+/* ============================================================
+   Procedure: ToneMapCPUHalo
+   ------------------------------------------------------------
+   Description:
+   Summed radius of the stages ToneMapCPURun builds. Extended
+   Reinhard is a global operator, so this is 0 today; a local
+   stage added to the pipeline widens every dirty rectangle
+   render by its radius.
+   ============================================================ */
+int ToneMapCPUHalo()
+{
+    return ToneMapStage(1.0f, 1.0f, nullptr).radius;
+}
+
+/* ============================================================
+   Procedure: ToneMapCPU
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image on the CPU. Load,
+   tone map and gamma/quantize run fused in one tiled,
+   multithreaded sweep; no full-size intermediate is allocated.
+   Tile size, threads and kernel settings come from this
+   machine's tune profile. Publishes quality counters if they
+   are enabled.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapCPU(
+    float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint)
+{
+    if (!linearRGB || !outputBGRA || width <= 0 || height <= 0)
+        return;
+
+    if (!StatsQualityEnabled())
+    {
+        ToneMapCPURun(linearRGB, width, height, outputBGRA, exposure, whitePoint, nullptr);
+        return;
+    }
+
+    QualityTotal quality;
+    ToneMapCPURun(linearRGB, width, height, outputBGRA, exposure, whitePoint, &quality);
+    StatsQuality(quality.total);
+}
@@ -0,0 +1,30 @@
+#ifndef CPU_PIPELINE_H
+#define CPU_PIPELINE_H
+
+#include "StageGraph.h"
+
+struct BloomSettings;
+struct HDRRect;
+struct QualityTotal;
+
+// ToneMapCPU without publishing quality counters: adds them to
+// quality instead (if given), so a caller rendering one image in
+// several parts can merge them first. With a region only those
+// pixels of outputBGRA are written; with a filter only the tiles
+// it accepts. bloom overrides the current bloom settings (callers
+// rendering one frame in bands read them once for all bands).
+void ToneMapCPURun(const float* linearRGB, int width, int height, unsigned char* outputBGRA,
+	float exposure, float whitePoint, QualityTotal* quality, const HDRRect* region = nullptr,
+	const StageTileFilter& filter = nullptr, const BloomSettings* bloom = nullptr);
+
+// ToneMapCPURun reading the image through a source instead of an
+// interleaved buffer (e.g. a compressed ImageStore).
+void ToneMapCPURunSource(const StageSource& source, int width, int height, unsigned char* outputBGRA,
+	float exposure, float whitePoint, QualityTotal* quality, const HDRRect* region = nullptr,
+	const StageTileFilter& filter = nullptr, const BloomSettings* bloom = nullptr);
+
+// Pixels around a changed input pixel whose output can change
+// (the summed radius of the pipeline's stages)
+int ToneMapCPUHalo();
+
+#endif
@@ -0,0 +1,430 @@
+// ============================================================
+// File: DeepZoom.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Deep Zoom (DZI) tile pyramid export in a single sweep. The
+// image is tone mapped band by band; each mapped row enters the
+// full resolution level and is averaged 2x2 into the level
+// above as soon as its pair has arrived, in linear light, so no
+// level is ever built from 8-bit output. Every level keeps just
+// the rows of the tile row it is filling. A finished tile row is
+// gamma encoded to 8 bits at once; its tiles are then compressed
+// and written by the pool together with the tone mapping of the
+// next band, so PNG encoding never stalls the sweep.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "HDR.h"
+#include "DeepZoom.h"
+#include "Dither.h"
+#include "Grade.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "Png.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "Tune.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Source rows tone mapped per parallel step
+static const int kBandRows = 64;
+
+/* ============================================================
+   Procedure: DziMaxLevel
+   ============================================================ */
+int DziMaxLevel(int width, int height)
+{
+    int maxLevel = 0;
+    while ((1LL << maxLevel) < std::max(width, height))
+        maxLevel++;
+    return maxLevel;
+}
+
+/* ============================================================
+   Procedure: DziDescriptor
+   ------------------------------------------------------------
+   Description:
+   Returns the .dzi XML describing the pyramid.
+   ============================================================ */
+std::string DziDescriptor(int width, int height, int tileSize, int overlap)
+{
+    char xml[512];
+    std::snprintf(xml, sizeof(xml),
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" "
+        "Format=\"png\" Overlap=\"%d\" TileSize=\"%d\">\n"
+        "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+        "</Image>\n", overlap, tileSize, width, height);
+    return xml;
+}
+
+/* ============================================================
+   DziLevel
+   ------------------------------------------------------------
+   One pyramid level. Rows are stored planar (R, G, B runs of
+   width floats) in a ring of capacity rows; row y lives in
+   slot y % capacity.
+   ============================================================ */
+struct DziLevel
+{
+    int index = 0;
+    int width = 0;
+    int height = 0;
+    int capacity = 0;
+    int rowsDone = 0;
+    int nextTileRow = 0;
+    std::vector<float> ring;
+
+    float* Row(int y) { return ring.data() + (size_t)(y % capacity) * width * 3; }
+};
+
+/* ============================================================
+   DziTile
+   ------------------------------------------------------------
+   A gamma encoded tile waiting to be compressed and written.
+   ============================================================ */
+struct DziTile
+{
+    std::vector<unsigned char> rgb;
+    int width = 0;
+    int height = 0;
+    std::filesystem::path path;
+};
+
+/* ============================================================
+   DziExporter
+   ------------------------------------------------------------
+   Receives full resolution rows in order, cascades them up the
+   pyramid and collects the tiles of every tile row completed,
+   for the caller to write.
+   ============================================================ */
+class DziExporter
+{
+public:
+    DziExporter(int width, int height, int tileSize, int overlap, const std::filesystem::path& filesDir);
+
+    // Adds the next full resolution row (planar R, G, B runs)
+    void AddRow(const float* planar) { Push((int)levels.size() - 1, planar); }
+
+    // Tiles completed since the last call
+    std::vector<DziTile> TakeTiles();
+    // Compresses and writes a tile; thread-safe
+    void WriteTile(const DziTile& tile);
+
+    bool Failed() const { return failed; }
+    int LevelCount() const { return (int)levels.size(); }
+    long long Bytes() const;
+
+private:
+    void Push(int level, const float* planar);
+    void EmitReady(DziLevel& level);
+    void CaptureTile(DziLevel& level, int col, int row, DziTile& tile);
+
+    // First / past-the-end pixel of tile i along an axis of length n
+    int TileStart(int i) const { return std::max(0, i * tileSize - overlap); }
+    int TileEnd(int i, int n) const { return std::min(n, (i + 1) * tileSize + overlap); }
+
+    std::vector<DziLevel> levels;
+    std::vector<float> scratch;
+    std::vector<DziTile> pending;
+    long long pendingPeak = 0;
+    std::filesystem::path filesDir;
+    int tileSize;
+    int overlap;
+    std::atomic<bool> failed{ false };
+};
+
+/* ============================================================
+   Procedure: DziExporter constructor
+   ------------------------------------------------------------
+   Description:
+   Sets up the levels: the last one is the full image, each one
+   below it half the size (rounded up), down to 1x1. A ring
+   holds one tile row plus both overlaps and the row being
+   added, which is all a level ever needs at once.
+   ============================================================ */
+DziExporter::DziExporter(int width, int height, int tileSize, int overlap,
+    const std::filesystem::path& filesDir)
+    : filesDir(filesDir), tileSize(tileSize), overlap(overlap)
+{
+    int maxLevel = DziMaxLevel(width, height);
+
+    levels.resize(maxLevel + 1);
+    for (int k = maxLevel; k >= 0; k--)
+    {
+        DziLevel& level = levels[k];
+        level.index = k;
+        level.width = k == maxLevel ? width : (levels[k + 1].width + 1) / 2;
+        level.height = k == maxLevel ? height : (levels[k + 1].height + 1) / 2;
+        level.capacity = std::min(level.height, tileSize + 2 * overlap + 1);
+        level.ring.resize((size_t)level.capacity * level.width * 3);
+    }
+
+    scratch.resize((size_t)((width + 1) / 2) * 3);
+}
+
+long long DziExporter::Bytes() const
+{
+    long long bytes = (long long)scratch.size() * sizeof(float) + pendingPeak;
+    for (const DziLevel& level : levels)
+        bytes += (long long)level.ring.size() * sizeof(float);
+    return bytes;
+}
+
+/* ============================================================
+   Procedure: DziExporter::Push
+   ------------------------------------------------------------
+   Description:
+   Stores row rowsDone of a level, writes any tile row it
+   completes and, on every second row (or the last one),
+   averages the row pair into the next smaller level. Odd edge
+   pixels and rows are repeated, i.e. averaged with themselves.
+
+   Input parameters:
+   level  - Level index
+   planar - Row of the level's width (R, G, B runs)
+   ============================================================ */
+void DziExporter::Push(int index, const float* planar)
+{
+    DziLevel& level = levels[index];
+    int y = level.rowsDone;
+    int w = level.width;
+
+    std::memcpy(level.Row(y), planar, (size_t)w * 3 * sizeof(float));
+    level.rowsDone++;
+
+    EmitReady(level);
+
+    if (index == 0 || ((y & 1) == 0 && y != level.height - 1))
+        return;
+
+    const float* a = level.Row(y & ~1);
+    const float* b = level.Row(y);
+    int half = levels[index - 1].width;
+    float* down = scratch.data();
+
+    for (int c = 0; c < 3; c++)
+    {
+        const float* ra = a + (size_t)c * w;
+        const float* rb = b + (size_t)c * w;
+        float* out = down + (size_t)c * half;
+        for (int x = 0; x < half; x++)
+        {
+            int x0 = 2 * x;
+            int x1 = std::min(x0 + 1, w - 1);
+            out[x] = 0.25f * (ra[x0] + ra[x1] + rb[x0] + rb[x1]);
+        }
+    }
+
+    Push(index - 1, down);
+}
+
+/* ============================================================
+   Procedure: DziExporter::EmitReady
+   ------------------------------------------------------------
+   Description:
+   Captures every tile row of a level whose rows (with overlap)
+   have all arrived, the tiles of a row in parallel, before the
+   ring slots they read are reused.
+   ============================================================ */
+void DziExporter::EmitReady(DziLevel& level)
+{
+    int tileRows = (level.height + tileSize - 1) / tileSize;
+    int tileCols = (level.width + tileSize - 1) / tileSize;
+
+    while (level.nextTileRow < tileRows && level.rowsDone >= TileEnd(level.nextTileRow, level.height))
+    {
+        int row = level.nextTileRow;
+        size_t first = pending.size();
+        pending.resize(first + tileCols);
+        ThreadPool::Instance().ParallelFor(tileCols, [&](int col)
+        {
+            CaptureTile(level, col, row, pending[first + col]);
+        });
+        level.nextTileRow++;
+    }
+}
+
+/* ============================================================
+   Procedure: DziExporter::TakeTiles
+   ------------------------------------------------------------
+   Description:
+   Hands the captured tiles to the caller and records the most
+   8-bit tile data held at once.
+   ============================================================ */
+std::vector<DziTile> DziExporter::TakeTiles()
+{
+    long long bytes = 0;
+    for (const DziTile& tile : pending)
+        bytes += (long long)tile.rgb.size();
+    pendingPeak = std::max(pendingPeak, bytes);
+
+    std::vector<DziTile> tiles;
+    tiles.swap(pending);
+    return tiles;
+}
+
+/* ============================================================
+   Procedure: DziExporter::CaptureTile
+   ------------------------------------------------------------
+   Description:
+   Gamma encodes one tile (with overlap) from the ring into
+   8-bit RGB, to be written as <level>/<col>_<row>.png.
+   ============================================================ */
+void DziExporter::CaptureTile(DziLevel& level, int col, int row, DziTile& tile)
+{
+    int x0 = TileStart(col);
+    int x1 = TileEnd(col, level.width);
+    int y0 = TileStart(row);
+    int y1 = TileEnd(row, level.height);
+    int tw = x1 - x0;
+    int th = y1 - y0;
+
+    std::vector<unsigned char> bgra((size_t)tw * 4);
+    std::vector<unsigned char>& rgb = tile.rgb;
+    rgb.resize((size_t)tw * th * 3);
+
+    for (int y = y0; y < y1; y++)
+    {
+        const float* r = level.Row(y);
+        StoreBGRA8(r + x0, r + level.width + x0, r + 2 * level.width + x0, tw, bgra.data(), false, nullptr,
+            DitherAt(x0, y));
+
+        unsigned char* dst = rgb.data() + (size_t)(y - y0) * tw * 3;
+        for (int x = 0; x < tw; x++)
+        {
+            dst[3 * x + 0] = bgra[4 * x + 2];
+            dst[3 * x + 1] = bgra[4 * x + 1];
+            dst[3 * x + 2] = bgra[4 * x + 0];
+        }
+    }
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "%d_%d.png", col, row);
+    tile.path = filesDir / std::to_string(level.index) / name;
+    tile.width = tw;
+    tile.height = th;
+}
+
+/* ============================================================
+   Procedure: DziExporter::WriteTile
+   ============================================================ */
+void DziExporter::WriteTile(const DziTile& tile)
+{
+    if (!WriteFileBytes(tile.path.string(), EncodePNG(tile.rgb.data(), tile.width, tile.height, 3)))
+        failed = true;
+}
+
+/* ============================================================
+   Procedure: ExportDeepZoom
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image and writes it as a Deep
+   Zoom pyramid: <name>.dzi plus <name>_files/<level>/
+   <col>_<row>.png, level 0 being 1x1. All levels are built in
+   the same sweep as the tone mapping; memory stays at about
+   one tile row per level however large the image is (reported
+   as cpuPeakBytes in HDRStats).
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+   dziPath     - Path of the .dzi file to create
+   tileSize    - Tile edge in pixels without overlap (e.g. 254)
+   overlap     - Pixels shared with each neighbour (e.g. 1)
+
+   Output parameters:
+   Returns false on invalid arguments or if a file could not
+   be written.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool ExportDeepZoom(
+    float* linearRGB,
+    int width,
+    int height,
+    float exposure,
+    float whitePoint,
+    const char* dziPath,
+    int tileSize,
+    int overlap)
+{
+    if (!linearRGB || !dziPath || width <= 0 || height <= 0 ||
+        tileSize <= 0 || overlap < 0 || overlap >= tileSize)
+        return false;
+
+    TuneEnsureLoaded();
+
+    std::filesystem::path dzi(dziPath);
+    std::filesystem::path filesDir = dzi.parent_path() / (dzi.stem().string() + "_files");
+
+    DziExporter exporter(width, height, tileSize, overlap, filesDir);
+
+    std::error_code error;
+    for (int k = 0; k < exporter.LevelCount(); k++)
+    {
+        std::filesystem::create_directories(filesDir / std::to_string(k), error);
+        if (error)
+            return false;
+    }
+
+    /* ----------------------------
+       Tone map bands in parallel, feed rows in order; the
+       tiles the previous band completed are written in the
+       same parallel step (listed first, as they take longer)
+       ---------------------------- */
+    std::vector<float> band((size_t)kBandRows * width * 3);
+    ThreadPool& pool = ThreadPool::Instance();
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+    std::vector<DziTile> tiles;
+
+    for (int y0 = 0; y0 < height; y0 += kBandRows)
+    {
+        int rows = std::min(kBandRows, height - y0);
+        int writes = (int)tiles.size();
+
+        pool.ParallelFor(writes + rows, [&](int i)
+        {
+            if (i < writes)
+            {
+                exporter.WriteTile(tiles[i]);
+                return;
+            }
+
+            float* r = band.data() + (size_t)(i - writes) * width * 3;
+            DeinterleaveRGB(linearRGB + (size_t)(y0 + i - writes) * width * 3, width, r, r + width, r + 2 * width);
+            ToneMapPlanar(r, r + width, r + 2 * width, width, exposure, whitePoint, nullptr, grade, lut.get());
+        });
+        tiles.clear();
+
+        for (int i = 0; i < rows; i++)
+            exporter.AddRow(band.data() + (size_t)i * width * 3);
+        tiles = exporter.TakeTiles();
+    }
+
+    pool.ParallelFor((int)tiles.size(), [&](int i)
+    {
+        exporter.WriteTile(tiles[i]);
+    });
+
+    StatsCpuRun(1, exporter.Bytes() + (long long)band.size() * sizeof(float));
+
+    std::string xml = DziDescriptor(width, height, tileSize, overlap);
+    bool ok = WriteFileBytes(dzi.string(), std::vector<unsigned char>(xml.begin(), xml.end()));
+    return ok && !exporter.Failed();
+}
@@ -0,0 +1,13 @@
+#ifndef DEEP_ZOOM_H
+#define DEEP_ZOOM_H
+
+#include <string>
+
+// Index of the full resolution level of a Deep Zoom pyramid
+// (level 0 is 1x1, each level doubles the one below).
+int DziMaxLevel(int width, int height);
+
+// Contents of the .dzi descriptor of a PNG tile pyramid.
+std::string DziDescriptor(int width, int height, int tileSize, int overlap);
+
+#endif
@@ -0,0 +1,240 @@
+// ============================================================
+// File: Dither.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Optional blue-noise dithering of 8-bit output. Smooth HDR
+// gradients quantized to 8 bits band; adding a different offset
+// below one code to every pixel before truncation turns the
+// bands into noise, and blue noise keeps that noise at high
+// frequencies the eye hardly sees. The offsets come from one
+// 64x64 tile repeated over the image, generated at first use
+// with the void-and-cluster method. The CPU quantizer
+// (StoreBGRA8) and the GL shader index it by image position, so
+// both backends dither alike.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "HDR.h"
+#include "Dither.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Energy filter of the void-and-cluster method (pixels)
+static const float kClusterSigma = 1.5f;
+
+// Share of the tile in the initial binary pattern
+static const int kInitialShare = 10;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gDitherEnabled
+ * 8-bit output is dithered (EnableDither).
+ * Range: default false
+ */
+static std::atomic<bool> gDitherEnabled{ false };
+
+/* ============================================================
+   VoidAndCluster
+   ------------------------------------------------------------
+   Binary pattern on the toroidal tile with the Gaussian energy
+   of its set pixels at every position. The tightest cluster is
+   the set pixel of highest energy, the largest void the empty
+   pixel of lowest.
+   ============================================================ */
+struct VoidAndCluster
+{
+    static const int kPixels = kDitherSize * kDitherSize;
+
+    std::vector<float> kernel = std::vector<float>(kPixels);
+    std::vector<float> energy = std::vector<float>(kPixels, 0.0f);
+    std::vector<char> set = std::vector<char>(kPixels, 0);
+
+    VoidAndCluster()
+    {
+        for (int dy = 0; dy < kDitherSize; dy++)
+        {
+            for (int dx = 0; dx < kDitherSize; dx++)
+            {
+                int wx = std::min(dx, kDitherSize - dx);
+                int wy = std::min(dy, kDitherSize - dy);
+                kernel[dy * kDitherSize + dx] =
+                    std::exp(-(float)(wx * wx + wy * wy) / (2.0f * kClusterSigma * kClusterSigma));
+            }
+        }
+    }
+
+    void Toggle(int p)
+    {
+        set[p] = !set[p];
+        float sign = set[p] ? 1.0f : -1.0f;
+
+        int px = p % kDitherSize;
+        int py = p / kDitherSize;
+        for (int y = 0; y < kDitherSize; y++)
+        {
+            const float* k = &kernel[((y - py) & (kDitherSize - 1)) * kDitherSize];
+            float* e = &energy[y * kDitherSize];
+            for (int x = 0; x < kDitherSize; x++)
+                e[x] += sign * k[(x - px) & (kDitherSize - 1)];
+        }
+    }
+
+    int TightestCluster() const
+    {
+        int best = -1;
+        for (int p = 0; p < kPixels; p++)
+            if (set[p] && (best < 0 || energy[p] > energy[best]))
+                best = p;
+        return best;
+    }
+
+    int LargestVoid() const
+    {
+        int best = -1;
+        for (int p = 0; p < kPixels; p++)
+            if (!set[p] && (best < 0 || energy[p] < energy[best]))
+                best = p;
+        return best;
+    }
+};
+
+/* ============================================================
+   Procedure: BuildBlueNoise
+   ------------------------------------------------------------
+   Description:
+   Void and cluster: a random sparse pattern is relaxed by
+   moving its tightest cluster into its largest void until that
+   changes nothing. Its pixels are then ranked by removing the
+   tightest cluster (highest rank first), and the remaining
+   pixels by filling the largest void. Rank r becomes the value
+   (r + 0.5) / 4096.
+   ============================================================ */
+static std::vector<float> BuildBlueNoise()
+{
+    const int pixels = VoidAndCluster::kPixels;
+    VoidAndCluster pattern;
+
+    /* ----------------------------
+       Initial pattern (fixed seed)
+       ---------------------------- */
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+    int ones = pixels / kInitialShare;
+    for (int placed = 0; placed < ones;)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int p = (int)(state % pixels);
+        if (!pattern.set[p])
+        {
+            pattern.Toggle(p);
+            placed++;
+        }
+    }
+
+    for (;;)
+    {
+        int cluster = pattern.TightestCluster();
+        pattern.Toggle(cluster);
+        int hole = pattern.LargestVoid();
+        pattern.Toggle(hole);
+        if (hole == cluster)
+            break;
+    }
+
+    /* ----------------------------
+       Ranks
+       ---------------------------- */
+    std::vector<int> rank(pixels);
+
+    VoidAndCluster removing = pattern;
+    for (int r = ones - 1; r >= 0; r--)
+    {
+        int cluster = removing.TightestCluster();
+        rank[cluster] = r;
+        removing.Toggle(cluster);
+    }
+
+    for (int r = ones; r < pixels; r++)
+    {
+        int hole = pattern.LargestVoid();
+        rank[hole] = r;
+        pattern.Toggle(hole);
+    }
+
+    /* ----------------------------
+       Padded tile
+       ---------------------------- */
+    std::vector<float> tile((size_t)kDitherSize * kDitherStride);
+    for (int y = 0; y < kDitherSize; y++)
+        for (int x = 0; x < kDitherStride; x++)
+            tile[y * kDitherStride + x] = (rank[y * kDitherSize + (x & (kDitherSize - 1))] + 0.5f) / pixels;
+
+    return tile;
+}
+
+/* ============================================================
+   Procedure: BlueNoiseTile
+   ============================================================ */
+const float* BlueNoiseTile()
+{
+    static const std::vector<float> tile = BuildBlueNoise();
+    return tile.data();
+}
+
+/* ============================================================
+   Procedure: DitherEnabled
+   ============================================================ */
+bool DitherEnabled()
+{
+    return gDitherEnabled;
+}
+
+/* ============================================================
+   Procedure: DitherAt
+   ============================================================ */
+DitherRow DitherAt(int x, int y)
+{
+    if (!gDitherEnabled)
+        return {};
+
+    return { BlueNoiseTile() + (y & (kDitherSize - 1)) * kDitherStride, x & (kDitherSize - 1) };
+}
+
+/* ============================================================
+   Procedure: EnableDither
+   ------------------------------------------------------------
+   Description:
+   Turns blue-noise dithering of 8-bit output (BGRA8, RGBA8,
+   LUMA8, and RGB10A2 at its own step) on or off for following
+   CPU, split and GL renders. Costs one addition per channel in
+   the quantize step. Cached renders and tiles made with the
+   other setting are dropped.
+
+   Input parameters:
+   enable - true to dither (default off)
+   ============================================================ */
+extern "C" __declspec(dllexport) void EnableDither(bool enable)
+{
+    if (gDitherEnabled.exchange(enable) == enable)
+        return;
+
+    // Build the tile now rather than inside the first render
+    if (enable)
+        BlueNoiseTile();
+
+    SpeculateCancel();
+    RenderCacheClear();
+    TileCacheClear();
+}
@@ -0,0 +1,24 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include "Kernels.h"
+
+// Blue-noise tile that dithers 8-bit output: kDitherSize x kDitherSize
+// values in (0, 1), each a different rank. Rows are kDitherStride
+// floats: the row, then its first 8 values again, so 8 lanes can be
+// loaded from any column without wrapping. The whole tile (18 KB)
+// stays in L1 while a tile row is quantized.
+const int kDitherSize = 64;
+const int kDitherStride = kDitherSize + 8;
+
+// The tile, built on first use (void and cluster, fixed seed).
+const float* BlueNoiseTile();
+
+// True while dithering is enabled (EnableDither).
+bool DitherEnabled();
+
+// Dither of the output row at image row y starting at column x; no
+// noise while dithering is off.
+DitherRow DitherAt(int x, int y);
+
+#endif
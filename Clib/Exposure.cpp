@@ -0,0 +1,287 @@
+// ============================================================
+// File: Exposure.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Automatic exposure from the scene luminance. A full log-average
+// pass over a very large image costs about as much as the tone
+// map itself, so the estimate is first made from a stratified
+// sample: the image is cut into a grid of about 64K cells and one
+// pixel at a random position inside each cell is read. The spread
+// of the samples gives a confidence interval for the log average
+// and, through the binomial distribution of ranks, for the
+// requested percentile. Only when either interval is wider than
+// the caller's tolerance is every pixel read.
+// ============================================================
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "HDR.h"
+#include "Exposure.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Sample cells of the estimate; smaller images are read whole
+static const double kSamples = 65536.0;
+
+// Two-sided 95% normal quantile
+static const double kZ95 = 1.959964;
+
+// Sampled pixels expected on the far side of the percentile for
+// its interval to be trusted (normal approximation of the rank)
+static const double kMinTail = 10.0;
+
+// Rows per band of the full pass
+static const int kBandRows = 64;
+
+/* ============================================================
+   Procedure: Mix64
+   ------------------------------------------------------------
+   Description:
+   SplitMix64 finalizer; turns a cell index into the position
+   of its sample. The seed is fixed, so one image always gives
+   the same estimate (and the same render cache key).
+   ============================================================ */
+static inline uint64_t Mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/* ============================================================
+   Procedure: SampleLogLuminance
+   ------------------------------------------------------------
+   Description:
+   Reads one pixel at a random position in every cell x cell
+   square of the image (edge cells clipped) and returns the log2
+   luminance of the finite ones.
+   ============================================================ */
+static std::vector<float> SampleLogLuminance(const float* linearRGB, int width, int height, int cell)
+{
+    int cols = (width + cell - 1) / cell;
+    int rows = (height + cell - 1) / cell;
+
+    // NaN marks a non-finite sample until the compaction below
+    std::vector<float> logs((size_t)cols * rows);
+
+    ThreadPool::Instance().ParallelFor(rows, [&](int cy)
+    {
+        int y0 = cy * cell;
+        int h = std::min(cell, height - y0);
+
+        for (int cx = 0; cx < cols; cx++)
+        {
+            int x0 = cx * cell;
+            int w = std::min(cell, width - x0);
+
+            size_t index = (size_t)cy * cols + cx;
+            uint64_t r = Mix64(index);
+            int x = x0 + (int)((r & 0xFFFFFFFF) % (uint32_t)w);
+            int y = y0 + (int)((r >> 32) % (uint32_t)h);
+
+            float logLum;
+            if (!LogLuminance(linearRGB + ((size_t)y * width + x) * 3, logLum))
+                logLum = NAN;
+            logs[index] = logLum;
+        }
+    });
+
+    logs.erase(std::remove_if(logs.begin(), logs.end(), [](float v) { return std::isnan(v); }), logs.end());
+    return logs;
+}
+
+/* ============================================================
+   Procedure: LogLuminanceStats::Merge
+   ============================================================ */
+void LogLuminanceStats::Merge(const LogLuminanceStats& other)
+{
+    sum += other.sum;
+    count += other.count;
+    for (int i = 0; i < kBins; i++)
+        bins[i] += other.bins[i];
+}
+
+/* ============================================================
+   Procedure: LogLuminanceStats::Percentile
+   ============================================================ */
+void LogLuminanceStats::Percentile(float rank, float& low, float& high) const
+{
+    // Bin holding pixel rank * (count - 1)
+    long long target = (long long)(rank * (count - 1));
+    long long seen = 0;
+    int bin = 0;
+    while (bin < kBins - 1 && seen + bins[bin] <= target)
+        seen += bins[bin++];
+
+    low = kMin + bin / kBinScale;
+    high = low + 1.0f / kBinScale;
+}
+
+/* ============================================================
+   Procedure: FullPass
+   ------------------------------------------------------------
+   Description:
+   Reads every pixel: the exact log average and a log2 luminance
+   histogram whose bin holding the requested rank gives the
+   percentile and its interval.
+   ============================================================ */
+static void FullPass(const float* linearRGB, int width, int height, float percentile,
+    HDRExposureEstimate& estimate)
+{
+    std::mutex mutex;
+    LogLuminanceStats stats;
+    int bands = (height + kBandRows - 1) / kBandRows;
+
+    ThreadPool::Instance().ParallelFor(bands, [&](int band)
+    {
+        LogLuminanceStats local;
+
+        int y1 = std::min(height, (band + 1) * kBandRows);
+        for (int y = band * kBandRows; y < y1; y++)
+        {
+            const float* row = linearRGB + (size_t)y * width * 3;
+            for (int x = 0; x < width; x++)
+            {
+                float logLum;
+                if (LogLuminance(row + (size_t)x * 3, logLum))
+                    local.Add(logLum);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.Merge(local);
+    });
+
+    estimate.samples = stats.count;
+    estimate.fullPass = 1;
+    if (stats.count == 0)
+        return;
+
+    estimate.logAverage = std::exp2(stats.LogAverage());
+    estimate.logAverageLow = estimate.logAverage;
+    estimate.logAverageHigh = estimate.logAverage;
+
+    float low, high;
+    stats.Percentile(percentile, low, high);
+    estimate.percentileLow = std::exp2(low);
+    estimate.percentile = std::exp2(0.5f * (low + high));
+    estimate.percentileHigh = std::exp2(high);
+}
+
+/* ============================================================
+   Procedure: EstimateExposure
+   ------------------------------------------------------------
+   Description:
+   Measures the log-average and a percentile luminance of an
+   image from a stratified sample, and reads every pixel instead
+   when the 95% interval of either figure is wider than
+   tolerance, or when the percentile is too close to 0 or 1 for
+   the sample to bound. The exposure it suggests can be passed
+   straight to any tone map entry point (ToneMapCPU, UploadToGL,
+   ASMlib's ToneMapAVX2). Non-finite pixels are ignored.
+
+   Input parameters:
+   linearRGB  - Linear RGB float data (RGBRGB...)
+   width      - Image width in pixels (> 0)
+   height     - Image height in pixels (> 0)
+   percentile - Rank of the percentile figure [0, 1]
+                (e.g. 0.99 for the highlights)
+   tolerance  - Largest accepted half-width of the intervals in
+                stops; 0 always reads every pixel
+
+   Output parameters:
+   estimate   - Luminance figures and suggested exposure
+   Returns false for invalid arguments or an image with no
+   finite pixel.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool EstimateExposure(const float* linearRGB, int width, int height, float percentile,
+    float tolerance, HDRExposureEstimate* estimate)
+{
+    if (!linearRGB || !estimate || width <= 0 || height <= 0 || !(percentile >= 0.0f && percentile <= 1.0f))
+        return false;
+
+    HDRExposureEstimate result = {};
+
+    // Sampling reads at most one pixel in cell * cell; below 2 the
+    // full pass costs about the same
+    int cell = (int)std::sqrt((double)width * height / kSamples);
+    bool accepted = false;
+
+    if (cell >= 2 && tolerance > 0.0f)
+    {
+        std::vector<float> logs = SampleLogLuminance(linearRGB, width, height, cell);
+        size_t n = logs.size();
+
+        if (n >= 2)
+        {
+            /* ----------------------------
+               Log average and its interval
+               ---------------------------- */
+            double sum = 0.0;
+            for (float v : logs)
+                sum += v;
+            double mean = sum / n;
+
+            double squares = 0.0;
+            for (float v : logs)
+                squares += (v - mean) * (v - mean);
+
+            // Stratification only narrows the spread, so the simple
+            // random sample interval is a safe bound
+            double halfWidth = kZ95 * std::sqrt(squares / (n - 1) / n);
+
+            /* ----------------------------
+               Percentile and the ranks of its interval
+               ---------------------------- */
+            double rank = percentile * (n - 1);
+            double spread = kZ95 * std::sqrt(n * (double)percentile * (1.0 - percentile));
+            size_t k = (size_t)rank;
+            size_t kLow = (size_t)std::max(0.0, std::floor(rank - spread));
+            size_t kHigh = (size_t)std::min((double)(n - 1), std::ceil(rank + spread));
+
+            std::nth_element(logs.begin(), logs.begin() + k, logs.end());
+            float value = logs[k];
+            std::nth_element(logs.begin(), logs.begin() + kLow, logs.begin() + k);
+            float low = kLow < k ? logs[kLow] : value;
+            if (kHigh > k)
+                std::nth_element(logs.begin() + k + 1, logs.begin() + kHigh, logs.end());
+            float high = kHigh > k ? logs[kHigh] : value;
+
+            result.samples = (long long)n;
+            result.logAverage = std::exp2((float)mean);
+            result.logAverageLow = std::exp2((float)(mean - halfWidth));
+            result.logAverageHigh = std::exp2((float)(mean + halfWidth));
+            result.percentile = std::exp2(value);
+            result.percentileLow = std::exp2(low);
+            result.percentileHigh = std::exp2(high);
+
+            // Extreme ranks (the maximum, say) cannot be bounded by
+            // the sample and always take the full pass
+            bool tail = n * std::min((double)percentile, 1.0 - percentile) >= kMinTail;
+
+            accepted = tail && halfWidth <= tolerance && value - low <= tolerance && high - value <= tolerance;
+        }
+    }
+
+    if (!accepted)
+    {
+        result = {};
+        FullPass(linearRGB, width, height, percentile, result);
+        if (result.samples == 0)
+            return false;
+    }
+
+    result.exposure = kExposureKey / result.logAverage;
+    *estimate = result;
+    return true;
+}
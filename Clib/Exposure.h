@@ -0,0 +1,83 @@
+#ifndef EXPOSURE_H
+#define EXPOSURE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Luminance floor of the log figures, so black pixels do not
+// dominate a log average
+const float kMinLuminance = 1.0e-6f;
+
+// Middle grey a metered luminance is exposed to
+const float kExposureKey = 0.18f;
+
+// log2 of a positive normal float. The mantissa is folded into
+// [sqrt(1/2), sqrt(2)) and log2 taken from the atanh series, which
+// is accurate to about 2e-6 there.
+inline float FastLog2(float x)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+	int exponent = (int)(bits >> 23) - 127;
+	bits = (bits & 0x7FFFFF) | 0x3F800000;
+
+	float m;
+	std::memcpy(&m, &bits, sizeof(m));
+	if (m > 1.41421356f)
+	{
+		m *= 0.5f;
+		exponent++;
+	}
+
+	float t = (m - 1.0f) / (m + 1.0f);
+	float t2 = t * t;
+	return (float)exponent + t * (2.88539008f + t2 * (0.96179669f + t2 * 0.57707802f));
+}
+
+// log2 Rec.709 luminance of one RGB pixel, floored at kMinLuminance.
+// Returns false for non-finite pixels.
+inline bool LogLuminance(const float* rgb, float& logLum)
+{
+	float lum = 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+	if (!std::isfinite(lum))
+		return false;
+
+	logLum = FastLog2(std::max(lum, kMinLuminance));
+	return true;
+}
+
+// Exact log2 luminance figures of a set of pixels: the log sum for
+// the log average and a histogram (bins of about 0.01 stop over
+// [-20, 20) stops) for percentiles. Filled per thread, then merged.
+struct LogLuminanceStats
+{
+	static constexpr float kMin = -20.0f;
+	static constexpr float kMax = 20.0f;
+	static constexpr int kBins = 4096;
+	static constexpr float kBinScale = kBins / (kMax - kMin);
+
+	double sum = 0.0;
+	long long count = 0;
+	std::vector<long long> bins = std::vector<long long>(kBins, 0);
+
+	void Add(float logLum)
+	{
+		sum += logLum;
+		count++;
+		bins[std::clamp((int)((logLum - kMin) * kBinScale), 0, kBins - 1)]++;
+	}
+
+	void Merge(const LogLuminanceStats& other);
+
+	// log2 of the geometric mean luminance (count must be > 0)
+	float LogAverage() const { return (float)(sum / count); }
+
+	// log2 luminance range of the bin holding rank [0, 1] of the
+	// pixels (count must be > 0)
+	void Percentile(float rank, float& low, float& high) const;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef GL_BACKEND_H
+#define GL_BACKEND_H
+
+struct BloomSettings;
+struct HDRRect;
+struct QualityAccum;
+struct RGTarget;
+
+// Settings of one GL tone mapping render
+struct GLToneMapParams
+{
+	int format = 0;               // HDROutputFormat
+	int op = 0;                   // HDROperator
+	float exposure = 1.0f;
+	float whitePoint = 4.0f;
+	// Match ToneMapCPU bit for bit as far as possible: float32 input
+	// and the kernel's epsilon clamp (quantized output truncates like
+	// the CPU in every mode). Used when GPU and CPU bands of one
+	// frame are stitched together.
+	bool cpuCompatible = false;
+	// If set, a reduction pass adds the quality counters of the
+	// render to it (see EnableQualityStats)
+	QualityAccum* quality = nullptr;
+	// Advance the texture pool's frame after the render. Renders of
+	// row bands clear it on all but the last band of a frame (or on
+	// all bands, then call RenderEndFrame), so the pool does not
+	// retire targets the next frame still needs.
+	bool endFrame = true;
+	// Bloom to render with (nullptr = the current settings). Renders
+	// of row bands pass the frame's settings, read once.
+	const BloomSettings* bloom = nullptr;
+};
+
+// Tone maps an image on the GPU and reads it back. Must run on the
+// GL thread (see GLThread.h).
+void RenderToneMap(const float* linearRGB, int width, int height, void* output, const GLToneMapParams& params);
+
+// Advances the texture pool's frame once for a frame rendered in
+// bands with endFrame cleared. Must run on the GL thread.
+void RenderEndFrame();
+
+// Textures an HDRImage keeps in the texture pool between renders:
+// the linear input and the BGRA8 result. generation tells whether
+// they still belong to the current GL context.
+struct GLImageTargets
+{
+	RGTarget* input = nullptr;
+	RGTarget* output = nullptr;
+	long long generation = 0;
+};
+
+// Uploads rectangles of an image into its persistent input, tone
+// maps just them into the persistent output and reads them back
+// into the same pixels of a whole-image BGRA8 buffer. If the
+// targets do not exist yet they are created and the whole image
+// is rendered instead (wholeImage is set). Returns false if GL is
+// not available. Must run on the GL thread.
+bool RenderToneMapRects(GLImageTargets& targets, const float* linearRGB, int width, int height,
+	const HDRRect* rects, int count, unsigned char* outputBGRA, const GLToneMapParams& params,
+	bool& wholeImage);
+
+// Returns the textures of an image to the pool. Must run on the
+// GL thread.
+void ReleaseImageTargets(GLImageTargets& targets);
+
+#endif
@@ -0,0 +1,207 @@
+// ============================================================
+// File: GLThread.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Dedicated thread that owns the hidden GLFW window and its
+// OpenGL context. A context can only be current on one thread
+// and Windows destroys a window together with the thread that
+// created it, so every OpenGL call of the library is executed
+// here as a queued job.
+// ============================================================
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "GLThread.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gQueueMutex / gQueueCond
+ * Protect and signal the job queue. gQueueMutex also guards the
+ * thread state below; gStateCond signals the end of a stop.
+ */
+static std::mutex gQueueMutex;
+static std::condition_variable gQueueCond;
+static std::condition_variable gStateCond;
+
+/*
+ * gQueue
+ * Pending jobs in submission order.
+ */
+static std::deque<std::function<void()>> gQueue;
+
+/*
+ * gThread
+ * The OpenGL worker thread. Started and reset under gQueueMutex;
+ * only GLThreadStop touches it while gStopping is set.
+ * Range: not joinable (not started) or running.
+ */
+static std::thread gThread;
+
+/*
+ * gThreadId
+ * Id of the running worker, readable without taking the queue lock.
+ * Range: default id (not started) or the worker's id.
+ */
+static std::atomic<std::thread::id> gThreadId;
+
+/*
+ * gStopping
+ * Set by GLThreadStop to let the worker exit once the queue is empty.
+ * Range: false (running), true (stopping).
+ */
+static bool gStopping = false;
+
+/*
+ * gWorkerExited
+ * Set by the worker as it leaves (stopping, queue empty) until
+ * GLThreadStop has joined it; jobs posted in between wait for
+ * the next thread instead of queueing for one that is gone.
+ * Range: false (running or not started), true (left, not joined).
+ */
+static bool gWorkerExited = false;
+
+/* ============================================================
+   Procedure: WorkerLoop
+   ------------------------------------------------------------
+   Description:
+   Pops and executes jobs until the thread is stopped. Jobs
+   posted while stopping still run; the worker leaves only
+   with the queue empty, and says so under the lock.
+   ============================================================ */
+static void WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(gQueueMutex);
+            gQueueCond.wait(lock, [] { return gStopping || !gQueue.empty(); });
+
+            if (gQueue.empty())
+            {
+                gWorkerExited = true;
+                return;
+            }
+
+            job = std::move(gQueue.front());
+            gQueue.pop_front();
+        }
+        job();
+    }
+}
+
+/* ============================================================
+   Procedure: GLThreadPost
+   ------------------------------------------------------------
+   Description:
+   Queues a job on the OpenGL thread, starting the thread if
+   needed. Does not wait for the job. While GLThreadStop runs
+   the job goes to the stopping worker, or, once that has left,
+   to the thread started after the stop.
+
+   Input parameters:
+   job - Work to execute with the OpenGL context current
+   ============================================================ */
+void GLThreadPost(std::function<void()> job)
+{
+    std::unique_lock<std::mutex> lock(gQueueMutex);
+    gStateCond.wait(lock, [] { return !gWorkerExited; });
+
+    if (!gStopping && !gThread.joinable())
+    {
+        gStopping = false;
+        gThread = std::thread(WorkerLoop);
+        gThreadId = gThread.get_id();
+    }
+
+    gQueue.push_back(std::move(job));
+    gQueueCond.notify_one();
+}
+
+/* ============================================================
+   Procedure: GLThreadRun
+   ------------------------------------------------------------
+   Description:
+   Executes a job on the OpenGL thread and blocks until it has
+   finished. Jobs queued earlier (e.g. a warm-up) run first.
+   Called from the OpenGL thread itself the job runs inline.
+
+   Input parameters:
+   job - Work to execute with the OpenGL context current
+   ============================================================ */
+void GLThreadRun(const std::function<void()>& job)
+{
+    if (GLThreadIsCurrent())
+    {
+        job();
+        return;
+    }
+
+    std::mutex doneMutex;
+    std::condition_variable doneCond;
+    bool done = false;
+
+    GLThreadPost([&]
+    {
+        job();
+        std::lock_guard<std::mutex> lock(doneMutex);
+        done = true;
+        doneCond.notify_one();
+    });
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCond.wait(lock, [&] { return done; });
+}
+
+/* ============================================================
+   Procedure: GLThreadIsCurrent
+   ------------------------------------------------------------
+   Description:
+   Returns true when called on the OpenGL thread.
+   ============================================================ */
+bool GLThreadIsCurrent()
+{
+    return std::this_thread::get_id() == gThreadId.load();
+}
+
+/* ============================================================
+   Procedure: GLThreadStop
+   ------------------------------------------------------------
+   Description:
+   Lets the worker finish all queued jobs and joins it. The
+   next GLThreadPost starts a new thread. A concurrent call
+   returns once the first has finished.
+   ============================================================ */
+void GLThreadStop()
+{
+    {
+        std::unique_lock<std::mutex> lock(gQueueMutex);
+        if (gStopping)
+        {
+            gStateCond.wait(lock, [] { return !gStopping; });
+            return;
+        }
+        if (!gThread.joinable())
+            return;
+        gStopping = true;
+        gQueueCond.notify_one();
+    }
+
+    // Nothing else reads gThread while gStopping is set
+    gThread.join();
+
+    std::lock_guard<std::mutex> lock(gQueueMutex);
+    gThread = std::thread();
+    gThreadId = std::thread::id();
+    gWorkerExited = false;
+    gStopping = false;
+    gStateCond.notify_all();
+}
@@ -0,0 +1,19 @@
+#ifndef GL_THREAD_H
+#define GL_THREAD_H
+
+#include <functional>
+
+// Runs a job on the thread that owns the OpenGL context and waits
+// for it to finish. Starts the thread on first use.
+void GLThreadRun(const std::function<void()>& job);
+
+// Queues a job on the OpenGL thread without waiting for it.
+void GLThreadPost(std::function<void()> job);
+
+// Returns true when called from the OpenGL thread itself.
+bool GLThreadIsCurrent();
+
+// Drains queued jobs and joins the OpenGL thread.
+void GLThreadStop();
+
+#endif
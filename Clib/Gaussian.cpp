@@ -0,0 +1,194 @@
+// ============================================================
+// File: Gaussian.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Recursive (IIR) Gaussian blur for the large radii of local
+// adaptation and bloom, where a separable FIR kernel of 6 sigma
+// taps costs hundreds of operations per pixel. The Young-van
+// Vliet recursive Gaussian replaces it with a third-order
+// recursion run forwards and backwards: four multiply-adds per pixel, axis
+// and direction whatever the sigma.
+//
+// A recursion cannot be vectorized along its own direction, so
+// it always runs down columns, many columns at once. The
+// vertical pass filters the plane in strips of kBlockColumns
+// columns; the horizontal pass copies kBlockColumns rows at a
+// time into a transposed block, which a core's cache holds up to
+// large widths (0.5 MB at 8K), filters its columns and copies it
+// back.
+// ============================================================
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "Gaussian.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Columns per strip of the vertical pass and rows per transposed
+// block of the horizontal one (a 64-byte line of floats)
+static const int kBlockColumns = 16;
+
+// Poles of the third-order filter at sigma 2 (van Vliet, Young
+// and Verbeek, 1998); other sigmas scale them. The impulse
+// response stays within 2.1% of the Gaussian's peak at sigma 2,
+// 1.2% at sigma 4 and about 1% from sigma 10 up (3.6% at 1)
+static const std::complex<double> kBasePoles[3] =
+{
+    { 1.41650, 1.00829 },
+    { 1.41650, -1.00829 },
+    { 1.86543, 0.0 }
+};
+
+// Smallest sigma taken (the fit gets coarse below 1)
+static const double kMinSigma = 0.5;
+
+// Newton steps solving for the pole scale (converges in a few)
+static const int kNewtonSteps = 8;
+
+/* ============================================================
+   Procedure: FilterVariance
+   ------------------------------------------------------------
+   Description:
+   Variance of the forward-backward filter whose poles are the
+   base poles raised to 1 / q.
+   ============================================================ */
+static double FilterVariance(double q)
+{
+    double variance = 0.0;
+    for (const std::complex<double>& pole : kBasePoles)
+    {
+        std::complex<double> p = std::pow(pole, 1.0 / q);
+        variance += std::real(2.0 * p / ((p - 1.0) * (p - 1.0)));
+    }
+    return variance;
+}
+
+/* ============================================================
+   Procedure: YoungVanVliet
+   ------------------------------------------------------------
+   Description:
+   Coefficients of the recursive Gaussian for sigma: the base
+   poles are scaled (raised to 1 / q) until the filter's
+   variance is sigma², found by Newton's method, and expanded
+   into the recursion 1 / prod(1 - z^-1 / p). The result has
+   unit gain; the Triggs-Sdika matrix (Triggs and Sdika, 2006)
+   is added for edges repeated outwards.
+   ============================================================ */
+static GaussianCoefficients YoungVanVliet(float sigma)
+{
+    double s = std::max((double)sigma, kMinSigma);
+    double target = s * s;
+
+    // q is close to sigma / 2 at every scale (1 at sigma 2)
+    double q = 0.5 * s;
+    for (int i = 0; i < kNewtonSteps; i++)
+    {
+        double h = q * 1.0e-6;
+        double f = FilterVariance(q) - target;
+        double slope = (FilterVariance(q + h) - target - f) / h;
+        q -= f / slope;
+    }
+
+    std::complex<double> p0 = 1.0 / std::pow(kBasePoles[0], 1.0 / q);
+    std::complex<double> p1 = 1.0 / std::pow(kBasePoles[1], 1.0 / q);
+    std::complex<double> p2 = 1.0 / std::pow(kBasePoles[2], 1.0 / q);
+
+    double a1 = std::real(p0 + p1 + p2);
+    double a2 = -std::real(p0 * p1 + p0 * p2 + p1 * p2);
+    double a3 = std::real(p0 * p1 * p2);
+
+    GaussianCoefficients c;
+    c.a1 = a1;
+    c.a2 = a2;
+    c.a3 = a3;
+    c.b = 1.0 - (a1 + a2 + a3);
+
+    double scale = c.b / ((1.0 + a1 - a2 + a3) * (1.0 - a1 - a2 - a3) * (1.0 + a2 + (a1 - a3) * a3));
+    double m[9] =
+    {
+        -a3 * a1 + 1.0 - a3 * a3 - a2,
+        (a3 + a1) * (a2 + a3 * a1),
+        a3 * (a1 + a3 * a2),
+        a1 + a3 * a2,
+        -(a2 - 1.0) * (a2 + a3 * a1),
+        -(a3 * a1 + a3 * a3 + a2 - 1.0) * a3,
+        a3 * a1 + a2 + a1 * a1 - a2 * a2,
+        a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3,
+        a3 * (a1 + a3 * a2)
+    };
+    for (int k = 0; k < 9; k++)
+        c.m[k] = m[k] * scale;
+
+    return c;
+}
+
+/* ============================================================
+   Procedure: GaussianBlurPlane
+   ------------------------------------------------------------
+   Description:
+   Blurs a plane in place with a Gaussian of sigma pixels,
+   vertically, then horizontally through transposed blocks.
+   Strips and blocks run in parallel on the thread pool.
+
+   Input parameters:
+   plane  - width * height floats, rows packed
+   width  - Plane width (> 0)
+   height - Plane height (> 0)
+   sigma  - Standard deviation in pixels (>= 0.5; 0 or less
+            leaves the plane unchanged)
+
+   Output parameters:
+   plane  - Blurred plane
+   ============================================================ */
+void GaussianBlurPlane(float* plane, int width, int height, float sigma)
+{
+    if (!plane || width <= 0 || height <= 0 || !(sigma > 0.0f))
+        return;
+
+    GaussianCoefficients c = YoungVanVliet(sigma);
+
+    /* ----------------------------
+       Vertical: strips of columns
+       ---------------------------- */
+    int strips = (width + kBlockColumns - 1) / kBlockColumns;
+    ThreadPool::Instance().ParallelFor(strips, [&](int strip)
+    {
+        int x0 = strip * kBlockColumns;
+        RecursiveGaussianColumns(plane + x0, std::min(kBlockColumns, width - x0), height, width, c);
+    });
+
+    /* ----------------------------
+       Horizontal: transposed blocks of rows
+       ---------------------------- */
+    int blocks = (height + kBlockColumns - 1) / kBlockColumns;
+    ThreadPool::Instance().ParallelFor(blocks, [&](int block)
+    {
+        int y0 = block * kBlockColumns;
+        int rows = std::min(kBlockColumns, height - y0);
+        std::vector<float> transposed((size_t)width * kBlockColumns);
+
+        for (int r = 0; r < rows; r++)
+        {
+            const float* row = plane + (size_t)(y0 + r) * width;
+            for (int x = 0; x < width; x++)
+                transposed[(size_t)x * kBlockColumns + r] = row[x];
+        }
+
+        RecursiveGaussianColumns(transposed.data(), rows, width, kBlockColumns, c);
+
+        for (int r = 0; r < rows; r++)
+        {
+            float* row = plane + (size_t)(y0 + r) * width;
+            for (int x = 0; x < width; x++)
+                row[x] = transposed[(size_t)x * kBlockColumns + r];
+        }
+    });
+}
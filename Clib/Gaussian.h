@@ -0,0 +1,11 @@
+#ifndef GAUSSIAN_H
+#define GAUSSIAN_H
+
+// Gaussian blur of one plane of floats in place (width * height,
+// rows packed), with the image edges repeated outwards. The cost
+// per pixel does not depend on sigma; meant for sigmas of a few
+// pixels and up. Runs on the thread pool, so it must not be called
+// from inside ParallelFor.
+void GaussianBlurPlane(float* plane, int width, int height, float sigma);
+
+#endif
@@ -0,0 +1,87 @@
+// ============================================================
+// File: Grade.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Color grading after the tone curve: the ASC CDL (slope,
+// offset and power per channel) followed by saturation, the
+// controls a colourist applies to a tone mapped image. The
+// grade is not a stage of its own; the CPU kernels apply it to
+// every pixel in the loop that tone maps it, and the GL path
+// switches to a variant of the tone mapping shader compiled
+// with it. At identity neither has any of its code, so graded
+// and ungraded renders both take a single pass.
+// ============================================================
+#include <algorithm>
+#include <mutex>
+#include "HDR.h"
+#include "Grade.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gGrade
+ * Grade of following renders (SetColorGrade), guarded by
+ * gGradeMutex.
+ * Range: default identity
+ */
+static ColorGrade gGrade;
+static std::mutex gGradeMutex;
+
+/* ============================================================
+   Procedure: GetColorGrade
+   ============================================================ */
+ColorGrade GetColorGrade()
+{
+    std::lock_guard<std::mutex> lock(gGradeMutex);
+    return gGrade;
+}
+
+/* ============================================================
+   Procedure: SetColorGrade
+   ------------------------------------------------------------
+   Description:
+   Sets the grade applied to the tone mapped color by following
+   CPU, split and GL renders, with every operator: per channel
+   out = max(in * slope + offset, 0)^power, then saturation
+   around the Rec. 709 luminance. It works on linear display
+   values, before the output gamma, and ahead of the CLAHE
+   curves. Cached renders and tiles made with another grade are
+   dropped.
+
+   Input parameters:
+   slope      - R, G, B slope (>= 0; nullptr = 1)
+   offset     - R, G, B offset (nullptr = 0)
+   power      - R, G, B power (>= 0; nullptr = 1)
+   saturation - 0 grey, 1 unchanged, above 1 more saturated
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void SetColorGrade(const float* slope, const float* offset, const float* power, float saturation)
+{
+    ColorGrade grade;
+    for (int c = 0; c < 3; c++)
+    {
+        if (slope)
+            grade.slope[c] = std::max(slope[c], 0.0f);
+        if (offset)
+            grade.offset[c] = offset[c];
+        if (power)
+            grade.power[c] = std::max(power[c], 0.0f);
+    }
+    grade.saturation = std::max(saturation, 0.0f);
+
+    {
+        std::lock_guard<std::mutex> lock(gGradeMutex);
+        if (grade == gGrade)
+            return;
+        gGrade = grade;
+    }
+
+    SpeculateCancel();
+    RenderCacheClear();
+    TileCacheClear();
+}
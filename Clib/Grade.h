@@ -0,0 +1,10 @@
+#ifndef GRADE_H
+#define GRADE_H
+
+#include "Kernels.h"
+
+// Current grade (SetColorGrade); identity while grading is off.
+// Read once per render and passed to the kernels.
+ColorGrade GetColorGrade();
+
+#endif
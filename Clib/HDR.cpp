@@ -4,11 +4,25 @@
 // Date: 5 sem, 2026-01-21
 // Topic: Tone Mapping
 // ============================================================
+#include <cmath>
 #include <iostream>
 #include <filesystem>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "shaderClass.h"
+#include "HDR.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Clahe.h"
+#include "Bloom.h"
+#include "Exposure.h"
+#include "Grade.h"
+#include "LocalTone.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "Dither.h"
+#include "RenderGraph.h"
+#include "Stats.h"
 
 /* ============================================================
    Global variables
@@ -42,6 +56,171 @@ static GLuint quadVAO = 0;
  */
 static GLuint quadVBO = 0;
 
+/*
+ * pointVAO
+ * Empty Vertex Array Object for attribute-less point draws
+ * (the CLAHE histogram scatter).
+ * Range: 0 (not created) or valid OpenGL VAO ID.
+ */
+static GLuint pointVAO = 0;
+
+/*
+ * gShaderDir
+ * Directory containing default.vert / default.frag.
+ * Range: empty (derive from the working directory) or an absolute path.
+ */
+static std::string gShaderDir;
+
+/*
+ * gToneMapPrograms
+ * Compiled tone mapping program variants, built on first use and
+ * reused by every call (the plain one is primed by WarmUpGLAsync).
+ * Indexed by kToneMapGraded | kToneMapLut: the variants compiled
+ * with COLOR_GRADE and CUBE_LUT, used while a color grade or a
+ * LUT is set.
+ * Range: nullptr (not compiled) or a linked program.
+ */
+static const int kToneMapGraded = 1;
+static const int kToneMapLut = 2;
+static Shader* gToneMapPrograms[4] = {};
+
+/*
+ * gQualityProgram
+ * Quality counter reduction program, compiled on first use.
+ * Range: nullptr (not compiled) or a linked program.
+ */
+static Shader* gQualityProgram = nullptr;
+
+/*
+ * gClaheHistogramProgram / gClaheCurveProgram
+ * CLAHE histogram scatter and tile curve programs, compiled on
+ * first use.
+ * Range: nullptr (not compiled) or a linked program.
+ */
+static Shader* gClaheHistogramProgram = nullptr;
+static Shader* gClaheCurveProgram = nullptr;
+
+/*
+ * gGuidedProgram
+ * Guided filter passes of the local operator, compiled on first
+ * use.
+ * Range: nullptr (not compiled) or a linked program.
+ */
+static Shader* gGuidedProgram = nullptr;
+
+/*
+ * gBloomProgram
+ * Bloom chain passes, compiled on first use.
+ * Range: nullptr (not compiled) or a linked program.
+ */
+static Shader* gBloomProgram = nullptr;
+
+/*
+ * gDitherTexture
+ * Blue-noise tile (GL_R32F, 64x64, repeated) read by the tone
+ * mapping shader while dithering is on; created on first use.
+ * Range: 0 (not created) or a texture name.
+ */
+static GLuint gDitherTexture = 0;
+
+/*
+ * gLut3DTexture / gLut1DTexture / gLutUploaded
+ * Lattice (GL_TEXTURE_3D, RGB32F) and shaper (RGB32F, folded
+ * into rows of kLutShaperRow texels) of the LUT last uploaded,
+ * and that LUT; replaced when the LUT set by LoadCubeLut
+ * changes. A shaper may have 65536 entries, more than a row of
+ * a GL texture is guaranteed to hold; the row width is the GL
+ * 3.3 minimum of GL_MAX_TEXTURE_SIZE, and the largest lattice
+ * (256) the minimum of GL_MAX_3D_TEXTURE_SIZE, so every LUT
+ * LoadCubeLut accepts can be uploaded.
+ * Range: 0 (not created) or texture names; nullptr (none).
+ */
+static const int kLutShaperRow = 1024;
+static GLuint gLut3DTexture = 0;
+static GLuint gLut1DTexture = 0;
+static std::shared_ptr<const CubeLut> gLutUploaded;
+
+/*
+ * gTexturePool
+ * Render targets and input textures kept alive between calls
+ * and shared by all render graph passes.
+ */
+static TexturePool gTexturePool;
+
+/*
+ * gContextGeneration
+ * Incremented whenever the pool is cleared with the context, so
+ * persistent image targets from before are known to be gone.
+ * Range: >= 1
+ */
+static long long gContextGeneration = 1;
+
+/*
+ * OutputFormatDesc
+ * Describes how one HDROutputFormat is rendered and read back.
+ *
+ * internalFormat - FBO color attachment format
+ * readFormat     - glReadPixels format (matches the attachment layout)
+ * readType       - glReadPixels type
+ * bytesPerPixel  - Size of one output pixel in the caller's buffer
+ * linearOutput   - Shader skips gamma encoding when set
+ * lumaOutput     - Shader writes luminance into the red channel
+ * codeLevels     - Largest code of a quantized format (0 = float);
+ *                  the shader truncates or dithers to it
+ */
+struct OutputFormatDesc
+{
+    GLenum internalFormat;
+    GLenum readFormat;
+    GLenum readType;
+    int bytesPerPixel;
+    int linearOutput;
+    int lumaOutput;
+    float codeLevels;
+};
+
+/*
+ * gOutputFormats
+ * Table indexed by HDROutputFormat.
+ * BGRA8 reads an RGBA8 attachment as BGRA, which is the native
+ * surface order on Windows drivers and therefore the memcpy path.
+ */
+static const OutputFormatDesc gOutputFormats[HDR_OUTPUT_FORMAT_COUNT] = {
+    { GL_RGBA8,    GL_BGRA, GL_UNSIGNED_BYTE,               4, 0, 0,  255.0f }, // BGRA8
+    { GL_RGBA8,    GL_RGBA, GL_UNSIGNED_BYTE,               4, 0, 0,  255.0f }, // RGBA8
+    { GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4, 0, 0, 1023.0f }, // RGB10A2
+    { GL_RGBA16F,  GL_RGBA, GL_HALF_FLOAT,                  8, 1, 0,    0.0f }, // RGBA16F
+    { GL_R8,       GL_RED,  GL_UNSIGNED_BYTE,               1, 0, 1,  255.0f }  // LUMA8
+};
+
+/* ============================================================
+   Procedure: ShaderPath
+   ------------------------------------------------------------
+   Description:
+   Builds the full path of a shader source file. Uses the
+   directory set by SetShaderDirectory, or falls back to the
+   Clib folder four levels above the working directory.
+
+   Input parameters:
+   fileName - Shader file name (e.g. "default.frag")
+
+   Output parameters:
+   Returns the full path as a string.
+   ============================================================ */
+static std::string ShaderPath(const char* fileName)
+{
+    if (!gShaderDir.empty())
+        return gShaderDir + "\\" + fileName;
+
+    std::string p = std::filesystem::current_path()
+        .parent_path()
+        .parent_path()
+        .parent_path()
+        .parent_path()
+        .string();
+    return p + "\\Clib\\" + fileName;
+}
+
 /* ============================================================
    Procedure: InitFullscreenQuad
    ------------------------------------------------------------
@@ -110,16 +289,16 @@ void InitFullscreenQuad()
 }
 
 /* ============================================================
-   Procedure: InitGLFW
+   Procedure: InitGLContext
    ------------------------------------------------------------
    Description:
    Initializes GLFW, creates a hidden OpenGL context, and loads
-   OpenGL function pointers using GLAD.
+   OpenGL function pointers using GLAD. Runs on the GL thread.
 
    Output parameters:
    Returns true if initialization succeeds, false otherwise.
    ============================================================ */
-extern "C" __declspec(dllexport) bool InitGLFW()
+static bool InitGLContext()
 {
     // If already initialized, return success
     if (gGLReady)
@@ -152,179 +331,1262 @@ extern "C" __declspec(dllexport) bool InitGLFW()
 }
 
 /* ============================================================
-   Procedure: UploadToGL
+   Procedure: GetToneMapProgram
    ------------------------------------------------------------
    Description:
-   Uploads a linear HDR RGB image to OpenGL, applies tone mapping
-   using a fragment shader, and reads back the result.
+   Returns the tone mapping program variant (kToneMapGraded,
+   kToneMapLut or both, 0 for the plain one), compiling it on
+   first use. Runs on the GL thread with the context current.
+   ============================================================ */
+static Shader* GetToneMapProgram(int variant = 0)
+{
+    Shader*& program = gToneMapPrograms[variant];
+    if (!program)
+    {
+        std::string defines;
+        if (variant & kToneMapGraded)
+            defines += "#define COLOR_GRADE\n";
+        if (variant & kToneMapLut)
+            defines += "#define CUBE_LUT\n";
+
+        std::string path_vert = ShaderPath("default.vert"); // path to vertex shader
+        std::string path_frag = ShaderPath("default.frag"); // path to fragment shader
+        program = new Shader(path_vert.c_str(), path_frag.c_str(), defines.empty() ? nullptr : defines.c_str());
+    }
+    return program;
+}
+
+/* ============================================================
+   Procedure: GetDitherTexture
+   ------------------------------------------------------------
+   Description:
+   Returns the blue-noise texture, uploading the tile on first
+   use. Runs on the GL thread with the context current.
+   ============================================================ */
+static GLuint GetDitherTexture()
+{
+    if (!gDitherTexture)
+    {
+        glGenTextures(1, &gDitherTexture);
+        glBindTexture(GL_TEXTURE_2D, gDitherTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Tile rows are padded; upload the first 64 of each
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, kDitherStride);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, kDitherSize, kDitherSize, 0, GL_RED, GL_FLOAT, BlueNoiseTile());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    return gDitherTexture;
+}
+
+/* ============================================================
+   Procedure: UploadCubeLut
+   ------------------------------------------------------------
+   Description:
+   Brings the LUT textures up to date with lut, uploading its
+   tables when it is not the LUT last uploaded. The shader
+   interpolates between texels itself (texelFetch), so both
+   are sampled GL_NEAREST. Runs on the GL thread with the
+   context current.
+   ============================================================ */
+static void UploadCubeLut(const std::shared_ptr<const CubeLut>& lut)
+{
+    if (lut == gLutUploaded)
+        return;
+
+    auto upload = [](GLuint& texture, GLenum target)
+    {
+        if (!texture)
+            glGenTextures(1, &texture);
+        glBindTexture(target, texture);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    };
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (lut->size3D)
+    {
+        int n = lut->size3D;
+        upload(gLut3DTexture, GL_TEXTURE_3D);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB32F, n, n, n, 0, GL_RGB, GL_FLOAT, lut->table3D.data());
+    }
+    if (lut->size1D)
+    {
+        // Rows of kLutShaperRow entries, the last one padded
+        int width = std::min(lut->size1D, kLutShaperRow);
+        int rows = (lut->size1D + width - 1) / width;
+        std::vector<float> folded((size_t)width * rows * 3, 0.0f);
+        std::copy(lut->table1D.begin(), lut->table1D.end(), folded.begin());
+
+        upload(gLut1DTexture, GL_TEXTURE_2D);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, rows, 0, GL_RGB, GL_FLOAT, folded.data());
+    }
+    gLutUploaded = lut;
+}
+
+/* ============================================================
+   Procedure: SetLutUniforms
+   ------------------------------------------------------------
+   Description:
+   Sets the LUT uniforms of the CUBE_LUT variant: the size and
+   the scale and bias taking an input value to a texel position
+   for each table (size 0 skips the table), and the texture
+   units, 3 for the lattice and 4 for the shaper.
+   ============================================================ */
+static void SetLutUniforms(GLuint program, const CubeLut& lut)
+{
+    float scale1D[3], bias1D[3], scale3D[3], bias3D[3];
+    for (int c = 0; c < 3; c++)
+    {
+        scale1D[c] = (lut.size1D - 1) / (lut.max1D[c] - lut.min1D[c]);
+        bias1D[c] = -lut.min1D[c] * scale1D[c];
+        scale3D[c] = (lut.size3D - 1) / (lut.max3D[c] - lut.min3D[c]);
+        bias3D[c] = -lut.min3D[c] * scale3D[c];
+    }
+
+    glUniform1i(glGetUniformLocation(program, "lut3D"), 3);
+    glUniform1i(glGetUniformLocation(program, "lut1D"), 4);
+    glUniform1i(glGetUniformLocation(program, "lutSize3D"), lut.size3D);
+    glUniform1i(glGetUniformLocation(program, "lutSize1D"), lut.size1D);
+    glUniform3fv(glGetUniformLocation(program, "lutScale3D"), 1, scale3D);
+    glUniform3fv(glGetUniformLocation(program, "lutBias3D"), 1, bias3D);
+    glUniform3fv(glGetUniformLocation(program, "lutScale1D"), 1, scale1D);
+    glUniform3fv(glGetUniformLocation(program, "lutBias1D"), 1, bias1D);
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_3D, lut.size3D ? gLut3DTexture : 0);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, lut.size1D ? gLut1DTexture : 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+/* ============================================================
+   Procedure: ActivateToneMapProgram
+   ------------------------------------------------------------
+   Description:
+   Binds the tone mapping program and sets its uniforms for a
+   render with the given settings and output format. With a
+   CLAHE grid the tile curves are expected on texture unit 1,
+   for the local operator (params.op) the guided filter means,
+   and with a bloomScale above 0 the bloom levels' sum. While a
+   color grade or a LUT is set the variant of the program
+   compiled for it is bound (the LUT on texture units 3 and 4).
+   ============================================================ */
+static void ActivateToneMapProgram(const GLToneMapParams& params, const OutputFormatDesc& desc,
+    const ClaheGrid* clahe = nullptr, float bloomScale = 0.0f)
+{
+    // Compiled once and reused
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+    bool graded = !grade.Identity();
+    if (lut)
+        UploadCubeLut(lut);
+    Shader& shaderProgram = *GetToneMapProgram((graded ? kToneMapGraded : 0) | (lut ? kToneMapLut : 0));
+
+    shaderProgram.Activate();
+
+    // Pass uniform values to shader
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "tex0"), 0);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "exposure"), params.exposure);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "whitePoint"), params.whitePoint);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "gamma"), 2.2f);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "invGamma"), 1.0f / 2.2f);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "linearOutput"), desc.linearOutput);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "lumaOutput"), desc.lumaOutput);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "cpuCompatible"), params.cpuCompatible ? 1 : 0);
+
+    // CLAHE tile curves
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "claheCurves"), 1);
+    glUniform2i(glGetUniformLocation(shaderProgram.ID, "claheTiles"),
+        clahe ? clahe->tilesX : 0, clahe ? clahe->tilesY : 0);
+
+    // Local operator: guided filter means on the same unit
+    LocalToneSettings local = GetLocalToneSettings();
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "localTone"), params.op == HDR_OPERATOR_LOCAL ? 1 : 0);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "guidedMeans"), 1);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "localAnchor"), std::log2(kExposureKey));
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "localCompression"), local.compression);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "localDetail"), local.detail);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "localMinLuminance"), kMinLuminance);
+
+    // Bloom on the same unit
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "bloomTex"), 1);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "bloomScale"), bloomScale);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "bloomFactor"), kBloomFactor);
+
+    // ASC CDL (graded variant only)
+    if (graded)
+    {
+        glUniform3fv(glGetUniformLocation(shaderProgram.ID, "gradeSlope"), 1, grade.slope);
+        glUniform3fv(glGetUniformLocation(shaderProgram.ID, "gradeOffset"), 1, grade.offset);
+        glUniform3fv(glGetUniformLocation(shaderProgram.ID, "gradePower"), 1, grade.power);
+        glUniform1f(glGetUniformLocation(shaderProgram.ID, "gradeSaturation"), grade.saturation);
+    }
+
+    // Output LUT (LUT variant only)
+    if (lut)
+        SetLutUniforms(shaderProgram.ID, *lut);
+
+    // Blue-noise dithering on texture unit 2
+    bool dither = DitherEnabled() && desc.codeLevels > 0.0f;
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "outputLevels"), desc.codeLevels);
+    glUniform1i(glGetUniformLocation(shaderProgram.ID, "ditherTex"), 2);
+    glUniform1f(glGetUniformLocation(shaderProgram.ID, "ditherLevels"), dither ? desc.codeLevels : 0.0f);
+    if (dither)
+    {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, GetDitherTexture());
+        glActiveTexture(GL_TEXTURE0);
+    }
+}
+
+/* ============================================================
+   Procedure: GetQualityProgram
+   ------------------------------------------------------------
+   Description:
+   Returns the quality reduction program, compiling it on
+   first use. Runs on the GL thread with the context current.
+   ============================================================ */
+static Shader* GetQualityProgram()
+{
+    if (!gQualityProgram)
+    {
+        std::string path_vert = ShaderPath("default.vert");
+        std::string path_frag = ShaderPath("quality_reduce.frag");
+        gQualityProgram = new Shader(path_vert.c_str(), path_frag.c_str());
+    }
+    return gQualityProgram;
+}
+
+/* ============================================================
+   Procedure: AddQualityPasses
+   ------------------------------------------------------------
+   Description:
+   Adds the quality counter reduction to a render graph. The
+   first pass folds 8x8 pixel blocks of input and output into
+   four RGBA32F texels per block (see quality_reduce.frag),
+   each further pass folds 8x8 blocks of the previous level,
+   until a single block of 4x1 texels is left: 4K takes four
+   small passes and a 64-byte readback.
 
    Input parameters:
-   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
-   width       - Image width in pixels (must be > 0)
-   height      - Image height in pixels (must be > 0)
-   exposure    - Exposure multiplier for tone mapping
-   whitePoint  - White point value for tone mapping
+   graph         - Graph of the render
+   hdr, mapped   - Input and tone mapped output resources
+   width, height - Image size in pixels
+   params        - Settings of the render
+   desc          - Output format of the render
 
    Output parameters:
-   outputBGRA  - Pointer to output BGRA8 image buffer
-
-   Notes:
-   This function performs offscreen rendering using an FBO.
+   Returns the resource holding the final 4x1 block.
    ============================================================ */
-extern "C" __declspec(dllexport)
-void UploadToGL(
-    float* linearRGB,
-    int width,
-    int height,
-    unsigned char* outputBGRA,
-    float exposure,
-    float whitePoint)
+static int AddQualityPasses(RenderGraph& graph, int hdr, int mapped, int width, int height,
+    const GLToneMapParams& params, const OutputFormatDesc& desc)
 {
-    /* ----------------------------
-       1. Initialize GLFW and OpenGL
-       ---------------------------- */
+    // Crushed: 8-bit code kClipLowCode or below, i.e. an encoded
+    // value below (kClipLowCode + 1) / 255 that the CPU truncates.
+    // Quantized outputs hold truncated codes too, so the level is
+    // moved half a code of the format down to fall between codes;
+    // linear outputs are compared with the linear equivalent.
+    int lumaOutput = desc.lumaOutput;
+    float clipLowLevel = desc.linearOutput
+        ? std::pow((kClipLowCode + 1) / 255.0f, 2.2f)
+        : (kClipLowCode + 1) / 255.0f - (desc.codeLevels > 0.0f ? 0.5f / desc.codeLevels : 0.0f);
 
-    if (!InitGLFW())
-        return;
+    int srcWidth = width;
+    int srcHeight = height;
+    int source = -1;
 
-    InitFullscreenQuad();
-    glfwMakeContextCurrent(gWindow);
+    do
+    {
+        int blocksX = (srcWidth + 7) / 8;
+        int blocksY = (srcHeight + 7) / 8;
+        int level = graph.CreateTexture({ blocksX * 4, blocksY, GL_RGBA32F });
+        bool first = source < 0;
 
-    /* ----------------------------
-       2. Upload input HDR texture
-       ---------------------------- */
+        std::vector<int> inputs;
+        if (first)
+            inputs = { hdr, mapped };
+        else
+            inputs = { source };
 
-    GLuint hdrTex;
-    glGenTextures(1, &hdrTex);
-    glBindTexture(GL_TEXTURE_2D, hdrTex);
+        graph.AddPass(first ? "QualityReduce" : "QualityCombine", inputs, level,
+            [&params, first, srcWidth, srcHeight, lumaOutput, clipLowLevel](const RGPassContext&)
+        {
+            Shader& program = *GetQualityProgram();
+            program.Activate();
 
-    // Upload HDR image as floating-point RGB texture
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGB16F,
-        width,
-        height,
-        0,
-        GL_RGB,
-        GL_FLOAT,
-        linearRGB
-    );
+            glUniform1i(glGetUniformLocation(program.ID, "tex0"), 0);
+            glUniform1i(glGetUniformLocation(program.ID, "tex1"), first ? 1 : 0);
+            glUniform1i(glGetUniformLocation(program.ID, "firstLevel"), first ? 1 : 0);
+            glUniform2i(glGetUniformLocation(program.ID, "srcSize"), srcWidth, srcHeight);
+            glUniform1f(glGetUniformLocation(program.ID, "exposure"), params.exposure);
+            glUniform1f(glGetUniformLocation(program.ID, "whitePoint"), params.whitePoint);
+            glUniform1i(glGetUniformLocation(program.ID, "lumaOutput"), lumaOutput);
+            glUniform1f(glGetUniformLocation(program.ID, "clipLowLevel"), clipLowLevel);
 
-    // Set texture filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+        });
 
-    /* ----------------------------
-       3. Create output texture and FBO
-       ---------------------------- */
+        source = level;
+        srcWidth = blocksX;
+        srcHeight = blocksY;
+    } while (srcWidth > 1 || srcHeight > 1);
 
-    GLuint fbo, colorTex;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return source;
+}
 
-    glGenTextures(1, &colorTex);
-    glBindTexture(GL_TEXTURE_2D, colorTex);
+/* ============================================================
+   Procedure: GetClaheHistogramProgram / GetClaheCurveProgram
+   ------------------------------------------------------------
+   Description:
+   Return the CLAHE programs, compiling them on first use. Run
+   on the GL thread with the context current.
+   ============================================================ */
+static Shader* GetClaheHistogramProgram()
+{
+    if (!gClaheHistogramProgram)
+    {
+        std::string path_vert = ShaderPath("clahe_histogram.vert");
+        std::string path_frag = ShaderPath("clahe_histogram.frag");
+        gClaheHistogramProgram = new Shader(path_vert.c_str(), path_frag.c_str());
+    }
+    return gClaheHistogramProgram;
+}
 
-    // Allocate BGRA8 output texture
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGBA8,
-        width,
-        height,
-        0,
-        GL_BGRA,
-        GL_UNSIGNED_BYTE,
-        nullptr
-    );
+static Shader* GetClaheCurveProgram()
+{
+    if (!gClaheCurveProgram)
+    {
+        std::string path_vert = ShaderPath("default.vert");
+        std::string path_frag = ShaderPath("clahe_curve.frag");
+        gClaheCurveProgram = new Shader(path_vert.c_str(), path_frag.c_str());
+    }
+    return gClaheCurveProgram;
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+/* ============================================================
+   Procedure: AddClahePasses
+   ------------------------------------------------------------
+   Description:
+   Adds the CLAHE tile curve passes to a render graph. GL 3.3
+   has no compute shaders, so the tile histograms are built by
+   scattering: one point per pixel lands on the texel of its
+   bin and tile in an R32F target and additive blending counts
+   it (exact up to 2^24 pixels per bin). Pixels are binned
+   after the color grade, like on the CPU. A fragment pass then
+   turns each tile's histogram row into its curve.
 
-    // Attach texture to framebuffer
-    glFramebufferTexture2D(
-        GL_FRAMEBUFFER,
-        GL_COLOR_ATTACHMENT0,
-        GL_TEXTURE_2D,
-        colorTex,
-        0
-    );
+   Input parameters:
+   graph         - Graph of the render
+   hdr           - Input resource
+   width, height - Image size in pixels
+   params        - Settings of the render
+   grid          - CLAHE tile grid and clip limit
 
-    // Verify framebuffer completeness
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        return;
+   Output parameters:
+   Returns the resource holding the tile curves.
+   ============================================================ */
+static int AddClahePasses(RenderGraph& graph, int hdr, int width, int height,
+    const GLToneMapParams& params, const ClaheGrid& grid)
+{
+    int tiles = grid.tilesX * grid.tilesY;
+    int histogram = graph.CreateTexture({ kClaheBins, tiles, GL_R32F });
+    int curves = graph.CreateTexture({ kClaheEdges, tiles, GL_R32F });
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, width, height);
+    ColorGrade grade = GetColorGrade();
+    graph.AddPass("ClaheHistogram", { hdr }, histogram, [&params, &grid, grade, width, height](const RGPassContext&)
+    {
+        Shader& program = *GetClaheHistogramProgram();
+        program.Activate();
 
-    /* ----------------------------
-       4. Render using shader
-       ---------------------------- */
-	   // Load and compile shader program
-    std::string p = std::filesystem::current_path()
-        .parent_path()
-        .parent_path()
-        .parent_path()
-        .parent_path()
-        .string();
-	std::string path_vert = p + "\\Clib\\default.vert"; // path to vertex shader
-	std::string path_frag = p + "\\Clib\\default.frag"; // path to fragment shader
-    Shader shaderProgram(
-        path_vert.c_str(),
-        path_frag.c_str()
-    );
+        glUniform1i(glGetUniformLocation(program.ID, "tex0"), 0);
+        glUniform2i(glGetUniformLocation(program.ID, "imageSize"), width, height);
+        glUniform2i(glGetUniformLocation(program.ID, "tiles"), grid.tilesX, grid.tilesY);
+        glUniform1f(glGetUniformLocation(program.ID, "exposure"), params.exposure);
+        glUniform1f(glGetUniformLocation(program.ID, "whitePoint"), params.whitePoint);
+        glUniform1f(glGetUniformLocation(program.ID, "gamma"), 2.2f);
 
-    shaderProgram.Activate();
+        glUniform1i(glGetUniformLocation(program.ID, "grading"), grade.Identity() ? 0 : 1);
+        glUniform3fv(glGetUniformLocation(program.ID, "gradeSlope"), 1, grade.slope);
+        glUniform3fv(glGetUniformLocation(program.ID, "gradeOffset"), 1, grade.offset);
+        glUniform3fv(glGetUniformLocation(program.ID, "gradePower"), 1, grade.power);
+        glUniform1f(glGetUniformLocation(program.ID, "gradeSaturation"), grade.saturation);
 
-    // Pass uniform values to shader
-    glUniform1i(glGetUniformLocation(shaderProgram.ID, "tex0"), 0);
-    glUniform1f(glGetUniformLocation(shaderProgram.ID, "exposure"), exposure);
-    glUniform1f(glGetUniformLocation(shaderProgram.ID, "whitePoint"), whitePoint);
-    glUniform1f(glGetUniformLocation(shaderProgram.ID, "gamma"), 2.2f);
+        if (!pointVAO)
+            glGenVertexArrays(1, &pointVAO);
 
-    // Render fullscreen quad
-    glBindVertexArray(quadVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTex);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
 
-    /* ----------------------------
-       5. Read back pixels
-       ---------------------------- */
+        glBindVertexArray(pointVAO);
+        glDrawArrays(GL_POINTS, 0, width * height);
+        glBindVertexArray(0);
 
-    glReadPixels(
-        0, 0,
-        width, height,
-        GL_BGRA,
-        GL_UNSIGNED_BYTE,
-        outputBGRA
-    );
+        glDisable(GL_BLEND);
+    });
 
-    /* ----------------------------
-       6. Cleanup OpenGL resources
-       ---------------------------- */
+    graph.AddPass("ClaheCurve", { histogram }, curves, [&grid](const RGPassContext&)
+    {
+        Shader& program = *GetClaheCurveProgram();
+        program.Activate();
+
+        glUniform1i(glGetUniformLocation(program.ID, "tex0"), 0);
+        glUniform1f(glGetUniformLocation(program.ID, "clipLimit"), grid.clipLimit);
+
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+    });
 
-    glDeleteTextures(1, &hdrTex);
-    glDeleteTextures(1, &colorTex);
-    glDeleteFramebuffers(1, &fbo);
-    shaderProgram.Delete();
+    return curves;
 }
 
 /* ============================================================
-   Procedure: CleanupGLFW
+   Procedure: GetGuidedProgram
    ------------------------------------------------------------
    Description:
-   Destroys the GLFW window and terminates GLFW.
+   Returns the guided filter program, compiling it on first
+   use. Run on the GL thread with the context current.
    ============================================================ */
-extern "C" __declspec(dllexport) void CleanupGLFW()
+static Shader* GetGuidedProgram()
 {
-    if (gGLReady)
+    if (!gGuidedProgram)
     {
-        glfwDestroyWindow(gWindow);
-        glfwTerminate();
-        gGLReady = false;
+        std::string path_vert = ShaderPath("default.vert");
+        std::string path_frag = ShaderPath("guided_filter.frag");
+        gGuidedProgram = new Shader(path_vert.c_str(), path_frag.c_str());
     }
+    return gGuidedProgram;
+}
+
+/* ============================================================
+   Procedure: AddLocalTonePasses
+   ------------------------------------------------------------
+   Description:
+   Adds the guided filter passes of the local operator to a
+   render graph: log luminance and its square, a box filter
+   of both (x then y) ending in the coefficients a, b, and a
+   box filter of those. GL 3.3 has no compute shaders to run
+   sums along rows, so each box pass reads its 2r + 1 taps; the
+   split into x and y keeps that linear in the radius.
+
+   Input parameters:
+   graph         - Graph of the render
+   hdr           - Input resource
+   width, height - Image size in pixels
+   params        - Settings of the render
+   settings      - Local operator settings
+
+   Output parameters:
+   Returns the resource holding the means of a and b.
+   ============================================================ */
+static int AddLocalTonePasses(RenderGraph& graph, int hdr, int width, int height,
+    const GLToneMapParams& params, const LocalToneSettings& settings)
+{
+    RGTextureDesc rg = { width, height, GL_RG32F };
+    int logLum = graph.CreateTexture(rg);
+    int boxX = graph.CreateTexture(rg);
+    int coefficients = graph.CreateTexture(rg);
+    int coefficientsX = graph.CreateTexture(rg);
+    int means = graph.CreateTexture(rg);
+
+    // stage, direction of every pass (see guided_filter.frag)
+    auto addPass = [&](const char* name, int input, int output, int stage, int dx, int dy)
+    {
+        graph.AddPass(name, { input }, output, [&params, &settings, stage, dx, dy](const RGPassContext&)
+        {
+            Shader& program = *GetGuidedProgram();
+            program.Activate();
+
+            glUniform1i(glGetUniformLocation(program.ID, "tex0"), 0);
+            glUniform1i(glGetUniformLocation(program.ID, "stage"), stage);
+            glUniform2i(glGetUniformLocation(program.ID, "direction"), dx, dy);
+            glUniform1i(glGetUniformLocation(program.ID, "radius"), settings.radius);
+            glUniform1f(glGetUniformLocation(program.ID, "exposure"), params.exposure);
+            glUniform1f(glGetUniformLocation(program.ID, "minLuminance"), kMinLuminance);
+            glUniform1f(glGetUniformLocation(program.ID, "edge"), settings.edge);
+
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+        });
+    };
+
+    addPass("GuidedLog", hdr, logLum, 0, 0, 0);
+    addPass("GuidedBoxX", logLum, boxX, 1, 1, 0);
+    addPass("GuidedCoefficients", boxX, coefficients, 2, 0, 1);
+    addPass("GuidedMeanX", coefficients, coefficientsX, 1, 1, 0);
+    addPass("GuidedMeanY", coefficientsX, means, 1, 0, 1);
+
+    return means;
+}
+
+/* ============================================================
+   Procedure: GetBloomProgram
+   ------------------------------------------------------------
+   Description:
+   Returns the bloom program, compiling it on first use. Run on
+   the GL thread with the context current.
+   ============================================================ */
+static Shader* GetBloomProgram()
+{
+    if (!gBloomProgram)
+    {
+        std::string path_vert = ShaderPath("default.vert");
+        std::string path_frag = ShaderPath("bloom.frag");
+        gBloomProgram = new Shader(path_vert.c_str(), path_frag.c_str());
+    }
+    return gBloomProgram;
+}
+
+/* ============================================================
+   Procedure: AddBloomPasses
+   ------------------------------------------------------------
+   Description:
+   Adds the bloom chain to a render graph, with the levels of
+   the CPU stage (Bloom.cpp): the light above the threshold
+   reduced by 2 x 2 means to a quarter of the image size, each
+   further level half of the one before, every level blurred
+   (x then y) and the levels summed from the coarsest up. The
+   blur is a direct Gaussian of kBloomSigma level pixels, so
+   its cost does not grow with the radius either; the CPU runs
+   a recursive filter of the same width instead. Levels are
+   RGBA32F like the CPU's floats: a bright source (a sun at
+   1e5 and more) would overflow half floats to inf, which the
+   blur would spread over the whole glow.
+
+   Input parameters:
+   graph         - Graph of the render
+   hdr           - Input resource
+   width, height - Image size in pixels
+   params        - Settings of the render
+   settings      - Bloom settings
+
+   Output parameters:
+   Returns the resource holding the sum of the levels, at the
+   size of the first level.
+   ============================================================ */
+static int AddBloomPasses(RenderGraph& graph, int hdr, int width, int height,
+    const GLToneMapParams& params, const BloomSettings& settings)
+{
+    // stage, direction, second input of every pass (see bloom.frag)
+    auto addPass = [&](const char* name, std::vector<int> inputs, int output, int stage, int dx, int dy)
+    {
+        graph.AddPass(name, inputs, output, [&params, &settings, stage, dx, dy](const RGPassContext&)
+        {
+            Shader& program = *GetBloomProgram();
+            program.Activate();
+
+            glUniform1i(glGetUniformLocation(program.ID, "tex0"), 0);
+            glUniform1i(glGetUniformLocation(program.ID, "tex1"), 1);
+            glUniform1i(glGetUniformLocation(program.ID, "stage"), stage);
+            glUniform2i(glGetUniformLocation(program.ID, "direction"), dx, dy);
+            glUniform1f(glGetUniformLocation(program.ID, "sigma"), kBloomSigma);
+
+            // The threshold is on exposed luminance; the image is linear
+            glUniform1f(glGetUniformLocation(program.ID, "threshold"), settings.threshold / params.exposure);
+
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+        });
+    };
+
+    /* ----------------------------
+       Levels
+       ---------------------------- */
+    int count = BloomLevels(width, height, settings);
+    int w = (width + 1) / 2;
+    int h = (height + 1) / 2;
+
+    int half = graph.CreateTexture({ w, h, GL_RGBA32F });
+    addPass("BloomThreshold", { hdr }, half, 0, 0, 0);
+
+    std::vector<RGTextureDesc> sizes;
+    std::vector<int> levels;
+    int previous = half;
+    for (int k = 0; k < count; k++)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        sizes.push_back({ w, h, GL_RGBA32F });
+        levels.push_back(graph.CreateTexture(sizes.back()));
+        addPass("BloomDown", { previous }, levels.back(), 1, 0, 0);
+        previous = levels.back();
+    }
+
+    /* ----------------------------
+       Blur and sum
+       ---------------------------- */
+    int sum = -1;
+    for (int k = count - 1; k >= 0; k--)
+    {
+        int blurX = graph.CreateTexture(sizes[k]);
+        int blurred = graph.CreateTexture(sizes[k]);
+        addPass("BloomBlurX", { levels[k] }, blurX, 2, 1, 0);
+        addPass("BloomBlurY", { blurX }, blurred, 2, 0, 1);
+
+        if (sum < 0)
+        {
+            sum = blurred;
+            continue;
+        }
+
+        int added = graph.CreateTexture(sizes[k]);
+        addPass("BloomUp", { blurred, sum }, added, 3, 0, 0);
+        sum = added;
+    }
+
+    return sum;
+}
+
+/* ============================================================
+   Procedure: ReadQualityResult
+   ------------------------------------------------------------
+   Description:
+   Reads the final reduction block and adds it to an
+   accumulator. Counts come back as floats; they are exact up
+   to 2^24 per channel of one block.
+
+   Input parameters:
+   fbo    - Framebuffer of the final block
+   pixels - Pixels rendered
+
+   Output parameters:
+   quality - Accumulator to add to
+   ============================================================ */
+static void ReadQualityResult(GLuint fbo, long long pixels, QualityAccum& quality)
+{
+    float v[16];
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, 4, 1, GL_RGBA, GL_FLOAT, v);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    QualityAccum part;
+    part.pixels = pixels;
+    for (int c = 0; c < 3; c++)
+    {
+        part.clipHigh[c] = std::llround(v[c]);
+        part.clipLow[c] = std::llround(v[4 + c]);
+    }
+    part.nonFinite = std::llround(v[3]);
+    part.sumIn = v[8];
+    part.sumOut = v[9];
+    part.minIn = v[10];
+    part.maxIn = v[11];
+    part.minOut = v[12];
+    part.maxOut = v[13];
+
+    quality.Merge(part);
+}
+
+/* ============================================================
+   Procedure: InitGLFW
+   ------------------------------------------------------------
+   Description:
+   Initializes GLFW and the OpenGL context on the GL thread.
+
+   Output parameters:
+   Returns true if initialization succeeds, false otherwise.
+   ============================================================ */
+extern "C" __declspec(dllexport) bool InitGLFW()
+{
+    bool ok = false;
+    GLThreadRun([&] { ok = InitGLContext(); });
+    return ok;
+}
+
+/* ============================================================
+   Procedure: SetShaderDirectory
+   ------------------------------------------------------------
+   Description:
+   Overrides the directory shaders are loaded from. Tools that
+   do not run from the WPF output folder (e.g. the benchmark)
+   use this instead of the working-directory heuristic.
+
+   Input parameters:
+   directory - Folder containing default.vert / default.frag,
+               or nullptr / "" to restore the default lookup
+   ============================================================ */
+extern "C" __declspec(dllexport) void SetShaderDirectory(const char* directory)
+{
+    std::string dir = directory ? directory : "";
+
+    GLThreadRun([&]
+    {
+        gShaderDir = dir;
+
+        // Recompile from the new location on next use
+        for (Shader*& program : gToneMapPrograms)
+        {
+            if (program)
+            {
+                program->Delete();
+                delete program;
+                program = nullptr;
+            }
+        }
+    });
+}
+
+/* ============================================================
+   Procedure: GetOutputBytesPerPixel
+   ------------------------------------------------------------
+   Description:
+   Returns the size of one output pixel for a given format so
+   callers can allocate the readback buffer.
+
+   Input parameters:
+   format - HDROutputFormat value
+
+   Output parameters:
+   Returns bytes per pixel, or 0 for an unknown format.
+   ============================================================ */
+extern "C" __declspec(dllexport) int GetOutputBytesPerPixel(int format)
+{
+    if (format < 0 || format >= HDR_OUTPUT_FORMAT_COUNT)
+        return 0;
+    return gOutputFormats[format].bytesPerPixel;
+}
+
+/* ============================================================
+   Procedure: RenderToneMap
+   ------------------------------------------------------------
+   Description:
+   Uploads a linear HDR RGB image to OpenGL, applies tone mapping
+   using a fragment shader, and reads back the result in the
+   requested output format.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   params      - Output format, exposure, white point, ...
+
+   Output parameters:
+   output      - Pointer to a tightly packed output buffer of
+                 width * height * GetOutputBytesPerPixel(format)
+
+   Notes:
+   The passes run through a render graph whose targets come
+   from a persistent pool, so repeated calls at the same size
+   allocate nothing. The output attachment format matches the
+   readback format. With params.quality set the quality
+   counters are reduced on the GPU from the same textures and
+   added to it. With params.op HDR_OPERATOR_CLAHE the tile
+   curves, with HDR_OPERATOR_LOCAL the guided filter means are
+   built by GPU passes before the tone mapping pass.
+   Runs on the GL thread.
+   ============================================================ */
+void RenderToneMap(
+    const float* linearRGB,
+    int width,
+    int height,
+    void* output,
+    const GLToneMapParams& params)
+{
+    if (params.format < 0 || params.format >= HDR_OUTPUT_FORMAT_COUNT)
+        return;
+
+    const OutputFormatDesc& desc = gOutputFormats[params.format];
+
+    // Half floats are enough for display, full floats when the
+    // result has to match the CPU kernel
+    GLenum inputFormat = params.cpuCompatible ? GL_RGB32F : GL_RGB16F;
+
+    /* ----------------------------
+       1. Initialize GLFW and OpenGL
+       ---------------------------- */
+
+    if (!InitGLContext())
+        return;
+
+    InitFullscreenQuad();
+
+    /* ----------------------------
+       2. Upload input HDR texture
+       ---------------------------- */
+
+    // Input texture comes from the pool and is reused while the
+    // image size stays the same
+    RGTarget* input = gTexturePool.Acquire({ width, height, inputFormat });
+    glBindTexture(GL_TEXTURE_2D, input->texture);
+
+    // Upload HDR image as floating-point RGB data
+    glTexSubImage2D(
+        GL_TEXTURE_2D,
+        0,
+        0, 0,
+        width,
+        height,
+        GL_RGB,
+        GL_FLOAT,
+        linearRGB
+    );
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    /* ----------------------------
+       3. Build the pass graph
+       ---------------------------- */
+
+    RenderGraph graph(gTexturePool);
+    int hdr = graph.ImportTexture(input->texture, { width, height, inputFormat });
+
+    // Output attachment in the same layout it is read back in
+    int mapped = graph.CreateTexture({ width, height, desc.internalFormat });
+
+    // CLAHE and the local operator: the tile curves or guided
+    // filter means are computed first and read by the tone
+    // mapping pass on unit 1
+    std::vector<int> toneMapInputs = { hdr };
+    ClaheGrid grid = ClaheGridFor(width, height);
+    LocalToneSettings local = GetLocalToneSettings();
+    bool clahe = params.op == HDR_OPERATOR_CLAHE;
+    if (clahe)
+        toneMapInputs.push_back(AddClahePasses(graph, hdr, width, height, params, grid));
+    else if (params.op == HDR_OPERATOR_LOCAL)
+        toneMapInputs.push_back(AddLocalTonePasses(graph, hdr, width, height, params, local));
+
+    // Bloom (global operator only): the levels' sum on unit 1
+    BloomSettings bloom = params.bloom ? *params.bloom : GetBloomSettings();
+    float bloomScale = 0.0f;
+    if (bloom.intensity > 0.0f && params.op == HDR_OPERATOR_REINHARD)
+    {
+        toneMapInputs.push_back(AddBloomPasses(graph, hdr, width, height, params, bloom));
+        bloomScale = bloom.intensity / BloomLevels(width, height, bloom);
+    }
+
+    graph.AddPass("ToneMap", toneMapInputs, mapped, [&](const RGPassContext&)
+    {
+        ActivateToneMapProgram(params, desc, clahe ? &grid : nullptr, bloomScale);
+
+        // Render fullscreen quad
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+    });
+
+    graph.MarkOutput(mapped);
+
+    int quality = -1;
+    if (params.quality)
+    {
+        quality = AddQualityPasses(graph, hdr, mapped, width, height, params, desc);
+        graph.MarkOutput(quality);
+    }
+
+    /* ----------------------------
+       4. Render
+       ---------------------------- */
+
+    if (graph.Execute())
+    {
+        /* ----------------------------
+           5. Read back pixels
+           ---------------------------- */
+
+        glBindFramebuffer(GL_FRAMEBUFFER, graph.Framebuffer(mapped));
+
+        // Rows are tightly packed; 1-byte formats need byte alignment.
+        // The previous alignment is restored for later readbacks
+        GLint packAlignment;
+        glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, desc.bytesPerPixel >= 4 ? 4 : 1);
+
+        glReadPixels(
+            0, 0,
+            width, height,
+            desc.readFormat,
+            desc.readType,
+            output
+        );
+
+        glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (quality >= 0)
+            ReadQualityResult(graph.Framebuffer(quality), (long long)width * height, *params.quality);
+    }
+
+    /* ----------------------------
+       6. Return textures to the pool
+       ---------------------------- */
+
+    graph.Release();
+    gTexturePool.Release(input);
+    if (params.endFrame)
+        gTexturePool.EndFrame();
+    StatsGpuPool(gTexturePool.TextureCount(), gTexturePool.Bytes(), gTexturePool.Allocations());
+}
+
+/* ============================================================
+   Procedure: RenderEndFrame
+   ------------------------------------------------------------
+   Description:
+   Ends the texture pool's frame after RenderToneMap calls that
+   left it open (params.endFrame cleared), so a frame drawn in
+   several bands ages the pool by one frame, not one per band.
+   ============================================================ */
+void RenderEndFrame()
+{
+    gTexturePool.EndFrame();
+    StatsGpuPool(gTexturePool.TextureCount(), gTexturePool.Bytes(), gTexturePool.Allocations());
+}
+
+/* ============================================================
+   Procedure: UploadToGLFormat
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image on the GPU and reads back
+   the result in the requested output format. Waits for a
+   running warm-up before it starts. Publishes quality
+   counters if they are enabled.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   format      - HDROutputFormat of the output buffer
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   output      - Pointer to a tightly packed output buffer of
+                 width * height * GetOutputBytesPerPixel(format)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void UploadToGLFormat(
+    float* linearRGB,
+    int width,
+    int height,
+    void* output,
+    int format,
+    float exposure,
+    float whitePoint)
+{
+    GLToneMapParams params;
+    params.format = format;
+    params.exposure = exposure;
+    params.whitePoint = whitePoint;
+
+    QualityAccum quality;
+    if (StatsQualityEnabled())
+        params.quality = &quality;
+
+    GLThreadRun([&]
+    {
+        RenderToneMap(linearRGB, width, height, output, params);
+    });
+
+    if (params.quality)
+        StatsQuality(quality);
+}
+
+/* ============================================================
+   Procedure: WarmUpGLAsync
+   ------------------------------------------------------------
+   Description:
+   Starts the OpenGL warm-up in the background and returns
+   immediately: context creation, GLAD loading, shader compile
+   and a 1x1 draw with readback to trigger the driver's lazy
+   work. Later calls queue behind the warm-up, so they only
+   wait if it has not finished yet. The duration is reported
+   through GetHDRStats.
+   ============================================================ */
+extern "C" __declspec(dllexport) void WarmUpGLAsync()
+{
+    double start = StatsNowMs();
+    StatsWarmUpStarted();
+
+    GLThreadPost([start]
+    {
+        bool ok = InitGLContext();
+        if (ok)
+        {
+            float pixel[3] = { 0.5f, 0.5f, 0.5f };
+            unsigned char out[4];
+            RenderToneMap(pixel, 1, 1, out, GLToneMapParams());
+            glFinish();
+        }
+        StatsWarmUpFinished(ok, StatsNowMs() - start);
+    });
+}
+
+/* ============================================================
+   Procedure: UploadToGL
+   ------------------------------------------------------------
+   Description:
+   Uploads a linear HDR RGB image to OpenGL, applies tone mapping
+   using a fragment shader, and reads back the result as BGRA8.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+
+   Notes:
+   Kept for existing callers; equivalent to UploadToGLFormat
+   with HDR_OUTPUT_BGRA8.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void UploadToGL(
+    float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint)
+{
+    UploadToGLFormat(linearRGB, width, height, outputBGRA,
+        HDR_OUTPUT_BGRA8, exposure, whitePoint);
+}
+
+/* ============================================================
+   Procedure: RenderToneMapRects
+   ------------------------------------------------------------
+   Description:
+   Incremental render of a persistent image. Each rectangle is
+   uploaded straight from the whole-image buffer (unpack row
+   length and skips select it), drawn with the scissor set to
+   it and read back into the same pixels of the output (pack
+   row length and skips again), so nothing outside the
+   rectangles is transferred or shaded.
+
+   Input parameters:
+   targets     - Textures of the image (created if missing)
+   linearRGB   - Whole linear RGB image (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   rects       - Rectangles to update, inside the image
+   count       - Number of rectangles
+   params      - Exposure and white point (format is BGRA8)
+
+   Output parameters:
+   outputBGRA  - Whole-image BGRA8 buffer; only the rectangles
+                 are written
+   wholeImage  - Set if the whole image was rendered instead
+   Returns false if the context or the target failed.
+   ============================================================ */
+bool RenderToneMapRects(
+    GLImageTargets& targets,
+    const float* linearRGB,
+    int width,
+    int height,
+    const HDRRect* rects,
+    int count,
+    unsigned char* outputBGRA,
+    const GLToneMapParams& params,
+    bool& wholeImage)
+{
+    const OutputFormatDesc& desc = gOutputFormats[HDR_OUTPUT_BGRA8];
+
+    if (!InitGLContext())
+        return false;
+
+    InitFullscreenQuad();
+
+    /* ----------------------------
+       1. Persistent textures
+       ---------------------------- */
+
+    HDRRect whole = { 0, 0, width, height };
+    bool fresh = !targets.input || targets.generation != gContextGeneration;
+    if (fresh)
+    {
+        // Targets of a previous context were deleted with it
+        targets.input = gTexturePool.Acquire({ width, height, GL_RGB16F });
+        targets.output = gTexturePool.Acquire({ width, height, desc.internalFormat });
+        targets.generation = gContextGeneration;
+        rects = &whole;
+        count = 1;
+    }
+    wholeImage = fresh;
+
+    GLuint fbo = gTexturePool.Framebuffer(targets.output);
+    if (!fbo)
+        return false;
+
+    /* ----------------------------
+       2. Upload the rectangles
+       ---------------------------- */
+
+    glBindTexture(GL_TEXTURE_2D, targets.input->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+
+    for (int i = 0; i < count; i++)
+    {
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rects[i].x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rects[i].y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rects[i].x, rects[i].y,
+            rects[i].width, rects[i].height, GL_RGB, GL_FLOAT, linearRGB);
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    /* ----------------------------
+       3. Draw the rectangles
+       ---------------------------- */
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, targets.input->texture);
+
+    ActivateToneMapProgram(params, desc);
+
+    glEnable(GL_SCISSOR_TEST);
+    glBindVertexArray(quadVAO);
+    for (int i = 0; i < count; i++)
+    {
+        glScissor(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glBindVertexArray(0);
+    glDisable(GL_SCISSOR_TEST);
+
+    /* ----------------------------
+       4. Read the rectangles back
+       ---------------------------- */
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+
+    for (int i = 0; i < count; i++)
+    {
+        glPixelStorei(GL_PACK_SKIP_PIXELS, rects[i].x);
+        glPixelStorei(GL_PACK_SKIP_ROWS, rects[i].y);
+        glReadPixels(rects[i].x, rects[i].y, rects[i].width, rects[i].height,
+            desc.readFormat, desc.readType, outputBGRA);
+    }
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_PACK_SKIP_ROWS, 0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    gTexturePool.EndFrame();
+    StatsGpuPool(gTexturePool.TextureCount(), gTexturePool.Bytes(), gTexturePool.Allocations());
+    return true;
+}
+
+/* ============================================================
+   Procedure: ReleaseImageTargets
+   ============================================================ */
+void ReleaseImageTargets(GLImageTargets& targets)
+{
+    if (targets.generation == gContextGeneration)
+    {
+        gTexturePool.Release(targets.input);
+        gTexturePool.Release(targets.output);
+    }
+
+    targets = GLImageTargets();
+}
+
+/* ============================================================
+   Procedure: CleanupGLFW
+   ------------------------------------------------------------
+   Description:
+   Destroys the GLFW window, terminates GLFW and stops the
+   GL thread. The speculation thread is stopped first so none
+   of its renders is left waiting on the GL thread, and so it
+   is not left to a static destructor, which would join it
+   under the loader lock.
+   ============================================================ */
+extern "C" __declspec(dllexport) void CleanupGLFW()
+{
+    SpeculateShutdown();
+
+    GLThreadRun([]
+    {
+        if (gGLReady)
+        {
+            for (Shader*& program : gToneMapPrograms)
+            {
+                if (program)
+                {
+                    program->Delete();
+                    delete program;
+                    program = nullptr;
+                }
+            }
+
+            if (gQualityProgram)
+            {
+                gQualityProgram->Delete();
+                delete gQualityProgram;
+                gQualityProgram = nullptr;
+            }
+
+            Shader** passPrograms[4] = { &gClaheHistogramProgram, &gClaheCurveProgram, &gGuidedProgram, &gBloomProgram };
+            for (Shader** program : passPrograms)
+            {
+                if (*program)
+                {
+                    (*program)->Delete();
+                    delete *program;
+                    *program = nullptr;
+                }
+            }
+
+            if (gDitherTexture)
+            {
+                glDeleteTextures(1, &gDitherTexture);
+                gDitherTexture = 0;
+            }
+
+            for (GLuint* texture : { &gLut3DTexture, &gLut1DTexture })
+            {
+                if (*texture)
+                {
+                    glDeleteTextures(1, texture);
+                    *texture = 0;
+                }
+            }
+            gLutUploaded = nullptr;
+
+            gTexturePool.Clear();
+            gContextGeneration++;
+
+            glDeleteVertexArrays(1, &quadVAO);
+            glDeleteBuffers(1, &quadVBO);
+            quadVAO = 0;
+            quadVBO = 0;
+
+            if (pointVAO)
+            {
+                glDeleteVertexArrays(1, &pointVAO);
+                pointVAO = 0;
+            }
+
+            glfwDestroyWindow(gWindow);
+            glfwTerminate();
+            gGLReady = false;
+        }
+    });
+
+    GLThreadStop();
 }
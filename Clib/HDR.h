@@ -7,13 +7,489 @@
 #define HDR_API __declspec(dllimport)
 #endif
 
+/*
+ * HDROutputFormat
+ * Pixel layout written by UploadToGLFormat. Every format is backed
+ * by an FBO whose internal format matches the readback format, so
+ * glReadPixels is a straight copy without a CPU-side swizzle.
+ *
+ *  HDR_OUTPUT_BGRA8   - 4 bytes/pixel, gamma encoded, B G R A
+ *  HDR_OUTPUT_RGBA8   - 4 bytes/pixel, gamma encoded, R G B A
+ *  HDR_OUTPUT_RGB10A2 - 4 bytes/pixel, gamma encoded, packed 10:10:10:2
+ *  HDR_OUTPUT_RGBA16F - 8 bytes/pixel, linear half floats R G B A
+ *  HDR_OUTPUT_LUMA8   - 1 byte/pixel, gamma encoded luminance
+ */
+enum HDROutputFormat
+{
+	HDR_OUTPUT_BGRA8 = 0,
+	HDR_OUTPUT_RGBA8 = 1,
+	HDR_OUTPUT_RGB10A2 = 2,
+	HDR_OUTPUT_RGBA16F = 3,
+	HDR_OUTPUT_LUMA8 = 4,
+	HDR_OUTPUT_FORMAT_COUNT
+};
+
+/*
+ * HDRBackend
+ * Renderer that produced (or should produce) an image.
+ */
+enum HDRBackend
+{
+	HDR_BACKEND_GL = 0,
+	HDR_BACKEND_CPU = 1,
+	HDR_BACKEND_SPLIT = 2,
+	HDR_BACKEND_ASM = 3,
+	HDR_BACKEND_COUNT
+};
+
+/*
+ * HDROperator
+ * Tone mapping operator.
+ */
+enum HDROperator
+{
+	HDR_OPERATOR_REINHARD = 0,
+	HDR_OPERATOR_CLAHE = 1,
+	HDR_OPERATOR_LOCAL = 2
+};
+
+/*
+ * RenderCacheKey
+ * Identifies one render in the result cache. imageHash is the
+ * HashLinearRGB of the unboosted linear image, computed once at
+ * load; every other field is a render setting.
+ */
+struct RenderCacheKey
+{
+	unsigned long long imageHash;
+	int width;
+	int height;
+	float boost;
+	float exposure;
+	float whitePoint;
+	int op;
+	int backend;
+	int format;
+};
+
+/*
+ * HDRLatencyStats
+ * Request latency distribution of one backend and cache outcome
+ * (GetLatencyStats), from submission to output buffer ready.
+ *
+ * count     - Requests recorded
+ * overSlo   - Requests slower than sloMs
+ * p50Ms ... - Percentiles, exact to 1% (never understated)
+ * maxMs     - Slowest request
+ * meanMs    - Average
+ * sloMs     - Current latency target (SetLatencySLO)
+ */
+struct HDRLatencyStats
+{
+	long long count;
+	long long overSlo;
+	double p50Ms;
+	double p95Ms;
+	double p99Ms;
+	double maxMs;
+	double meanMs;
+	double sloMs;
+};
+
+/*
+ * HDRKernelVariant
+ * CPU kernel implementation.
+ */
+enum HDRKernelVariant
+{
+	HDR_KERNEL_AUTO = 0,
+	HDR_KERNEL_SCALAR = 1,
+	HDR_KERNEL_AVX2 = 2
+};
+
+/*
+ * HDRTuneProfile
+ * Machine-dependent CPU pipeline settings, found by the Bench
+ * autotune command and stored per CPU model.
+ *
+ * tileWidth, tileHeight - Fused loop tile size in pixels
+ * threads               - Threads per CPU render (0 = all)
+ * kernelVariant         - HDRKernelVariant
+ * unroll                - AVX2 iterations per loop step (1 or 2)
+ * streamThreshold       - Output bytes from which the 8-bit store
+ *                         bypasses the cache (0 = never)
+ */
+struct HDRTuneProfile
+{
+	int tileWidth;
+	int tileHeight;
+	int threads;
+	int kernelVariant;
+	int unroll;
+	long long streamThreshold;
+};
+
+/*
+ * HDRQualityStats
+ * Quality counters of the last render (GetQualityStats), gathered
+ * while the pixels were processed when EnableQualityStats is on.
+ *
+ * pixels     - Pixels rendered
+ * nonFinite  - Pixels with a NaN or infinite input channel
+ * clipHigh   - Output channels (R, G, B) at full scale
+ * clipLow    - Output channels (R, G, B) at or below the 8-bit
+ *              code of the channel floor 0.0001 (code 3), which
+ *              black maps to (crushed)
+ * lumMinIn ... lumMeanIn    - Exposed scene luminance (finite pixels)
+ * lumMinOut ... lumMeanOut  - Mapped luminance (finite pixels)
+ */
+struct HDRQualityStats
+{
+	long long pixels;
+	long long nonFinite;
+	long long clipHigh[3];
+	long long clipLow[3];
+	double lumMinIn;
+	double lumMaxIn;
+	double lumMeanIn;
+	double lumMinOut;
+	double lumMaxOut;
+	double lumMeanOut;
+};
+
+/*
+ * HDRRect
+ * Pixel rectangle of an image, top left corner plus size, in the
+ * row order of the linear RGB buffers (HDRImageMarkDirty,
+ * HDRImageGetUpdated).
+ */
+struct HDRRect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+/*
+ * HDRExposureEstimate
+ * Scene luminance figures of an image (EstimateExposure), in
+ * unexposed linear units. Each comes with a 95% confidence
+ * interval; after a full pass the intervals shrink to the exact
+ * value (log average) or one histogram bin (percentile).
+ *
+ * logAverage ... logAverageHigh - Geometric mean luminance
+ * percentile ... percentileHigh - Luminance at the requested rank
+ * exposure   - Exposure that maps logAverage to middle grey (0.18)
+ * samples    - Pixels read (finite ones)
+ * fullPass   - 1 if the sampled estimate was not certain enough and
+ *              every pixel was read
+ */
+struct HDRExposureEstimate
+{
+	float logAverage;
+	float logAverageLow;
+	float logAverageHigh;
+	float percentile;
+	float percentileLow;
+	float percentileHigh;
+	float exposure;
+	long long samples;
+	int fullPass;
+};
+
+/*
+ * HDRMeteringMode
+ * How MeterExposure weighs the parts of the image.
+ *
+ * MATRIX    - 5x5 zones, the centre weighted up and zones far
+ *             brighter (sky) or darker than the rest weighted down
+ * CENTRE    - Gaussian weight around a point
+ * SPOT      - Mean of a disc around a point
+ * HIGHLIGHT - Matrix, but never exposing the brightest 1% of the
+ *             image past the white point
+ */
+enum HDRMeteringMode
+{
+	HDR_METER_MATRIX = 0,
+	HDR_METER_CENTRE = 1,
+	HDR_METER_SPOT = 2,
+	HDR_METER_HIGHLIGHT = 3
+};
+
+/*
+ * HDRMeterResult
+ * Result of MeterExposure, in unexposed linear units.
+ *
+ * luminance - Metered (weighted geometric mean) luminance
+ * highlight - Luminance of the brightest 1% of the image
+ * exposure  - Suggested exposure (luminance to middle grey, 0.18)
+ */
+struct HDRMeterResult
+{
+	float luminance;
+	float highlight;
+	float exposure;
+};
+
+/*
+ * HDRBatchImage
+ * One file of a batch (BatchAnalyze, BatchSolveExposure,
+ * BatchToneMap). Luminances are of the decoded linear image
+ * (8-bit files linearized with gamma 2.2, as the app does).
+ *
+ * width, height - Image size in pixels
+ * logAverage    - Geometric mean luminance
+ * highlight     - Luminance of the brightest 1%
+ * exposure      - Exposure to tone map with (BatchSolveExposure)
+ * status        - 1 if the file was read, 0 if not
+ */
+struct HDRBatchImage
+{
+	int width;
+	int height;
+	float logAverage;
+	float highlight;
+	float exposure;
+	int status;
+};
+
+/*
+ * HDRCacheResult
+ * Outcome of ToneMapCached.
+ */
+enum HDRCacheResult
+{
+	HDR_CACHE_FAILED = 0,
+	HDR_CACHE_RENDERED = 1,
+	HDR_CACHE_HIT = 2
+};
+
+/*
+ * HDRWarmUpState
+ * Progress of the asynchronous OpenGL warm-up.
+ */
+enum HDRWarmUpState
+{
+	HDR_WARMUP_NONE = 0,
+	HDR_WARMUP_RUNNING = 1,
+	HDR_WARMUP_DONE = 2,
+	HDR_WARMUP_FAILED = 3
+};
+
+/*
+ * HDRStats
+ * Library-wide counters returned by GetHDRStats.
+ *
+ * warmUpState - HDRWarmUpState value
+ * warmUpMs    - Duration of the warm-up in milliseconds
+ *               (context, shader compile, first draw); 0 until done
+ * gpuPoolTextures - Textures currently held by the GL texture pool
+ * gpuPoolBytes    - GPU memory held by the pool in bytes
+ * gpuAllocations  - Textures created by the pool since start-up
+ * cpuPasses       - Full-image sweeps of the last ToneMapCPU call
+ * cpuPeakBytes    - Peak scratch + intermediate memory of that call
+ * splitGpuShare   - ToneMapSplit's current GPU row fraction estimate
+ * splitGpuRows    - Rows the GPU rendered in the last split frame
+ * splitGpuMs      - GPU busy time in the last split frame
+ * splitCpuMs      - CPU busy time in the last split frame
+ * cacheHits       - Render cache lookups that returned a result
+ * cacheMisses     - Render cache lookups that had to render
+ * cacheEntries    - Renders currently cached
+ * cacheBytes      - Bytes held by the render cache
+ * specRenders     - Speculative renders completed into the cache
+ * specCancelled   - Speculative renders aborted by a real request
+ * specHits        - Cache hits served by a speculative render
+ * specWastedMs    - Time spent on speculative renders that were
+ *                   cancelled or evicted without being used
+ * tileHits        - Tile server requests (cells and files) served
+ *                   from the tile cache
+ * tileMisses      - Tiles computed on demand
+ * tileCoalesced   - Requests that waited for a tile another
+ *                   request was already computing
+ * tileEntries     - Tiles currently cached
+ * tileBytes       - Bytes held by the tile cache
+ * seqTilesSkipped - Sequence frame tiles whose input had not
+ *                   changed, so the previous output was kept
+ * seqTilesRendered - Sequence frame tiles tone mapped
+ */
+struct HDRStats
+{
+	int warmUpState;
+	double warmUpMs;
+	int gpuPoolTextures;
+	long long gpuPoolBytes;
+	long long gpuAllocations;
+	int cpuPasses;
+	long long cpuPeakBytes;
+	double splitGpuShare;
+	int splitGpuRows;
+	double splitGpuMs;
+	double splitCpuMs;
+	long long cacheHits;
+	long long cacheMisses;
+	int cacheEntries;
+	long long cacheBytes;
+	long long specRenders;
+	long long specCancelled;
+	long long specHits;
+	double specWastedMs;
+	long long tileHits;
+	long long tileMisses;
+	long long tileCoalesced;
+	int tileEntries;
+	long long tileBytes;
+	long long seqTilesSkipped;
+	long long seqTilesRendered;
+};
+
 extern "C" {
 
 	void HDR_API UploadToGL(float* linearRGB, int width, int height, unsigned char* outputBGRA, float exposure, float whitePoint);
 
+	void HDR_API UploadToGLFormat(float* linearRGB, int width, int height, void* output, int format, float exposure, float whitePoint);
+
+	int HDR_API GetOutputBytesPerPixel(int format);
+
+	void HDR_API SetShaderDirectory(const char* directory);
+
 	void HDR_API CleanupGLFW();
 
 	bool HDR_API InitGLFW();
+
+	void HDR_API WarmUpGLAsync();
+
+	void HDR_API GetHDRStats(HDRStats* stats);
+
+	void HDR_API ToneMapCPU(float* linearRGB, int width, int height, unsigned char* outputBGRA, float exposure, float whitePoint);
+
+	void HDR_API ToneMapSplit(float* linearRGB, int width, int height, unsigned char* outputBGRA, float exposure, float whitePoint);
+
+	unsigned long long HDR_API HashLinearRGB(const float* linearRGB, long long count);
+
+	bool HDR_API RenderCacheLookup(const RenderCacheKey* key, void* output, long long bytes);
+
+	void HDR_API RenderCacheStore(const RenderCacheKey* key, const void* data, long long bytes);
+
+	void HDR_API RenderCacheSetBudget(long long bytes);
+
+	void HDR_API RenderCacheClear();
+
+	int HDR_API ToneMapCached(const RenderCacheKey* key, float* linearRGB, void* output);
+
+	void HDR_API SpeculateNext(const RenderCacheKey* key, float* linearRGB, float exposureStep, float whitePointStep);
+
+	void HDR_API SpeculateCancel();
+
+	void HDR_API SpeculateShutdown();
+
+	void HDR_API RecordLatency(int backend, bool cacheHit, double ms);
+
+	bool HDR_API GetLatencyStats(int backend, int cacheHit, HDRLatencyStats* stats);
+
+	void HDR_API ResetLatencyStats();
+
+	void HDR_API SetLatencySLO(double ms);
+
+	void HDR_API SetTuneProfile(const HDRTuneProfile* profile);
+
+	void HDR_API GetTuneProfile(HDRTuneProfile* profile);
+
+	int HDR_API GetCpuModel(char* buffer, int size);
+
+	bool HDR_API LoadTuneProfile(const char* path);
+
+	bool HDR_API SaveTuneProfile(const char* path);
+
+	void HDR_API EnableQualityStats(bool enable);
+
+	void HDR_API EnableDither(bool enable);
+
+	bool HDR_API GetQualityStats(HDRQualityStats* stats);
+
+	bool HDR_API ExportDeepZoom(float* linearRGB, int width, int height, float exposure, float whitePoint,
+		const char* dziPath, int tileSize, int overlap);
+
+	int HDR_API TileSourceOpen(const float* linearRGB, int width, int height, int tileSize, int overlap);
+
+	void HDR_API TileSourceClose(int source);
+
+	int HDR_API TileServerGetTile(int source, int level, int col, int row, float exposure, float whitePoint,
+		unsigned char* png, int capacity);
+
+	void HDR_API TileCacheSetBudget(long long bytes);
+
+	void HDR_API TileCacheClear();
+
+	bool HDR_API TileServerStart(int source, int port, float exposure, float whitePoint);
+
+	void HDR_API TileServerStop();
+
+	int HDR_API HDRImageCreate(int width, int height);
+
+	void HDR_API HDRImageDestroy(int image);
+
+	HDR_API float* HDRImageData(int image);
+
+	bool HDR_API HDRImageWrite(int image, int x, int y, int width, int height, const float* linearRGB, int stride);
+
+	bool HDR_API HDRImageMarkDirty(int image, int x, int y, int width, int height);
+
+	int HDR_API HDRImageRender(int image, int backend, float exposure, float whitePoint, unsigned char* outputBGRA);
+
+	int HDR_API HDRImageGetUpdated(int image, HDRRect* rects, int capacity);
+
+	int HDR_API HDRSequenceCreate(int width, int height);
+
+	void HDR_API HDRSequenceDestroy(int sequence);
+
+	int HDR_API HDRSequenceRender(int sequence, const float* linearRGB, unsigned char* outputBGRA,
+		float exposure, float whitePoint);
+
+	int HDR_API ImageStoreCreate(const float* linearRGB, int width, int height);
+
+	void HDR_API ImageStoreRelease(int store);
+
+	long long HDR_API ImageStoreBytes(int store);
+
+	bool HDR_API ImageStoreRead(int store, float* linearRGB, float scale);
+
+	bool HDR_API ToneMapStoreCPU(int store, unsigned char* outputBGRA, float exposure, float whitePoint);
+
+	bool HDR_API EstimateExposure(const float* linearRGB, int width, int height, float percentile,
+		float tolerance, HDRExposureEstimate* estimate);
+
+	int HDR_API LuminancePyramidCreate(const float* linearRGB, int width, int height);
+
+	void HDR_API LuminancePyramidRelease(int pyramid);
+
+	bool HDR_API MeterExposure(int pyramid, int mode, float x, float y, float radius, float whitePoint,
+		HDRMeterResult* result);
+
+	int HDR_API BatchAnalyze(const char* const* paths, int count, HDRBatchImage* images);
+
+	void HDR_API BatchSolveExposure(HDRBatchImage* images, int count, float exposure, float strength, float whitePoint);
+
+	int HDR_API BatchToneMap(const char* const* paths, const char* const* outputs, const HDRBatchImage* images,
+		int count, float whitePoint);
+
+	void HDR_API ToneMapCLAHECPU(float* linearRGB, int width, int height, unsigned char* outputBGRA, float exposure, float whitePoint);
+
+	void HDR_API ToneMapCLAHEGL(float* linearRGB, int width, int height, void* output, int format, float exposure, float whitePoint);
+
+	void HDR_API SetCLAHEParams(float clipLimit, int tiles);
+
+	void HDR_API ToneMapLocalCPU(float* linearRGB, int width, int height, unsigned char* outputBGRA, float exposure, float whitePoint);
+
+	void HDR_API ToneMapLocalGL(float* linearRGB, int width, int height, void* output, int format, float exposure, float whitePoint);
+
+	void HDR_API SetLocalToneParams(int radius, float edge, float compression, float detail);
+
+	void HDR_API SetBloomParams(float threshold, float intensity, float radius);
+
+	void HDR_API SetColorGrade(const float* slope, const float* offset, const float* power, float saturation);
+
+	bool HDR_API LoadCubeLut(const char* path);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,473 @@
+// ============================================================
+// File: HDRImage.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Persistent images for incremental tone mapping. An editor
+// keeps its linear image here and marks the rectangles an edit
+// changed; the next render re-processes only those rectangles,
+// grown by the halo of the operator. The CPU path runs the
+// stage graph on each rectangle, the GL path uploads, draws and
+// reads back just the rectangles of textures that stay alive
+// between renders. A new setting, backend or output buffer
+// renders the whole image.
+// ============================================================
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "HDR.h"
+#include "Bloom.h"
+#include "CpuPipeline.h"
+#include "Dither.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Grade.h"
+#include "Lut.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Dirty rectangles kept apart before they collapse into one
+static const int kMaxDirtyRects = 16;
+
+// Share of the image from which an update renders all of it
+static const double kFullRenderShare = 0.5;
+
+/* ============================================================
+   HDRImage
+   ------------------------------------------------------------
+   A registered image: the linear pixels, the rectangles
+   changed since the last render and the settings of that
+   render. All fields are protected by mutex.
+   ============================================================ */
+struct HDRImage
+{
+    std::mutex mutex;
+    int width = 0;
+    int height = 0;
+    std::vector<float> linear;
+    std::vector<HDRRect> dirty;
+    std::vector<HDRRect> updated;
+
+    // Last render
+    bool rendered = false;
+    int backend = 0;
+    float exposure = 0.0f;
+    float whitePoint = 0.0f;
+    bool dither = false;
+    bool bloom = false;
+    ColorGrade grade;
+    std::shared_ptr<const CubeLut> lut;
+    unsigned char* output = nullptr;
+    GLImageTargets gl;
+};
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gImageMutex
+ * Protects gImages and gNextImage.
+ */
+static std::mutex gImageMutex;
+
+/*
+ * gImages
+ * Created images by id.
+ */
+static std::unordered_map<int, std::shared_ptr<HDRImage>> gImages;
+
+/*
+ * gNextImage
+ * Id of the next created image.
+ * Range: > 0
+ */
+static int gNextImage = 1;
+
+/* ============================================================
+   Procedure: FindImage
+   ============================================================ */
+static std::shared_ptr<HDRImage> FindImage(int id)
+{
+    std::lock_guard<std::mutex> lock(gImageMutex);
+    auto it = gImages.find(id);
+    return it != gImages.end() ? it->second : nullptr;
+}
+
+/* ============================================================
+   Procedure: ClipRect
+   ------------------------------------------------------------
+   Description:
+   Clips a rectangle to the image.
+
+   Output parameters:
+   Returns false if nothing of it is left.
+   ============================================================ */
+static bool ClipRect(HDRRect& r, int width, int height)
+{
+    int x0 = std::max(r.x, 0);
+    int y0 = std::max(r.y, 0);
+    int x1 = std::min(r.x + r.width, width);
+    int y1 = std::min(r.y + r.height, height);
+
+    r = { x0, y0, x1 - x0, y1 - y0 };
+    return r.width > 0 && r.height > 0;
+}
+
+/* ============================================================
+   Procedure: AddRect
+   ------------------------------------------------------------
+   Description:
+   Adds a rectangle to a set, merging it with every rectangle
+   it overlaps or touches (strokes arrive as many small, mostly
+   adjacent rectangles). When the set grows past kMaxDirtyRects
+   it collapses into its bounding box.
+   ============================================================ */
+static void AddRect(std::vector<HDRRect>& rects, HDRRect r)
+{
+    for (size_t i = 0; i < rects.size();)
+    {
+        const HDRRect& o = rects[i];
+        if (r.x <= o.x + o.width && o.x <= r.x + r.width &&
+            r.y <= o.y + o.height && o.y <= r.y + r.height)
+        {
+            int x1 = std::max(r.x + r.width, o.x + o.width);
+            int y1 = std::max(r.y + r.height, o.y + o.height);
+            r.x = std::min(r.x, o.x);
+            r.y = std::min(r.y, o.y);
+            r.width = x1 - r.x;
+            r.height = y1 - r.y;
+
+            // The grown rectangle may now reach earlier ones
+            rects.erase(rects.begin() + i);
+            i = 0;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    rects.push_back(r);
+
+    if ((int)rects.size() > kMaxDirtyRects)
+    {
+        HDRRect box = rects[0];
+        for (const HDRRect& o : rects)
+        {
+            int x1 = std::max(box.x + box.width, o.x + o.width);
+            int y1 = std::max(box.y + box.height, o.y + o.height);
+            box.x = std::min(box.x, o.x);
+            box.y = std::min(box.y, o.y);
+            box.width = x1 - box.x;
+            box.height = y1 - box.y;
+        }
+        rects.assign(1, box);
+    }
+}
+
+/* ============================================================
+   Procedure: HDRImageCreate
+   ------------------------------------------------------------
+   Description:
+   Creates a persistent image, all black. The first render of
+   it processes the whole image.
+
+   Input parameters:
+   width  - Image width in pixels (> 0)
+   height - Image height in pixels (> 0)
+
+   Output parameters:
+   Returns the image id (> 0), or 0 on invalid arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int HDRImageCreate(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return 0;
+
+    auto image = std::make_shared<HDRImage>();
+    image->width = width;
+    image->height = height;
+    image->linear.assign((size_t)width * height * 3, 0.0f);
+
+    std::lock_guard<std::mutex> lock(gImageMutex);
+    int id = gNextImage++;
+    gImages[id] = image;
+    return id;
+}
+
+/* ============================================================
+   Procedure: HDRImageDestroy
+   ------------------------------------------------------------
+   Description:
+   Waits for a render of the image still running, returns its
+   GL textures to the pool and frees it.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void HDRImageDestroy(int image)
+{
+    std::shared_ptr<HDRImage> img;
+    {
+        std::lock_guard<std::mutex> lock(gImageMutex);
+        auto it = gImages.find(image);
+        if (it == gImages.end())
+            return;
+        img = it->second;
+        gImages.erase(it);
+    }
+
+    std::lock_guard<std::mutex> lock(img->mutex);
+    if (img->gl.input)
+        GLThreadRun([&] { ReleaseImageTargets(img->gl); });
+}
+
+/* ============================================================
+   Procedure: HDRImageData
+   ------------------------------------------------------------
+   Description:
+   Returns the linear RGB pixels (RGBRGB..., width * height * 3
+   floats) for editing in place. Changed pixels must be
+   reported with HDRImageMarkDirty before the next render.
+
+   Output parameters:
+   Returns nullptr for an invalid image.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+float* HDRImageData(int image)
+{
+    std::shared_ptr<HDRImage> img = FindImage(image);
+    return img ? img->linear.data() : nullptr;
+}
+
+/* ============================================================
+   Procedure: HDRImageWrite
+   ------------------------------------------------------------
+   Description:
+   Copies a block of linear pixels into the image and marks it
+   dirty.
+
+   Input parameters:
+   image         - Id from HDRImageCreate
+   x, y          - Top left pixel of the block in the image
+   width, height - Block size (must lie inside the image)
+   linearRGB     - Block pixels (RGBRGB...)
+   stride        - Pixels between block rows (0 = width)
+
+   Output parameters:
+   Returns false for an invalid image or block.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool HDRImageWrite(int image, int x, int y, int width, int height, const float* linearRGB, int stride)
+{
+    std::shared_ptr<HDRImage> img = FindImage(image);
+    if (!img || !linearRGB || width <= 0 || height <= 0)
+        return false;
+
+    if (stride == 0)
+        stride = width;
+
+    std::lock_guard<std::mutex> lock(img->mutex);
+    if (x < 0 || y < 0 || x + width > img->width || y + height > img->height || stride < width)
+        return false;
+
+    for (int row = 0; row < height; row++)
+        std::memcpy(img->linear.data() + ((size_t)(y + row) * img->width + x) * 3,
+            linearRGB + (size_t)row * stride * 3, (size_t)width * 3 * sizeof(float));
+
+    AddRect(img->dirty, { x, y, width, height });
+    return true;
+}
+
+/* ============================================================
+   Procedure: HDRImageMarkDirty
+   ------------------------------------------------------------
+   Description:
+   Marks a rectangle as changed (after editing HDRImageData).
+   The rectangle is clipped to the image.
+
+   Output parameters:
+   Returns false for an invalid image.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool HDRImageMarkDirty(int image, int x, int y, int width, int height)
+{
+    std::shared_ptr<HDRImage> img = FindImage(image);
+    if (!img)
+        return false;
+
+    std::lock_guard<std::mutex> lock(img->mutex);
+    HDRRect r = { x, y, width, height };
+    if (ClipRect(r, img->width, img->height))
+        AddRect(img->dirty, r);
+    return true;
+}
+
+/* ============================================================
+   Procedure: HDRImageRender
+   ------------------------------------------------------------
+   Description:
+   Brings a BGRA8 rendering of the image up to date. If the
+   backend, exposure, white point, dither setting, color grade,
+   LUT and output buffer are those of the last render, only the
+   dirty rectangles grown by the operator's halo are
+   re-processed (all of the image once they cover more than
+   kFullRenderShare of it); otherwise the whole image is. Bloom
+   spreads any change over the image, so with bloom on (or just
+   turned off) the whole image is rendered. The rectangles
+   written can be read with HDRImageGetUpdated, e.g. to copy
+   just them to the screen.
+   Quality counters are not gathered for these renders.
+
+   Input parameters:
+   image       - Id from HDRImageCreate
+   backend     - HDR_BACKEND_CPU or HDR_BACKEND_GL
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - BGRA8 buffer of the whole image holding the
+                 last render of this image (pixels outside the
+                 updated rectangles are left as they are)
+   Returns the number of updated rectangles (0 if nothing
+   changed), or -1 for invalid arguments or a GL failure.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int HDRImageRender(int image, int backend, float exposure, float whitePoint, unsigned char* outputBGRA)
+{
+    if (!outputBGRA || (backend != HDR_BACKEND_CPU && backend != HDR_BACKEND_GL))
+        return -1;
+
+    std::shared_ptr<HDRImage> img = FindImage(image);
+    if (!img)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(img->mutex);
+    HDRRect whole = { 0, 0, img->width, img->height };
+
+    bool dither = DitherEnabled();
+    bool bloom = BloomEnabled();
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+    bool full = !img->rendered || backend != img->backend || exposure != img->exposure ||
+        whitePoint != img->whitePoint || dither != img->dither || bloom || img->bloom || grade != img->grade ||
+        lut != img->lut || outputBGRA != img->output;
+
+    /* ----------------------------
+       Rectangles to render
+       ---------------------------- */
+    std::vector<HDRRect> rects;
+    if (!full)
+    {
+        // The GL pass samples one texel per pixel
+        int halo = backend == HDR_BACKEND_CPU ? ToneMapCPUHalo() : 0;
+
+        for (HDRRect r : img->dirty)
+        {
+            r = { r.x - halo, r.y - halo, r.width + 2 * halo, r.height + 2 * halo };
+            if (ClipRect(r, img->width, img->height))
+                AddRect(rects, r);
+        }
+
+        long long area = 0;
+        for (const HDRRect& r : rects)
+            area += (long long)r.width * r.height;
+        full = area > kFullRenderShare * img->width * img->height;
+    }
+    if (full)
+        rects.assign(1, whole);
+
+    /* ----------------------------
+       Render
+       ---------------------------- */
+    if (rects.empty())
+    {
+        img->updated.clear();
+        return 0;
+    }
+
+    if (backend == HDR_BACKEND_CPU)
+    {
+        for (const HDRRect& r : rects)
+            ToneMapCPURun(img->linear.data(), img->width, img->height, outputBGRA,
+                exposure, whitePoint, nullptr, &r);
+    }
+    else
+    {
+        GLToneMapParams params;
+        params.exposure = exposure;
+        params.whitePoint = whitePoint;
+
+        bool ok = false;
+        bool wholeImage = false;
+        GLThreadRun([&]
+        {
+            // The bloom passes need the full render graph; the
+            // persistent textures are uploaded afresh after it
+            if (bloom)
+            {
+                ReleaseImageTargets(img->gl);
+                RenderToneMap(img->linear.data(), img->width, img->height, outputBGRA, params);
+                ok = true;
+                return;
+            }
+
+            ok = RenderToneMapRects(img->gl, img->linear.data(), img->width, img->height,
+                rects.data(), (int)rects.size(), outputBGRA, params, wholeImage);
+        });
+
+        if (!ok)
+            return -1;
+        if (wholeImage)
+            rects.assign(1, whole);
+    }
+
+    img->rendered = true;
+    img->backend = backend;
+    img->exposure = exposure;
+    img->whitePoint = whitePoint;
+    img->dither = dither;
+    img->bloom = bloom;
+    img->grade = grade;
+    img->lut = lut;
+    img->output = outputBGRA;
+    img->dirty.clear();
+    img->updated = rects;
+    return (int)rects.size();
+}
+
+/* ============================================================
+   Procedure: HDRImageGetUpdated
+   ------------------------------------------------------------
+   Description:
+   Returns the rectangles the last HDRImageRender wrote.
+
+   Input parameters:
+   image    - Id from HDRImageCreate
+   capacity - Number of entries rects can hold
+
+   Output parameters:
+   rects    - Receives up to capacity rectangles
+   Returns the number of updated rectangles (-1 for an invalid
+   image).
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int HDRImageGetUpdated(int image, HDRRect* rects, int capacity)
+{
+    std::shared_ptr<HDRImage> img = FindImage(image);
+    if (!img)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(img->mutex);
+    int count = (int)img->updated.size();
+    if (rects)
+        std::memcpy(rects, img->updated.data(), (size_t)std::min(count, std::max(capacity, 0)) * sizeof(HDRRect));
+    return count;
+}
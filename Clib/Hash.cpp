@@ -0,0 +1,233 @@
+// ============================================================
+// File: Hash.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Fast 64-bit content hash used to identify image buffers
+// (render cache keys, tile comparisons). Built like XXH3: the
+// input is consumed in 64-byte stripes by eight independent
+// 64-bit accumulators, which AVX2 updates four at a time.
+// ============================================================
+#include <cstring>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Hash.h"
+#include "Kernels.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+static const uint64_t kPrime32_1 = 0x9E3779B1ULL;
+static const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+
+// Stripe size in bytes and stripes per scrambled block
+static const size_t kStripe = 64;
+static const size_t kStripesPerBlock = 16;
+
+/* ============================================================
+   Procedure: Secret
+   ------------------------------------------------------------
+   Description:
+   Returns the 192-byte key material, generated once with
+   splitmix64 from a fixed constant.
+   ============================================================ */
+static const unsigned char* Secret()
+{
+    static const struct Table
+    {
+        alignas(32) uint64_t words[24];
+        Table()
+        {
+            uint64_t x = 0x243F6A8885A308D3ULL;
+            for (uint64_t& w : words)
+            {
+                uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                w = z ^ (z >> 31);
+            }
+        }
+    } table;
+    return (const unsigned char*)table.words;
+}
+
+static inline uint64_t Read64(const unsigned char* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* ============================================================
+   Procedure: Mul128Fold64
+   ------------------------------------------------------------
+   Description:
+   Full 64x64 -> 128-bit product, high and low halves XORed.
+   ============================================================ */
+static inline uint64_t Mul128Fold64(uint64_t a, uint64_t b)
+{
+#ifdef _MSC_VER
+    uint64_t hi;
+    uint64_t lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    unsigned __int128 p = (unsigned __int128)a * b;
+    return (uint64_t)p ^ (uint64_t)(p >> 64);
+#endif
+}
+
+/* ============================================================
+   Procedure: AccumulateScalar / ScrambleScalar
+   ------------------------------------------------------------
+   Description:
+   Portable stripe update and block scramble. Lane i takes the
+   32x32-bit product of (data ^ secret) halves and the data
+   word of its neighbour lane.
+   ============================================================ */
+static void AccumulateScalar(uint64_t* acc, const unsigned char* in, const unsigned char* sec)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        uint64_t d = Read64(in + 8 * i);
+        uint64_t k = d ^ Read64(sec + 8 * i);
+        acc[i ^ 1] += d;
+        acc[i] += (k & 0xFFFFFFFFULL) * (k >> 32);
+    }
+}
+
+static void ScrambleScalar(uint64_t* acc, const unsigned char* sec)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= Read64(sec + 8 * i);
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+/* ============================================================
+   Procedure: AccumulateAVX2 / ScrambleAVX2
+   ------------------------------------------------------------
+   Description:
+   Same math as the scalar versions, four lanes per register.
+   ============================================================ */
+static inline void AccumulateAVX2(__m256i* acc, const unsigned char* in, const unsigned char* sec)
+{
+    for (int h = 0; h < 2; h++)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(in + 32 * h));
+        __m256i k = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i*)(sec + 32 * h)));
+        __m256i product = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+        __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[h] = _mm256_add_epi64(acc[h], _mm256_add_epi64(product, swapped));
+    }
+}
+
+static inline void ScrambleAVX2(__m256i* acc, const unsigned char* sec)
+{
+    __m256i prime = _mm256_set1_epi32((int)kPrime32_1);
+    for (int h = 0; h < 2; h++)
+    {
+        __m256i a = acc[h];
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*)(sec + 32 * h)));
+
+        // 64-bit multiply by a 32-bit constant
+        __m256i lo = _mm256_mul_epu32(a, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        acc[h] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+    }
+}
+
+/* ============================================================
+   Procedure: HashBytes
+   ------------------------------------------------------------
+   Description:
+   Hashes a buffer. Full 1 KB blocks are accumulated stripe by
+   stripe (secret offset moves 8 bytes per stripe) and then
+   scrambled; the rest is accumulated the same way with the
+   last partial stripe zero padded. The lanes are folded with
+   128-bit multiplies and the length, then avalanched.
+
+   Input parameters:
+   data - Buffer to hash (may be nullptr if size is 0)
+   size - Size in bytes
+   seed - Optional seed
+
+   Output parameters:
+   Returns the 64-bit hash.
+   ============================================================ */
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* sec = Secret();
+    const unsigned char* scrambleSec = sec + 128;
+
+    alignas(32) uint64_t acc[8] = {
+        kPrime32_1 + seed, kPrime64_1 + seed, kPrime64_2 + seed, kPrime64_3 + seed,
+        kPrime64_1 - seed, kPrime64_2 - seed, kPrime64_3 - seed, kPrime32_1 - seed
+    };
+
+    size_t stripes = size / kStripe;
+    size_t blocks = stripes / kStripesPerBlock;
+    size_t tailStripes = stripes - blocks * kStripesPerBlock;
+    size_t tailBytes = size - stripes * kStripe;
+
+    if (CpuHasAVX2())
+    {
+        __m256i vacc[2] = {
+            _mm256_load_si256((const __m256i*)acc),
+            _mm256_load_si256((const __m256i*)(acc + 4))
+        };
+
+        for (size_t b = 0; b < blocks; b++)
+        {
+            for (size_t s = 0; s < kStripesPerBlock; s++)
+                AccumulateAVX2(vacc, in + (b * kStripesPerBlock + s) * kStripe, sec + 8 * s);
+            ScrambleAVX2(vacc, scrambleSec);
+        }
+        for (size_t s = 0; s < tailStripes; s++)
+            AccumulateAVX2(vacc, in + (blocks * kStripesPerBlock + s) * kStripe, sec + 8 * s);
+
+        _mm256_store_si256((__m256i*)acc, vacc[0]);
+        _mm256_store_si256((__m256i*)(acc + 4), vacc[1]);
+    }
+    else
+    {
+        for (size_t b = 0; b < blocks; b++)
+        {
+            for (size_t s = 0; s < kStripesPerBlock; s++)
+                AccumulateScalar(acc, in + (b * kStripesPerBlock + s) * kStripe, sec + 8 * s);
+            ScrambleScalar(acc, scrambleSec);
+        }
+        for (size_t s = 0; s < tailStripes; s++)
+            AccumulateScalar(acc, in + (blocks * kStripesPerBlock + s) * kStripe, sec + 8 * s);
+    }
+
+    // Last partial stripe, zero padded
+    if (tailBytes)
+    {
+        unsigned char last[kStripe] = {};
+        std::memcpy(last, in + stripes * kStripe, tailBytes);
+        AccumulateScalar(acc, last, sec + 8 * tailStripes);
+    }
+
+    // Fold lanes
+    uint64_t h = (uint64_t)size * kPrime64_1 + seed;
+    for (int i = 0; i < 4; i++)
+        h += Mul128Fold64(acc[2 * i] ^ Read64(sec + 88 + 16 * i), acc[2 * i + 1] ^ Read64(sec + 96 + 16 * i));
+
+    // Avalanche
+    h ^= h >> 37;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
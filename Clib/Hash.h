@@ -0,0 +1,13 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit content hash of a byte buffer. XXH3-style: 64-byte stripes
+// mixed into eight 64-bit lanes (AVX2 when available), scrambled every
+// kilobyte and folded with 128-bit multiplies. Not bit-compatible with
+// the reference XXH3, but the same on every machine and code path.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+#endif
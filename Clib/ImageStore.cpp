@@ -0,0 +1,423 @@
+// ============================================================
+// File: ImageStore.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Compressed in-memory linear images. A float RGB pixel takes
+// 12 bytes; as byte-shuffled, LZ4 compressed half floats it
+// takes 6 at most, around 5 for a noisy photograph and a
+// fraction of a byte for flat or synthetic content (renders,
+// screenshots, large skies). Tiles have the shape of the CPU
+// pipeline's tiles, so a render decompresses each one exactly
+// once, on the worker that tone maps it, straight into that
+// worker's scratch.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "HDR.h"
+#include "CpuPipeline.h"
+#include "ImageStore.h"
+#include "Kernels.h"
+#include "Lz4.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "Tune.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gStoreSerial
+ * Serial number of the next store created.
+ * Range: > 0
+ */
+static std::atomic<unsigned long long> gStoreSerial{ 1 };
+
+/*
+ * gStoreMutex
+ * Protects gStores and gNextStore.
+ */
+static std::mutex gStoreMutex;
+
+/*
+ * gStores
+ * Created stores by id.
+ */
+static std::unordered_map<int, std::shared_ptr<ImageStore>> gStores;
+
+/*
+ * gNextStore
+ * Id of the next created store.
+ * Range: > 0
+ */
+static int gNextStore = 1;
+
+/*
+ * TileScratch
+ * Per-thread decompressed tile: serial of its store and its
+ * index, so repeated reads of one tile decompress it once.
+ */
+struct TileScratch
+{
+    unsigned long long serial = 0;
+    int index = -1;
+    std::vector<unsigned char> bytes;
+};
+
+static thread_local TileScratch tScratch;
+
+/* ============================================================
+   Procedure: ImageStore constructor
+   ------------------------------------------------------------
+   Description:
+   Compresses the image tile by tile on the thread pool: each
+   tile row and channel is converted to halves and split into
+   the byte planes, then the tile is LZ4 compressed.
+
+   Input parameters:
+   linearRGB             - Linear RGB float data (RGBRGB...)
+   width, height         - Image size in pixels (> 0)
+   tileWidth, tileHeight - Tile size in pixels (> 0)
+   ============================================================ */
+ImageStore::ImageStore(const float* linearRGB, int width, int height, int tileWidth, int tileHeight)
+    : width(width), height(height),
+      tileWidth(std::min(tileWidth, width)), tileHeight(std::min(tileHeight, height)),
+      serial(gStoreSerial++)
+{
+    tilesX = (width + this->tileWidth - 1) / this->tileWidth;
+    tilesY = (height + this->tileHeight - 1) / this->tileHeight;
+    tiles.resize((size_t)tilesX * tilesY);
+
+    ThreadPool::Instance().ParallelFor((int)tiles.size(), [&](int index)
+    {
+        int x0, y0, w, h;
+        TileRect(index, x0, y0, w, h);
+        size_t n = (size_t)w * h * 3;
+
+        thread_local std::vector<float> planar;
+        thread_local std::vector<unsigned char> planes;
+        thread_local std::vector<unsigned char> packed;
+        planar.resize((size_t)w * 3);
+        planes.resize(n * 2);
+        packed.resize(Lz4Bound(n * 2));
+
+        unsigned char* lo = planes.data();
+        unsigned char* hi = planes.data() + n;
+
+        for (int y = 0; y < h; y++)
+        {
+            float* r = planar.data();
+            DeinterleaveRGB(linearRGB + ((size_t)(y0 + y) * width + x0) * 3, w, r, r + w, r + 2 * w);
+
+            for (int c = 0; c < 3; c++)
+            {
+                size_t offset = ((size_t)c * h + y) * w;
+                PackHalfPlanes(r + (size_t)c * w, w, lo + offset, hi + offset);
+            }
+        }
+
+        Tile& tile = tiles[index];
+        size_t size = Lz4Compress(planes.data(), n * 2, packed.data(), packed.size());
+        if (size > 0 && size < n * 2)
+        {
+            tile.data.assign(packed.begin(), packed.begin() + size);
+        }
+        else
+        {
+            tile.data.assign(planes.begin(), planes.end());
+            tile.raw = true;
+        }
+    });
+}
+
+/* ============================================================
+   Procedure: ImageStore::Bytes
+   ============================================================ */
+long long ImageStore::Bytes() const
+{
+    long long bytes = 0;
+    for (const Tile& tile : tiles)
+        bytes += (long long)tile.data.size();
+    return bytes;
+}
+
+/* ============================================================
+   Procedure: ImageStore::TileRect
+   ============================================================ */
+void ImageStore::TileRect(int index, int& x0, int& y0, int& w, int& h) const
+{
+    x0 = (index % tilesX) * tileWidth;
+    y0 = (index / tilesX) * tileHeight;
+    w = std::min(tileWidth, width - x0);
+    h = std::min(tileHeight, height - y0);
+}
+
+/* ============================================================
+   Procedure: ImageStore::DecodeTile
+   ------------------------------------------------------------
+   Description:
+   Returns the byte planes of a tile (low bytes of all halves,
+   then high bytes), decompressing them into this thread's
+   scratch unless they are already there. Raw tiles are
+   returned in place.
+   ============================================================ */
+const unsigned char* ImageStore::DecodeTile(int index) const
+{
+    const Tile& tile = tiles[index];
+    if (tile.raw)
+        return tile.data.data();
+
+    TileScratch& scratch = tScratch;
+    if (scratch.serial == serial && scratch.index == index)
+        return scratch.bytes.data();
+
+    int x0, y0, w, h;
+    TileRect(index, x0, y0, w, h);
+    size_t size = (size_t)w * h * 3 * 2;
+
+    scratch.bytes.resize(size);
+    if (Lz4Decompress(tile.data.data(), tile.data.size(), scratch.bytes.data(), size) != (long long)size)
+        std::memset(scratch.bytes.data(), 0, size);
+
+    scratch.serial = serial;
+    scratch.index = index;
+    return scratch.bytes.data();
+}
+
+/* ============================================================
+   Procedure: ImageStore::ReadRegion
+   ------------------------------------------------------------
+   Description:
+   Fills a planar region from the tiles it overlaps, one tile
+   at a time so each is decompressed once per call.
+   ============================================================ */
+void ImageStore::ReadRegion(TileBuf& out) const
+{
+    int ty0 = out.y0 / tileHeight;
+    int ty1 = (out.y0 + out.height - 1) / tileHeight;
+    int tx0 = out.x0 / tileWidth;
+    int tx1 = (out.x0 + out.width - 1) / tileWidth;
+
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+            int index = ty * tilesX + tx;
+            int x0, y0, w, h;
+            TileRect(index, x0, y0, w, h);
+
+            const unsigned char* lo = DecodeTile(index);
+            const unsigned char* hi = lo + (size_t)w * h * 3;
+
+            int xs = std::max(x0, out.x0);
+            int xe = std::min(x0 + w, out.x0 + out.width);
+            int ys = std::max(y0, out.y0);
+            int ye = std::min(y0 + h, out.y0 + out.height);
+
+            for (int c = 0; c < out.channels; c++)
+            {
+                for (int y = ys; y < ye; y++)
+                {
+                    size_t offset = ((size_t)c * h + (y - y0)) * w + (xs - x0);
+                    UnpackHalfPlanes(lo + offset, hi + offset, xe - xs, out.Row(c, y) + (xs - out.x0));
+                }
+            }
+        }
+    }
+}
+
+/* ============================================================
+   Procedure: ImageStore::Source
+   ============================================================ */
+StageSource ImageStore::Source() const
+{
+    return [this](TileBuf& out)
+    {
+        ReadRegion(out);
+    };
+}
+
+/* ============================================================
+   Procedure: ImageStore::ReadAll
+   ------------------------------------------------------------
+   Description:
+   Decodes every tile on the thread pool and interleaves it
+   into the output, scaled.
+   ============================================================ */
+void ImageStore::ReadAll(float* linearRGB, float scale) const
+{
+    ThreadPool::Instance().ParallelFor((int)tiles.size(), [&](int index)
+    {
+        int x0, y0, w, h;
+        TileRect(index, x0, y0, w, h);
+
+        thread_local std::vector<float> planar;
+        planar.resize((size_t)w * h * 3);
+
+        TileBuf region = {};
+        region.channels = 3;
+        region.x0 = x0;
+        region.y0 = y0;
+        region.width = w;
+        region.height = h;
+        region.stride = w;
+        for (int c = 0; c < 3; c++)
+            region.planes[c] = planar.data() + (size_t)c * w * h;
+
+        ReadRegion(region);
+
+        for (int y = 0; y < h; y++)
+        {
+            float* dst = linearRGB + ((size_t)(y0 + y) * width + x0) * 3;
+            const float* r = region.Row(0, y0 + y);
+            const float* g = region.Row(1, y0 + y);
+            const float* b = region.Row(2, y0 + y);
+            for (int x = 0; x < w; x++)
+            {
+                dst[3 * x + 0] = r[x] * scale;
+                dst[3 * x + 1] = g[x] * scale;
+                dst[3 * x + 2] = b[x] * scale;
+            }
+        }
+    });
+}
+
+/* ============================================================
+   Procedure: FindStore
+   ============================================================ */
+static std::shared_ptr<ImageStore> FindStore(int id)
+{
+    std::lock_guard<std::mutex> lock(gStoreMutex);
+    auto it = gStores.find(id);
+    return it != gStores.end() ? it->second : nullptr;
+}
+
+/* ============================================================
+   Procedure: ImageStoreCreate
+   ------------------------------------------------------------
+   Description:
+   Compresses a linear image into a new store. The tiles take
+   the CPU pipeline's tile size of this machine, so renders
+   from the store decompress every tile once.
+
+   Input parameters:
+   linearRGB - Linear RGB float data (RGBRGB...); may be freed
+               when this returns
+   width     - Image width in pixels (> 0)
+   height    - Image height in pixels (> 0)
+
+   Output parameters:
+   Returns the store id (> 0), or 0 on invalid arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int ImageStoreCreate(const float* linearRGB, int width, int height)
+{
+    if (!linearRGB || width <= 0 || height <= 0)
+        return 0;
+
+    TuneEnsureLoaded();
+
+    StageTileSize tile = StageGraph::TileSize();
+    auto store = std::make_shared<ImageStore>(linearRGB, width, height, tile.width, tile.height);
+
+    std::lock_guard<std::mutex> lock(gStoreMutex);
+    int id = gNextStore++;
+    gStores[id] = store;
+    return id;
+}
+
+/* ============================================================
+   Procedure: ImageStoreRelease
+   ------------------------------------------------------------
+   Description:
+   Frees a store; a render still reading it finishes first.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ImageStoreRelease(int store)
+{
+    std::lock_guard<std::mutex> lock(gStoreMutex);
+    gStores.erase(store);
+}
+
+/* ============================================================
+   Procedure: ImageStoreBytes
+   ------------------------------------------------------------
+   Output parameters:
+   Returns the compressed size of a store in bytes (-1 for an
+   invalid store).
+   ============================================================ */
+extern "C" __declspec(dllexport)
+long long ImageStoreBytes(int store)
+{
+    std::shared_ptr<ImageStore> s = FindStore(store);
+    return s ? s->Bytes() : -1;
+}
+
+/* ============================================================
+   Procedure: ImageStoreRead
+   ------------------------------------------------------------
+   Description:
+   Decompresses a whole store into a float buffer, e.g. for a
+   backend that needs the image in memory.
+
+   Input parameters:
+   store     - Id from ImageStoreCreate
+   scale     - Multiplier applied to every value (1 = none)
+
+   Output parameters:
+   linearRGB - width * height * 3 floats (RGBRGB...)
+   Returns false for an invalid store.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool ImageStoreRead(int store, float* linearRGB, float scale)
+{
+    std::shared_ptr<ImageStore> s = FindStore(store);
+    if (!s || !linearRGB)
+        return false;
+
+    s->ReadAll(linearRGB, scale);
+    return true;
+}
+
+/* ============================================================
+   Procedure: ToneMapStoreCPU
+   ------------------------------------------------------------
+   Description:
+   ToneMapCPU on a compressed store: tiles are decompressed as
+   the fused sweep loads them, so no float copy of the image
+   is made. Publishes quality counters if they are enabled.
+
+   Input parameters:
+   store       - Id from ImageStoreCreate
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   Returns false for an invalid store.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool ToneMapStoreCPU(int store, unsigned char* outputBGRA, float exposure, float whitePoint)
+{
+    std::shared_ptr<ImageStore> s = FindStore(store);
+    if (!s || !outputBGRA)
+        return false;
+
+    if (!StatsQualityEnabled())
+    {
+        ToneMapCPURunSource(s->Source(), s->Width(), s->Height(), outputBGRA, exposure, whitePoint, nullptr);
+        return true;
+    }
+
+    QualityTotal quality;
+    ToneMapCPURunSource(s->Source(), s->Width(), s->Height(), outputBGRA, exposure, whitePoint, &quality);
+    StatsQuality(quality.total);
+    return true;
+}
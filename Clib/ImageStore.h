@@ -0,0 +1,60 @@
+#ifndef IMAGE_STORE_H
+#define IMAGE_STORE_H
+
+#include <vector>
+#include "StageGraph.h"
+
+// Linear RGB image held compressed in memory. The image is cut into
+// tiles; a tile is stored as half floats, channel planes one after
+// another, with the low and high bytes of all halves in separate
+// byte planes, LZ4 compressed (or raw if that is not smaller).
+// Values are rounded to half precision, the precision the GL path
+// uploads its input at; finite values beyond the half range are
+// clamped to +-65504 rather than becoming infinite.
+class ImageStore
+{
+public:
+	// Compresses an image in tiles of the given size (in parallel)
+	ImageStore(const float* linearRGB, int width, int height, int tileWidth, int tileHeight);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	// Bytes held by the compressed tiles
+	long long Bytes() const;
+
+	// Decodes a region into planar floats. Tiles are decompressed
+	// into thread-local scratch, which keeps the last tile for the
+	// next call on the same thread.
+	void ReadRegion(TileBuf& out) const;
+	// Source for a StageGraph reading this image; the store must
+	// outlive the graph
+	StageSource Source() const;
+
+	// Decodes the whole image interleaved (RGBRGB...), each value
+	// multiplied by scale
+	void ReadAll(float* linearRGB, float scale) const;
+
+private:
+	struct Tile
+	{
+		std::vector<unsigned char> data;
+		bool raw = false;
+	};
+
+	// Tile rectangle in pixels
+	void TileRect(int index, int& x0, int& y0, int& w, int& h) const;
+	// Byte planes of a tile, decompressed into thread-local scratch
+	const unsigned char* DecodeTile(int index) const;
+
+	int width;
+	int height;
+	int tileWidth;
+	int tileHeight;
+	int tilesX;
+	int tilesY;
+	std::vector<Tile> tiles;
+	// Distinguishes this store in the thread-local tile scratch
+	unsigned long long serial;
+};
+
+#endif
@@ -0,0 +1,1971 @@
+// ============================================================
+// File: Kernels.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Row kernels of the native CPU pipeline. Each kernel handles
+// one contiguous run of pixels: 8 pixels per iteration with
+// AVX2 and a scalar tail, like ToneMapAVX2 in ASMlib. Variant,
+// unroll factor and streaming stores follow the machine's tune
+// profile (KernelConfig).
+// ============================================================
+#include <algorithm>
+#include <bit>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <immintrin.h>
+#include <mutex>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Kernels.h"
+#include "Dither.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Rec.709 luminance coefficients
+static const float kLumaR = 0.2126f;
+static const float kLumaG = 0.7152f;
+static const float kLumaB = 0.0722f;
+
+// Small epsilon to avoid division by zero
+static const float kEps = 0.0001f;
+
+// Display gamma used for 8-bit output
+static const float kGamma = 2.2f;
+static const float kInvGamma = 1.0f / kGamma;
+
+// Largest finite half float
+static const float kHalfMax = 65504.0f;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gKernelConfigs
+ * Every distinct configuration published so far. Entries are
+ * never removed, so a snapshot stays valid without a reference
+ * count; the tune profile only ever produces a handful.
+ */
+static std::deque<KernelConfig> gKernelConfigs;
+static std::mutex gKernelConfigMutex;
+
+/*
+ * gKernelConfig
+ * Current variant, unroll factor and streaming threshold of the
+ * row kernels (an entry of gKernelConfigs, nullptr = defaults).
+ */
+static std::atomic<const KernelConfig*> gKernelConfig{ nullptr };
+static const KernelConfig kDefaultKernelConfig;
+
+/* ============================================================
+   Procedure: CpuHasAVX2
+   ------------------------------------------------------------
+   Description:
+   Detects AVX2 + FMA support (and OS support for YMM state).
+   The result is computed once.
+   ============================================================ */
+bool CpuHasAVX2()
+{
+    static const bool has = []
+    {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        bool fma = (regs[2] & (1 << 12)) != 0;
+        bool osxsave = (regs[2] & (1 << 27)) != 0;
+        bool avx = (regs[2] & (1 << 28)) != 0;
+        if (!(fma && osxsave && avx))
+            return false;
+        if ((_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(regs, 7, 0);
+        return (regs[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }();
+    return has;
+}
+
+/* ============================================================
+   Procedure: SetKernelConfig / GetKernelConfig
+   ------------------------------------------------------------
+   Description:
+   Publishes / returns the kernel configuration. Invalid unroll
+   factors fall back to 1. The new configuration is an immutable
+   snapshot swapped in atomically, so kernels already running
+   finish their call with the one they loaded.
+   ============================================================ */
+static const KernelConfig& LoadKernelConfig()
+{
+    const KernelConfig* config = gKernelConfig.load(std::memory_order_acquire);
+    return config ? *config : kDefaultKernelConfig;
+}
+
+void SetKernelConfig(const KernelConfig& config)
+{
+    KernelConfig valid = config;
+    if (valid.unroll != 2)
+        valid.unroll = 1;
+    if (valid.streamThreshold < 0)
+        valid.streamThreshold = 0;
+
+    std::lock_guard<std::mutex> lock(gKernelConfigMutex);
+    const KernelConfig* snapshot = nullptr;
+    for (const KernelConfig& known : gKernelConfigs)
+    {
+        if (known.variant == valid.variant && known.unroll == valid.unroll &&
+            known.streamThreshold == valid.streamThreshold)
+        {
+            snapshot = &known;
+            break;
+        }
+    }
+    if (!snapshot)
+    {
+        gKernelConfigs.push_back(valid);
+        snapshot = &gKernelConfigs.back();
+    }
+    gKernelConfig.store(snapshot, std::memory_order_release);
+}
+
+KernelConfig GetKernelConfig()
+{
+    return LoadKernelConfig();
+}
+
+/* ============================================================
+   Procedure: QualityAccum::Merge
+   ------------------------------------------------------------
+   Description:
+   Adds the counters of another region (tile, band) to these.
+   ============================================================ */
+void QualityAccum::Merge(const QualityAccum& other)
+{
+    pixels += other.pixels;
+    nonFinite += other.nonFinite;
+    for (int c = 0; c < 3; c++)
+    {
+        clipHigh[c] += other.clipHigh[c];
+        clipLow[c] += other.clipLow[c];
+    }
+    sumIn += other.sumIn;
+    sumOut += other.sumOut;
+    minIn = std::min(minIn, other.minIn);
+    maxIn = std::max(maxIn, other.maxIn);
+    minOut = std::min(minOut, other.minOut);
+    maxOut = std::max(maxOut, other.maxOut);
+}
+
+/*
+ * QualityVec
+ * Vector form of the luminance part of QualityAccum, kept in
+ * registers for the length of one ToneMapPlanar call.
+ */
+struct QualityVec
+{
+    __m256 minIn, maxIn, minOut, maxOut, sumIn, sumOut;
+    long long nonFinite;
+};
+
+/*
+ * GradeVec
+ * ColorGrade broadcast to AVX registers.
+ */
+struct GradeVec
+{
+    __m256 slope[3], offset[3], power[3], saturation;
+
+    // Some power is not 1 (most grades leave it)
+    bool powered;
+
+    explicit GradeVec(const ColorGrade& grade)
+    {
+        powered = grade.power[0] != 1.0f || grade.power[1] != 1.0f || grade.power[2] != 1.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            slope[c] = _mm256_set1_ps(grade.slope[c]);
+            offset[c] = _mm256_set1_ps(grade.offset[c]);
+            power[c] = _mm256_set1_ps(grade.power[c]);
+        }
+        saturation = _mm256_set1_ps(grade.saturation);
+    }
+};
+
+/*
+ * LutVec
+ * Index scale and bias of each CubeLut table (input * scale +
+ * bias is the position among the entries) and its last entry,
+ * broadcast to AVX registers; the lattice strides in floats.
+ */
+struct LutVec
+{
+    __m256 scale1D[3], bias1D[3], last1D;
+    __m256 scale3D[3], bias3D[3], last3D;
+    __m256i stride[3];
+
+    explicit LutVec(const CubeLut& lut)
+    {
+        int n1 = std::max(lut.size1D, 2);
+        int n3 = std::max(lut.size3D, 2);
+        for (int c = 0; c < 3; c++)
+        {
+            float s1 = (n1 - 1) / (lut.max1D[c] - lut.min1D[c]);
+            float s3 = (n3 - 1) / (lut.max3D[c] - lut.min3D[c]);
+            scale1D[c] = _mm256_set1_ps(s1);
+            bias1D[c] = _mm256_set1_ps(-lut.min1D[c] * s1);
+            scale3D[c] = _mm256_set1_ps(s3);
+            bias3D[c] = _mm256_set1_ps(-lut.min3D[c] * s3);
+        }
+        last1D = _mm256_set1_ps((float)(n1 - 1));
+        last3D = _mm256_set1_ps((float)(n3 - 1));
+        stride[0] = _mm256_set1_epi32(3);
+        stride[1] = _mm256_set1_epi32(3 * n3);
+        stride[2] = _mm256_set1_epi32(3 * n3 * n3);
+    }
+};
+
+/* ============================================================
+   Procedure: UseAVX2
+   ------------------------------------------------------------
+   Description:
+   True if the AVX2 kernels should run: supported by the CPU
+   and not overridden by the scalar variant (of the given
+   snapshot, or of the current configuration).
+   ============================================================ */
+static inline bool UseAVX2(const KernelConfig& config)
+{
+    return config.variant != KERNEL_VARIANT_SCALAR && CpuHasAVX2();
+}
+
+static inline bool UseAVX2()
+{
+    return UseAVX2(LoadKernelConfig());
+}
+
+/* ============================================================
+   Procedure: Log2AVX
+   ------------------------------------------------------------
+   Description:
+   log2 of 8 positive floats. Splits exponent and mantissa and
+   evaluates ln(m) = 2*atanh((m-1)/(m+1)) on [sqrt(.5), sqrt(2)).
+   Relative error below 1e-7.
+   ============================================================ */
+static inline __m256 Log2AVX(__m256 x)
+{
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(
+        _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+        _mm256_set1_epi32(0x3f800000)));
+
+    // Move m into [sqrt(.5), sqrt(2))
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    __m256 t2 = _mm256_mul_ps(t, t);
+
+    __m256 p = _mm256_set1_ps(1.0f / 9.0f);
+    p = _mm256_fmadd_ps(p, t2, _mm256_set1_ps(1.0f / 7.0f));
+    p = _mm256_fmadd_ps(p, t2, _mm256_set1_ps(1.0f / 5.0f));
+    p = _mm256_fmadd_ps(p, t2, _mm256_set1_ps(1.0f / 3.0f));
+    p = _mm256_fmadd_ps(p, t2, one);
+
+    // log2(x) = 2*t*p / ln(2) + e
+    return _mm256_fmadd_ps(_mm256_mul_ps(t, p), _mm256_set1_ps(2.0f / 0.69314718f), e);
+}
+
+/* ============================================================
+   Procedure: Exp2AVX
+   ------------------------------------------------------------
+   Description:
+   2^y for 8 floats in [-126, 127]. Splits y into an integer
+   exponent and a fraction in [-0.5, 0.5] evaluated with a
+   degree-6 Taylor series of exp.
+   ============================================================ */
+static inline __m256 Exp2AVX(__m256 y)
+{
+    y = _mm256_max_ps(y, _mm256_set1_ps(-126.0f));
+    y = _mm256_min_ps(y, _mm256_set1_ps(127.0f));
+
+    __m256 n = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 z = _mm256_mul_ps(_mm256_sub_ps(y, n), _mm256_set1_ps(0.69314718f));
+
+    __m256 p = _mm256_set1_ps(1.0f / 720.0f);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.0f / 120.0f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.0f / 24.0f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.0f / 6.0f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(0.5f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.0f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.0f));
+
+    __m256i scale = _mm256_slli_epi32(
+        _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+/* ============================================================
+   Procedure: GammaEncodeAVX
+   ------------------------------------------------------------
+   Description:
+   Clamps 8 linear values to [0,1] and returns x^(1/2.2).
+   ============================================================ */
+static inline __m256 GammaEncodeAVX(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(1e-30f)), _mm256_set1_ps(1.0f));
+    return Exp2AVX(_mm256_mul_ps(Log2AVX(x), _mm256_set1_ps(kInvGamma)));
+}
+
+/* ============================================================
+   Procedure: Grade8 / GradePixel
+   ------------------------------------------------------------
+   Description:
+   ASC CDL of tone mapped linear RGB: v * slope + offset,
+   clipped below at 0, raised to power; then saturation blends
+   between the Rec. 709 luminance and the color. The power,
+   most of the cost, is skipped where it is 1.
+   ============================================================ */
+static inline void Grade8(__m256& R, __m256& G, __m256& B, const GradeVec& grade)
+{
+    __m256* v[3] = { &R, &G, &B };
+    for (int c = 0; c < 3; c++)
+    {
+        __m256 x = _mm256_fmadd_ps(*v[c], grade.slope[c], grade.offset[c]);
+        x = _mm256_max_ps(x, _mm256_set1_ps(1e-30f));
+        *v[c] = grade.powered ? Exp2AVX(_mm256_mul_ps(Log2AVX(x), grade.power[c])) : x;
+    }
+
+    __m256 L = _mm256_mul_ps(R, _mm256_set1_ps(kLumaR));
+    L = _mm256_fmadd_ps(G, _mm256_set1_ps(kLumaG), L);
+    L = _mm256_fmadd_ps(B, _mm256_set1_ps(kLumaB), L);
+
+    R = _mm256_fmadd_ps(grade.saturation, _mm256_sub_ps(R, L), L);
+    G = _mm256_fmadd_ps(grade.saturation, _mm256_sub_ps(G, L), L);
+    B = _mm256_fmadd_ps(grade.saturation, _mm256_sub_ps(B, L), L);
+}
+
+static inline void GradePixel(float& R, float& G, float& B, const ColorGrade& grade)
+{
+    float* v[3] = { &R, &G, &B };
+    for (int c = 0; c < 3; c++)
+    {
+        float x = fmaxf(*v[c] * grade.slope[c] + grade.offset[c], 1e-30f);
+        *v[c] = grade.power[c] != 1.0f ? std::exp2(std::log2(x) * grade.power[c]) : x;
+    }
+
+    float L = R * kLumaR + G * kLumaG + B * kLumaB;
+    R = L + grade.saturation * (R - L);
+    G = L + grade.saturation * (G - L);
+    B = L + grade.saturation * (B - L);
+}
+
+/* ============================================================
+   Procedure: LutPosition8
+   ------------------------------------------------------------
+   Description:
+   Entry below each of 8 table inputs and the fraction towards
+   the next one, the input clamped to the table's range.
+   ============================================================ */
+static inline __m256i LutPosition8(__m256 v, __m256 scale, __m256 bias, __m256 last, __m256& f)
+{
+    __m256 x = _mm256_fmadd_ps(v, scale, bias);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), last);
+    __m256 i = _mm256_min_ps(_mm256_floor_ps(x), _mm256_sub_ps(last, _mm256_set1_ps(1.0f)));
+    f = _mm256_sub_ps(x, i);
+    return _mm256_cvttps_epi32(i);
+}
+
+/* ============================================================
+   Procedure: Lut8 / LutPixel
+   ------------------------------------------------------------
+   Description:
+   Gamma encodes linear RGB, passes it through the shaper
+   (linear interpolation) and the lattice, and decodes the
+   result. The lattice is interpolated tetrahedrally: the cell
+   is split into six tetrahedra along its diagonal, the one
+   holding the point is picked by the order of its three
+   fractions, and its four corners are blended with weights
+   1 - f1, f1 - f2, f2 - f3 and f3 (f1 >= f2 >= f3). Corner one
+   steps along the axis of the largest fraction, corner two
+   along all but the smallest. Four taps instead of trilinear's
+   eight, and grey stays on the lattice diagonal.
+   ============================================================ */
+static inline void Lut8(__m256& R, __m256& G, __m256& B, const CubeLut& lut, const LutVec& v)
+{
+    __m256* rgb[3] = { &R, &G, &B };
+    for (int c = 0; c < 3; c++)
+        *rgb[c] = GammaEncodeAVX(*rgb[c]);
+
+    if (lut.size1D)
+    {
+        const float* table = lut.table1D.data();
+        for (int c = 0; c < 3; c++)
+        {
+            __m256 f;
+            __m256i i = LutPosition8(*rgb[c], v.scale1D[c], v.bias1D[c], v.last1D, f);
+            __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(i, v.stride[0]), _mm256_set1_epi32(c));
+            __m256 a = _mm256_i32gather_ps(table, index, 4);
+            __m256 b = _mm256_i32gather_ps(table, _mm256_add_epi32(index, v.stride[0]), 4);
+            *rgb[c] = _mm256_fmadd_ps(f, _mm256_sub_ps(b, a), a);
+        }
+    }
+
+    if (lut.size3D)
+    {
+        __m256 fr, fg, fb;
+        __m256i ir = LutPosition8(R, v.scale3D[0], v.bias3D[0], v.last3D, fr);
+        __m256i ig = LutPosition8(G, v.scale3D[1], v.bias3D[1], v.last3D, fg);
+        __m256i ib = LutPosition8(B, v.scale3D[2], v.bias3D[2], v.last3D, fb);
+
+        __m256i base = _mm256_mullo_epi32(ir, v.stride[0]);
+        base = _mm256_add_epi32(base, _mm256_mullo_epi32(ig, v.stride[1]));
+        base = _mm256_add_epi32(base, _mm256_mullo_epi32(ib, v.stride[2]));
+
+        // Axis of the largest and of the smallest fraction
+        __m256i rg = _mm256_castps_si256(_mm256_cmp_ps(fr, fg, _CMP_GT_OQ));
+        __m256i gb = _mm256_castps_si256(_mm256_cmp_ps(fg, fb, _CMP_GT_OQ));
+        __m256i rb = _mm256_castps_si256(_mm256_cmp_ps(fr, fb, _CMP_GT_OQ));
+        __m256i first = _mm256_blendv_epi8(
+            _mm256_blendv_epi8(v.stride[2], v.stride[1], gb),
+            _mm256_blendv_epi8(v.stride[2], v.stride[0], rb), rg);
+        __m256i last = _mm256_blendv_epi8(
+            _mm256_blendv_epi8(v.stride[0], v.stride[1], rg),
+            _mm256_blendv_epi8(v.stride[0], v.stride[2], rb), gb);
+
+        __m256i diagonal = _mm256_add_epi32(_mm256_add_epi32(v.stride[0], v.stride[1]), v.stride[2]);
+        __m256i corner1 = _mm256_add_epi32(base, first);
+        __m256i corner2 = _mm256_add_epi32(base, _mm256_sub_epi32(diagonal, last));
+        __m256i corner3 = _mm256_add_epi32(base, diagonal);
+
+        __m256 f1 = _mm256_max_ps(_mm256_max_ps(fr, fg), fb);
+        __m256 f3 = _mm256_min_ps(_mm256_min_ps(fr, fg), fb);
+        __m256 f2 = _mm256_max_ps(_mm256_min_ps(fr, fg), _mm256_min_ps(_mm256_max_ps(fr, fg), fb));
+
+        __m256 w0 = _mm256_sub_ps(_mm256_set1_ps(1.0f), f1);
+        __m256 w1 = _mm256_sub_ps(f1, f2);
+        __m256 w2 = _mm256_sub_ps(f2, f3);
+
+        const float* table = lut.table3D.data();
+        for (int c = 0; c < 3; c++)
+        {
+            __m256i offset = _mm256_set1_epi32(c);
+            __m256 out = _mm256_mul_ps(_mm256_i32gather_ps(table, _mm256_add_epi32(base, offset), 4), w0);
+            out = _mm256_fmadd_ps(_mm256_i32gather_ps(table, _mm256_add_epi32(corner1, offset), 4), w1, out);
+            out = _mm256_fmadd_ps(_mm256_i32gather_ps(table, _mm256_add_epi32(corner2, offset), 4), w2, out);
+            out = _mm256_fmadd_ps(_mm256_i32gather_ps(table, _mm256_add_epi32(corner3, offset), 4), f3, out);
+            *rgb[c] = out;
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        __m256 x = _mm256_max_ps(*rgb[c], _mm256_set1_ps(1e-30f));
+        *rgb[c] = Exp2AVX(_mm256_mul_ps(Log2AVX(x), _mm256_set1_ps(kGamma)));
+    }
+}
+
+static inline int LutPosition(float v, float min, float max, int size, float& f)
+{
+    float scale = (size - 1) / (max - min);
+    float x = fminf(fmaxf(fmaf(v, scale, -min * scale), 0.0f), (float)(size - 1));
+    float i = fminf(std::floor(x), (float)(size - 2));
+    f = x - i;
+    return (int)i;
+}
+
+static inline void LutPixel(float& R, float& G, float& B, const CubeLut& lut)
+{
+    float* rgb[3] = { &R, &G, &B };
+    for (int c = 0; c < 3; c++)
+        *rgb[c] = powf(fminf(fmaxf(*rgb[c], 0.0f), 1.0f), kInvGamma);
+
+    if (lut.size1D)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            float f;
+            int i = LutPosition(*rgb[c], lut.min1D[c], lut.max1D[c], lut.size1D, f);
+            float a = lut.table1D[3 * i + c];
+            float b = lut.table1D[3 * (i + 1) + c];
+            *rgb[c] = fmaf(f, b - a, a);
+        }
+    }
+
+    if (lut.size3D)
+    {
+        int n = lut.size3D;
+        float fr, fg, fb;
+        int ir = LutPosition(R, lut.min3D[0], lut.max3D[0], n, fr);
+        int ig = LutPosition(G, lut.min3D[1], lut.max3D[1], n, fg);
+        int ib = LutPosition(B, lut.min3D[2], lut.max3D[2], n, fb);
+
+        int stride[3] = { 3, 3 * n, 3 * n * n };
+        int base = ir * stride[0] + ig * stride[1] + ib * stride[2];
+        int first = fr > fg ? (fr > fb ? stride[0] : stride[2]) : (fg > fb ? stride[1] : stride[2]);
+        int last = fg > fb ? (fr > fb ? stride[2] : stride[0]) : (fr > fg ? stride[1] : stride[0]);
+        int diagonal = stride[0] + stride[1] + stride[2];
+
+        float f1 = fmaxf(fmaxf(fr, fg), fb);
+        float f3 = fminf(fminf(fr, fg), fb);
+        float f2 = fmaxf(fminf(fr, fg), fminf(fmaxf(fr, fg), fb));
+
+        const float* table = lut.table3D.data();
+        for (int c = 0; c < 3; c++)
+        {
+            float out = table[base + c] * (1.0f - f1);
+            out = fmaf(table[base + first + c], f1 - f2, out);
+            out = fmaf(table[base + diagonal - last + c], f2 - f3, out);
+            *rgb[c] = fmaf(table[base + diagonal + c], f3, out);
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+        *rgb[c] = powf(fmaxf(*rgb[c], 1e-30f), kGamma);
+}
+
+/* ============================================================
+   Procedure: DeinterleaveRGB
+   ------------------------------------------------------------
+   Description:
+   Copies n pixels from RGBRGB... into separate R, G, B rows.
+
+   Input parameters:
+   rgb - Interleaved source (3*n floats)
+   n   - Number of pixels
+
+   Output parameters:
+   r, g, b - Planar destination rows (n floats each)
+   ============================================================ */
+void DeinterleaveRGB(const float* rgb, int n, float* r, float* g, float* b)
+{
+    for (int i = 0; i < n; i++)
+    {
+        r[i] = rgb[3 * i + 0];
+        g[i] = rgb[3 * i + 1];
+        b[i] = rgb[3 * i + 2];
+    }
+}
+
+/* ============================================================
+   Procedure: ToneMap8
+   ------------------------------------------------------------
+   Description:
+   Extended Reinhard on 8 planar pixels at index i, in place.
+   The grade and the LUT are only compiled in when kGrade and
+   kLut are set.
+   ============================================================ */
+template <bool kGrade, bool kLut>
+static inline void ToneMap8(float* r, float* g, float* b, int i, __m256 vExp, __m256 vWp2,
+    QualityVec* q, const GradeVec* grade, const CubeLut* lut, const LutVec* lutVec)
+{
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vEps = _mm256_set1_ps(kEps);
+
+    // Apply exposure
+    __m256 R = _mm256_mul_ps(_mm256_loadu_ps(r + i), vExp);
+    __m256 G = _mm256_mul_ps(_mm256_loadu_ps(g + i), vExp);
+    __m256 B = _mm256_mul_ps(_mm256_loadu_ps(b + i), vExp);
+
+    // Luminance
+    __m256 L = _mm256_mul_ps(R, _mm256_set1_ps(kLumaR));
+    L = _mm256_fmadd_ps(G, _mm256_set1_ps(kLumaG), L);
+    L = _mm256_fmadd_ps(B, _mm256_set1_ps(kLumaB), L);
+
+    // Extended Reinhard
+    __m256 num = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(L, vWp2), vOne), L);
+    __m256 mapped = _mm256_div_ps(num, _mm256_add_ps(L, vOne));
+
+    // Quality counters (x - x == 0 only for finite x)
+    if (q)
+    {
+        __m256 zero = _mm256_setzero_ps();
+        __m256 finite = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(R, R), zero, _CMP_EQ_OQ),
+                _mm256_cmp_ps(_mm256_sub_ps(G, G), zero, _CMP_EQ_OQ)),
+            _mm256_cmp_ps(_mm256_sub_ps(B, B), zero, _CMP_EQ_OQ));
+
+        q->nonFinite += 8 - std::popcount((unsigned)_mm256_movemask_ps(finite));
+
+        __m256 big = _mm256_set1_ps(3.0e38f);
+        __m256 small = _mm256_set1_ps(-3.0e38f);
+        q->minIn = _mm256_min_ps(q->minIn, _mm256_blendv_ps(big, L, finite));
+        q->maxIn = _mm256_max_ps(q->maxIn, _mm256_blendv_ps(small, L, finite));
+        q->minOut = _mm256_min_ps(q->minOut, _mm256_blendv_ps(big, mapped, finite));
+        q->maxOut = _mm256_max_ps(q->maxOut, _mm256_blendv_ps(small, mapped, finite));
+        q->sumIn = _mm256_add_ps(q->sumIn, _mm256_and_ps(L, finite));
+        q->sumOut = _mm256_add_ps(q->sumOut, _mm256_and_ps(mapped, finite));
+    }
+
+    // Scale factor
+    __m256 scale = _mm256_div_ps(mapped, _mm256_max_ps(L, vEps));
+
+    R = _mm256_max_ps(_mm256_mul_ps(R, scale), vEps);
+    G = _mm256_max_ps(_mm256_mul_ps(G, scale), vEps);
+    B = _mm256_max_ps(_mm256_mul_ps(B, scale), vEps);
+
+    if constexpr (kGrade)
+    {
+        Grade8(R, G, B, *grade);
+        R = _mm256_max_ps(R, vEps);
+        G = _mm256_max_ps(G, vEps);
+        B = _mm256_max_ps(B, vEps);
+    }
+
+    if constexpr (kLut)
+    {
+        Lut8(R, G, B, *lut, *lutVec);
+        R = _mm256_max_ps(R, vEps);
+        G = _mm256_max_ps(G, vEps);
+        B = _mm256_max_ps(B, vEps);
+    }
+
+    _mm256_storeu_ps(r + i, R);
+    _mm256_storeu_ps(g + i, G);
+    _mm256_storeu_ps(b + i, B);
+}
+
+/* ============================================================
+   Procedure: ToneMapLoop
+   ------------------------------------------------------------
+   Description:
+   AVX2 loop of ToneMapPlanar over whole groups of 8 pixels;
+   returns the index the scalar tail starts at.
+   ============================================================ */
+template <bool kGrade, bool kLut>
+static int ToneMapLoop(float* r, float* g, float* b, int n, int unroll, __m256 vExp, __m256 vWp2,
+    QualityVec* q, const GradeVec* grade, const CubeLut* lut, const LutVec* lutVec)
+{
+    int i = 0;
+
+    // Unrolled: two independent 8-pixel chains hide the divide latency
+    if (unroll == 2)
+    {
+        for (; i + 16 <= n; i += 16)
+        {
+            ToneMap8<kGrade, kLut>(r, g, b, i, vExp, vWp2, q, grade, lut, lutVec);
+            ToneMap8<kGrade, kLut>(r, g, b, i + 8, vExp, vWp2, q, grade, lut, lutVec);
+        }
+    }
+
+    for (; i + 8 <= n; i += 8)
+        ToneMap8<kGrade, kLut>(r, g, b, i, vExp, vWp2, q, grade, lut, lutVec);
+
+    return i;
+}
+
+/* ============================================================
+   Procedure: ToneMapPlanar
+   ------------------------------------------------------------
+   Description:
+   Extended Reinhard tone mapping on planar rows, in place.
+   Lmapped = L * (1 + L/wp²) / (1 + L), RGB scaled by
+   Lmapped / max(L, eps) and clamped to eps. The unroll factor
+   does not change which pixels take the scalar tail, so all
+   configurations give identical results. With quality given
+   the luminance before and after mapping and the non-finite
+   pixels are counted in the same loop. A grade and then a LUT
+   are applied to the mapped color before it is stored, each
+   in its own instantiations of the loop, so rows without them
+   run exactly the code they would if neither existed.
+
+   Input parameters:
+   r, g, b    - Planar rows (modified in place)
+   n          - Number of pixels
+   exposure   - Exposure multiplier (> 0.0)
+   whitePoint - White point (> 0.0)
+   grade      - Color grade (identity = none)
+   lut        - LUT (nullptr = none)
+
+   Output parameters:
+   quality    - Counters to add to (may be nullptr)
+   ============================================================ */
+void ToneMapPlanar(float* r, float* g, float* b, int n, float exposure, float whitePoint,
+    QualityAccum* quality, const ColorGrade& grade, const CubeLut* lut)
+{
+    float wp = whitePoint > kEps ? whitePoint : kEps;
+    float wp2 = wp * wp;
+    bool graded = !grade.Identity();
+    const KernelConfig& config = LoadKernelConfig();
+    int i = 0;
+
+    if (UseAVX2(config))
+    {
+        int unroll = config.unroll;
+        __m256 vExp = _mm256_set1_ps(exposure);
+        __m256 vWp2 = _mm256_set1_ps(wp2);
+
+        QualityVec qv;
+        QualityVec* q = nullptr;
+        if (quality)
+        {
+            qv.minIn = qv.minOut = _mm256_set1_ps(3.0e38f);
+            qv.maxIn = qv.maxOut = _mm256_set1_ps(-3.0e38f);
+            qv.sumIn = qv.sumOut = _mm256_setzero_ps();
+            qv.nonFinite = 0;
+            q = &qv;
+        }
+
+        GradeVec vGrade(grade);
+        if (lut)
+        {
+            LutVec vLut(*lut);
+            i = graded ? ToneMapLoop<true, true>(r, g, b, n, unroll, vExp, vWp2, q, &vGrade, lut, &vLut)
+                : ToneMapLoop<false, true>(r, g, b, n, unroll, vExp, vWp2, q, nullptr, lut, &vLut);
+        }
+        else
+        {
+            i = graded ? ToneMapLoop<true, false>(r, g, b, n, unroll, vExp, vWp2, q, &vGrade, nullptr, nullptr)
+                : ToneMapLoop<false, false>(r, g, b, n, unroll, vExp, vWp2, q, nullptr, nullptr, nullptr);
+        }
+
+        if (q)
+        {
+            alignas(32) float lanes[6][8];
+            _mm256_store_ps(lanes[0], qv.minIn);
+            _mm256_store_ps(lanes[1], qv.maxIn);
+            _mm256_store_ps(lanes[2], qv.minOut);
+            _mm256_store_ps(lanes[3], qv.maxOut);
+            _mm256_store_ps(lanes[4], qv.sumIn);
+            _mm256_store_ps(lanes[5], qv.sumOut);
+
+            for (int k = 0; k < 8; k++)
+            {
+                quality->minIn = std::min(quality->minIn, lanes[0][k]);
+                quality->maxIn = std::max(quality->maxIn, lanes[1][k]);
+                quality->minOut = std::min(quality->minOut, lanes[2][k]);
+                quality->maxOut = std::max(quality->maxOut, lanes[3][k]);
+                quality->sumIn += lanes[4][k];
+                quality->sumOut += lanes[5][k];
+            }
+            quality->nonFinite += qv.nonFinite;
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float R = r[i] * exposure;
+        float G = g[i] * exposure;
+        float B = b[i] * exposure;
+
+        float L = R * kLumaR + G * kLumaG + B * kLumaB;
+        float mapped = (L * (1.0f + L / wp2)) / (1.0f + L);
+        float scale = mapped / (L > kEps ? L : kEps);
+
+        if (quality)
+        {
+            if (std::isfinite(R) && std::isfinite(G) && std::isfinite(B))
+            {
+                quality->minIn = std::min(quality->minIn, L);
+                quality->maxIn = std::max(quality->maxIn, L);
+                quality->minOut = std::min(quality->minOut, mapped);
+                quality->maxOut = std::max(quality->maxOut, mapped);
+                quality->sumIn += L;
+                quality->sumOut += mapped;
+            }
+            else
+            {
+                quality->nonFinite++;
+            }
+        }
+
+        R = fmaxf(R * scale, kEps);
+        G = fmaxf(G * scale, kEps);
+        B = fmaxf(B * scale, kEps);
+        if (graded)
+        {
+            GradePixel(R, G, B, grade);
+            R = fmaxf(R, kEps);
+            G = fmaxf(G, kEps);
+            B = fmaxf(B, kEps);
+        }
+        if (lut)
+        {
+            LutPixel(R, G, B, *lut);
+            R = fmaxf(R, kEps);
+            G = fmaxf(G, kEps);
+            B = fmaxf(B, kEps);
+        }
+
+        r[i] = R;
+        g[i] = G;
+        b[i] = B;
+    }
+
+    if (quality)
+        quality->pixels += n;
+}
+
+/* ============================================================
+   Procedure: PackBGRA8
+   ------------------------------------------------------------
+   Description:
+   Gamma encodes and packs 8 planar pixels at index i into
+   B | G<<8 | R<<16 | A<<24. With quality given, channels at
+   255 and at or below kClipLowCode (black, floored at kEps)
+   are counted for the lanes set in laneMask
+   (lanes an overlapping store has already counted are left
+   out). With noise given, the 8 noise values are added to the
+   scaled values of every channel before truncation; they are
+   below 1, so 0 and 255 stay exact.
+   ============================================================ */
+static inline __m256i PackBGRA8(const float* r, const float* g, const float* b, int i,
+    QualityAccum* quality = nullptr, int laneMask = 0xFF, const float* noise = nullptr)
+{
+    const __m256 v255 = _mm256_set1_ps(255.0f);
+
+    __m256 fR = _mm256_mul_ps(GammaEncodeAVX(_mm256_loadu_ps(r + i)), v255);
+    __m256 fG = _mm256_mul_ps(GammaEncodeAVX(_mm256_loadu_ps(g + i)), v255);
+    __m256 fB = _mm256_mul_ps(GammaEncodeAVX(_mm256_loadu_ps(b + i)), v255);
+
+    if (noise)
+    {
+        __m256 d = _mm256_loadu_ps(noise);
+        fR = _mm256_add_ps(fR, d);
+        fG = _mm256_add_ps(fG, d);
+        fB = _mm256_add_ps(fB, d);
+    }
+
+    __m256i R = _mm256_cvttps_epi32(fR);
+    __m256i G = _mm256_cvttps_epi32(fG);
+    __m256i B = _mm256_cvttps_epi32(fB);
+
+    if (quality)
+    {
+        const __m256i max = _mm256_set1_epi32(255);
+        const __m256i floor = _mm256_set1_epi32(kClipLowCode + 1);
+        const __m256i channels[3] = { R, G, B };
+        for (int c = 0; c < 3; c++)
+        {
+            int high = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(channels[c], max)));
+            int low = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(floor, channels[c])));
+            quality->clipHigh[c] += std::popcount((unsigned)(high & laneMask));
+            quality->clipLow[c] += std::popcount((unsigned)(low & laneMask));
+        }
+    }
+
+    __m256i px = _mm256_or_si256(B, _mm256_slli_epi32(G, 8));
+    px = _mm256_or_si256(px, _mm256_slli_epi32(R, 16));
+    return _mm256_or_si256(px, _mm256_set1_epi32((int)0xFF000000));
+}
+
+/* ============================================================
+   Procedure: StoreBGRA8
+   ------------------------------------------------------------
+   Description:
+   Converts planar linear rows to 8-bit BGRA: clamp to [0,1],
+   gamma 1/2.2, scale by 255 and truncate (same rounding as
+   LinearRGBToBitmap in the WPF app). Alpha is 255.
+
+   With stream set the aligned middle of the row is written
+   with non-temporal stores, which keep a large output image
+   from evicting the working set. The row ends are written with
+   overlapping unaligned stores of the same values, so the
+   output is identical either way.
+
+   With dither noise, the blue-noise value of each pixel's
+   column is added to its scaled channels before truncation,
+   which trades banding for fine noise and, unlike truncation,
+   keeps the mean level. Noise lanes are read from the padded
+   tile row, so the SIMD loop only adds one load and three
+   additions per 8 pixels.
+
+   With AVX2 the last n % 8 pixels go through the same vector
+   code from zero-padded copies: powf differs from the Exp2/Log2
+   approximation by enough to move a value across a code, which
+   would show as a seam at tile ends.
+
+   Input parameters:
+   r, g, b - Planar linear rows
+   n       - Number of pixels
+   stream  - Use non-temporal stores
+   dither  - Noise row and start column (no noise = off)
+
+   Output parameters:
+   bgra    - Destination (4*n bytes)
+   quality - Clip counters to add to (may be nullptr)
+   ============================================================ */
+void StoreBGRA8(const float* r, const float* g, const float* b, int n, unsigned char* bgra,
+    bool stream, QualityAccum* quality, const DitherRow& dither)
+{
+    int i = 0;
+
+    // Noise of the 8 pixels from index k (tile rows are padded by 8)
+    auto noiseAt = [&](int k) -> const float*
+    {
+        return dither.noise ? dither.noise + ((dither.x + k) & (kDitherSize - 1)) : nullptr;
+    };
+
+    if (UseAVX2())
+    {
+        int end = n - n % 8;
+
+        if (stream && end >= 16 && ((size_t)bgra & 3) == 0)
+        {
+            // Unaligned head, streamed 32-byte aligned middle, unaligned last
+            // block. Head and last block count only the lanes the middle misses.
+            int first = (int)((32 - ((size_t)bgra & 31)) & 31) / 4;
+            _mm256_storeu_si256((__m256i*)bgra, PackBGRA8(r, g, b, 0, quality, (1 << first) - 1, noiseAt(0)));
+
+            for (i = first; i + 8 <= end; i += 8)
+                _mm256_stream_si256((__m256i*)(bgra + 4 * i), PackBGRA8(r, g, b, i, quality, 0xFF, noiseAt(i)));
+
+            int covered = i - (end - 8);
+            _mm256_storeu_si256((__m256i*)(bgra + 4 * (end - 8)),
+                PackBGRA8(r, g, b, end - 8, quality, 0xFF & ~((1 << covered) - 1), noiseAt(end - 8)));
+            _mm_sfence();
+            i = end;
+        }
+        else
+        {
+            for (; i + 8 <= n; i += 8)
+                _mm256_storeu_si256((__m256i*)(bgra + 4 * i), PackBGRA8(r, g, b, i, quality, 0xFF, noiseAt(i)));
+        }
+
+        int rest = n - i;
+        if (rest > 0)
+        {
+            alignas(32) float pr[8] = {};
+            alignas(32) float pg[8] = {};
+            alignas(32) float pb[8] = {};
+            std::copy(r + i, r + n, pr);
+            std::copy(g + i, g + n, pg);
+            std::copy(b + i, b + n, pb);
+
+            alignas(32) unsigned char px[32];
+            _mm256_store_si256((__m256i*)px, PackBGRA8(pr, pg, pb, 0, quality, (1 << rest) - 1, noiseAt(i)));
+            std::memcpy(bgra + 4 * i, px, 4 * rest);
+            i = n;
+        }
+    }
+
+    // Scalar path
+    for (; i < n; i++)
+    {
+        float R = fminf(fmaxf(r[i], 0.0f), 1.0f);
+        float G = fminf(fmaxf(g[i], 0.0f), 1.0f);
+        float B = fminf(fmaxf(b[i], 0.0f), 1.0f);
+
+        float d = dither.noise ? dither.noise[(dither.x + i) & (kDitherSize - 1)] : 0.0f;
+        bgra[4 * i + 0] = (unsigned char)(powf(B, kInvGamma) * 255.0f + d);
+        bgra[4 * i + 1] = (unsigned char)(powf(G, kInvGamma) * 255.0f + d);
+        bgra[4 * i + 2] = (unsigned char)(powf(R, kInvGamma) * 255.0f + d);
+        bgra[4 * i + 3] = 255;
+
+        if (quality)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned char v = bgra[4 * i + 2 - c];
+                quality->clipHigh[c] += v == 255;
+                quality->clipLow[c] += v <= kClipLowCode;
+            }
+        }
+    }
+}
+
+/* ============================================================
+   Procedure: ClaheBins
+   ------------------------------------------------------------
+   Description:
+   Histogram bin of each pixel for CLAHE: the luminance of the
+   tone mapped pixel, gamma encoded to [0,1] and split into
+   bins equal steps. With AVX2 the last n % 8 pixels use the
+   vector code as well (zero-padded), so every pixel is binned
+   with the same gamma approximation.
+
+   Input parameters:
+   r, g, b - Planar tone mapped rows
+   n       - Number of pixels
+   bins    - Number of histogram bins
+
+   Output parameters:
+   index   - Bin of each pixel [0, bins - 1]
+   ============================================================ */
+void ClaheBins(const float* r, const float* g, const float* b, int n, int bins, int* index)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vBins = _mm256_set1_ps((float)bins);
+        const __m256i vLast = _mm256_set1_epi32(bins - 1);
+
+        auto bin8 = [&](const float* pr, const float* pg, const float* pb, int* out)
+        {
+            __m256 L = _mm256_mul_ps(_mm256_loadu_ps(pr), _mm256_set1_ps(kLumaR));
+            L = _mm256_fmadd_ps(_mm256_loadu_ps(pg), _mm256_set1_ps(kLumaG), L);
+            L = _mm256_fmadd_ps(_mm256_loadu_ps(pb), _mm256_set1_ps(kLumaB), L);
+
+            __m256i k = _mm256_cvttps_epi32(_mm256_mul_ps(GammaEncodeAVX(L), vBins));
+            _mm256_storeu_si256((__m256i*)out, _mm256_min_epi32(k, vLast));
+        };
+
+        for (; i + 8 <= n; i += 8)
+            bin8(r + i, g + i, b + i, index + i);
+
+        if (i < n)
+        {
+            float pr[8] = {};
+            float pg[8] = {};
+            float pb[8] = {};
+            int out[8];
+            std::copy(r + i, r + n, pr);
+            std::copy(g + i, g + n, pg);
+            std::copy(b + i, b + n, pb);
+            bin8(pr, pg, pb, out);
+            std::copy(out, out + (n - i), index + i);
+            i = n;
+        }
+    }
+
+    // Scalar path
+    for (; i < n; i++)
+    {
+        float L = r[i] * kLumaR + g[i] * kLumaG + b[i] * kLumaB;
+        int k = (int)(powf(fminf(fmaxf(L, 0.0f), 1.0f), kInvGamma) * bins);
+        index[i] = std::min(k, bins - 1);
+    }
+}
+
+/* ============================================================
+   Procedure: ClahePlanar
+   ------------------------------------------------------------
+   Description:
+   Applies the CLAHE tile curves to tone mapped planar rows, in
+   place. A curve holds bins + 1 values of display luminance at
+   the bin edges, so the gamma encoded luminance of a pixel is
+   interpolated within its bin; the curves of the pixel's two
+   nearest tile columns are then blended by its weight. The
+   rows of the two nearest tile rows are already blended into
+   rowCurves by the caller. RGB is scaled to the new luminance
+   and clamped to eps as in ToneMapPlanar. With AVX2 the four
+   curve values of 8 pixels are fetched with gathers; the last
+   n % 8 pixels run through the same code from padded copies,
+   so no pixel falls back to powf.
+
+   Input parameters:
+   r, g, b    - Planar tone mapped rows (modified in place)
+   n          - Number of pixels
+   rowCurves  - Curves of one tile row, bins + 1 floats per tile
+                column, plus a copy of the last column
+   tileBase   - Per pixel: offset of its left tile column's curve
+   tileWeight - Per pixel: weight of the right tile column [0,1]
+   bins       - Number of histogram bins
+   ============================================================ */
+void ClahePlanar(float* r, float* g, float* b, int n, const float* rowCurves, const int* tileBase,
+    const float* tileWeight, int bins)
+{
+    int edges = bins + 1;
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vBins = _mm256_set1_ps((float)bins);
+        const __m256i vLast = _mm256_set1_epi32(bins - 1);
+        const __m256i vOne = _mm256_set1_epi32(1);
+        const __m256i vNext = _mm256_set1_epi32(edges);
+        const __m256 vEps = _mm256_set1_ps(kEps);
+
+        auto curve8 = [&](float* pr, float* pg, float* pb, const int* base, const float* weight)
+        {
+            __m256 R = _mm256_loadu_ps(pr);
+            __m256 G = _mm256_loadu_ps(pg);
+            __m256 B = _mm256_loadu_ps(pb);
+
+            __m256 L = _mm256_mul_ps(R, _mm256_set1_ps(kLumaR));
+            L = _mm256_fmadd_ps(G, _mm256_set1_ps(kLumaG), L);
+            L = _mm256_fmadd_ps(B, _mm256_set1_ps(kLumaB), L);
+
+            // Bin and position inside it
+            __m256 pos = _mm256_mul_ps(GammaEncodeAVX(L), vBins);
+            __m256i k = _mm256_min_epi32(_mm256_cvttps_epi32(pos), vLast);
+            __m256 f = _mm256_sub_ps(pos, _mm256_cvtepi32_ps(k));
+
+            // Both edges of the bin in both tile columns
+            __m256i at = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)base), k);
+            __m256 a0 = _mm256_i32gather_ps(rowCurves, at, 4);
+            __m256 a1 = _mm256_i32gather_ps(rowCurves, _mm256_add_epi32(at, vOne), 4);
+            at = _mm256_add_epi32(at, vNext);
+            __m256 b0 = _mm256_i32gather_ps(rowCurves, at, 4);
+            __m256 b1 = _mm256_i32gather_ps(rowCurves, _mm256_add_epi32(at, vOne), 4);
+
+            __m256 left = _mm256_fmadd_ps(f, _mm256_sub_ps(a1, a0), a0);
+            __m256 right = _mm256_fmadd_ps(f, _mm256_sub_ps(b1, b0), b0);
+            __m256 display = _mm256_fmadd_ps(_mm256_loadu_ps(weight), _mm256_sub_ps(right, left), left);
+
+            // Back to linear, RGB scaled to the new luminance
+            display = _mm256_max_ps(display, _mm256_set1_ps(1e-30f));
+            __m256 linear = Exp2AVX(_mm256_mul_ps(Log2AVX(display), _mm256_set1_ps(kGamma)));
+            __m256 scale = _mm256_div_ps(linear, _mm256_max_ps(L, vEps));
+
+            _mm256_storeu_ps(pr, _mm256_max_ps(_mm256_mul_ps(R, scale), vEps));
+            _mm256_storeu_ps(pg, _mm256_max_ps(_mm256_mul_ps(G, scale), vEps));
+            _mm256_storeu_ps(pb, _mm256_max_ps(_mm256_mul_ps(B, scale), vEps));
+        };
+
+        for (; i + 8 <= n; i += 8)
+            curve8(r + i, g + i, b + i, tileBase + i, tileWeight + i);
+
+        // Padding lanes read the first curve, which always exists
+        if (i < n)
+        {
+            float pr[8] = {};
+            float pg[8] = {};
+            float pb[8] = {};
+            int base[8] = {};
+            float weight[8] = {};
+            std::copy(r + i, r + n, pr);
+            std::copy(g + i, g + n, pg);
+            std::copy(b + i, b + n, pb);
+            std::copy(tileBase + i, tileBase + n, base);
+            std::copy(tileWeight + i, tileWeight + n, weight);
+            curve8(pr, pg, pb, base, weight);
+            std::copy(pr, pr + (n - i), r + i);
+            std::copy(pg, pg + (n - i), g + i);
+            std::copy(pb, pb + (n - i), b + i);
+            i = n;
+        }
+    }
+
+    // Scalar path
+    for (; i < n; i++)
+    {
+        float L = r[i] * kLumaR + g[i] * kLumaG + b[i] * kLumaB;
+
+        float pos = powf(fminf(fmaxf(L, 0.0f), 1.0f), kInvGamma) * bins;
+        int k = std::min((int)pos, bins - 1);
+        float f = pos - k;
+
+        const float* left = rowCurves + tileBase[i] + k;
+        const float* right = left + edges;
+        float l = left[0] + f * (left[1] - left[0]);
+        float h = right[0] + f * (right[1] - right[0]);
+        float display = l + tileWeight[i] * (h - l);
+
+        float scale = powf(fmaxf(display, 0.0f), kGamma) / (L > kEps ? L : kEps);
+        r[i] = fmaxf(r[i] * scale, kEps);
+        g[i] = fmaxf(g[i] * scale, kEps);
+        b[i] = fmaxf(b[i] * scale, kEps);
+    }
+}
+
+/* ============================================================
+   Procedure: LogLuminancePlanar
+   ------------------------------------------------------------
+   Description:
+   log2 of the exposed luminance of n planar pixels, floored at
+   minLuminance (non-finite pixels give the floor as well).
+
+   Input parameters:
+   r, g, b      - Planar linear rows
+   n            - Number of pixels
+   exposure     - Exposure multiplier
+   minLuminance - Smallest luminance taken (> 0)
+
+   Output parameters:
+   logLum       - log2 luminance of every pixel
+   ============================================================ */
+void LogLuminancePlanar(const float* r, const float* g, const float* b, int n, float exposure,
+    float minLuminance, float* logLum)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vExp = _mm256_set1_ps(exposure);
+        const __m256 vMin = _mm256_set1_ps(minLuminance);
+        const __m256 vMax = _mm256_set1_ps(3.0e38f);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 L = _mm256_mul_ps(_mm256_loadu_ps(r + i), _mm256_set1_ps(kLumaR));
+            L = _mm256_fmadd_ps(_mm256_loadu_ps(g + i), _mm256_set1_ps(kLumaG), L);
+            L = _mm256_fmadd_ps(_mm256_loadu_ps(b + i), _mm256_set1_ps(kLumaB), L);
+            L = _mm256_mul_ps(L, vExp);
+
+            // max/min with the constant second returns it for NaN
+            L = _mm256_min_ps(_mm256_max_ps(L, vMin), vMax);
+            _mm256_storeu_ps(logLum + i, Log2AVX(L));
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float L = (r[i] * kLumaR + g[i] * kLumaG + b[i] * kLumaB) * exposure;
+        logLum[i] = std::log2(L > minLuminance && L < 3.0e38f ? L : minLuminance);
+    }
+}
+
+/* ============================================================
+   Procedure: SlideColumnSums
+   ------------------------------------------------------------
+   Description:
+   Moves the column sums of a vertical box window down one
+   row: adds the entering row and subtracts the leaving one,
+   for every column at once. With sumSq the squares are summed
+   as well. At the image edges one of the rows may be missing.
+
+   Input parameters:
+   add    - Row entering the window (nullptr if none)
+   remove - Row leaving it (nullptr if none)
+   n      - Number of columns
+
+   Output parameters:
+   sum    - Column sums (updated)
+   sumSq  - Column sums of squares (updated; may be nullptr)
+   ============================================================ */
+void SlideColumnSums(float* sum, float* sumSq, const float* add, const float* remove, int n)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 a = add ? _mm256_loadu_ps(add + i) : _mm256_setzero_ps();
+            __m256 r = remove ? _mm256_loadu_ps(remove + i) : _mm256_setzero_ps();
+
+            _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_sub_ps(a, r)));
+            if (sumSq)
+            {
+                __m256 sq = _mm256_fmsub_ps(a, a, _mm256_mul_ps(r, r));
+                _mm256_storeu_ps(sumSq + i, _mm256_add_ps(_mm256_loadu_ps(sumSq + i), sq));
+            }
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float a = add ? add[i] : 0.0f;
+        float r = remove ? remove[i] : 0.0f;
+        sum[i] += a - r;
+        if (sumSq)
+            sumSq[i] += a * a - r * r;
+    }
+}
+
+/* ============================================================
+   Procedure: GuidedCoefficients
+   ------------------------------------------------------------
+   Description:
+   Linear coefficients of the self-guided filter from the box
+   means of I and I²: a = var / (var + eps), b = mean (1 - a).
+   Flat windows (var << eps) get a ~ 0 and are smoothed; edges
+   (var >> eps) get a ~ 1 and are kept.
+
+   Input parameters:
+   meanI, meanII - Box means of I and I²
+   n             - Number of pixels
+   eps           - Edge threshold (variance, > 0)
+
+   Output parameters:
+   a, b          - Coefficients
+   ============================================================ */
+void GuidedCoefficients(const float* meanI, const float* meanII, int n, float eps, float* a, float* b)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vEps = _mm256_set1_ps(eps);
+        const __m256 vZero = _mm256_setzero_ps();
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 m = _mm256_loadu_ps(meanI + i);
+            __m256 var = _mm256_max_ps(_mm256_fnmadd_ps(m, m, _mm256_loadu_ps(meanII + i)), vZero);
+            __m256 k = _mm256_div_ps(var, _mm256_add_ps(var, vEps));
+
+            _mm256_storeu_ps(a + i, k);
+            _mm256_storeu_ps(b + i, _mm256_fnmadd_ps(k, m, m));
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float m = meanI[i];
+        float var = fmaxf(meanII[i] - m * m, 0.0f);
+        float k = var / (var + eps);
+        a[i] = k;
+        b[i] = m - k * m;
+    }
+}
+
+/* ============================================================
+   Procedure: LocalToneMapPlanar
+   ------------------------------------------------------------
+   Description:
+   Local tone mapping of planar rows, in place. The filtered
+   log luminance (meanA * I + meanB) is the base layer, the
+   rest of I the detail. The base is compressed around middle
+   grey (anchor), the detail scaled, and the luminance they
+   give goes through Extended Reinhard; RGB is scaled from the
+   exposed luminance to the result and clamped to eps as in
+   ToneMapPlanar, then graded and passed through the LUT as
+   there. Compression and detail of 1 give Extended Reinhard.
+
+   Input parameters:
+   r, g, b      - Planar linear rows (modified in place)
+   n            - Number of pixels
+   exposure     - Exposure multiplier (> 0.0)
+   whitePoint   - White point (> 0.0)
+   logLum       - I: LogLuminancePlanar of the rows
+   meanA, meanB - Box means of the guided filter coefficients
+   anchor       - log2 luminance kept in place by compression
+   compression  - Scale of the base layer around the anchor
+   detail       - Scale of the detail layer
+   grade        - Color grade (identity = none)
+   lut          - LUT (nullptr = none)
+   ============================================================ */
+void LocalToneMapPlanar(float* r, float* g, float* b, int n, float exposure, float whitePoint,
+    const float* logLum, const float* meanA, const float* meanB, float anchor, float compression, float detail,
+    const ColorGrade& grade, const CubeLut* lut)
+{
+    float wp = whitePoint > kEps ? whitePoint : kEps;
+    float wp2 = wp * wp;
+    bool graded = !grade.Identity();
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vExp = _mm256_set1_ps(exposure);
+        const __m256 vWp2 = _mm256_set1_ps(wp2);
+        const __m256 vAnchor = _mm256_set1_ps(anchor);
+        const __m256 vCompression = _mm256_set1_ps(compression);
+        const __m256 vDetail = _mm256_set1_ps(detail);
+        const __m256 vOne = _mm256_set1_ps(1.0f);
+        const __m256 vEps = _mm256_set1_ps(kEps);
+        const GradeVec vGrade(grade);
+        const LutVec vLut(lut ? *lut : CubeLut());
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 R = _mm256_mul_ps(_mm256_loadu_ps(r + i), vExp);
+            __m256 G = _mm256_mul_ps(_mm256_loadu_ps(g + i), vExp);
+            __m256 B = _mm256_mul_ps(_mm256_loadu_ps(b + i), vExp);
+
+            __m256 L = _mm256_mul_ps(R, _mm256_set1_ps(kLumaR));
+            L = _mm256_fmadd_ps(G, _mm256_set1_ps(kLumaG), L);
+            L = _mm256_fmadd_ps(B, _mm256_set1_ps(kLumaB), L);
+
+            // Base and detail layers
+            __m256 I = _mm256_loadu_ps(logLum + i);
+            __m256 base = _mm256_fmadd_ps(_mm256_loadu_ps(meanA + i), I, _mm256_loadu_ps(meanB + i));
+            __m256 logOut = _mm256_fmadd_ps(vCompression, _mm256_sub_ps(base, vAnchor), vAnchor);
+            logOut = _mm256_fmadd_ps(vDetail, _mm256_sub_ps(I, base), logOut);
+            __m256 local = Exp2AVX(logOut);
+
+            // Extended Reinhard of the new luminance
+            __m256 num = _mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(local, vWp2), vOne), local);
+            __m256 mapped = _mm256_div_ps(num, _mm256_add_ps(local, vOne));
+            __m256 scale = _mm256_div_ps(mapped, _mm256_max_ps(L, vEps));
+
+            R = _mm256_max_ps(_mm256_mul_ps(R, scale), vEps);
+            G = _mm256_max_ps(_mm256_mul_ps(G, scale), vEps);
+            B = _mm256_max_ps(_mm256_mul_ps(B, scale), vEps);
+
+            // The local operator costs far more than these branches
+            if (graded)
+            {
+                Grade8(R, G, B, vGrade);
+                R = _mm256_max_ps(R, vEps);
+                G = _mm256_max_ps(G, vEps);
+                B = _mm256_max_ps(B, vEps);
+            }
+            if (lut)
+            {
+                Lut8(R, G, B, *lut, vLut);
+                R = _mm256_max_ps(R, vEps);
+                G = _mm256_max_ps(G, vEps);
+                B = _mm256_max_ps(B, vEps);
+            }
+
+            _mm256_storeu_ps(r + i, R);
+            _mm256_storeu_ps(g + i, G);
+            _mm256_storeu_ps(b + i, B);
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float R = r[i] * exposure;
+        float G = g[i] * exposure;
+        float B = b[i] * exposure;
+        float L = R * kLumaR + G * kLumaG + B * kLumaB;
+
+        float I = logLum[i];
+        float base = meanA[i] * I + meanB[i];
+        float local = std::exp2(anchor + compression * (base - anchor) + detail * (I - base));
+
+        float mapped = (local * (1.0f + local / wp2)) / (1.0f + local);
+        float scale = mapped / (L > kEps ? L : kEps);
+
+        R = fmaxf(R * scale, kEps);
+        G = fmaxf(G * scale, kEps);
+        B = fmaxf(B * scale, kEps);
+        if (graded)
+        {
+            GradePixel(R, G, B, grade);
+            R = fmaxf(R, kEps);
+            G = fmaxf(G, kEps);
+            B = fmaxf(B, kEps);
+        }
+        if (lut)
+        {
+            LutPixel(R, G, B, *lut);
+            R = fmaxf(R, kEps);
+            G = fmaxf(G, kEps);
+            B = fmaxf(B, kEps);
+        }
+
+        r[i] = R;
+        g[i] = G;
+        b[i] = B;
+    }
+}
+
+/* ============================================================
+   Procedure: CubeLutPlanar
+   ------------------------------------------------------------
+   Description:
+   Applies a LUT to tone mapped planar rows in place, for
+   operators that change the mapped color after ToneMapPlanar
+   (CLAHE); the result is clamped to eps as there.
+
+   Input parameters:
+   r, g, b - Planar tone mapped rows (modified in place)
+   n       - Number of pixels
+   lut     - LUT to apply
+   ============================================================ */
+void CubeLutPlanar(float* r, float* g, float* b, int n, const CubeLut& lut)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vEps = _mm256_set1_ps(kEps);
+        const LutVec vLut(lut);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 R = _mm256_loadu_ps(r + i);
+            __m256 G = _mm256_loadu_ps(g + i);
+            __m256 B = _mm256_loadu_ps(b + i);
+            Lut8(R, G, B, lut, vLut);
+            _mm256_storeu_ps(r + i, _mm256_max_ps(R, vEps));
+            _mm256_storeu_ps(g + i, _mm256_max_ps(G, vEps));
+            _mm256_storeu_ps(b + i, _mm256_max_ps(B, vEps));
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        LutPixel(r[i], g[i], b[i], lut);
+        r[i] = fmaxf(r[i], kEps);
+        g[i] = fmaxf(g[i], kEps);
+        b[i] = fmaxf(b[i], kEps);
+    }
+}
+
+/* ============================================================
+   Procedure: RecursiveGaussianColumns
+   ------------------------------------------------------------
+   Description:
+   Young-van Vliet recursive Gaussian down columns of floats in
+   place: a causal third-order pass from the top row, then an
+   anticausal one from the bottom. The image is taken to repeat
+   its edge rows; the causal pass starts in the steady state of
+   the top row, the anticausal one from the Triggs-Sdika state
+   of the bottom row. The recursion poles get close to 1 as
+   sigma grows, so its state is kept in double; four columns go
+   through one AVX2 register.
+
+   Input parameters:
+   data    - First row of the columns
+   columns - Number of adjacent columns
+   count   - Number of rows (length of each column)
+   stride  - Floats between rows
+   c       - Coefficients for the sigma
+
+   Output parameters:
+   data    - Filtered columns
+   ============================================================ */
+void RecursiveGaussianColumns(float* data, int columns, int count, size_t stride, const GaussianCoefficients& c)
+{
+    int col = 0;
+
+    if (UseAVX2())
+    {
+        const __m256d vB = _mm256_set1_pd(c.b);
+        const __m256d vA1 = _mm256_set1_pd(c.a1);
+        const __m256d vA2 = _mm256_set1_pd(c.a2);
+        const __m256d vA3 = _mm256_set1_pd(c.a3);
+
+        for (; col + 4 <= columns; col += 4)
+        {
+            float* p = data + col;
+            float* last = p + (size_t)(count - 1) * stride;
+            __m256d edge = _mm256_cvtps_pd(_mm_loadu_ps(last));
+
+            // Causal pass
+            __m256d w1 = _mm256_cvtps_pd(_mm_loadu_ps(p));
+            __m256d w2 = w1;
+            __m256d w3 = w1;
+            for (int i = 0; i < count; i++)
+            {
+                float* row = p + (size_t)i * stride;
+                __m256d w = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(row)), vB);
+                w = _mm256_fmadd_pd(w1, vA1, w);
+                w = _mm256_fmadd_pd(w2, vA2, w);
+                w = _mm256_fmadd_pd(w3, vA3, w);
+                _mm_storeu_ps(row, _mm256_cvtpd_ps(w));
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+            }
+
+            // Anticausal state at the last row
+            __m256d d0 = _mm256_sub_pd(w1, edge);
+            __m256d d1 = _mm256_sub_pd(w2, edge);
+            __m256d d2 = _mm256_sub_pd(w3, edge);
+            __m256d y[3];
+            for (int k = 0; k < 3; k++)
+            {
+                __m256d v = _mm256_fmadd_pd(d0, _mm256_set1_pd(c.m[k * 3]), edge);
+                v = _mm256_fmadd_pd(d1, _mm256_set1_pd(c.m[k * 3 + 1]), v);
+                y[k] = _mm256_fmadd_pd(d2, _mm256_set1_pd(c.m[k * 3 + 2]), v);
+            }
+            _mm_storeu_ps(last, _mm256_cvtpd_ps(y[0]));
+
+            // Anticausal pass
+            __m256d y1 = y[0];
+            __m256d y2 = y[1];
+            __m256d y3 = y[2];
+            for (int i = count - 2; i >= 0; i--)
+            {
+                float* row = p + (size_t)i * stride;
+                __m256d v = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(row)), vB);
+                v = _mm256_fmadd_pd(y1, vA1, v);
+                v = _mm256_fmadd_pd(y2, vA2, v);
+                v = _mm256_fmadd_pd(y3, vA3, v);
+                _mm_storeu_ps(row, _mm256_cvtpd_ps(v));
+                y3 = y2;
+                y2 = y1;
+                y1 = v;
+            }
+        }
+    }
+
+    // Scalar tail
+    for (; col < columns; col++)
+    {
+        float* p = data + col;
+        float* last = p + (size_t)(count - 1) * stride;
+        double edge = *last;
+
+        double w1 = *p;
+        double w2 = w1;
+        double w3 = w1;
+        for (int i = 0; i < count; i++)
+        {
+            float* row = p + (size_t)i * stride;
+            double w = c.b * *row + c.a1 * w1 + c.a2 * w2 + c.a3 * w3;
+            *row = (float)w;
+            w3 = w2;
+            w2 = w1;
+            w1 = w;
+        }
+
+        double d0 = w1 - edge;
+        double d1 = w2 - edge;
+        double d2 = w3 - edge;
+        double y[3];
+        for (int k = 0; k < 3; k++)
+            y[k] = c.m[k * 3] * d0 + c.m[k * 3 + 1] * d1 + c.m[k * 3 + 2] * d2 + edge;
+        *last = (float)y[0];
+
+        double y1 = y[0];
+        double y2 = y[1];
+        double y3 = y[2];
+        for (int i = count - 2; i >= 0; i--)
+        {
+            float* row = p + (size_t)i * stride;
+            double v = c.b * *row + c.a1 * y1 + c.a2 * y2 + c.a3 * y3;
+            *row = (float)v;
+            y3 = y2;
+            y2 = y1;
+            y1 = v;
+        }
+    }
+}
+
+/* ============================================================
+   Procedure: BloomThreshold
+   ------------------------------------------------------------
+   Description:
+   Keeps the light of planar pixels above a luminance: each
+   pixel is scaled by max(L - threshold, 0) / L, which keeps
+   its hue. Non-finite pixels give nothing, so one of them
+   cannot spread over the blurred levels.
+
+   Input parameters:
+   r, g, b   - Planar linear rows
+   n         - Number of pixels
+   threshold - Luminance that blooms (>= 0)
+
+   Output parameters:
+   r, g, b   - Light above the threshold
+   ============================================================ */
+void BloomThreshold(float* r, float* g, float* b, int n, float threshold)
+{
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vT = _mm256_set1_ps(threshold);
+        const __m256 vTiny = _mm256_set1_ps(1.0e-20f);
+        const __m256 vZero = _mm256_setzero_ps();
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 R = _mm256_loadu_ps(r + i);
+            __m256 G = _mm256_loadu_ps(g + i);
+            __m256 B = _mm256_loadu_ps(b + i);
+
+            __m256 L = _mm256_mul_ps(R, _mm256_set1_ps(kLumaR));
+            L = _mm256_fmadd_ps(G, _mm256_set1_ps(kLumaG), L);
+            L = _mm256_fmadd_ps(B, _mm256_set1_ps(kLumaB), L);
+
+            // NaN and infinite luminance fail the comparison
+            __m256 k = _mm256_div_ps(_mm256_sub_ps(L, vT), _mm256_max_ps(L, vTiny));
+            __m256 keep = _mm256_cmp_ps(k, vZero, _CMP_GT_OQ);
+            k = _mm256_and_ps(k, keep);
+
+            _mm256_storeu_ps(r + i, _mm256_and_ps(_mm256_mul_ps(R, k), keep));
+            _mm256_storeu_ps(g + i, _mm256_and_ps(_mm256_mul_ps(G, k), keep));
+            _mm256_storeu_ps(b + i, _mm256_and_ps(_mm256_mul_ps(B, k), keep));
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float L = r[i] * kLumaR + g[i] * kLumaG + b[i] * kLumaB;
+        float k = (L - threshold) / std::max(L, 1.0e-20f);
+        bool keep = k > 0.0f;
+        r[i] = keep ? r[i] * k : 0.0f;
+        g[i] = keep ? g[i] * k : 0.0f;
+        b[i] = keep ? b[i] * k : 0.0f;
+    }
+}
+
+/* ============================================================
+   Procedure: DownsampleRow2x2
+   ------------------------------------------------------------
+   Description:
+   Halves a pair of rows in both directions: every output
+   value is the mean of a 2 x 2 block. An odd last column is
+   averaged over its two rows alone.
+
+   Input parameters:
+   row0, row1 - Rows of the block (the same row twice at an odd
+                last row)
+   width      - Values per input row
+
+   Output parameters:
+   out        - (width + 1) / 2 means
+   ============================================================ */
+void DownsampleRow2x2(const float* row0, const float* row1, int width, float* out)
+{
+    int pairs = width / 2;
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vQuarter = _mm256_set1_ps(0.25f);
+
+        for (; i + 8 <= pairs; i += 8)
+        {
+            __m256 lo = _mm256_add_ps(_mm256_loadu_ps(row0 + 2 * i), _mm256_loadu_ps(row1 + 2 * i));
+            __m256 hi = _mm256_add_ps(_mm256_loadu_ps(row0 + 2 * i + 8), _mm256_loadu_ps(row1 + 2 * i + 8));
+
+            // hadd works within 128-bit lanes; reorder its quarters
+            __m256 sums = _mm256_hadd_ps(lo, hi);
+            sums = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(sums, vQuarter));
+        }
+    }
+
+    // Scalar tail
+    for (; i < pairs; i++)
+        out[i] = (row0[2 * i] + row0[2 * i + 1] + row1[2 * i] + row1[2 * i + 1]) * 0.25f;
+
+    if (width & 1)
+        out[pairs] = (row0[width - 1] + row1[width - 1]) * 0.5f;
+}
+
+/* ============================================================
+   Procedure: UpsampleAddRow
+   ------------------------------------------------------------
+   Description:
+   Adds a bilinear sample of a coarser plane to a row. Coarse
+   pixel i covers fine pixels i * factor .. (i + 1) * factor - 1,
+   so fine column x samples at (x + 0.5) / factor - 0.5; the
+   coarse edges are repeated outwards.
+
+   Input parameters:
+   coarse0, coarse1 - Coarse rows above and below the fine row
+   wy               - Weight of coarse1 [0, 1]
+   coarseWidth      - Values per coarse row
+   factor           - Fine pixels per coarse pixel
+   x0               - Fine column of fine[0]
+   n                - Number of fine pixels
+   scale            - Factor of the added sample
+
+   Output parameters:
+   fine             - Row the samples are added to
+   ============================================================ */
+void UpsampleAddRow(const float* coarse0, const float* coarse1, float wy, int coarseWidth, int factor,
+    int x0, int n, float scale, float* fine)
+{
+    float inv = 1.0f / factor;
+    int i = 0;
+
+    if (UseAVX2())
+    {
+        const __m256 vInv = _mm256_set1_ps(inv);
+        const __m256 vWy = _mm256_set1_ps(wy);
+        const __m256 vScale = _mm256_set1_ps(scale);
+        const __m256i vLast = _mm256_set1_epi32(coarseWidth - 1);
+        const __m256i vZero = _mm256_setzero_si256();
+        const __m256i vOne = _mm256_set1_epi32(1);
+        const __m256 vStep = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 fx = _mm256_fmsub_ps(_mm256_add_ps(_mm256_set1_ps((float)(x0 + i)), vStep), vInv,
+                _mm256_set1_ps(0.5f));
+            __m256 fl = _mm256_floor_ps(fx);
+            __m256 wx = _mm256_sub_ps(fx, fl);
+
+            __m256i c = _mm256_cvttps_epi32(fl);
+            __m256i c0 = _mm256_min_epi32(_mm256_max_epi32(c, vZero), vLast);
+            __m256i c1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(c, vOne), vZero), vLast);
+
+            __m256 a0 = _mm256_i32gather_ps(coarse0, c0, 4);
+            __m256 a1 = _mm256_i32gather_ps(coarse0, c1, 4);
+            __m256 b0 = _mm256_i32gather_ps(coarse1, c0, 4);
+            __m256 b1 = _mm256_i32gather_ps(coarse1, c1, 4);
+
+            __m256 top = _mm256_fmadd_ps(wx, _mm256_sub_ps(a1, a0), a0);
+            __m256 bottom = _mm256_fmadd_ps(wx, _mm256_sub_ps(b1, b0), b0);
+            __m256 v = _mm256_fmadd_ps(vWy, _mm256_sub_ps(bottom, top), top);
+
+            _mm256_storeu_ps(fine + i, _mm256_fmadd_ps(v, vScale, _mm256_loadu_ps(fine + i)));
+        }
+    }
+
+    // Scalar tail
+    for (; i < n; i++)
+    {
+        float fx = (x0 + i + 0.5f) * inv - 0.5f;
+        float fl = std::floor(fx);
+        float wx = fx - fl;
+
+        int c = (int)fl;
+        int c0 = std::clamp(c, 0, coarseWidth - 1);
+        int c1 = std::clamp(c + 1, 0, coarseWidth - 1);
+
+        float top = coarse0[c0] + wx * (coarse0[c1] - coarse0[c0]);
+        float bottom = coarse1[c0] + wx * (coarse1[c1] - coarse1[c0]);
+        fine[i] += (top + wy * (bottom - top)) * scale;
+    }
+}
+
+/* ============================================================
+   Procedure: UseF16C
+   ------------------------------------------------------------
+   Description:
+   True if the half conversion instructions can be used. Every
+   AVX2 CPU has F16C; it is checked anyway since the hash and
+   the kernels only test for AVX2 and FMA.
+   ============================================================ */
+static inline bool UseF16C()
+{
+    static const bool has = []
+    {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        return (regs[2] & (1 << 29)) != 0;
+#else
+        return __builtin_cpu_supports("f16c") != 0;
+#endif
+    }();
+    return has && UseAVX2();
+}
+
+/* ============================================================
+   Procedure: FloatToHalf / HalfToFloat
+   ------------------------------------------------------------
+   Description:
+   Scalar conversions matching the F16C instructions bit for
+   bit: round to nearest even, overflow to infinity, subnormals
+   kept, NaN quieted.
+   ============================================================ */
+static inline unsigned short FloatToHalf(float f)
+{
+    unsigned int x = std::bit_cast<unsigned int>(f);
+    unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+
+    // Infinity, and NaN quieted with the top of its payload
+    if (x >= 0x7f800000)
+        return (unsigned short)(sign | 0x7c00 | (x > 0x7f800000 ? 0x200 | ((x >> 13) & 0x3ff) : 0));
+
+    // Rounds to infinity (>= 65520)
+    if (x >= 0x477ff000)
+        return (unsigned short)(sign | 0x7c00);
+
+    // Subnormal half: adding 0.5 leaves round(f * 2^24) in the
+    // low mantissa bits
+    if (x < 0x38800000)
+    {
+        float v = std::bit_cast<float>(x) + 0.5f;
+        return (unsigned short)(sign | (std::bit_cast<unsigned int>(v) - 0x3f000000));
+    }
+
+    // Normal: rebias the exponent and round the mantissa
+    unsigned int odd = (x >> 13) & 1;
+    x += 0xc8000fff + odd;
+    return (unsigned short)(sign | (x >> 13));
+}
+
+static inline float HalfToFloat(unsigned short h)
+{
+    unsigned int x = (unsigned int)(h & 0x7fff) << 13;
+    unsigned int exponent = x & (0x7c00 << 13);
+    x += (127 - 15) << 23;
+
+    if (exponent == (0x7c00 << 13))
+    {
+        // Infinity, and NaN quieted
+        x += (128 - 16) << 23;
+        if (h & 0x3ff)
+            x |= 0x400000;
+    }
+    else if (exponent == 0)
+    {
+        // Subnormal: normalize through a float subtraction
+        x += 1 << 23;
+        x = std::bit_cast<unsigned int>(std::bit_cast<float>(x) - std::bit_cast<float>(113u << 23));
+    }
+
+    return std::bit_cast<float>(x | (unsigned int)(h & 0x8000) << 16);
+}
+
+/* ============================================================
+   Procedure: PackHalfPlanes
+   ------------------------------------------------------------
+   Description:
+   Converts floats to halves and splits each into its low and
+   high byte. The high bytes (sign, exponent, top mantissa bits)
+   of neighbouring pixels are mostly equal, so as a plane of
+   their own they compress far better than interleaved.
+   Finite values beyond the half range are clamped to +-65504
+   instead of rounding to infinity, which the renders would
+   count as non-finite and draw black; infinities and NaNs are
+   kept as they are.
+
+   Input parameters:
+   src - n floats
+
+   Output parameters:
+   lo  - n low bytes
+   hi  - n high bytes
+   ============================================================ */
+void PackHalfPlanes(const float* src, int n, unsigned char* lo, unsigned char* hi)
+{
+    int i = 0;
+
+    if (UseF16C())
+    {
+        const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+        const __m256 vMax = _mm256_set1_ps(kHalfMax);
+        const __m256 vMin = _mm256_set1_ps(-kHalfMax);
+        const __m256 vInf = _mm256_set1_ps(INFINITY);
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 v = _mm256_loadu_ps(src + i);
+            __m256 finite = _mm256_cmp_ps(_mm256_and_ps(v, absMask), vInf, _CMP_LT_OQ);
+            v = _mm256_blendv_ps(v, _mm256_max_ps(vMin, _mm256_min_ps(vMax, v)), finite);
+
+            __m128i h = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+            h = _mm_shuffle_epi8(h, split);
+            _mm_storel_epi64((__m128i*)(lo + i), h);
+            _mm_storel_epi64((__m128i*)(hi + i), _mm_unpackhi_epi64(h, h));
+        }
+    }
+
+    for (; i < n; i++)
+    {
+        float v = src[i];
+        if (std::isfinite(v))
+            v = std::clamp(v, -kHalfMax, kHalfMax);
+
+        unsigned short h = FloatToHalf(v);
+        lo[i] = (unsigned char)(h & 0xFF);
+        hi[i] = (unsigned char)(h >> 8);
+    }
+}
+
+/* ============================================================
+   Procedure: UnpackHalfPlanes
+   ------------------------------------------------------------
+   Description:
+   Joins byte planes back into halves and converts them to
+   floats.
+
+   Input parameters:
+   lo, hi - n low / high bytes
+
+   Output parameters:
+   dst    - n floats
+   ============================================================ */
+void UnpackHalfPlanes(const unsigned char* lo, const unsigned char* hi, int n, float* dst)
+{
+    int i = 0;
+
+    if (UseF16C())
+    {
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i h = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((const __m128i*)(lo + i)),
+                _mm_loadl_epi64((const __m128i*)(hi + i)));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+    }
+
+    for (; i < n; i++)
+        dst[i] = HalfToFloat((unsigned short)(lo[i] | hi[i] << 8));
+}
@@ -0,0 +1,203 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <mutex>
+#include <vector>
+
+// Returns true if the CPU supports AVX2 and FMA.
+bool CpuHasAVX2();
+
+// Kernel implementation choice (HDRKernelVariant values)
+enum KernelVariant
+{
+	KERNEL_VARIANT_AUTO = 0,
+	KERNEL_VARIANT_SCALAR = 1,
+	KERNEL_VARIANT_AVX2 = 2
+};
+
+// Machine-dependent kernel settings (see the tune profile)
+struct KernelConfig
+{
+	int variant = KERNEL_VARIANT_AUTO;
+	// AVX2 iterations per loop step (1 or 2)
+	int unroll = 1;
+	// Output image bytes from which stores bypass the cache (0 = never)
+	long long streamThreshold = 0;
+};
+
+// Publishes a new configuration / returns a copy of the current
+// one. Safe while kernels run: every kernel call reads one
+// snapshot, so a row never mixes two configurations.
+void SetKernelConfig(const KernelConfig& config);
+KernelConfig GetKernelConfig();
+
+// Highest 8-bit code counted as crushed (QualityAccum::clipLow):
+// the code of the kernels' channel floor (0.0001), which mapped
+// black encodes to, so black is crushed on every backend.
+const int kClipLowCode = 3;
+
+// Per-image quality counters gathered while the kernels run.
+// Luminance "in" is the exposed scene luminance entering the
+// operator, "out" the mapped luminance; non-finite pixels are
+// counted but left out of the luminance figures.
+struct QualityAccum
+{
+	long long pixels = 0;
+	long long nonFinite = 0;
+	// 8-bit output channels (R, G, B) at 255 / at or below kClipLowCode
+	long long clipHigh[3] = {};
+	long long clipLow[3] = {};
+	double sumIn = 0.0;
+	double sumOut = 0.0;
+	float minIn = 3.0e38f;
+	float maxIn = -3.0e38f;
+	float minOut = 3.0e38f;
+	float maxOut = -3.0e38f;
+
+	void Merge(const QualityAccum& other);
+};
+
+// Counters of one render merged from its tiles / bands
+struct QualityTotal
+{
+	std::mutex mutex;
+	QualityAccum total;
+
+	void Add(const QualityAccum& part)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		total.Merge(part);
+	}
+};
+
+// Splits n interleaved RGB pixels into three planar rows.
+void DeinterleaveRGB(const float* rgb, int n, float* r, float* g, float* b);
+
+// ASC CDL grade of tone mapped linear RGB (see Grade.h): per
+// channel (v * slope + offset)^power, negatives clipped to 0, then
+// saturation around the Rec. 709 luminance. The default is identity.
+struct ColorGrade
+{
+	float slope[3] = { 1.0f, 1.0f, 1.0f };
+	float offset[3] = { 0.0f, 0.0f, 0.0f };
+	float power[3] = { 1.0f, 1.0f, 1.0f };
+	float saturation = 1.0f;
+
+	bool operator==(const ColorGrade& other) const = default;
+	bool Identity() const { return *this == ColorGrade(); }
+};
+
+// .cube LUT (see Lut.h) applied to gamma encoded output values: an
+// optional 1D shaper of size1D RGB entries, then an optional lattice
+// of size3D³ RGB entries, red fastest. Each table maps its input range
+// [min, max] onto its entries, clamping outside it.
+struct CubeLut
+{
+	int size1D = 0;
+	float min1D[3] = { 0.0f, 0.0f, 0.0f };
+	float max1D[3] = { 1.0f, 1.0f, 1.0f };
+	std::vector<float> table1D;
+
+	int size3D = 0;
+	float min3D[3] = { 0.0f, 0.0f, 0.0f };
+	float max3D[3] = { 1.0f, 1.0f, 1.0f };
+	std::vector<float> table3D;
+};
+
+// Extended Reinhard tone mapping of n planar pixels in place
+// (same math as ToneMapAVX2 in ASMlib). Adds luminance and
+// non-finite counts to quality if given (before the grade). A grade
+// other than identity and a LUT (nullptr = none) are applied in the
+// same loop; the result stays linear.
+void ToneMapPlanar(float* r, float* g, float* b, int n, float exposure, float whitePoint,
+	QualityAccum* quality = nullptr, const ColorGrade& grade = {}, const CubeLut* lut = nullptr);
+
+// Applies a LUT to n tone mapped planar pixels in place: gamma
+// encodes, looks up (tetrahedral in the lattice) and decodes again.
+void CubeLutPlanar(float* r, float* g, float* b, int n, const CubeLut& lut);
+
+// Dither of one output row: the blue-noise row it uses (see Dither.h)
+// and the tile column of its first pixel. No noise = no dither.
+struct DitherRow
+{
+	const float* noise = nullptr;
+	int x = 0;
+};
+
+// Clamps to [0,1], gamma encodes (1/2.2) and writes n BGRA8 pixels,
+// optionally with non-temporal stores (same output either way).
+// Adds clipped channel counts to quality if given. With dither noise
+// each value is offset by its noise value before truncation.
+void StoreBGRA8(const float* r, const float* g, const float* b, int n, unsigned char* bgra,
+	bool stream = false, QualityAccum* quality = nullptr, const DitherRow& dither = {});
+
+// CLAHE histogram bin (0..bins-1) of n tone mapped planar pixels:
+// their gamma encoded luminance in bins equal steps.
+void ClaheBins(const float* r, const float* g, const float* b, int n, int bins, int* index);
+
+// Applies CLAHE tile curves (bins + 1 display luminance values per
+// tile column, blended between tile rows by the caller) to n tone
+// mapped planar pixels in place. tileBase is each pixel's offset of
+// its left tile column in rowCurves, tileWeight that of the right.
+void ClahePlanar(float* r, float* g, float* b, int n, const float* rowCurves, const int* tileBase,
+	const float* tileWeight, int bins);
+
+// log2 of the exposed luminance of n planar pixels, floored at
+// minLuminance (also for non-finite pixels).
+void LogLuminancePlanar(const float* r, const float* g, const float* b, int n, float exposure,
+	float minLuminance, float* logLum);
+
+// Moves vertical box window column sums down one row: adds add,
+// subtracts remove (either may be nullptr), and the same for the
+// squares into sumSq if given.
+void SlideColumnSums(float* sum, float* sumSq, const float* add, const float* remove, int n);
+
+// Self-guided filter coefficients from the box means of I and I²:
+// a = var / (var + eps), b = mean * (1 - a).
+void GuidedCoefficients(const float* meanI, const float* meanII, int n, float eps, float* a, float* b);
+
+// Local tone mapping of n planar pixels in place: base layer
+// meanA * logLum + meanB compressed around anchor, detail layer
+// scaled, then Extended Reinhard. Compression and detail of 1 give
+// ToneMapPlanar's result, grade and LUT included.
+void LocalToneMapPlanar(float* r, float* g, float* b, int n, float exposure, float whitePoint,
+	const float* logLum, const float* meanA, const float* meanB, float anchor, float compression, float detail,
+	const ColorGrade& grade = {}, const CubeLut* lut = nullptr);
+
+// Young-van Vliet recursive Gaussian of one sigma: input gain b,
+// feedback a1..a3, and the Triggs-Sdika matrix (scaled by b) that
+// starts the anticausal pass at an edge repeated outwards
+struct GaussianCoefficients
+{
+	double b;
+	double a1, a2, a3;
+	double m[9];
+};
+
+// Gaussian blur of columns of floats in place (rows stride floats
+// apart), at a cost per pixel independent of sigma.
+void RecursiveGaussianColumns(float* data, int columns, int count, size_t stride, const GaussianCoefficients& c);
+
+// Keeps the light of n planar pixels above a luminance threshold:
+// each pixel scaled by max(L - threshold, 0) / L (0 if non-finite).
+void BloomThreshold(float* r, float* g, float* b, int n, float threshold);
+
+// Means of the 2 x 2 blocks of a row pair ((width + 1) / 2 values;
+// an odd last column is averaged over the two rows only).
+void DownsampleRow2x2(const float* row0, const float* row1, int width, float* out);
+
+// Adds scale times a bilinear sample of a coarse plane (rows
+// coarse0 and coarse1 blended by wy, one coarse pixel per factor
+// fine ones, edges repeated) to n fine pixels from column x0.
+void UpsampleAddRow(const float* coarse0, const float* coarse1, float wy, int coarseWidth, int factor,
+	int x0, int n, float scale, float* fine);
+
+// Rounds n floats to half precision (nearest even, like F16C;
+// finite values clamped to the half range) and writes the low
+// and high byte of each half to separate planes.
+void PackHalfPlanes(const float* src, int n, unsigned char* lo, unsigned char* hi);
+
+// Inverse of PackHalfPlanes: n halves from byte planes to floats.
+void UnpackHalfPlanes(const unsigned char* lo, const unsigned char* hi, int n, float* dst);
+
+#endif
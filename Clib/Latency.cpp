@@ -0,0 +1,248 @@
+// ============================================================
+// File: Latency.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Request latency instrumentation. Every render request is
+// timed from submission to the moment its output buffer is
+// ready and recorded into a histogram per backend and cache
+// outcome, so interactive responsiveness can be read as
+// percentiles (and checked against a latency target) instead
+// of as average throughput.
+// ============================================================
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "HDR.h"
+#include "Latency.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gLatencyMutex
+ * Protects the histograms and SLO counters.
+ */
+static std::mutex gLatencyMutex;
+
+/*
+ * gLatency
+ * One histogram per backend and cache outcome
+ * ([backend][0] = miss, [backend][1] = hit).
+ */
+static LatencyHistogram gLatency[HDR_BACKEND_COUNT][2];
+
+/*
+ * gOverSlo
+ * Requests slower than gSloMs, same layout as gLatency.
+ */
+static long long gOverSlo[HDR_BACKEND_COUNT][2];
+
+/*
+ * gSloMs
+ * Interactive latency target in milliseconds.
+ * Range: > 0 (default 100 ms)
+ */
+static double gSloMs = 100.0;
+
+/* ============================================================
+   Procedure: LatencyHistogram::BucketOf
+   ------------------------------------------------------------
+   Description:
+   Bucket index of a value. Below kSubCount microseconds every
+   value has its own bucket; above, each power of two is split
+   into kHalfCount equal buckets.
+   ============================================================ */
+int LatencyHistogram::BucketOf(long long us)
+{
+    if (us < kSubCount)
+        return (int)std::max(us, 0LL);
+
+    int exponent = 0;
+    for (long long v = us; v > 1; v >>= 1)
+        exponent++;
+
+    if (exponent > kMaxExponent)
+        return kBuckets - 1;
+
+    int shift = exponent - (kSubBits - 1);
+    int sub = (int)(us >> shift);
+    return kSubCount + (exponent - kSubBits) * kHalfCount + (sub - kHalfCount);
+}
+
+/* ============================================================
+   Procedure: LatencyHistogram::BucketHighest
+   ------------------------------------------------------------
+   Description:
+   Highest value that falls into a bucket; percentiles report
+   it, so they never understate a latency.
+   ============================================================ */
+long long LatencyHistogram::BucketHighest(int bucket)
+{
+    if (bucket < kSubCount)
+        return bucket;
+
+    int j = bucket - kSubCount;
+    int exponent = j / kHalfCount + kSubBits;
+    long long sub = j % kHalfCount + kHalfCount;
+    int shift = exponent - (kSubBits - 1);
+    return ((sub + 1) << shift) - 1;
+}
+
+/* ============================================================
+   Procedure: LatencyHistogram::Record / Reset
+   ------------------------------------------------------------
+   Input parameters:
+   ms - Request latency in milliseconds
+   ============================================================ */
+void LatencyHistogram::Record(double ms)
+{
+    long long us = (long long)std::llround(std::max(ms, 0.0) * 1000.0);
+
+    counts[BucketOf(us)]++;
+    count++;
+    maxUs = std::max(maxUs, us);
+    totalUs += (double)us;
+}
+
+void LatencyHistogram::Reset()
+{
+    std::fill(counts, counts + kBuckets, 0LL);
+    count = 0;
+    maxUs = 0;
+    totalUs = 0.0;
+}
+
+/* ============================================================
+   Procedure: LatencyHistogram::PercentileMs
+   ------------------------------------------------------------
+   Input parameters:
+   p - Percentile in [0, 100]
+
+   Output parameters:
+   Returns the latency in milliseconds (0 if nothing recorded).
+   ============================================================ */
+double LatencyHistogram::PercentileMs(double p) const
+{
+    if (count == 0)
+        return 0.0;
+
+    long long target = (long long)std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * count);
+    target = std::max(target, 1LL);
+
+    long long seen = 0;
+    for (int b = 0; b < kBuckets; b++)
+    {
+        seen += counts[b];
+        if (seen >= target)
+            return std::min(BucketHighest(b), maxUs) / 1000.0;
+    }
+    return MaxMs();
+}
+
+/* ============================================================
+   Procedure: LatencyRecord
+   ------------------------------------------------------------
+   Description:
+   Records one request.
+
+   Input parameters:
+   backend  - HDRBackend that served the request
+   cacheHit - true if it came from the render cache
+   ms       - Submission to output-ready time
+   ============================================================ */
+void LatencyRecord(int backend, bool cacheHit, double ms)
+{
+    if (backend < 0 || backend >= HDR_BACKEND_COUNT)
+        return;
+
+    std::lock_guard<std::mutex> lock(gLatencyMutex);
+    gLatency[backend][cacheHit].Record(ms);
+    if (ms > gSloMs)
+        gOverSlo[backend][cacheHit]++;
+}
+
+/* ============================================================
+   Procedure: RecordLatency
+   ------------------------------------------------------------
+   Description:
+   Records a request served outside this library (the ASM
+   backend is timed by its caller).
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void RecordLatency(int backend, bool cacheHit, double ms)
+{
+    LatencyRecord(backend, cacheHit, ms);
+}
+
+/* ============================================================
+   Procedure: GetLatencyStats
+   ------------------------------------------------------------
+   Description:
+   Copies the distribution of one backend and cache outcome.
+
+   Input parameters:
+   backend  - HDRBackend
+   cacheHit - Nonzero for cache hits, 0 for rendered requests
+
+   Output parameters:
+   stats    - Count, p50/p95/p99/max/mean in milliseconds and
+              the number of requests over the SLO
+   Returns false for an invalid backend.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool GetLatencyStats(int backend, int cacheHit, HDRLatencyStats* stats)
+{
+    if (!stats || backend < 0 || backend >= HDR_BACKEND_COUNT)
+        return false;
+
+    std::lock_guard<std::mutex> lock(gLatencyMutex);
+    const LatencyHistogram& h = gLatency[backend][cacheHit ? 1 : 0];
+
+    stats->count = h.Count();
+    stats->overSlo = gOverSlo[backend][cacheHit ? 1 : 0];
+    stats->p50Ms = h.PercentileMs(50.0);
+    stats->p95Ms = h.PercentileMs(95.0);
+    stats->p99Ms = h.PercentileMs(99.0);
+    stats->maxMs = h.MaxMs();
+    stats->meanMs = h.MeanMs();
+    stats->sloMs = gSloMs;
+    return true;
+}
+
+/* ============================================================
+   Procedure: ResetLatencyStats / SetLatencySLO
+   ------------------------------------------------------------
+   Description:
+   Clears all histograms / sets the latency target counted by
+   overSlo (applies to requests recorded from now on).
+
+   Input parameters:
+   ms - Latency target in milliseconds (> 0)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ResetLatencyStats()
+{
+    std::lock_guard<std::mutex> lock(gLatencyMutex);
+    for (int b = 0; b < HDR_BACKEND_COUNT; b++)
+    {
+        for (int hit = 0; hit < 2; hit++)
+        {
+            gLatency[b][hit].Reset();
+            gOverSlo[b][hit] = 0;
+        }
+    }
+}
+
+extern "C" __declspec(dllexport)
+void SetLatencySLO(double ms)
+{
+    if (ms <= 0.0)
+        return;
+
+    std::lock_guard<std::mutex> lock(gLatencyMutex);
+    gSloMs = ms;
+}
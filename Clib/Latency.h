@@ -0,0 +1,39 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Latency distribution in the style of HdrHistogram: values are
+// recorded in microseconds into log-linear buckets (128 linear
+// sub-buckets per power of two), so every percentile is exact to
+// within 1% from a microsecond up to days, in constant memory.
+class LatencyHistogram
+{
+public:
+	void Record(double ms);
+	void Reset();
+
+	// Latency at or below which p percent of requests finished
+	double PercentileMs(double p) const;
+	double MaxMs() const { return maxUs / 1000.0; }
+	double MeanMs() const { return count ? totalUs / count / 1000.0 : 0.0; }
+	long long Count() const { return count; }
+
+private:
+	static const int kSubBits = 8;
+	static const int kSubCount = 1 << kSubBits;
+	static const int kHalfCount = kSubCount / 2;
+	static const int kMaxExponent = 40;
+	static const int kBuckets = kSubCount + (kMaxExponent - kSubBits + 1) * kHalfCount;
+
+	static int BucketOf(long long us);
+	static long long BucketHighest(int bucket);
+
+	long long counts[kBuckets] = {};
+	long long count = 0;
+	long long maxUs = 0;
+	double totalUs = 0.0;
+};
+
+// Records one request from submission to output ready.
+void LatencyRecord(int backend, bool cacheHit, double ms);
+
+#endif
@@ -0,0 +1,385 @@
+// ============================================================
+// File: LocalTone.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Local tone mapping with an edge-aware base/detail split. The
+// log2 luminance I of the image is smoothed by a self-guided
+// filter (I guides itself), which flattens regions and keeps
+// edges without the halos and cost of a bilateral filter: over
+// every box window, base = a I + b with a = var / (var + edge),
+// and the a, b of all windows covering a pixel are averaged.
+// The base layer is compressed around middle grey, the detail
+// (I - base) kept or boosted, and the result finished with
+// Extended Reinhard, so compression and detail of 1 give
+// Extended Reinhard itself.
+//
+// All box filters are running sums, so the cost does not depend
+// on the radius: column sums slide down the image, one add and
+// one subtract per column and row for all columns at once, and
+// each row's sums are run along it. The image is processed in
+// bands spanning its width, in parallel; each band recomputes
+// the halo of rows its filters reach (2 radii above and below),
+// which also limits how far float sums can drift.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "HDR.h"
+#include "Dither.h"
+#include "Exposure.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Grade.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "LocalTone.h"
+#include "ThreadPool.h"
+#include "Tune.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Smallest band height; bands grow with the radius so the halo
+// rows stay at most as many as the band's own
+static const int kMinBandRows = 64;
+
+// Largest filter radius (pixels)
+static const int kMaxRadius = 256;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gRadius, gEdge, gCompression, gDetail
+ * Settings of the local operator (SetLocalToneParams).
+ * Range: radius 1 .. kMaxRadius (default 16), edge > 0
+ * (default 0.1), compression > 0 (default 0.6), detail >= 0
+ * (default 1.2)
+ */
+static std::atomic<int> gRadius{ 16 };
+static std::atomic<float> gEdge{ 0.1f };
+static std::atomic<float> gCompression{ 0.6f };
+static std::atomic<float> gDetail{ 1.2f };
+
+/* ============================================================
+   Procedure: GetLocalToneSettings
+   ============================================================ */
+LocalToneSettings GetLocalToneSettings()
+{
+    LocalToneSettings settings;
+    settings.radius = gRadius;
+    settings.edge = gEdge;
+    settings.compression = gCompression;
+    settings.detail = gDetail;
+    return settings;
+}
+
+/* ============================================================
+   Procedure: BoxRows
+   ------------------------------------------------------------
+   Description:
+   Horizontal pass of the box filter for two quantities: runs
+   a window of 2 radius + 1 column sums along the row and
+   scales each result by its window's inverse pixel count.
+   Sums run in double, so a long row does not drift.
+
+   Input parameters:
+   sumA, sumB  - Column sums of the row's vertical window
+   n           - Number of columns
+   radius      - Box radius
+   columnScale - Per column: 1 / columns in its window
+   rowScale    - 1 / rows in the vertical window
+
+   Output parameters:
+   meanA, meanB - Box means
+   ============================================================ */
+static void BoxRows(const float* sumA, const float* sumB, int n, int radius, const float* columnScale,
+    float rowScale, float* meanA, float* meanB)
+{
+    double a = 0.0;
+    double b = 0.0;
+    for (int x = 0; x < std::min(radius, n); x++)
+    {
+        a += sumA[x];
+        b += sumB[x];
+    }
+
+    for (int x = 0; x < n; x++)
+    {
+        int enter = x + radius;
+        int leave = x - radius - 1;
+        if (enter < n)
+        {
+            a += sumA[enter];
+            b += sumB[enter];
+        }
+        if (leave >= 0)
+        {
+            a -= sumA[leave];
+            b -= sumB[leave];
+        }
+
+        float scale = columnScale[x] * rowScale;
+        meanA[x] = (float)a * scale;
+        meanB[x] = (float)b * scale;
+    }
+}
+
+/* ============================================================
+   BandBuffers
+   ------------------------------------------------------------
+   Rows of one band: I for the band and 2 radii around it, the
+   coefficients for 1 radius around it, and the running sums.
+   ============================================================ */
+struct BandBuffers
+{
+    std::vector<float> logLum;
+    std::vector<float> a;
+    std::vector<float> b;
+    std::vector<float> sum0, sum1;
+    std::vector<float> mean0, mean1;
+    std::vector<float> planes;
+};
+
+/* ============================================================
+   Procedure: RenderBand
+   ------------------------------------------------------------
+   Description:
+   Tone maps rows y0 .. y1 - 1. Windows are clipped at the
+   image edges and divided by the pixels they hold.
+   ============================================================ */
+static void RenderBand(const float* linearRGB, int width, int height, unsigned char* outputBGRA,
+    float exposure, float whitePoint, const LocalToneSettings& settings, const float* columnScale,
+    bool stream, int y0, int y1, BandBuffers& buf)
+{
+    int radius = settings.radius;
+    float anchor = std::log2(kExposureKey);
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+
+    auto rowsIn = [&](int y) { return std::min(height - 1, y + radius) - std::max(0, y - radius) + 1; };
+
+    // Rows of I and of the coefficients the band needs
+    int iy0 = std::max(0, y0 - 2 * radius);
+    int iy1 = std::min(height, y1 + 2 * radius);
+    int cy0 = std::max(0, y0 - radius);
+    int cy1 = std::min(height, y1 + radius);
+
+    buf.logLum.resize((size_t)(iy1 - iy0) * width);
+    buf.a.resize((size_t)(cy1 - cy0) * width);
+    buf.b.resize((size_t)(cy1 - cy0) * width);
+    buf.sum0.resize(width);
+    buf.sum1.resize(width);
+    buf.mean0.resize(width);
+    buf.mean1.resize(width);
+    buf.planes.resize((size_t)width * 3);
+
+    float* r = buf.planes.data();
+    float* g = r + width;
+    float* b = g + width;
+
+    auto I = [&](int y) { return buf.logLum.data() + (size_t)(y - iy0) * width; };
+    auto A = [&](int y) { return buf.a.data() + (size_t)(y - cy0) * width; };
+    auto B = [&](int y) { return buf.b.data() + (size_t)(y - cy0) * width; };
+
+    /* ----------------------------
+       Log luminance
+       ---------------------------- */
+    for (int y = iy0; y < iy1; y++)
+    {
+        DeinterleaveRGB(linearRGB + (size_t)y * width * 3, width, r, g, b);
+        LogLuminancePlanar(r, g, b, width, exposure, kMinLuminance, I(y));
+    }
+
+    /* ----------------------------
+       Coefficients: box means of I and I²
+       ---------------------------- */
+    std::fill(buf.sum0.begin(), buf.sum0.end(), 0.0f);
+    std::fill(buf.sum1.begin(), buf.sum1.end(), 0.0f);
+    for (int y = std::max(0, cy0 - radius); y < std::min(height, cy0 + radius); y++)
+        SlideColumnSums(buf.sum0.data(), buf.sum1.data(), I(y), nullptr, width);
+
+    for (int y = cy0; y < cy1; y++)
+    {
+        // The first row's window is already summed but for its last row
+        int enter = y + radius;
+        int leave = y - radius - 1;
+        SlideColumnSums(buf.sum0.data(), buf.sum1.data(), enter < height ? I(enter) : nullptr,
+            y > cy0 && leave >= 0 ? I(leave) : nullptr, width);
+
+        BoxRows(buf.sum0.data(), buf.sum1.data(), width, radius, columnScale, 1.0f / rowsIn(y),
+            buf.mean0.data(), buf.mean1.data());
+        GuidedCoefficients(buf.mean0.data(), buf.mean1.data(), width, settings.edge, A(y), B(y));
+    }
+
+    /* ----------------------------
+       Output: box means of a and b
+       ---------------------------- */
+    std::fill(buf.sum0.begin(), buf.sum0.end(), 0.0f);
+    std::fill(buf.sum1.begin(), buf.sum1.end(), 0.0f);
+    for (int y = std::max(0, y0 - radius); y < std::min(height, y0 + radius); y++)
+    {
+        SlideColumnSums(buf.sum0.data(), nullptr, A(y), nullptr, width);
+        SlideColumnSums(buf.sum1.data(), nullptr, B(y), nullptr, width);
+    }
+
+    for (int y = y0; y < y1; y++)
+    {
+        int enter = y + radius;
+        int leave = y - radius - 1;
+        bool leaves = y > y0 && leave >= 0;
+        SlideColumnSums(buf.sum0.data(), nullptr, enter < height ? A(enter) : nullptr, leaves ? A(leave) : nullptr, width);
+        SlideColumnSums(buf.sum1.data(), nullptr, enter < height ? B(enter) : nullptr, leaves ? B(leave) : nullptr, width);
+
+        BoxRows(buf.sum0.data(), buf.sum1.data(), width, radius, columnScale, 1.0f / rowsIn(y),
+            buf.mean0.data(), buf.mean1.data());
+
+        DeinterleaveRGB(linearRGB + (size_t)y * width * 3, width, r, g, b);
+        LocalToneMapPlanar(r, g, b, width, exposure, whitePoint, I(y), buf.mean0.data(), buf.mean1.data(),
+            anchor, settings.compression, settings.detail, grade, lut.get());
+        StoreBGRA8(r, g, b, width, outputBGRA + (size_t)y * width * 4, stream, nullptr, DitherAt(0, y));
+    }
+}
+
+/* ============================================================
+   Procedure: ToneMapLocalCPU
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image with the local operator on
+   the CPU (see the file description and SetLocalToneParams).
+   Bands run in parallel on the thread pool; each needs a few
+   of its own rows of scratch per radius, so memory does not
+   grow with the image beyond the output. Quality counters are
+   not gathered.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point of the final Extended Reinhard
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapLocalCPU(
+    float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint)
+{
+    if (!linearRGB || !outputBGRA || width <= 0 || height <= 0)
+        return;
+
+    TuneEnsureLoaded();
+
+    LocalToneSettings settings = GetLocalToneSettings();
+    int radius = settings.radius;
+
+    std::vector<float> columnScale(width);
+    for (int x = 0; x < width; x++)
+        columnScale[x] = 1.0f / (std::min(width - 1, x + radius) - std::max(0, x - radius) + 1);
+
+    long long threshold = GetKernelConfig().streamThreshold;
+    bool stream = threshold > 0 && (long long)width * height * 4 >= threshold;
+
+    int bandRows = std::max(kMinBandRows, 4 * radius);
+    int bands = (height + bandRows - 1) / bandRows;
+
+    ThreadPool::Instance().ParallelFor(bands, [&](int band)
+    {
+        BandBuffers buffers;
+        int y0 = band * bandRows;
+        int y1 = std::min(height, y0 + bandRows);
+        RenderBand(linearRGB, width, height, outputBGRA, exposure, whitePoint, settings, columnScale.data(),
+            stream, y0, y1, buffers);
+    });
+}
+
+/* ============================================================
+   Procedure: ToneMapLocalGL
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image with the local operator on
+   the GPU and reads back the result in the requested output
+   format. The guided filter runs as separable box passes
+   before the tone mapping pass. Quality counters are not
+   gathered.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   format      - HDROutputFormat of the output buffer
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point of the final Extended Reinhard
+
+   Output parameters:
+   output      - Pointer to a tightly packed output buffer of
+                 width * height * GetOutputBytesPerPixel(format)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapLocalGL(
+    float* linearRGB,
+    int width,
+    int height,
+    void* output,
+    int format,
+    float exposure,
+    float whitePoint)
+{
+    GLToneMapParams params;
+    params.format = format;
+    params.exposure = exposure;
+    params.whitePoint = whitePoint;
+    params.op = HDR_OPERATOR_LOCAL;
+
+    GLThreadRun([&]
+    {
+        RenderToneMap(linearRGB, width, height, output, params);
+    });
+}
+
+/* ============================================================
+   Procedure: SetLocalToneParams
+   ------------------------------------------------------------
+   Description:
+   Sets the local operator used by following renders. Cached
+   renders made with other settings are dropped.
+
+   Input parameters:
+   radius      - Filter radius in pixels (1 .. 256): the size of
+                 the regions whose contrast is compressed
+   edge        - Edge threshold as a log2 luminance variance
+                 (> 0): steps well above sqrt(edge) stops are
+                 kept in the base, smaller ones count as detail
+   compression - Base layer scale (> 0; below 1 compresses the
+                 range between regions)
+   detail      - Detail layer scale (>= 0; above 1 enhances it)
+   ============================================================ */
+extern "C" __declspec(dllexport) void SetLocalToneParams(int radius, float edge, float compression, float detail)
+{
+    radius = std::clamp(radius, 1, kMaxRadius);
+    edge = std::max(edge, 1.0e-6f);
+    compression = std::max(compression, 0.01f);
+    detail = std::max(detail, 0.0f);
+
+    bool changed = gRadius.exchange(radius) != radius;
+    changed |= gEdge.exchange(edge) != edge;
+    changed |= gCompression.exchange(compression) != compression;
+    changed |= gDetail.exchange(detail) != detail;
+    if (!changed)
+        return;
+
+    SpeculateCancel();
+    RenderCacheClear();
+}
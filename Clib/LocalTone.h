@@ -0,0 +1,20 @@
+#ifndef LOCAL_TONE_H
+#define LOCAL_TONE_H
+
+// Settings of the local (guided filter) operator (SetLocalToneParams)
+struct LocalToneSettings
+{
+	// Box radius of the guided filter in pixels
+	int radius;
+	// Edge threshold: log2 luminance variance kept as an edge
+	float edge;
+	// Scale of the base layer around middle grey
+	float compression;
+	// Scale of the detail layer
+	float detail;
+};
+
+// Current settings of the local operator
+LocalToneSettings GetLocalToneSettings();
+
+#endif
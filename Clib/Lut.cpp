@@ -0,0 +1,297 @@
+// ============================================================
+// File: Lut.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// .cube LUTs (Adobe / Resolve text format) as an output
+// transform. The LUT takes the gamma encoded output values, as
+// a separate pass over 8-bit output would, but is applied by
+// the tone mapping kernels in their own loop (and by a variant
+// of the GL shader), so it costs no pass and no rounding to 8
+// bits in between. A 65³ LUT is about 800K numbers of text;
+// parsed tables are kept by the hash of their file's bytes, so
+// loading the same file again, for every job of a batch say,
+// only reads and hashes it.
+// ============================================================
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "HDR.h"
+#include "Hash.h"
+#include "Lut.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Largest table sizes the format allows
+static const int kMax1DSize = 65536;
+static const int kMax3DSize = 256;
+
+// Parsed LUTs kept; the cache is emptied when it is full
+static const size_t kMaxCached = 16;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gLut
+ * LUT of following renders (LoadCubeLut), guarded by gLutMutex.
+ * Range: nullptr (none) or a parsed LUT
+ */
+static std::shared_ptr<const CubeLut> gLut;
+
+/*
+ * gParsed
+ * Parsed LUTs by file content hash, guarded by gLutMutex.
+ * Range: at most kMaxCached entries
+ */
+static std::unordered_map<uint64_t, std::shared_ptr<const CubeLut>> gParsed;
+static std::mutex gLutMutex;
+
+/* ============================================================
+   Procedure: ReadFile
+   ------------------------------------------------------------
+   Description:
+   Reads a whole file; false if it cannot be read.
+   ============================================================ */
+static bool ReadFile(const char* path, std::vector<char>& data)
+{
+    FILE* file = std::fopen(path, "rb");
+    if (!file)
+        return false;
+
+    data.clear();
+    char buffer[65536];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + read);
+
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+/* ============================================================
+   Procedure: ParseFloats
+   ------------------------------------------------------------
+   Description:
+   Reads count numbers separated by blanks from [p, end);
+   false unless exactly that many are there. from_chars does
+   not depend on the locale, unlike strtof.
+   ============================================================ */
+static bool ParseFloats(const char* p, const char* end, float* values, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+
+        std::from_chars_result result = std::from_chars(p, end, values[k]);
+        if (result.ec != std::errc())
+            return false;
+        p = result.ptr;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p == end;
+}
+
+/* ============================================================
+   Procedure: ParseCube
+   ------------------------------------------------------------
+   Description:
+   Parses the text of a .cube file: keywords first, then one
+   RGB triple per line, the shaper's entries before the
+   lattice's when the file has both (Resolve). DOMAIN_MIN /
+   DOMAIN_MAX give the input range of the first table,
+   LUT_1D_INPUT_RANGE / LUT_3D_INPUT_RANGE that of either;
+   unknown keywords and TITLE are skipped.
+
+   Output parameters:
+   lut - Parsed tables
+   Returns false on malformed text or a wrong entry count.
+   ============================================================ */
+static bool ParseCube(const std::vector<char>& text, CubeLut& lut)
+{
+    float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+    float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+    bool domain = false;
+    std::vector<float> values;
+
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end)
+    {
+        const char* eol = (const char*)std::memchr(p, '\n', end - p);
+        const char* next = eol ? eol + 1 : end;
+        const char* line = p;
+        const char* lineEnd = eol ? eol : end;
+        p = next;
+
+        while (line < lineEnd && (*line == ' ' || *line == '\t'))
+            line++;
+        while (lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+            lineEnd--;
+        if (line == lineEnd || *line == '#')
+            continue;
+
+        /* ----------------------------
+           Table entries
+           ---------------------------- */
+        if (!std::isalpha((unsigned char)*line))
+        {
+            float rgb[3];
+            if (!ParseFloats(line, lineEnd, rgb, 3))
+                return false;
+            values.insert(values.end(), rgb, rgb + 3);
+            continue;
+        }
+
+        // Keywords come before the entries
+        if (!values.empty())
+            return false;
+
+        /* ----------------------------
+           Keywords
+           ---------------------------- */
+        const char* word = line;
+        while (line < lineEnd && *line != ' ' && *line != '\t')
+            line++;
+        std::string key(word, line);
+
+        if (key == "LUT_1D_SIZE" || key == "LUT_3D_SIZE")
+        {
+            float size;
+            if (!ParseFloats(line, lineEnd, &size, 1))
+                return false;
+            int limit = key == "LUT_1D_SIZE" ? kMax1DSize : kMax3DSize;
+            if (size < 2.0f || size > (float)limit || size != (int)size)
+                return false;
+            (key == "LUT_1D_SIZE" ? lut.size1D : lut.size3D) = (int)size;
+        }
+        else if (key == "DOMAIN_MIN" || key == "DOMAIN_MAX")
+        {
+            if (!ParseFloats(line, lineEnd, key == "DOMAIN_MIN" ? domainMin : domainMax, 3))
+                return false;
+            domain = true;
+        }
+        else if (key == "LUT_1D_INPUT_RANGE" || key == "LUT_3D_INPUT_RANGE")
+        {
+            float range[2];
+            if (!ParseFloats(line, lineEnd, range, 2))
+                return false;
+            bool shaper = key == "LUT_1D_INPUT_RANGE";
+            std::fill_n(shaper ? lut.min1D : lut.min3D, 3, range[0]);
+            std::fill_n(shaper ? lut.max1D : lut.max3D, 3, range[1]);
+        }
+    }
+
+    /* ----------------------------
+       Split and check the entries
+       ---------------------------- */
+    size_t count1D = (size_t)lut.size1D * 3;
+    size_t count3D = (size_t)lut.size3D * lut.size3D * lut.size3D * 3;
+    if ((lut.size1D == 0 && lut.size3D == 0) || values.size() != count1D + count3D)
+        return false;
+
+    lut.table1D.assign(values.begin(), values.begin() + count1D);
+    lut.table3D.assign(values.begin() + count1D, values.end());
+
+    if (domain)
+    {
+        std::copy_n(domainMin, 3, lut.size1D ? lut.min1D : lut.min3D);
+        std::copy_n(domainMax, 3, lut.size1D ? lut.max1D : lut.max3D);
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        if (!(lut.max1D[c] > lut.min1D[c]) || !(lut.max3D[c] > lut.min3D[c]))
+            return false;
+    }
+    return true;
+}
+
+/* ============================================================
+   Procedure: GetCubeLut
+   ============================================================ */
+std::shared_ptr<const CubeLut> GetCubeLut()
+{
+    std::lock_guard<std::mutex> lock(gLutMutex);
+    return gLut;
+}
+
+/* ============================================================
+   Procedure: LoadCubeLut
+   ------------------------------------------------------------
+   Description:
+   Sets the .cube LUT applied to the output of following CPU,
+   split and GL renders, with every operator (after CLAHE's
+   curves, after the color grade). Its input is the gamma
+   encoded output value in [0, 1]; its result is written as it
+   is to 8-bit formats and decoded again for linear ones. 1D,
+   3D and shaper + 3D files are read; a file already parsed
+   (the same bytes) is not parsed again. Cached renders and
+   tiles made without this LUT are dropped.
+
+   Input parameters:
+   path - .cube file, or nullptr / "" for no LUT
+
+   Output parameters:
+   Returns false if the file cannot be read or parsed; the
+   LUT set before stays in place then.
+   ============================================================ */
+extern "C" __declspec(dllexport) bool LoadCubeLut(const char* path)
+{
+    std::shared_ptr<const CubeLut> lut;
+
+    if (path && *path)
+    {
+        std::vector<char> text;
+        if (!ReadFile(path, text))
+            return false;
+
+        uint64_t hash = HashBytes(text.data(), text.size());
+        {
+            std::lock_guard<std::mutex> lock(gLutMutex);
+            auto it = gParsed.find(hash);
+            if (it != gParsed.end())
+                lut = it->second;
+        }
+
+        if (!lut)
+        {
+            auto parsed = std::make_shared<CubeLut>();
+            if (!ParseCube(text, *parsed))
+                return false;
+            lut = parsed;
+
+            std::lock_guard<std::mutex> lock(gLutMutex);
+            if (gParsed.size() >= kMaxCached)
+                gParsed.clear();
+            gParsed[hash] = lut;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gLutMutex);
+        if (lut == gLut)
+            return true;
+        gLut = lut;
+    }
+
+    SpeculateCancel();
+    RenderCacheClear();
+    TileCacheClear();
+    return true;
+}
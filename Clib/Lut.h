@@ -0,0 +1,11 @@
+#ifndef LUT_H
+#define LUT_H
+
+#include <memory>
+#include "Kernels.h"
+
+// Current output LUT (LoadCubeLut); nullptr while none is set. Read
+// once per render and passed to the kernels.
+std::shared_ptr<const CubeLut> GetCubeLut();
+
+#endif
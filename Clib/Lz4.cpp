@@ -0,0 +1,274 @@
+// ============================================================
+// File: Lz4.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// LZ4 block compression for the in-memory image store. A block
+// is a run of sequences: a token (literal count, match length),
+// the literals, a 16-bit match offset and the match length
+// extension; the last sequence carries literals only. The
+// compressor finds matches through one hash table of 4-byte
+// prefixes and skips ahead faster the longer it finds none, so
+// incompressible data costs little.
+// ============================================================
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Lz4.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Shortest match, and the end margins the format requires: the
+// last 5 bytes are literals, the last match starts 12 bytes
+// before the end
+static const size_t kMinMatch = 4;
+static const size_t kLastLiterals = 5;
+static const size_t kMatchLimit = 12;
+
+static const size_t kMaxOffset = 65535;
+
+// Hash table size (log2)
+static const int kHashLog = 12;
+
+/* ============================================================
+   Procedure: Read32 / Hash4
+   ============================================================ */
+static inline uint32_t Read32(const unsigned char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Hash4(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kHashLog);
+}
+
+/* ============================================================
+   Procedure: WriteLength
+   ------------------------------------------------------------
+   Description:
+   Writes the extension of a length whose token nibble is 15:
+   bytes of 255 followed by the remainder.
+   ============================================================ */
+static inline unsigned char* WriteLength(unsigned char* op, size_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+/* ============================================================
+   Procedure: Lz4Bound
+   ============================================================ */
+size_t Lz4Bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/* ============================================================
+   Procedure: Lz4Compress
+   ------------------------------------------------------------
+   Description:
+   Compresses one block.
+
+   Input parameters:
+   src, size - Data to compress
+   capacity  - Size of dst (Lz4Bound(size) always suffices)
+
+   Output parameters:
+   dst       - Compressed block
+   Returns the compressed size, or 0 if dst is too small.
+   ============================================================ */
+size_t Lz4Compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity)
+{
+    if (capacity < Lz4Bound(size))
+        return 0;
+
+    thread_local std::vector<uint32_t> table;
+    table.assign((size_t)1 << kHashLog, 0);
+
+    unsigned char* op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    // Blocks too short to hold a match are literals only
+    size_t matchEnd = size > kMatchLimit ? size - kMatchLimit : 0;
+
+    while (ip < matchEnd)
+    {
+        /* ----------------------------
+           Find a match
+           ---------------------------- */
+        uint32_t sequence = Read32(src + ip);
+        uint32_t h = Hash4(sequence);
+        size_t ref = table[h];
+        table[h] = (uint32_t)ip;
+
+        if (ip - ref > kMaxOffset || ref >= ip || Read32(src + ref) != sequence)
+        {
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+
+        // Extend backwards over pending literals, then forwards
+        while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+        {
+            ip--;
+            ref--;
+        }
+
+        size_t length = kMinMatch;
+        size_t limit = size - kLastLiterals;
+        while (ip + length < limit && src[ref + length] == src[ip + length])
+            length++;
+
+        /* ----------------------------
+           Emit the sequence
+           ---------------------------- */
+        size_t literals = ip - anchor;
+        size_t extra = length - kMinMatch;
+        unsigned char* token = op++;
+
+        *token = (unsigned char)((literals < 15 ? literals : 15) << 4 | (extra < 15 ? extra : 15));
+        if (literals >= 15)
+            op = WriteLength(op, literals - 15);
+        std::memcpy(op, src + anchor, literals);
+        op += literals;
+
+        size_t offset = ip - ref;
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        if (extra >= 15)
+            op = WriteLength(op, extra - 15);
+
+        ip += length;
+        anchor = ip;
+
+        // Index a position inside the match for the next search
+        if (ip - 2 < matchEnd)
+            table[Hash4(Read32(src + ip - 2))] = (uint32_t)(ip - 2);
+    }
+
+    /* ----------------------------
+       Last literals
+       ---------------------------- */
+    size_t literals = size - anchor;
+    *op++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+        op = WriteLength(op, literals - 15);
+    std::memcpy(op, src + anchor, literals);
+    op += literals;
+
+    return (size_t)(op - dst);
+}
+
+/* ============================================================
+   Procedure: Lz4Decompress
+   ------------------------------------------------------------
+   Description:
+   Decompresses one block, checking every length and offset
+   against both buffers.
+
+   Input parameters:
+   src, size - Compressed block
+   capacity  - Size of dst
+
+   Output parameters:
+   dst       - Decompressed data
+   Returns the decompressed size, or -1 on a malformed block.
+   ============================================================ */
+long long Lz4Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity)
+{
+    const unsigned char* ip = src;
+    const unsigned char* end = src + size;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + capacity;
+
+    while (ip < end)
+    {
+        unsigned token = *ip++;
+
+        // Literals
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= end)
+                    return -1;
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+
+        if ((size_t)(end - ip) < literals || (size_t)(oend - op) < literals)
+            return -1;
+        std::memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence has no match
+        if (ip == end)
+            break;
+
+        // Match
+        if (end - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return -1;
+
+        size_t length = token & 15;
+        if (length == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= end)
+                    return -1;
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+        length += kMinMatch;
+
+        if ((size_t)(oend - op) < length)
+            return -1;
+
+        const unsigned char* match = op - offset;
+        if (offset >= length)
+        {
+            std::memcpy(op, match, length);
+            op += length;
+        }
+        else
+        {
+            // Overlapping match: the output repeats with period
+            // offset, so whole periods can be copied from its start,
+            // twice as many each time
+            size_t done = 0;
+            while (done < length)
+            {
+                size_t chunk = std::min(length - done, (size_t)(op - match));
+                std::memcpy(op, match, chunk);
+                op += chunk;
+                done += chunk;
+            }
+        }
+    }
+
+    return (long long)(op - dst);
+}
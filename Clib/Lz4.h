@@ -0,0 +1,21 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+
+// LZ4 block format (no frame header), readable by the reference
+// decoder. The compressor is the simple greedy variant: one hash
+// table, no match search chains.
+
+// Worst-case compressed size of size input bytes.
+size_t Lz4Bound(size_t size);
+
+// Compresses src into dst; returns the compressed size, or 0 if it
+// does not fit in capacity.
+size_t Lz4Compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity);
+
+// Decompresses a block; returns the decompressed size, or -1 if the
+// block is malformed or would overflow capacity.
+long long Lz4Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity);
+
+#endif
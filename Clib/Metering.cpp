@@ -0,0 +1,548 @@
+// ============================================================
+// File: Metering.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Camera-style metering modes. Creating a luminance pyramid
+// reads the image once: the base level holds the mean log2
+// luminance of blocks of pixels (at most 512 on the longer
+// side), each level above halves it, down to one cell. Metering
+// then works on the pyramid only - the zones and weights of a
+// mode on a level of at most 64 x 64 cells, a spot on the
+// coarsest level that still resolves it - so switching modes or
+// moving the spot costs microseconds, not a pass over the image.
+// ============================================================
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "HDR.h"
+#include "Exposure.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Longest side of the pyramid base in cells
+static const int kBaseSize = 512;
+
+// Longest side of the level zone and centre metering work on
+static const int kMeterSize = 64;
+
+// Matrix zones per side and their weights (centre first)
+static const int kZones = 5;
+static const float kZoneWeights[kZones][kZones] =
+{
+    { 1, 1, 1, 1, 1 },
+    { 1, 2, 2, 2, 1 },
+    { 1, 2, 4, 2, 1 },
+    { 1, 2, 2, 2, 1 },
+    { 1, 1, 1, 1, 1 }
+};
+
+// Zones this many stops above / below the median zone (sky, deep
+// shadow) and the factor their weight is multiplied by
+static const float kBrightZoneStops = 2.0f;
+static const float kBrightZoneFactor = 0.25f;
+static const float kDarkZoneStops = 3.0f;
+static const float kDarkZoneFactor = 0.5f;
+
+// Rank of the highlight luminance among the base cells
+static const float kHighlightRank = 0.99f;
+
+// Default spot radius and centre weighting sigma, as fractions of
+// the longer image side
+static const float kSpotRadius = 0.025f;
+static const float kCentreSigma = 0.25f;
+
+// Spot radius in cells of the level the spot is metered on
+static const float kSpotCells = 3.0f;
+
+/* ============================================================
+   LuminancePyramid
+   ------------------------------------------------------------
+   Mean log2 luminance per cell of each level, base first, and
+   the finite pixels behind each cell (cells of only non-finite
+   pixels have weight 0). Immutable once built.
+   ============================================================ */
+struct PyramidLevel
+{
+    int width = 0;
+    int height = 0;
+    std::vector<float> logMean;
+    std::vector<float> weight;
+};
+
+struct LuminancePyramid
+{
+    int width = 0;
+    int height = 0;
+    std::vector<PyramidLevel> levels;
+    float highlightLog = 0.0f;
+};
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gPyramidMutex
+ * Protects gPyramids and gNextPyramid.
+ */
+static std::mutex gPyramidMutex;
+
+/*
+ * gPyramids
+ * Created luminance pyramids by id.
+ */
+static std::unordered_map<int, std::shared_ptr<const LuminancePyramid>> gPyramids;
+
+/*
+ * gNextPyramid
+ * Id of the next created pyramid.
+ * Range: > 0
+ */
+static int gNextPyramid = 1;
+
+/* ============================================================
+   Procedure: BuildBase
+   ------------------------------------------------------------
+   Description:
+   Base level: the image in blocks of block x block pixels
+   (edge blocks clipped), each cell the mean log2 luminance of
+   its finite pixels. Rows of cells are built in parallel.
+   ============================================================ */
+static PyramidLevel BuildBase(const float* linearRGB, int width, int height, int block)
+{
+    PyramidLevel base;
+    base.width = (width + block - 1) / block;
+    base.height = (height + block - 1) / block;
+    base.logMean.assign((size_t)base.width * base.height, 0.0f);
+    base.weight.assign((size_t)base.width * base.height, 0.0f);
+
+    ThreadPool::Instance().ParallelFor(base.height, [&](int cy)
+    {
+        std::vector<double> sums(base.width, 0.0);
+        std::vector<long long> counts(base.width, 0);
+
+        int y1 = std::min(height, (cy + 1) * block);
+        for (int y = cy * block; y < y1; y++)
+        {
+            const float* row = linearRGB + (size_t)y * width * 3;
+            for (int cx = 0; cx < base.width; cx++)
+            {
+                int x1 = std::min(width, (cx + 1) * block);
+                double sum = 0.0;
+                long long count = 0;
+
+                for (int x = cx * block; x < x1; x++)
+                {
+                    float logLum;
+                    if (LogLuminance(row + (size_t)x * 3, logLum))
+                    {
+                        sum += logLum;
+                        count++;
+                    }
+                }
+
+                sums[cx] += sum;
+                counts[cx] += count;
+            }
+        }
+
+        size_t offset = (size_t)cy * base.width;
+        for (int cx = 0; cx < base.width; cx++)
+        {
+            if (counts[cx] > 0)
+                base.logMean[offset + cx] = (float)(sums[cx] / counts[cx]);
+            base.weight[offset + cx] = (float)counts[cx];
+        }
+    });
+
+    return base;
+}
+
+/* ============================================================
+   Procedure: Downsample
+   ------------------------------------------------------------
+   Description:
+   Next level: each cell the weighted mean of (up to) 2 x 2
+   cells of the level below.
+   ============================================================ */
+static PyramidLevel Downsample(const PyramidLevel& fine)
+{
+    PyramidLevel coarse;
+    coarse.width = (fine.width + 1) / 2;
+    coarse.height = (fine.height + 1) / 2;
+    coarse.logMean.assign((size_t)coarse.width * coarse.height, 0.0f);
+    coarse.weight.assign((size_t)coarse.width * coarse.height, 0.0f);
+
+    for (int cy = 0; cy < coarse.height; cy++)
+    {
+        for (int cx = 0; cx < coarse.width; cx++)
+        {
+            double sum = 0.0;
+            double weight = 0.0;
+
+            for (int y = cy * 2; y < std::min(fine.height, cy * 2 + 2); y++)
+            {
+                for (int x = cx * 2; x < std::min(fine.width, cx * 2 + 2); x++)
+                {
+                    size_t i = (size_t)y * fine.width + x;
+                    sum += (double)fine.logMean[i] * fine.weight[i];
+                    weight += fine.weight[i];
+                }
+            }
+
+            size_t o = (size_t)cy * coarse.width + cx;
+            if (weight > 0.0)
+                coarse.logMean[o] = (float)(sum / weight);
+            coarse.weight[o] = (float)weight;
+        }
+    }
+
+    return coarse;
+}
+
+/* ============================================================
+   Procedure: HighlightLog
+   ------------------------------------------------------------
+   Description:
+   log2 luminance below which kHighlightRank of the finite
+   pixels lie, at base cell resolution.
+   ============================================================ */
+static float HighlightLog(const PyramidLevel& base)
+{
+    std::vector<std::pair<float, float>> cells;
+    double total = 0.0;
+    for (size_t i = 0; i < base.logMean.size(); i++)
+    {
+        if (base.weight[i] > 0.0f)
+        {
+            cells.emplace_back(base.logMean[i], base.weight[i]);
+            total += base.weight[i];
+        }
+    }
+
+    std::sort(cells.begin(), cells.end());
+
+    double seen = 0.0;
+    for (const auto& cell : cells)
+    {
+        seen += cell.second;
+        if (seen >= kHighlightRank * total)
+            return cell.first;
+    }
+    return cells.empty() ? 0.0f : cells.back().first;
+}
+
+/* ============================================================
+   Procedure: MeterLevel
+   ------------------------------------------------------------
+   Description:
+   Finest level of the pyramid with at most size cells on its
+   longer side.
+   ============================================================ */
+static const PyramidLevel& MeterLevel(const LuminancePyramid& pyramid, int size)
+{
+    for (const PyramidLevel& level : pyramid.levels)
+    {
+        if (std::max(level.width, level.height) <= size)
+            return level;
+    }
+    return pyramid.levels.back();
+}
+
+/* ============================================================
+   Procedure: MeterMatrix
+   ------------------------------------------------------------
+   Description:
+   Mean log2 luminance of kZones x kZones zones, weighted by
+   kZoneWeights, with zones far from the median zone weighted
+   down so a bright sky or a deep shadow does not pull the
+   exposure.
+   ============================================================ */
+static bool MeterMatrix(const LuminancePyramid& pyramid, float& logLum)
+{
+    const PyramidLevel& level = MeterLevel(pyramid, kMeterSize);
+
+    double sums[kZones][kZones] = {};
+    double weights[kZones][kZones] = {};
+    for (int cy = 0; cy < level.height; cy++)
+    {
+        int zy = std::min(kZones - 1, cy * kZones / level.height);
+        for (int cx = 0; cx < level.width; cx++)
+        {
+            int zx = std::min(kZones - 1, cx * kZones / level.width);
+            size_t i = (size_t)cy * level.width + cx;
+            sums[zy][zx] += (double)level.logMean[i] * level.weight[i];
+            weights[zy][zx] += level.weight[i];
+        }
+    }
+
+    float zoneLog[kZones][kZones] = {};
+    std::vector<float> sorted;
+    for (int zy = 0; zy < kZones; zy++)
+    {
+        for (int zx = 0; zx < kZones; zx++)
+        {
+            if (weights[zy][zx] > 0.0)
+            {
+                zoneLog[zy][zx] = (float)(sums[zy][zx] / weights[zy][zx]);
+                sorted.push_back(zoneLog[zy][zx]);
+            }
+        }
+    }
+
+    if (sorted.empty())
+        return false;
+
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    float median = sorted[sorted.size() / 2];
+
+    double sum = 0.0;
+    double total = 0.0;
+    for (int zy = 0; zy < kZones; zy++)
+    {
+        for (int zx = 0; zx < kZones; zx++)
+        {
+            if (weights[zy][zx] <= 0.0)
+                continue;
+
+            float w = kZoneWeights[zy][zx];
+            if (zoneLog[zy][zx] > median + kBrightZoneStops)
+                w *= kBrightZoneFactor;
+            else if (zoneLog[zy][zx] < median - kDarkZoneStops)
+                w *= kDarkZoneFactor;
+
+            sum += (double)zoneLog[zy][zx] * w;
+            total += w;
+        }
+    }
+
+    logLum = (float)(sum / total);
+    return true;
+}
+
+/* ============================================================
+   Procedure: MeterCentre
+   ------------------------------------------------------------
+   Description:
+   Mean log2 luminance weighted by a Gaussian of sigma pixels
+   around (px, py).
+   ============================================================ */
+static bool MeterCentre(const LuminancePyramid& pyramid, float px, float py, float sigma, float& logLum)
+{
+    const PyramidLevel& level = MeterLevel(pyramid, kMeterSize);
+    float cellW = (float)pyramid.width / level.width;
+    float cellH = (float)pyramid.height / level.height;
+    float scale = -0.5f / (sigma * sigma);
+
+    double sum = 0.0;
+    double total = 0.0;
+    for (int cy = 0; cy < level.height; cy++)
+    {
+        float dy = (cy + 0.5f) * cellH - py;
+        for (int cx = 0; cx < level.width; cx++)
+        {
+            float dx = (cx + 0.5f) * cellW - px;
+            size_t i = (size_t)cy * level.width + cx;
+            double w = std::exp((dx * dx + dy * dy) * scale) * level.weight[i];
+
+            sum += level.logMean[i] * w;
+            total += w;
+        }
+    }
+
+    if (total <= 0.0)
+        return false;
+
+    logLum = (float)(sum / total);
+    return true;
+}
+
+/* ============================================================
+   Procedure: MeterSpot
+   ------------------------------------------------------------
+   Description:
+   Mean log2 luminance of the cells whose centres lie within
+   radius pixels of (px, py), on the coarsest level where the
+   radius still spans kSpotCells cells. A spot smaller than one
+   base cell meters the cell under it.
+   ============================================================ */
+static bool MeterSpot(const LuminancePyramid& pyramid, float px, float py, float radius, float& logLum)
+{
+    const PyramidLevel* level = &pyramid.levels[0];
+    for (const PyramidLevel& candidate : pyramid.levels)
+    {
+        float cell = std::max((float)pyramid.width / candidate.width, (float)pyramid.height / candidate.height);
+        if (radius < kSpotCells * cell)
+            break;
+        level = &candidate;
+    }
+
+    float cellW = (float)pyramid.width / level->width;
+    float cellH = (float)pyramid.height / level->height;
+    int x0 = std::max(0, (int)((px - radius) / cellW));
+    int x1 = std::min(level->width - 1, (int)((px + radius) / cellW));
+    int y0 = std::max(0, (int)((py - radius) / cellH));
+    int y1 = std::min(level->height - 1, (int)((py + radius) / cellH));
+
+    double sum = 0.0;
+    double total = 0.0;
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        float dy = (cy + 0.5f) * cellH - py;
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            float dx = (cx + 0.5f) * cellW - px;
+            if (dx * dx + dy * dy > radius * radius)
+                continue;
+
+            size_t i = (size_t)cy * level->width + cx;
+            sum += (double)level->logMean[i] * level->weight[i];
+            total += level->weight[i];
+        }
+    }
+
+    if (total <= 0.0)
+    {
+        int cx = std::clamp((int)(px / cellW), 0, level->width - 1);
+        int cy = std::clamp((int)(py / cellH), 0, level->height - 1);
+        size_t i = (size_t)cy * level->width + cx;
+        if (level->weight[i] <= 0.0f)
+            return false;
+
+        logLum = level->logMean[i];
+        return true;
+    }
+
+    logLum = (float)(sum / total);
+    return true;
+}
+
+/* ============================================================
+   Procedure: LuminancePyramidCreate
+   ------------------------------------------------------------
+   Description:
+   Builds the luminance pyramid of an image for MeterExposure.
+   This is the only step that reads the image.
+
+   Input parameters:
+   linearRGB  - Linear RGB float data (RGBRGB...)
+   width      - Image width in pixels (> 0)
+   height     - Image height in pixels (> 0)
+
+   Output parameters:
+   Returns the pyramid id (> 0), or 0 on invalid arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int LuminancePyramidCreate(const float* linearRGB, int width, int height)
+{
+    if (!linearRGB || width <= 0 || height <= 0)
+        return 0;
+
+    auto pyramid = std::make_shared<LuminancePyramid>();
+    pyramid->width = width;
+    pyramid->height = height;
+
+    int block = (std::max(width, height) + kBaseSize - 1) / kBaseSize;
+    pyramid->levels.push_back(BuildBase(linearRGB, width, height, block));
+    while (pyramid->levels.back().width > 1 || pyramid->levels.back().height > 1)
+        pyramid->levels.push_back(Downsample(pyramid->levels.back()));
+
+    pyramid->highlightLog = HighlightLog(pyramid->levels[0]);
+
+    std::lock_guard<std::mutex> lock(gPyramidMutex);
+    int id = gNextPyramid++;
+    gPyramids[id] = pyramid;
+    return id;
+}
+
+/* ============================================================
+   Procedure: LuminancePyramidRelease
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void LuminancePyramidRelease(int pyramid)
+{
+    std::lock_guard<std::mutex> lock(gPyramidMutex);
+    gPyramids.erase(pyramid);
+}
+
+/* ============================================================
+   Procedure: MeterExposure
+   ------------------------------------------------------------
+   Description:
+   Meters an image from its luminance pyramid. The exposure
+   puts the metered luminance on middle grey; in highlight
+   priority it is lowered further if the highlights would
+   otherwise go past the white point.
+
+   Input parameters:
+   pyramid    - Id from LuminancePyramidCreate
+   mode       - HDRMeteringMode value
+   x, y       - Centre of the spot / centre weighting, as
+                fractions of the image width and height
+   radius     - Spot radius / centre weighting sigma as a fraction
+                of the longer image side; <= 0 for the default
+   whitePoint - White point the image will be tone mapped with
+                (highlight priority)
+
+   Output parameters:
+   result     - Metered luminance, highlight and exposure
+   Returns false for invalid arguments or when the metered area
+   holds no finite pixel.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool MeterExposure(int pyramid, int mode, float x, float y, float radius, float whitePoint,
+    HDRMeterResult* result)
+{
+    if (!result || mode < HDR_METER_MATRIX || mode > HDR_METER_HIGHLIGHT)
+        return false;
+
+    std::shared_ptr<const LuminancePyramid> p;
+    {
+        std::lock_guard<std::mutex> lock(gPyramidMutex);
+        auto it = gPyramids.find(pyramid);
+        if (it == gPyramids.end())
+            return false;
+        p = it->second;
+    }
+
+    float side = (float)std::max(p->width, p->height);
+    float px = std::clamp(x, 0.0f, 1.0f) * p->width;
+    float py = std::clamp(y, 0.0f, 1.0f) * p->height;
+
+    float logLum = 0.0f;
+    bool metered = false;
+    switch (mode)
+    {
+    case HDR_METER_CENTRE:
+        metered = MeterCentre(*p, px, py, (radius > 0.0f ? radius : kCentreSigma) * side, logLum);
+        break;
+    case HDR_METER_SPOT:
+        metered = MeterSpot(*p, px, py, (radius > 0.0f ? radius : kSpotRadius) * side, logLum);
+        break;
+    default:
+        metered = MeterMatrix(*p, logLum);
+        break;
+    }
+
+    if (!metered)
+        return false;
+
+    result->luminance = std::exp2(logLum);
+    result->highlight = std::exp2(p->highlightLog);
+    result->exposure = kExposureKey / result->luminance;
+
+    if (mode == HDR_METER_HIGHLIGHT && whitePoint > 0.0f)
+        result->exposure = std::min(result->exposure, whitePoint / result->highlight);
+
+    return true;
+}
@@ -0,0 +1,514 @@
+// ============================================================
+// File: Png.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Minimal PNG encoder for exported tiles. Each row gets the PNG
+// filter with the smallest sum of residuals, and the filtered
+// rows are compressed by a small deflate encoder: greedy LZ77
+// matching over a hash chain, written as one block with the
+// fixed Huffman codes of RFC 1951 (no code tables to build or
+// send, which keeps small tiles small). Data that does not
+// compress (noise) falls back to stored blocks.
+// ============================================================
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Png.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Largest payload of one stored deflate block
+static const size_t kStoredBlock = 65535;
+
+// LZ77 window (largest deflate distance) and match lengths
+static const size_t kWindow = 32768;
+static const size_t kMinMatch = 3;
+static const size_t kMaxMatch = 258;
+
+// Match positions hashed on 3 bytes; candidates tried per position
+static const int kHashBits = 15;
+static const int kMaxChain = 32;
+
+// Base values and extra bits of deflate length codes 257..285 and
+// distance codes 0..29
+static const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t kDistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/* ============================================================
+   Procedure: Crc32Table
+   ------------------------------------------------------------
+   Description:
+   Returns the CRC-32 (polynomial 0xEDB88320) lookup table,
+   built on first use.
+   ============================================================ */
+static const uint32_t* Crc32Table()
+{
+    static const struct Table
+    {
+        uint32_t entries[256];
+
+        Table()
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+        }
+    } table;
+
+    return table.entries;
+}
+
+/* ============================================================
+   Procedure: Crc32 / Adler32
+   ------------------------------------------------------------
+   Description:
+   Checksums of PNG chunks and of the zlib stream.
+   ============================================================ */
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+    const uint32_t* table = Crc32Table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t Adler32(const unsigned char* data, size_t size, uint32_t adler)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    // 5552 bytes is the most that cannot overflow b before the modulo
+    while (size > 0)
+    {
+        size_t n = std::min(size, (size_t)5552);
+        for (size_t i = 0; i < n; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+/* ============================================================
+   Procedure: FixedCodes
+   ------------------------------------------------------------
+   Description:
+   Returns the fixed Huffman codes of deflate, bit-reversed for
+   LSB-first output, and lookups from match length / distance
+   to their code. Built on first use.
+   ============================================================ */
+struct DeflateTables
+{
+    uint16_t literalCode[288];
+    uint8_t literalBits[288];
+    uint8_t distCode[30];
+    uint8_t lengthSymbol[kMaxMatch + 1];
+    // Distance - 1 below 256 directly, above in steps of 128
+    uint8_t distSymbol[512];
+};
+
+static uint16_t ReverseBits(uint32_t code, int bits)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return (uint16_t)r;
+}
+
+static const DeflateTables& FixedCodes()
+{
+    static const struct Tables : DeflateTables
+    {
+        Tables()
+        {
+            for (int s = 0; s < 288; s++)
+            {
+                int bits = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+                int code = s < 144 ? 0x30 + s : s < 256 ? 0x190 + (s - 144) : s < 280 ? s - 256 : 0xC0 + (s - 280);
+                literalCode[s] = ReverseBits(code, bits);
+                literalBits[s] = (uint8_t)bits;
+            }
+
+            for (int c = 0; c < 30; c++)
+            {
+                distCode[c] = (uint8_t)ReverseBits(c, 5);
+                for (int d = kDistBase[c]; d < kDistBase[c] + (1 << kDistExtra[c]) && d <= (int)kWindow; d++)
+                    distSymbol[d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7)] = (uint8_t)c;
+            }
+
+            // Length 258 has a code of its own (the range of 284 ends at 257)
+            for (int c = 0; c < 29; c++)
+                for (int n = kLengthBase[c]; n < kLengthBase[c] + (1 << kLengthExtra[c]) && n <= (int)kMaxMatch; n++)
+                    lengthSymbol[n] = (uint8_t)c;
+            lengthSymbol[kMaxMatch] = 28;
+        }
+    } tables;
+
+    return tables;
+}
+
+/* ============================================================
+   BitWriter
+   ------------------------------------------------------------
+   Appends bits to a byte stream least significant bit first,
+   as deflate packs them.
+   ============================================================ */
+struct BitWriter
+{
+    std::vector<unsigned char>& out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    void Put(uint32_t value, int n)
+    {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8)
+        {
+            out.push_back((unsigned char)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void Flush()
+    {
+        if (count > 0)
+            out.push_back((unsigned char)bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+/* ============================================================
+   Procedure: DeflateFixed
+   ------------------------------------------------------------
+   Description:
+   Compresses data into a single final deflate block with the
+   fixed Huffman codes. Matches are found greedily: the longest
+   of up to kMaxChain earlier positions with the same 3-byte
+   hash is taken, and every position it covers is hashed too.
+
+   Input parameters:
+   data - Bytes to compress
+   size - Number of bytes
+
+   Output parameters:
+   out  - Deflate stream appended
+   ============================================================ */
+static void DeflateFixed(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    const DeflateTables& t = FixedCodes();
+    BitWriter writer{ out };
+    writer.Put(1, 1);   // final block
+    writer.Put(1, 2);   // fixed Huffman codes
+
+    std::vector<int32_t> head((size_t)1 << kHashBits, -1);
+    std::vector<int32_t> prev(kWindow, -1);
+
+    auto hashAt = [&](size_t i)
+    {
+        uint32_t v = data[i] | (uint32_t)data[i + 1] << 8 | (uint32_t)data[i + 2] << 16;
+        return (v * 2654435761u) >> (32 - kHashBits);
+    };
+    auto insert = [&](size_t i)
+    {
+        uint32_t h = hashAt(i);
+        prev[i & (kWindow - 1)] = head[h];
+        head[h] = (int32_t)i;
+    };
+    auto literal = [&](int s)
+    {
+        writer.Put(t.literalCode[s], t.literalBits[s]);
+    };
+
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t bestLength = 0;
+        size_t bestDist = 0;
+
+        if (i + kMinMatch <= size)
+        {
+            size_t maxLength = std::min(kMaxMatch, size - i);
+            int32_t candidate = head[hashAt(i)];
+
+            for (int chain = 0; candidate >= 0 && i - candidate <= kWindow && chain < kMaxChain; chain++)
+            {
+                const unsigned char* a = data + candidate;
+                const unsigned char* b = data + i;
+                if (a[bestLength] == b[bestLength])
+                {
+                    size_t length = 0;
+                    while (length < maxLength && a[length] == b[length])
+                        length++;
+
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDist = i - candidate;
+                        if (length == maxLength)
+                            break;
+                    }
+                }
+                candidate = prev[candidate & (kWindow - 1)];
+            }
+            insert(i);
+        }
+
+        if (bestLength < kMinMatch)
+        {
+            literal(data[i]);
+            i++;
+            continue;
+        }
+
+        int ls = t.lengthSymbol[bestLength];
+        literal(257 + ls);
+        writer.Put((uint32_t)(bestLength - kLengthBase[ls]), kLengthExtra[ls]);
+
+        int ds = t.distSymbol[bestDist - 1 < 256 ? bestDist - 1 : 256 + ((bestDist - 1) >> 7)];
+        writer.Put(t.distCode[ds], 5);
+        writer.Put((uint32_t)(bestDist - kDistBase[ds]), kDistExtra[ds]);
+
+        for (size_t k = i + 1; k < i + bestLength && k + kMinMatch <= size; k++)
+            insert(k);
+        i += bestLength;
+    }
+
+    literal(256);
+    writer.Flush();
+}
+
+/* ============================================================
+   Procedure: DeflateStored
+   ------------------------------------------------------------
+   Description:
+   Writes data as uncompressed deflate blocks (byte aligned,
+   the last one final).
+   ============================================================ */
+static void DeflateStored(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    size_t offset = 0;
+    do
+    {
+        size_t n = std::min(kStoredBlock, size - offset);
+        bool last = offset + n == size;
+
+        out.push_back(last ? 1 : 0);
+        out.push_back((unsigned char)(n & 0xFF));
+        out.push_back((unsigned char)(n >> 8));
+        out.push_back((unsigned char)(~n & 0xFF));
+        out.push_back((unsigned char)((~n >> 8) & 0xFF));
+        out.insert(out.end(), data + offset, data + offset + n);
+        offset += n;
+    } while (offset < size);
+}
+
+/* ============================================================
+   Procedure: FilterRow
+   ------------------------------------------------------------
+   Description:
+   Writes a row with the PNG filter (None, Sub, Up, Average,
+   Paeth) whose residuals have the smallest sum of magnitudes,
+   the usual heuristic for what deflate compresses best.
+
+   Input parameters:
+   row      - Row pixels
+   above    - Previous row (nullptr for the first)
+   rowBytes - Bytes per row
+   bpp      - Bytes per pixel
+   scratch  - Buffer reused for the five candidates
+
+   Output parameters:
+   out      - Filter byte followed by rowBytes residuals
+   ============================================================ */
+static void FilterRow(const unsigned char* row, const unsigned char* above, size_t rowBytes, int bpp,
+    unsigned char* out, std::vector<unsigned char>& scratch)
+{
+    scratch.resize(rowBytes * 5);
+    unsigned long long best = ~0ull;
+    int bestFilter = 0;
+
+    for (int f = 0; f < 5; f++)
+    {
+        unsigned char* res = scratch.data() + rowBytes * f;
+        unsigned long long sum = 0;
+        for (size_t x = 0; x < rowBytes; x++)
+        {
+            int a = x >= (size_t)bpp ? row[x - bpp] : 0;
+            int b = above ? above[x] : 0;
+            int c = above && x >= (size_t)bpp ? above[x - bpp] : 0;
+
+            int predict = 0;
+            if (f == 1)
+                predict = a;
+            else if (f == 2)
+                predict = b;
+            else if (f == 3)
+                predict = (a + b) / 2;
+            else if (f == 4)
+            {
+                int p = a + b - c;
+                int pa = std::abs(p - a);
+                int pb = std::abs(p - b);
+                int pc = std::abs(p - c);
+                predict = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+            }
+
+            res[x] = (unsigned char)(row[x] - predict);
+            sum += std::abs((int)(signed char)res[x]);
+        }
+
+        if (sum < best)
+        {
+            best = sum;
+            bestFilter = f;
+        }
+    }
+
+    out[0] = (unsigned char)bestFilter;
+    std::memcpy(out + 1, scratch.data() + rowBytes * bestFilter, rowBytes);
+}
+
+/* ============================================================
+   Procedure: PutBE32
+   ============================================================ */
+static void PutBE32(std::vector<unsigned char>& out, uint32_t v)
+{
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+/* ============================================================
+   Procedure: PutChunk
+   ------------------------------------------------------------
+   Description:
+   Appends a chunk: length, type, data and CRC over type and
+   data.
+   ============================================================ */
+static void PutChunk(std::vector<unsigned char>& out, const char* type,
+    const unsigned char* data, size_t size)
+{
+    PutBE32(out, (uint32_t)size);
+
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0)
+        out.insert(out.end(), data, data + size);
+
+    PutBE32(out, Crc32(out.data() + start, size + 4));
+}
+
+/* ============================================================
+   Procedure: EncodePNG
+   ------------------------------------------------------------
+   Input parameters:
+   pixels   - Tightly packed rows, channels bytes per pixel
+   width    - Width in pixels (> 0)
+   height   - Height in pixels (> 0)
+   channels - 1 (gray), 3 (RGB) or 4 (RGBA)
+
+   Output parameters:
+   Returns the PNG file contents (empty on invalid input).
+   ============================================================ */
+std::vector<unsigned char> EncodePNG(const unsigned char* pixels, int width, int height, int channels)
+{
+    std::vector<unsigned char> png;
+
+    static const unsigned char kColorType[5] = { 0, 0, 0, 2, 6 };
+    if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4 || channels == 2)
+        return png;
+
+    /* ----------------------------
+       Filtered scanlines: filter byte + residuals
+       ---------------------------- */
+    size_t rowBytes = (size_t)width * channels;
+    std::vector<unsigned char> raw((rowBytes + 1) * height);
+    std::vector<unsigned char> scratch;
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* row = pixels + rowBytes * y;
+        FilterRow(row, y > 0 ? row - rowBytes : nullptr, rowBytes, channels,
+            raw.data() + (rowBytes + 1) * y, scratch);
+    }
+
+    /* ----------------------------
+       zlib stream: header, deflate, Adler-32
+       ---------------------------- */
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() / 2 + 64);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    DeflateFixed(raw.data(), raw.size(), zlib);
+
+    size_t blocks = (raw.size() + kStoredBlock - 1) / kStoredBlock;
+    if (zlib.size() - 2 > raw.size() + blocks * 5)
+    {
+        zlib.resize(2);
+        DeflateStored(raw.data(), raw.size(), zlib);
+    }
+    PutBE32(zlib, Adler32(raw.data(), raw.size(), 1));
+
+    /* ----------------------------
+       File: signature, IHDR, IDAT, IEND
+       ---------------------------- */
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    png.reserve(zlib.size() + 64);
+    png.insert(png.end(), kSignature, kSignature + 8);
+
+    std::vector<unsigned char> header;
+    PutBE32(header, (uint32_t)width);
+    PutBE32(header, (uint32_t)height);
+    header.push_back(8);                    // bit depth
+    header.push_back(kColorType[channels]);
+    header.push_back(0);                    // deflate
+    header.push_back(0);                    // adaptive filtering
+    header.push_back(0);                    // no interlace
+
+    PutChunk(png, "IHDR", header.data(), header.size());
+    PutChunk(png, "IDAT", zlib.data(), zlib.size());
+    PutChunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+/* ============================================================
+   Procedure: WriteFileBytes
+   ============================================================ */
+bool WriteFileBytes(const std::string& path, const std::vector<unsigned char>& data)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
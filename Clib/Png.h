@@ -0,0 +1,17 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <string>
+#include <vector>
+
+// Encodes 8-bit pixels (channels: 1 = gray, 3 = RGB, 4 = RGBA) as a
+// PNG. Rows are filtered adaptively and compressed with greedy LZ77
+// matching into one fixed-Huffman deflate block: no zlib is needed
+// and a tile encodes in a few milliseconds, at some cost in size
+// against zlib's dynamic Huffman tables.
+std::vector<unsigned char> EncodePNG(const unsigned char* pixels, int width, int height, int channels);
+
+// Writes a whole buffer to a file; false on failure.
+bool WriteFileBytes(const std::string& path, const std::vector<unsigned char>& data);
+
+#endif
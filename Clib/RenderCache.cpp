@@ -0,0 +1,335 @@
+// ============================================================
+// File: RenderCache.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Memoized renders. Moving a slider back to a value that was
+// already shown (or toggling between two settings) returns the
+// stored pixels instead of running the tone mapper again. Keys
+// are the image content hash plus every render setting; the
+// cache is LRU under a byte budget.
+// ============================================================
+#include <cstring>
+#include "RenderCache.h"
+#include "Hash.h"
+#include "Latency.h"
+#include "Stats.h"
+
+// The key is hashed as raw bytes, so it must not have padding
+static_assert(sizeof(RenderCacheKey) == 40, "RenderCacheKey must be tightly packed");
+
+/* ============================================================
+   Procedure: RenderCache::Instance
+   ============================================================ */
+RenderCache& RenderCache::Instance()
+{
+    static RenderCache cache;
+    return cache;
+}
+
+/* ============================================================
+   Procedure: KeyHash / KeyEqual
+   ------------------------------------------------------------
+   Description:
+   Hash and equality of cache keys. Floats compare bitwise, so
+   a setting must be reproduced exactly to hit.
+   ============================================================ */
+size_t RenderCache::KeyHash::operator()(const RenderCacheKey& key) const
+{
+    return (size_t)HashBytes(&key, sizeof(key));
+}
+
+bool RenderCache::KeyEqual::operator()(const RenderCacheKey& a, const RenderCacheKey& b) const
+{
+    return std::memcmp(&a, &b, sizeof(RenderCacheKey)) == 0;
+}
+
+/* ============================================================
+   Procedure: RenderCache::Lookup
+   ------------------------------------------------------------
+   Description:
+   Copies a cached render and marks it most recently used.
+
+   Input parameters:
+   key    - Render identity
+   bytes  - Size of the output buffer
+
+   Output parameters:
+   output - Receives the pixels on a hit
+   Returns true on a hit. A cached render of another size is a
+   miss.
+   ============================================================ */
+bool RenderCache::Lookup(const RenderCacheKey& key, void* output, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+    if (it == index.end() || it->second->data.size() != bytes)
+    {
+        misses++;
+        Publish();
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    std::memcpy(output, it->second->data.data(), bytes);
+
+    if (it->second->speculative)
+    {
+        it->second->speculative = false;
+        StatsSpeculationHit();
+    }
+
+    hits++;
+    Publish();
+    return true;
+}
+
+bool RenderCache::Contains(const RenderCacheKey& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.find(key) != index.end();
+}
+
+/* ============================================================
+   Procedure: RenderCache::Store
+   ------------------------------------------------------------
+   Description:
+   Inserts a render (or replaces the stored one) as most
+   recently used and evicts from the back until the budget
+   holds. A render bigger than the whole budget is not kept.
+
+   Input parameters:
+   key         - Render identity
+   data, bytes - Pixels
+   speculative - Rendered ahead of a request (not asked for yet)
+   costMs      - Render time of a speculative render
+   ============================================================ */
+void RenderCache::Store(const RenderCacheKey& key, const void* data, size_t bytes,
+    bool speculative, double costMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        bytesUsed -= it->second->data.size();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    if (bytes <= budget)
+    {
+        const unsigned char* src = (const unsigned char*)data;
+        entries.push_front({ key, std::vector<unsigned char>(src, src + bytes), speculative, costMs });
+        index[key] = entries.begin();
+        bytesUsed += bytes;
+        EvictToBudget();
+    }
+
+    Publish();
+}
+
+void RenderCache::SetBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    EvictToBudget();
+    Publish();
+}
+
+void RenderCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Entry& entry : entries)
+        if (entry.speculative)
+            StatsSpeculationWasted(entry.costMs);
+    entries.clear();
+    index.clear();
+    bytesUsed = 0;
+    Publish();
+}
+
+/* ============================================================
+   Procedure: RenderCache::EvictToBudget / Publish
+   ------------------------------------------------------------
+   Description:
+   Drops least recently used renders over the budget / pushes
+   the counters to HDRStats. Called with the mutex held.
+   ============================================================ */
+void RenderCache::EvictToBudget()
+{
+    while (bytesUsed > budget && !entries.empty())
+    {
+        Entry& last = entries.back();
+        if (last.speculative)
+            StatsSpeculationWasted(last.costMs);
+        bytesUsed -= last.data.size();
+        index.erase(last.key);
+        entries.pop_back();
+    }
+}
+
+void RenderCache::Publish()
+{
+    StatsCache(hits, misses, (int)entries.size(), (long long)bytesUsed);
+}
+
+/* ============================================================
+   Procedure: HashLinearRGB
+   ------------------------------------------------------------
+   Description:
+   Content hash of a float image, used as imageHash of cache
+   keys. Hash once when the image is loaded, not per render.
+
+   Input parameters:
+   linearRGB - Float data
+   count     - Number of floats (width * height * 3)
+
+   Output parameters:
+   Returns the 64-bit hash.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+unsigned long long HashLinearRGB(const float* linearRGB, long long count)
+{
+    if (!linearRGB || count <= 0)
+        return 0;
+    return HashBytes(linearRGB, (size_t)count * sizeof(float));
+}
+
+/* ============================================================
+   Procedure: RenderCacheLookup / RenderCacheStore
+   ------------------------------------------------------------
+   Description:
+   Direct access to the render cache, for callers that render
+   outside this library (the ASM backend).
+
+   Input parameters:
+   key   - Render identity
+   data  - Pixels to store
+   bytes - Buffer size in bytes
+
+   Output parameters:
+   output - Receives the pixels on a hit
+   Lookup returns true on a hit.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool RenderCacheLookup(const RenderCacheKey* key, void* output, long long bytes)
+{
+    if (!key || !output || bytes <= 0)
+        return false;
+
+    SpeculateCancel();
+    return RenderCache::Instance().Lookup(*key, output, (size_t)bytes);
+}
+
+extern "C" __declspec(dllexport)
+void RenderCacheStore(const RenderCacheKey* key, const void* data, long long bytes)
+{
+    if (!key || !data || bytes <= 0)
+        return;
+    RenderCache::Instance().Store(*key, data, (size_t)bytes);
+}
+
+/* ============================================================
+   Procedure: RenderCacheSetBudget / RenderCacheClear
+   ------------------------------------------------------------
+   Input parameters:
+   bytes - Maximum bytes of cached renders (default 512 MB)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void RenderCacheSetBudget(long long bytes)
+{
+    if (bytes >= 0)
+        RenderCache::Instance().SetBudget((size_t)bytes);
+}
+
+extern "C" __declspec(dllexport)
+void RenderCacheClear()
+{
+    RenderCache::Instance().Clear();
+}
+
+/* ============================================================
+   Procedure: ToneMapCached
+   ------------------------------------------------------------
+   Description:
+   Returns the render for key from the cache, or renders it
+   with the key's backend and operator and stores it. The CPU
+   and split backends only produce BGRA8; other formats are
+   rendered by the GL backend. The CLAHE and local operators
+   are not split: the split backend renders them on the CPU.
+   ASM renders live outside this library and use
+   RenderCacheLookup / RenderCacheStore instead. The time
+   until the output is ready is recorded per backend and cache
+   outcome (GetLatencyStats).
+
+   Input parameters:
+   key       - Render identity (size, settings, backend, format)
+   linearRGB - Linear RGB float data the key was computed for
+               (already boosted by key->boost)
+
+   Output parameters:
+   output    - Receives key->width * key->height pixels of
+               GetOutputBytesPerPixel(key->format) bytes
+   Returns HDR_CACHE_HIT or HDR_CACHE_RENDERED with output
+   written, or HDR_CACHE_FAILED with output untouched (invalid
+   key, unsupported backend, OpenGL unavailable).
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int ToneMapCached(const RenderCacheKey* key, float* linearRGB, void* output)
+{
+    if (!key || !linearRGB || !output || key->width <= 0 || key->height <= 0)
+        return HDR_CACHE_FAILED;
+
+    int bpp = GetOutputBytesPerPixel(key->format);
+    if (bpp <= 0)
+        return HDR_CACHE_FAILED;
+
+    double start = StatsNowMs();
+    size_t bytes = (size_t)key->width * key->height * bpp;
+    RenderCache& cache = RenderCache::Instance();
+
+    // A real request: speculative work would only compete with it
+    SpeculateCancel();
+
+    if (cache.Lookup(*key, output, bytes))
+    {
+        LatencyRecord(key->backend, true, StatsNowMs() - start);
+        return HDR_CACHE_HIT;
+    }
+
+    if (key->backend != HDR_BACKEND_GL && key->backend != HDR_BACKEND_CPU && key->backend != HDR_BACKEND_SPLIT)
+        return HDR_CACHE_FAILED;
+
+    if (key->op != HDR_OPERATOR_REINHARD && key->op != HDR_OPERATOR_CLAHE && key->op != HDR_OPERATOR_LOCAL)
+        return HDR_CACHE_FAILED;
+
+    bool bgra = key->format == HDR_OUTPUT_BGRA8;
+    bool local = key->op != HDR_OPERATOR_REINHARD;
+    bool cpu = bgra && key->backend != HDR_BACKEND_GL;
+    if (key->op == HDR_OPERATOR_CLAHE && cpu)
+        ToneMapCLAHECPU(linearRGB, key->width, key->height, (unsigned char*)output, key->exposure, key->whitePoint);
+    else if (key->op == HDR_OPERATOR_LOCAL && cpu)
+        ToneMapLocalCPU(linearRGB, key->width, key->height, (unsigned char*)output, key->exposure, key->whitePoint);
+    else if (key->op == HDR_OPERATOR_CLAHE && InitGLFW())
+        ToneMapCLAHEGL(linearRGB, key->width, key->height, output, key->format, key->exposure, key->whitePoint);
+    else if (key->op == HDR_OPERATOR_LOCAL && InitGLFW())
+        ToneMapLocalGL(linearRGB, key->width, key->height, output, key->format, key->exposure, key->whitePoint);
+    else if (local)
+        return HDR_CACHE_FAILED;
+    else if (bgra && key->backend == HDR_BACKEND_CPU)
+        ToneMapCPU(linearRGB, key->width, key->height, (unsigned char*)output, key->exposure, key->whitePoint);
+    else if (bgra && key->backend == HDR_BACKEND_SPLIT)
+        ToneMapSplit(linearRGB, key->width, key->height, (unsigned char*)output, key->exposure, key->whitePoint);
+    else if (InitGLFW())
+        UploadToGLFormat(linearRGB, key->width, key->height, output, key->format, key->exposure, key->whitePoint);
+    else
+        return HDR_CACHE_FAILED;
+
+    cache.Store(*key, output, bytes);
+    LatencyRecord(key->backend, false, StatsNowMs() - start);
+    return HDR_CACHE_RENDERED;
+}
@@ -0,0 +1,59 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "HDR.h"
+
+// LRU cache of finished renders under a byte budget
+class RenderCache
+{
+public:
+	// Process-wide cache used by the exported API
+	static RenderCache& Instance();
+
+	// Copies a cached render into output; returns false on a miss
+	bool Lookup(const RenderCacheKey& key, void* output, size_t bytes);
+	// Returns true if the key is cached (does not count as a hit)
+	bool Contains(const RenderCacheKey& key);
+	// Inserts or refreshes a render, evicting least recently used ones.
+	// Speculative renders remember their cost until the first hit.
+	void Store(const RenderCacheKey& key, const void* data, size_t bytes,
+		bool speculative = false, double costMs = 0.0);
+
+	void SetBudget(size_t bytes);
+	void Clear();
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const RenderCacheKey& key) const;
+	};
+	struct KeyEqual
+	{
+		bool operator()(const RenderCacheKey& a, const RenderCacheKey& b) const;
+	};
+	struct Entry
+	{
+		RenderCacheKey key;
+		std::vector<unsigned char> data;
+		bool speculative = false;
+		double costMs = 0.0;
+	};
+
+	void EvictToBudget();
+	void Publish();
+
+	std::mutex mutex;
+	std::list<Entry> entries;   // front = most recently used
+	std::unordered_map<RenderCacheKey, std::list<Entry>::iterator, KeyHash, KeyEqual> index;
+	size_t budget = 512u * 1024u * 1024u;
+	size_t bytesUsed = 0;
+	long long hits = 0;
+	long long misses = 0;
+};
+
+#endif
@@ -0,0 +1,484 @@
+// ============================================================
+// File: RenderGraph.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Small render graph for chaining fullscreen GL passes (tone
+// map, bloom, local operators, ...). Passes declare the
+// textures they read and the texture they write; the graph
+// orders and culls them, allocates render targets from a
+// persistent pool and hands a transient texture back to the
+// pool right after its last reader, so later passes with the
+// same size and format alias the same memory.
+// ============================================================
+#include <algorithm>
+#include "RenderGraph.h"
+
+/*
+ * kIdleFrames
+ * Number of frames a free pooled target survives before it is
+ * deleted (e.g. after the image size changed).
+ * Range: > 0
+ */
+static const long long kIdleFrames = 3;
+
+/* ============================================================
+   Procedure: TransferFormat
+   ------------------------------------------------------------
+   Description:
+   Returns a client format/type pair valid for allocating a
+   texture of the given internal format without data.
+
+   Input parameters:
+   internalFormat - Sized GL internal format
+
+   Output parameters:
+   format, type   - Values for glTexImage2D
+   bytes          - Size of one texel in GPU memory
+   ============================================================ */
+static void TransferFormat(GLenum internalFormat, GLenum& format, GLenum& type, int& bytes)
+{
+    switch (internalFormat)
+    {
+    case GL_R8:       format = GL_RED;  type = GL_UNSIGNED_BYTE; bytes = 1; break;
+    case GL_R16F:     format = GL_RED;  type = GL_HALF_FLOAT;    bytes = 2; break;
+    case GL_R32F:     format = GL_RED;  type = GL_FLOAT;         bytes = 4; break;
+    case GL_RG16F:    format = GL_RG;   type = GL_HALF_FLOAT;    bytes = 4; break;
+    case GL_RG32F:    format = GL_RG;   type = GL_FLOAT;         bytes = 8; break;
+    case GL_RGB16F:   format = GL_RGB;  type = GL_HALF_FLOAT;    bytes = 6; break;
+    case GL_RGB32F:   format = GL_RGB;  type = GL_FLOAT;         bytes = 12; break;
+    case GL_RGBA16F:  format = GL_RGBA; type = GL_HALF_FLOAT;    bytes = 8; break;
+    case GL_RGBA32F:  format = GL_RGBA; type = GL_FLOAT;         bytes = 16; break;
+    case GL_RGB10_A2: format = GL_RGBA; type = GL_UNSIGNED_INT_2_10_10_10_REV; bytes = 4; break;
+    default:          format = GL_RGBA; type = GL_UNSIGNED_BYTE; bytes = 4; break;
+    }
+}
+
+/* ============================================================
+   Procedure: TexturePool::Acquire
+   ------------------------------------------------------------
+   Description:
+   Returns a free pooled target matching the description or
+   allocates a new texture.
+
+   Input parameters:
+   desc - Required size and internal format
+
+   Output parameters:
+   Returns a target marked as in use.
+   ============================================================ */
+RGTarget* TexturePool::Acquire(const RGTextureDesc& desc)
+{
+    for (auto& t : targets)
+    {
+        if (!t->inUse &&
+            t->desc.width == desc.width &&
+            t->desc.height == desc.height &&
+            t->desc.internalFormat == desc.internalFormat)
+        {
+            t->inUse = true;
+            t->lastUsedFrame = frame;
+            return t.get();
+        }
+    }
+
+    GLenum format, type;
+    int bytes;
+    TransferFormat(desc.internalFormat, format, type, bytes);
+
+    auto t = std::make_unique<RGTarget>();
+    t->desc = desc;
+    t->inUse = true;
+    t->lastUsedFrame = frame;
+
+    glGenTextures(1, &t->texture);
+    glBindTexture(GL_TEXTURE_2D, t->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat,
+        desc.width, desc.height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    allocations++;
+    targets.push_back(std::move(t));
+    return targets.back().get();
+}
+
+/* ============================================================
+   Procedure: TexturePool::Release
+   ------------------------------------------------------------
+   Description:
+   Marks a target as free so the next Acquire can reuse it.
+   ============================================================ */
+void TexturePool::Release(RGTarget* target)
+{
+    if (target)
+    {
+        target->inUse = false;
+        target->lastUsedFrame = frame;
+    }
+}
+
+/* ============================================================
+   Procedure: TexturePool::Framebuffer
+   ------------------------------------------------------------
+   Description:
+   Returns the FBO rendering into a target, creating it on
+   first use. Input-only formats (e.g. GL_RGB16F) never get one.
+
+   Output parameters:
+   Returns the FBO, or 0 if the format is not renderable.
+   ============================================================ */
+GLuint TexturePool::Framebuffer(RGTarget* target)
+{
+    if (target->fbo)
+        return target->fbo;
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, target->texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &target->fbo);
+        target->fbo = 0;
+    }
+
+    return target->fbo;
+}
+
+/* ============================================================
+   Procedure: TexturePool::EndFrame
+   ------------------------------------------------------------
+   Description:
+   Advances the frame counter and deletes free targets that
+   have not been used for kIdleFrames frames.
+   ============================================================ */
+void TexturePool::EndFrame()
+{
+    frame++;
+
+    for (size_t i = 0; i < targets.size();)
+    {
+        RGTarget* t = targets[i].get();
+        if (!t->inUse && frame - t->lastUsedFrame > kIdleFrames)
+        {
+            if (t->fbo)
+                glDeleteFramebuffers(1, &t->fbo);
+            glDeleteTextures(1, &t->texture);
+            targets.erase(targets.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/* ============================================================
+   Procedure: TexturePool::Clear
+   ------------------------------------------------------------
+   Description:
+   Deletes all pooled textures and FBOs.
+   ============================================================ */
+void TexturePool::Clear()
+{
+    for (auto& t : targets)
+    {
+        if (t->fbo)
+            glDeleteFramebuffers(1, &t->fbo);
+        glDeleteTextures(1, &t->texture);
+    }
+    targets.clear();
+}
+
+/* ============================================================
+   Procedure: TexturePool::Bytes
+   ------------------------------------------------------------
+   Description:
+   Returns the GPU memory held by the pool in bytes.
+   ============================================================ */
+long long TexturePool::Bytes() const
+{
+    long long total = 0;
+    for (auto& t : targets)
+    {
+        GLenum format, type;
+        int bytes;
+        TransferFormat(t->desc.internalFormat, format, type, bytes);
+        total += (long long)t->desc.width * t->desc.height * bytes;
+    }
+    return total;
+}
+
+/* ============================================================
+   Procedure: RenderGraph constructor / destructor
+   ------------------------------------------------------------
+   Description:
+   The graph borrows the pool; anything still held is returned
+   to it on destruction.
+   ============================================================ */
+RenderGraph::RenderGraph(TexturePool& pool)
+    : pool(pool)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    Release();
+}
+
+/* ============================================================
+   Procedure: RenderGraph::CreateTexture
+   ------------------------------------------------------------
+   Description:
+   Declares a transient texture. Memory is only assigned while
+   the graph executes.
+
+   Output parameters:
+   Returns the resource handle.
+   ============================================================ */
+int RenderGraph::CreateTexture(const RGTextureDesc& desc)
+{
+    Resource r;
+    r.desc = desc;
+    resources.push_back(r);
+    return (int)resources.size() - 1;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::ImportTexture
+   ------------------------------------------------------------
+   Description:
+   Declares a caller-owned texture that passes may read.
+
+   Output parameters:
+   Returns the resource handle.
+   ============================================================ */
+int RenderGraph::ImportTexture(GLuint texture, const RGTextureDesc& desc)
+{
+    Resource r;
+    r.desc = desc;
+    r.imported = texture;
+    resources.push_back(r);
+    return (int)resources.size() - 1;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::AddPass
+   ------------------------------------------------------------
+   Description:
+   Adds a pass. The graph binds the output FBO, sets the
+   viewport and binds inputs to texture units 0..N-1 before
+   calling execute, which sets its program and draws.
+
+   Input parameters:
+   name    - Pass name (for debugging)
+   inputs  - Resources read by the pass
+   output  - Transient resource written by the pass
+   execute - Callback issuing the draw
+   ============================================================ */
+void RenderGraph::AddPass(const char* name, std::vector<int> inputs, int output,
+    std::function<void(const RGPassContext&)> execute)
+{
+    Pass p;
+    p.name = name;
+    p.inputs = std::move(inputs);
+    p.output = output;
+    p.execute = std::move(execute);
+
+    resources[output].producer = (int)passes.size();
+    passes.push_back(std::move(p));
+}
+
+/* ============================================================
+   Procedure: RenderGraph::MarkOutput
+   ------------------------------------------------------------
+   Description:
+   Marks a resource as a graph result. Only passes that feed an
+   output are executed and outputs are never aliased.
+   ============================================================ */
+void RenderGraph::MarkOutput(int resource)
+{
+    resources[resource].output = true;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::Order
+   ------------------------------------------------------------
+   Description:
+   Depth-first walk from the outputs to their producers. Yields
+   only the contributing passes, each after all of its inputs.
+
+   Output parameters:
+   order - Pass indices in execution order
+   Returns false if the passes form a cycle.
+   ============================================================ */
+bool RenderGraph::Order(std::vector<int>& order)
+{
+    // 0 = unvisited, 1 = on stack, 2 = done
+    std::vector<int> state(passes.size(), 0);
+    std::vector<std::pair<int, size_t>> stack;
+
+    for (size_t r = 0; r < resources.size(); r++)
+    {
+        if (!resources[r].output || resources[r].producer < 0)
+            continue;
+
+        int root = resources[r].producer;
+        if (state[root] == 2)
+            continue;
+
+        stack.push_back({ root, 0 });
+        state[root] = 1;
+
+        while (!stack.empty())
+        {
+            int p = stack.back().first;
+            size_t& next = stack.back().second;
+
+            if (next < passes[p].inputs.size())
+            {
+                int dep = resources[passes[p].inputs[next++]].producer;
+                if (dep < 0 || state[dep] == 2)
+                    continue;
+                if (state[dep] == 1)
+                    return false;
+
+                state[dep] = 1;
+                stack.push_back({ dep, 0 });
+            }
+            else
+            {
+                state[p] = 2;
+                order.push_back(p);
+                stack.pop_back();
+            }
+        }
+    }
+
+    return true;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::Execute
+   ------------------------------------------------------------
+   Description:
+   Orders the passes, computes the last reader of every
+   transient texture, then runs each pass. A transient goes
+   back to the pool directly after its last reader, so a later
+   pass with the same size and format renders into the same
+   texture (ping-pong between two targets for linear chains).
+
+   Output parameters:
+   Returns false on a cycle or an incomplete framebuffer.
+   ============================================================ */
+bool RenderGraph::Execute()
+{
+    std::vector<int> order;
+    if (!Order(order))
+        return false;
+
+    // Last position in the order at which each resource is read
+    std::vector<int> lastUse(resources.size(), -1);
+    for (int i = 0; i < (int)order.size(); i++)
+        for (int in : passes[order[i]].inputs)
+            lastUse[in] = i;
+
+    std::vector<RGTarget*> used;
+
+    for (int i = 0; i < (int)order.size(); i++)
+    {
+        Pass& pass = passes[order[i]];
+        Resource& out = resources[pass.output];
+
+        out.target = pool.Acquire(out.desc);
+        if (std::find(used.begin(), used.end(), out.target) == used.end())
+            used.push_back(out.target);
+
+        GLuint fbo = pool.Framebuffer(out.target);
+        if (!fbo)
+            return false;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, out.desc.width, out.desc.height);
+
+        RGPassContext ctx;
+        ctx.width = out.desc.width;
+        ctx.height = out.desc.height;
+
+        for (size_t u = 0; u < pass.inputs.size(); u++)
+        {
+            const Resource& in = resources[pass.inputs[u]];
+            GLuint tex = in.imported ? in.imported : (in.target ? in.target->texture : 0);
+            ctx.inputs.push_back(tex);
+
+            glActiveTexture(GL_TEXTURE0 + (GLenum)u);
+            glBindTexture(GL_TEXTURE_2D, tex);
+        }
+
+        pass.execute(ctx);
+
+        // Transients whose last reader just ran become reusable
+        for (int in : pass.inputs)
+        {
+            Resource& r = resources[in];
+            if (!r.imported && !r.output && r.target && lastUse[in] == i)
+            {
+                pool.Release(r.target);
+                r.target = nullptr;
+            }
+        }
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    physicalCount = (int)used.size();
+    return true;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::Texture / Framebuffer
+   ------------------------------------------------------------
+   Description:
+   Return the physical texture / FBO of a resource after
+   Execute (0 if the resource has been released).
+   ============================================================ */
+GLuint RenderGraph::Texture(int resource) const
+{
+    const Resource& r = resources[resource];
+    if (r.imported)
+        return r.imported;
+    return r.target ? r.target->texture : 0;
+}
+
+GLuint RenderGraph::Framebuffer(int resource) const
+{
+    const Resource& r = resources[resource];
+    return r.target ? r.target->fbo : 0;
+}
+
+/* ============================================================
+   Procedure: RenderGraph::Release
+   ------------------------------------------------------------
+   Description:
+   Returns every target still held by the graph to the pool.
+   ============================================================ */
+void RenderGraph::Release()
+{
+    for (Resource& r : resources)
+    {
+        if (r.target)
+        {
+            pool.Release(r.target);
+            r.target = nullptr;
+        }
+    }
+}
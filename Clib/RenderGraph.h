@@ -0,0 +1,120 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Size and format of a texture used by the render graph
+struct RGTextureDesc
+{
+	int width;
+	int height;
+	GLenum internalFormat;
+};
+
+// One pooled texture and the FBO that renders into it
+struct RGTarget
+{
+	GLuint texture = 0;
+	GLuint fbo = 0;
+	RGTextureDesc desc = {};
+	long long lastUsedFrame = 0;
+	bool inUse = false;
+};
+
+// Keeps textures alive between passes and calls so matching
+// requests reuse them instead of allocating new ones
+class TexturePool
+{
+public:
+	// Returns a free target with the given description, creating one if needed
+	RGTarget* Acquire(const RGTextureDesc& desc);
+	// Returns a target to the pool; its contents may be overwritten
+	void Release(RGTarget* target);
+	// Returns the FBO of a target, creating it on first use (0 if incomplete)
+	GLuint Framebuffer(RGTarget* target);
+	// Advances the frame counter and frees targets idle for several frames
+	void EndFrame();
+	// Deletes every target
+	void Clear();
+
+	int TextureCount() const { return (int)targets.size(); }
+	long long Bytes() const;
+	long long Allocations() const { return allocations; }
+
+private:
+	std::vector<std::unique_ptr<RGTarget>> targets;
+	long long frame = 0;
+	long long allocations = 0;
+};
+
+// Textures of a pass bound to units 0..N-1 in input order
+struct RGPassContext
+{
+	std::vector<GLuint> inputs;
+	int width;
+	int height;
+};
+
+// Orders passes by their declared inputs/outputs, culls passes
+// that do not contribute to an output and aliases transient
+// textures whose lifetimes do not overlap through the pool
+class RenderGraph
+{
+public:
+	explicit RenderGraph(TexturePool& pool);
+	~RenderGraph();
+
+	// Declares a transient texture produced by a pass
+	int CreateTexture(const RGTextureDesc& desc);
+	// Declares an existing texture owned by the caller (input only)
+	int ImportTexture(GLuint texture, const RGTextureDesc& desc);
+	// Adds a fullscreen pass reading inputs and rendering into output
+	void AddPass(const char* name, std::vector<int> inputs, int output,
+		std::function<void(const RGPassContext&)> execute);
+	// Keeps a resource alive after Execute so it can be read back
+	void MarkOutput(int resource);
+
+	// Runs the graph; returns false on a cycle or incomplete framebuffer
+	bool Execute();
+
+	// Physical texture / FBO of a resource after Execute
+	GLuint Texture(int resource) const;
+	GLuint Framebuffer(int resource) const;
+
+	// Returns the retained outputs to the pool
+	void Release();
+
+	// Distinct pooled targets used by the last Execute
+	int PhysicalCount() const { return physicalCount; }
+
+private:
+	struct Resource
+	{
+		RGTextureDesc desc;
+		GLuint imported = 0;
+		RGTarget* target = nullptr;
+		int producer = -1;
+		bool output = false;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<int> inputs;
+		int output;
+		std::function<void(const RGPassContext&)> execute;
+	};
+
+	bool Order(std::vector<int>& order);
+
+	TexturePool& pool;
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	int physicalCount = 0;
+};
+
+#endif
@@ -0,0 +1,243 @@
+// ============================================================
+// File: Sequence.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Sequence mode: frame after frame of one size tone mapped into
+// the same output buffer. Turntables and locked-off shots leave
+// large areas unchanged between frames, so every tile of the
+// fused CPU sweep first hashes the input it would read (SIMD
+// HashBytes) and compares it with the previous frame's hash;
+// unchanged tiles keep last frame's output and are not loaded
+// or tone mapped at all. Hashing reads the same rows the tile
+// load would, right before it, so a changed tile costs one
+// extra pass over cached data.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "HDR.h"
+#include "Bloom.h"
+#include "CpuPipeline.h"
+#include "Dither.h"
+#include "Grade.h"
+#include "Hash.h"
+#include "Lut.h"
+#include "StageGraph.h"
+#include "Stats.h"
+#include "Tune.h"
+
+/* ============================================================
+   HDRSequence
+   ------------------------------------------------------------
+   Per-tile input hashes and settings of the last frame. All
+   fields are protected by mutex.
+   ============================================================ */
+struct HDRSequence
+{
+    std::mutex mutex;
+    int width = 0;
+    int height = 0;
+    std::vector<uint64_t> hashes;
+
+    // Last frame
+    bool rendered = false;
+    float exposure = 0.0f;
+    float whitePoint = 0.0f;
+    bool dither = false;
+    bool bloom = false;
+    ColorGrade grade;
+    std::shared_ptr<const CubeLut> lut;
+    unsigned char* output = nullptr;
+    int tileWidth = 0;
+    int tileHeight = 0;
+};
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gSequenceMutex
+ * Protects gSequences and gNextSequence.
+ */
+static std::mutex gSequenceMutex;
+
+/*
+ * gSequences
+ * Created sequences by id.
+ */
+static std::unordered_map<int, std::shared_ptr<HDRSequence>> gSequences;
+
+/*
+ * gNextSequence
+ * Id of the next created sequence.
+ * Range: > 0
+ */
+static int gNextSequence = 1;
+
+/* ============================================================
+   Procedure: HashRegion
+   ------------------------------------------------------------
+   Description:
+   Content hash of a rectangle of an interleaved RGB image,
+   seeded with the rectangle itself, then row by row, each row
+   seeded with the hash so far. Equal pixels at another place or
+   size (e.g. after a tile size change) hash differently.
+   ============================================================ */
+static uint64_t HashRegion(const float* linearRGB, int width, int x0, int y0, int w, int h)
+{
+    int rect[4] = { x0, y0, w, h };
+    uint64_t hash = HashBytes(rect, sizeof(rect));
+    for (int y = y0; y < y0 + h; y++)
+        hash = HashBytes(linearRGB + ((size_t)y * width + x0) * 3, (size_t)w * 3 * sizeof(float), hash);
+    return hash;
+}
+
+/* ============================================================
+   Procedure: HDRSequenceCreate
+   ------------------------------------------------------------
+   Description:
+   Starts a sequence of frames of one size. The first frame is
+   rendered whole.
+
+   Input parameters:
+   width  - Frame width in pixels (> 0)
+   height - Frame height in pixels (> 0)
+
+   Output parameters:
+   Returns the sequence id (> 0), or 0 on invalid arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int HDRSequenceCreate(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return 0;
+
+    auto sequence = std::make_shared<HDRSequence>();
+    sequence->width = width;
+    sequence->height = height;
+
+    std::lock_guard<std::mutex> lock(gSequenceMutex);
+    int id = gNextSequence++;
+    gSequences[id] = sequence;
+    return id;
+}
+
+/* ============================================================
+   Procedure: HDRSequenceDestroy
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void HDRSequenceDestroy(int sequence)
+{
+    std::lock_guard<std::mutex> lock(gSequenceMutex);
+    gSequences.erase(sequence);
+}
+
+/* ============================================================
+   Procedure: HDRSequenceRender
+   ------------------------------------------------------------
+   Description:
+   Tone maps the next frame on the CPU. Tiles whose input is
+   unchanged since the previous frame are skipped when the
+   exposure, white point, dither setting, color grade, LUT and
+   output buffer are the same as then (and bloom is off); any
+   change renders the whole frame.
+   Skipped and rendered tiles are counted in HDRStats. Quality
+   counters are not gathered for sequence frames.
+
+   Input parameters:
+   sequence    - Id from HDRSequenceCreate
+   linearRGB   - Frame, linear RGB float data (RGBRGB...)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - BGRA8 buffer holding the previous frame of the
+                 sequence (pass the same buffer every frame)
+   Returns the number of tiles tone mapped, or -1 for invalid
+   arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int HDRSequenceRender(int sequence, const float* linearRGB, unsigned char* outputBGRA,
+    float exposure, float whitePoint)
+{
+    if (!linearRGB || !outputBGRA)
+        return -1;
+
+    std::shared_ptr<HDRSequence> seq;
+    {
+        std::lock_guard<std::mutex> lock(gSequenceMutex);
+        auto it = gSequences.find(sequence);
+        if (it == gSequences.end())
+            return -1;
+        seq = it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(seq->mutex);
+    TuneEnsureLoaded();
+
+    // Tile indices of the sweep, as StageGraph lays them out
+    int width = seq->width;
+    int height = seq->height;
+    StageTileSize tile = StageGraph::TileSize();
+    int tileW = std::min(tile.width, width);
+    int tileH = std::min(tile.height, height);
+    size_t tiles = (size_t)((width + tileW - 1) / tileW) * ((height + tileH - 1) / tileH);
+
+    // Bloom carries changes across tiles, so no tile is skipped
+    // while it is on
+    bool dither = DitherEnabled();
+    bool bloom = BloomEnabled();
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+    bool reuse = seq->rendered && exposure == seq->exposure && whitePoint == seq->whitePoint &&
+        dither == seq->dither && !bloom && !seq->bloom && grade == seq->grade && lut == seq->lut && outputBGRA == seq->output &&
+        tileW == seq->tileWidth && tileH == seq->tileHeight;
+    if (!reuse)
+        seq->hashes.assign(tiles, 0);
+
+    std::atomic<long long> skipped{ 0 };
+    std::atomic<long long> rendered{ 0 };
+    uint64_t* hashes = seq->hashes.data();
+
+    // The graph takes the tile size again; if it was retuned in
+    // between, no tile matches its old hash (see HashRegion) and
+    // tiles past the table are rendered without being recorded
+    StageTileFilter filter = [&](int tile, int x0, int y0, int w, int h)
+    {
+        if ((size_t)tile >= tiles)
+        {
+            rendered++;
+            return true;
+        }
+
+        uint64_t hash = HashRegion(linearRGB, width, x0, y0, w, h);
+        bool same = reuse && hashes[tile] == hash;
+        hashes[tile] = hash;
+
+        (same ? skipped : rendered)++;
+        return !same;
+    };
+
+    ToneMapCPURun(linearRGB, width, height, outputBGRA, exposure, whitePoint, nullptr, nullptr, filter);
+    StatsSequence(skipped, rendered);
+
+    seq->rendered = true;
+    seq->exposure = exposure;
+    seq->whitePoint = whitePoint;
+    seq->dither = dither;
+    seq->bloom = bloom;
+    seq->grade = grade;
+    seq->lut = lut;
+    seq->output = outputBGRA;
+    seq->tileWidth = tileW;
+    seq->tileHeight = tileH;
+    return (int)rendered;
+}
@@ -0,0 +1,452 @@
+// ============================================================
+// File: Speculate.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Speculative pre-rendering. While a slider is dragged the next
+// values are easy to guess from the direction and size of the
+// last steps; a low-priority background thread renders those
+// settings into the render cache before they are asked for.
+// Any real request cancels the speculation within a few rows
+// (CPU) or one band (GL).
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "HDR.h"
+#include "Bloom.h"
+#include "Dither.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Grade.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "RenderCache.h"
+#include "Stats.h"
+#include "Tune.h"
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Predicted settings rendered ahead of the current one
+static const int kSpecDepth = 3;
+
+// Rows rendered between cancellation checks
+static const int kSpecRows = 16;
+
+// Rows of one GL draw between cancellation checks; a multiple
+// of the dither tile, so the bands join into the same image as
+// one full-frame draw
+static const int kSpecGLRows = 4 * kDitherSize;
+
+/* ============================================================
+   Speculator
+   ------------------------------------------------------------
+   Background thread and its queue of settings to pre-render.
+   ============================================================ */
+class Speculator
+{
+public:
+    static Speculator& Instance()
+    {
+        static Speculator speculator;
+        return speculator;
+    }
+
+    ~Speculator();
+
+    void Submit(const RenderCacheKey& key, const float* linearRGB, float exposureStep, float whitePointStep);
+    void Cancel();
+    void Shutdown();
+
+private:
+    void ThreadLoop();
+    bool Render(const RenderCacheKey& key, const std::vector<float>& pixels,
+        unsigned long long gen, std::vector<unsigned char>& output);
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<RenderCacheKey> queue;
+    std::atomic<unsigned long long> generation{ 0 };
+    bool busy = false;
+    bool stopping = false;
+
+    // Private copy of the image the queued keys refer to; the
+    // caller's buffer is only valid during its call
+    std::shared_ptr<const std::vector<float>> image;
+    RenderCacheKey imageKey = {};
+
+    // Drag state: last submitted settings and the smoothed
+    // per-event change of each slider, in slider steps
+    RenderCacheKey last = {};
+    bool hasLast = false;
+    double exposureDelta = 0.0;
+    double whitePointDelta = 0.0;
+};
+
+/* ============================================================
+   Procedure: SameImage
+   ------------------------------------------------------------
+   Description:
+   True if two keys render the same input (content, boost,
+   size), i.e. only the tone mapping settings differ.
+   ============================================================ */
+static bool SameImage(const RenderCacheKey& a, const RenderCacheKey& b)
+{
+    return a.imageHash == b.imageHash && a.boost == b.boost &&
+        a.width == b.width && a.height == b.height;
+}
+
+/* ============================================================
+   Procedure: SmoothDelta
+   ------------------------------------------------------------
+   Description:
+   Updates the running per-event change of a slider. A change
+   of direction restarts the average.
+   ============================================================ */
+static double SmoothDelta(double average, double delta)
+{
+    if (delta == 0.0)
+        return average;
+    if (average * delta < 0.0)
+        return delta;
+    return 0.5 * average + 0.5 * delta;
+}
+
+/* ============================================================
+   Procedure: Predict
+   ------------------------------------------------------------
+   Description:
+   Value of a slider k events ahead, snapped to its step grid
+   the way the slider snaps (so the prediction can match the
+   real request bit for bit).
+   ============================================================ */
+static float Predict(float value, double delta, int k, float step)
+{
+    if (k == 0 || step <= 0.0f || delta == 0.0)
+        return value;
+
+    // Move at least one step per event in the drag direction
+    double steps = delta > 0.0 ? std::max(1.0, std::round(delta)) : std::min(-1.0, std::round(delta));
+    double v = value + k * steps * step;
+    return (float)(std::round(v / step) * step);
+}
+
+/* ============================================================
+   Procedure: Speculator destructor
+   ------------------------------------------------------------
+   Description:
+   Runs while the DLL is unloaded, under the loader lock, where
+   joining a thread can deadlock; the thread must already have
+   been stopped by SpeculateShutdown (CleanupGLFW). If it was
+   not, the process is exiting and the thread is detached.
+   ============================================================ */
+Speculator::~Speculator()
+{
+    if (thread.joinable())
+        thread.detach();
+}
+
+/* ============================================================
+   Procedure: Speculator::Shutdown
+   ------------------------------------------------------------
+   Description:
+   Cancels outstanding work and joins the thread. A later
+   Submit starts a new one.
+   ============================================================ */
+void Speculator::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+        generation++;
+    }
+    cond.notify_all();
+
+    if (thread.joinable())
+        thread.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    busy = false;
+}
+
+/* ============================================================
+   Procedure: Speculator::Submit
+   ------------------------------------------------------------
+   Description:
+   Records a slider event and replaces the queue with the
+   current settings plus kSpecDepth predicted ones along the
+   drag, skipping those already cached. Work in progress for
+   an older prediction is cancelled.
+
+   Input parameters:
+   key            - Settings the slider shows now
+   linearRGB      - Boosted linear RGB data of the key
+   exposureStep   - Exposure slider step (snap grid)
+   whitePointStep - White point slider step (snap grid)
+   ============================================================ */
+void Speculator::Submit(const RenderCacheKey& key, const float* linearRGB, float exposureStep, float whitePointStep)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!image || !SameImage(key, imageKey))
+    {
+        size_t count = (size_t)key.width * key.height * 3;
+        image = std::make_shared<const std::vector<float>>(linearRGB, linearRGB + count);
+        imageKey = key;
+        hasLast = false;
+    }
+
+    if (hasLast && last.backend == key.backend && last.format == key.format && SameImage(last, key))
+    {
+        if (exposureStep > 0.0f)
+            exposureDelta = SmoothDelta(exposureDelta, (key.exposure - last.exposure) / exposureStep);
+        if (whitePointStep > 0.0f)
+            whitePointDelta = SmoothDelta(whitePointDelta, (key.whitePoint - last.whitePoint) / whitePointStep);
+    }
+    else
+    {
+        exposureDelta = 0.0;
+        whitePointDelta = 0.0;
+    }
+    last = key;
+    hasLast = true;
+
+    generation++;
+    queue.clear();
+
+    RenderCache& cache = RenderCache::Instance();
+    for (int k = 0; k <= kSpecDepth; k++)
+    {
+        RenderCacheKey next = key;
+        next.exposure = Predict(key.exposure, exposureDelta, k, exposureStep);
+        next.whitePoint = Predict(key.whitePoint, whitePointDelta, k, whitePointStep);
+
+        if (k > 0 && next.exposure == key.exposure && next.whitePoint == key.whitePoint)
+            break;
+        if (next.exposure < 0.0f || next.whitePoint <= 0.0f)
+            break;
+        if (!cache.Contains(next))
+            queue.push_back(next);
+    }
+
+    if (queue.empty())
+        return;
+
+    if (!thread.joinable())
+        thread = std::thread([this] { ThreadLoop(); });
+    cond.notify_all();
+}
+
+/* ============================================================
+   Procedure: Speculator::Cancel
+   ------------------------------------------------------------
+   Description:
+   Drops queued work, aborts the render in progress and waits
+   until the thread is idle. A CPU render stops within
+   kSpecRows rows, a GL render after its current band of
+   kSpecGLRows rows.
+   ============================================================ */
+void Speculator::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.clear();
+    generation++;
+    cond.wait(lock, [this] { return !busy; });
+}
+
+/* ============================================================
+   Procedure: Speculator::ThreadLoop
+   ------------------------------------------------------------
+   Description:
+   Renders queued settings one at a time at below-normal
+   priority and stores finished ones in the render cache as
+   speculative entries.
+   ============================================================ */
+void Speculator::ThreadLoop()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+    std::vector<unsigned char> output;
+
+    for (;;)
+    {
+        RenderCacheKey key;
+        std::shared_ptr<const std::vector<float>> source;
+        unsigned long long gen;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            busy = false;
+            cond.notify_all();
+            cond.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (stopping)
+                return;
+
+            key = queue.front();
+            queue.pop_front();
+            source = image;
+            gen = generation;
+            busy = true;
+        }
+
+        double start = StatsNowMs();
+        bool completed = Render(key, *source, gen, output);
+        double ms = StatsNowMs() - start;
+
+        if (completed)
+            RenderCache::Instance().Store(key, output.data(), output.size(), true, ms);
+        StatsSpeculationRender(completed, ms);
+    }
+}
+
+/* ============================================================
+   Procedure: Speculator::Render
+   ------------------------------------------------------------
+   Description:
+   Renders one key the way ToneMapCached would. BGRA8 CPU keys
+   use the CPU kernels on this thread only, row band by row
+   band, so the thread pool stays free for real requests;
+   everything else is drawn by GL in bands of kSpecGLRows rows
+   (the speculated operator is per pixel, so the bands give
+   the full-frame result), checking for cancellation between
+   them.
+
+   Input parameters:
+   key        - Settings to render
+   pixels     - Linear RGB data of the key
+   gen        - Generation the work was queued in
+
+   Output parameters:
+   output     - Rendered pixels
+   Returns false if cancelled (or not renderable here).
+   ============================================================ */
+bool Speculator::Render(const RenderCacheKey& key, const std::vector<float>& pixels,
+    unsigned long long gen, std::vector<unsigned char>& output)
+{
+    int bpp = GetOutputBytesPerPixel(key.format);
+    if (bpp <= 0 || key.backend == HDR_BACKEND_ASM)
+        return false;
+
+    output.resize((size_t)key.width * key.height * bpp);
+    TuneEnsureLoaded();
+
+    if (key.format == HDR_OUTPUT_BGRA8 && key.backend == HDR_BACKEND_CPU)
+    {
+        std::vector<float> planes((size_t)key.width * 3);
+        ColorGrade grade = GetColorGrade();
+        std::shared_ptr<const CubeLut> lut = GetCubeLut();
+        float* r = planes.data();
+        float* g = r + key.width;
+        float* b = g + key.width;
+
+        for (int y = 0; y < key.height; y++)
+        {
+            if (y % kSpecRows == 0 && generation != gen)
+                return false;
+
+            DeinterleaveRGB(pixels.data() + (size_t)y * key.width * 3, key.width, r, g, b);
+            ToneMapPlanar(r, g, b, key.width, key.exposure, key.whitePoint, nullptr, grade, lut.get());
+            StoreBGRA8(r, g, b, key.width, output.data() + (size_t)y * key.width * 4, false, nullptr,
+                DitherAt(0, y));
+        }
+        return true;
+    }
+
+    if (generation != gen || !InitGLFW())
+        return false;
+
+    GLToneMapParams params;
+    params.format = key.format;
+    params.exposure = key.exposure;
+    params.whitePoint = key.whitePoint;
+
+    for (int y0 = 0; y0 < key.height; y0 += kSpecGLRows)
+    {
+        if (generation != gen)
+            return false;
+
+        int rows = std::min(kSpecGLRows, key.height - y0);
+        params.endFrame = y0 + rows == key.height;
+        GLThreadRun([&]
+        {
+            RenderToneMap(pixels.data() + (size_t)y0 * key.width * 3, key.width, rows,
+                output.data() + (size_t)y0 * key.width * bpp, params);
+        });
+    }
+    return true;
+}
+
+/* ============================================================
+   Procedure: SpeculateNext
+   ------------------------------------------------------------
+   Description:
+   Reports a slider change. Pre-renders the shown settings and
+   the next values the drag is likely to reach into the render
+   cache, in the background. ASM keys are not speculated (the
+   ASM backend lives outside this library), nor split keys
+   (where a band ends up depends on the GPU/CPU balance of the
+   frame, so a speculated render would not match a real one
+   bit for bit), nor keys of the CLAHE and local operators,
+   nor any while bloom is on.
+
+   Input parameters:
+   key            - Current settings (backend and format of the
+                    renders to prepare)
+   linearRGB      - Boosted linear RGB data of the key
+   exposureStep   - Exposure slider step (> 0, or 0 to keep it)
+   whitePointStep - White point slider step (> 0, or 0 to keep it)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void SpeculateNext(const RenderCacheKey* key, float* linearRGB, float exposureStep, float whitePointStep)
+{
+    if (!key || !linearRGB || key->width <= 0 || key->height <= 0 || key->backend == HDR_BACKEND_ASM
+        || key->backend == HDR_BACKEND_SPLIT || key->op != HDR_OPERATOR_REINHARD || BloomEnabled())
+        return;
+
+    Speculator::Instance().Submit(*key, linearRGB, exposureStep, whitePointStep);
+}
+
+/* ============================================================
+   Procedure: SpeculateCancel
+   ------------------------------------------------------------
+   Description:
+   Stops all speculative work and waits until it has stopped.
+   Called by every real request.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void SpeculateCancel()
+{
+    Speculator::Instance().Cancel();
+}
+
+/* ============================================================
+   Procedure: SpeculateShutdown
+   ------------------------------------------------------------
+   Description:
+   Stops the speculation thread and waits for it to exit. Must
+   be called before the library is unloaded (CleanupGLFW does);
+   SpeculateNext restarts the thread.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void SpeculateShutdown()
+{
+    Speculator::Instance().Shutdown();
+}
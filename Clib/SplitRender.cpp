@@ -0,0 +1,225 @@
+// ============================================================
+// File: SplitRender.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Heterogeneous rendering: one image is cut into row bands
+// that the GL backend takes from the top and the CPU pipeline
+// takes from the bottom at the same time, until they meet.
+// The GPU chunk size follows the measured GPU/CPU throughput
+// of previous frames, so both sides finish together.
+// ============================================================
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include "HDR.h"
+#include "Bloom.h"
+#include "CpuPipeline.h"
+#include "GLBackend.h"
+#include "GLThread.h"
+#include "Kernels.h"
+#include "Stats.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * kBandRows
+ * Height of one band in rows. A multiple of the dither tile
+ * height, so GPU and CPU bands dither with the same pattern.
+ * Range: > 0
+ */
+static const int kBandRows = 64;
+
+/*
+ * gGpuShare
+ * Estimated fraction of rows the GPU should take, smoothed
+ * over frames from measured rows per millisecond.
+ * Range: [0.02, 0.98]
+ */
+static double gGpuShare = 0.5;
+
+/*
+ * gSplitMutex
+ * Serializes split renders (they share gGpuShare and the
+ * whole thread pool anyway).
+ */
+static std::mutex gSplitMutex;
+
+/* ============================================================
+   Procedure: ToneMapSplit
+   ------------------------------------------------------------
+   Description:
+   Tone maps a linear HDR RGB image with the GPU and the CPU
+   working on disjoint row bands concurrently. The GPU runs in
+   CPU-compatible mode so the bands join without seams. Falls
+   back to ToneMapCPU if OpenGL is not available. Quality
+   counters of both sides are merged into one frame result.
+
+   Input parameters:
+   linearRGB   - Pointer to linear RGB float data (RGBRGB...)
+   width       - Image width in pixels (must be > 0)
+   height      - Image height in pixels (must be > 0)
+   exposure    - Exposure multiplier for tone mapping
+   whitePoint  - White point value for tone mapping
+
+   Output parameters:
+   outputBGRA  - Pointer to output BGRA8 image buffer
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void ToneMapSplit(
+    float* linearRGB,
+    int width,
+    int height,
+    unsigned char* outputBGRA,
+    float exposure,
+    float whitePoint)
+{
+    if (!linearRGB || !outputBGRA || width <= 0 || height <= 0)
+        return;
+
+    // Bloom crosses band edges, so it is rendered whole. The
+    // settings are read once and handed to every band: bloom
+    // switched on mid-frame must not reach only the later bands.
+    BloomSettings bloom = GetBloomSettings();
+    if (bloom.intensity > 0.0f || !InitGLFW())
+    {
+        ToneMapCPU(linearRGB, width, height, outputBGRA, exposure, whitePoint);
+        return;
+    }
+
+    std::lock_guard<std::mutex> splitLock(gSplitMutex);
+
+    int bands = (height + kBandRows - 1) / kBandRows;
+
+    // Bands [top, bottom) are still unclaimed
+    std::mutex claimMutex;
+    int top = 0;
+    int bottom = bands;
+
+    // About two GPU uploads per frame when the estimate is right,
+    // small CPU chunks so the meeting point is precise
+    int gpuChunk = std::max(1, (int)(gGpuShare * bands / 2.0 + 0.5));
+    int cpuChunk = std::max(1, (int)((1.0 - gGpuShare) * bands / 8.0 + 0.5));
+
+    GLToneMapParams params;
+    params.format = HDR_OUTPUT_BGRA8;
+    params.exposure = exposure;
+    params.whitePoint = whitePoint;
+    params.cpuCompatible = true;
+    params.bloom = &bloom;
+    // The GPU takes a varying number of chunks; the pool's frame
+    // ends once after the last of them
+    params.endFrame = false;
+
+    bool quality = StatsQualityEnabled();
+    QualityAccum gpuQuality;
+    QualityTotal cpuQuality;
+    params.quality = quality ? &gpuQuality : nullptr;
+
+    std::mutex doneMutex;
+    std::condition_variable doneCond;
+    bool gpuDone = false;
+    double gpuMs = 0.0;
+    int gpuRows = 0;
+
+    /* ----------------------------
+       GPU: bands from the top
+       ---------------------------- */
+    GLThreadPost([&]
+    {
+        for (;;)
+        {
+            int first, last;
+            {
+                std::lock_guard<std::mutex> lock(claimMutex);
+                first = top;
+                last = std::min(top + gpuChunk, bottom);
+                top = last;
+            }
+            if (first >= last)
+                break;
+
+            int y0 = first * kBandRows;
+            int rows = std::min(last * kBandRows, height) - y0;
+
+            double start = StatsNowMs();
+            RenderToneMap(linearRGB + (size_t)y0 * width * 3, width, rows,
+                outputBGRA + (size_t)y0 * width * 4, params);
+            gpuMs += StatsNowMs() - start;
+            gpuRows += rows;
+        }
+        if (gpuRows > 0)
+            RenderEndFrame();
+
+        std::lock_guard<std::mutex> lock(doneMutex);
+        gpuDone = true;
+        doneCond.notify_one();
+    });
+
+    /* ----------------------------
+       CPU: bands from the bottom
+       ---------------------------- */
+    double cpuMs = 0.0;
+    int cpuRows = 0;
+
+    for (;;)
+    {
+        int first, last;
+        {
+            std::lock_guard<std::mutex> lock(claimMutex);
+            last = bottom;
+            first = std::max(bottom - cpuChunk, top);
+            bottom = first;
+        }
+        if (first >= last)
+            break;
+
+        int y0 = first * kBandRows;
+        int rows = std::min(last * kBandRows, height) - y0;
+
+        double start = StatsNowMs();
+        ToneMapCPURun(linearRGB + (size_t)y0 * width * 3, width, rows,
+            outputBGRA + (size_t)y0 * width * 4, exposure, whitePoint, quality ? &cpuQuality : nullptr,
+            nullptr, nullptr, &bloom);
+        cpuMs += StatsNowMs() - start;
+        cpuRows += rows;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCond.wait(lock, [&] { return gpuDone; });
+    }
+
+    if (quality)
+    {
+        cpuQuality.Add(gpuQuality);
+        StatsQuality(cpuQuality.total);
+    }
+
+    /* ----------------------------
+       Adapt the split for the next frame
+       ---------------------------- */
+    double share = gGpuShare;
+    if (gpuRows > 0 && cpuRows > 0 && gpuMs > 0.0 && cpuMs > 0.0)
+    {
+        double gpuRate = gpuRows / gpuMs;
+        double cpuRate = cpuRows / cpuMs;
+        share = gpuRate / (gpuRate + cpuRate);
+    }
+    else if (gpuRows == 0)
+    {
+        share = gGpuShare * 0.5;
+    }
+    else
+    {
+        share = gGpuShare + (1.0 - gGpuShare) * 0.5;
+    }
+
+    gGpuShare = std::clamp(0.5 * gGpuShare + 0.5 * share, 0.02, 0.98);
+
+    StatsSplit(gGpuShare, gpuRows, gpuMs, cpuMs);
+}
@@ -0,0 +1,453 @@
+// ============================================================
+// File: StageGraph.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Native CPU pipeline driver. Replaces the chain of separate
+// full-image passes (copy, deinterleave, concat, tone map,
+// interleave, gamma/quantize) with one tiled loop: each tile is
+// read from the source once, runs through all fused stages in
+// two per-thread scratch buffers and is written to the sink.
+// ============================================================
+#include <algorithm>
+#include <cstring>
+#include "StageGraph.h"
+#include "Dither.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gTileSize
+ * Output tile size of fused loops. 256 x 16 keeps two 3-channel
+ * scratch tiles (2 x 48 KB) in L2 on all our machines. Width and
+ * height change together, as tuning may run beside a render.
+ * Range: > 0
+ */
+static std::atomic<StageTileSize> gTileSize{ StageTileSize{ 256, 16 } };
+
+/*
+ * Rect
+ * Pixel rectangle [x0, x0+w) x [y0, y0+h).
+ */
+struct Rect
+{
+    int x0, y0, w, h;
+};
+
+/* ============================================================
+   Procedure: GrowRect
+   ------------------------------------------------------------
+   Description:
+   Grows a rectangle by a halo and clips it to the image.
+   ============================================================ */
+static Rect GrowRect(const Rect& r, int halo, int width, int height)
+{
+    int x0 = std::max(r.x0 - halo, 0);
+    int y0 = std::max(r.y0 - halo, 0);
+    int x1 = std::min(r.x0 + r.w + halo, width);
+    int y1 = std::min(r.y0 + r.h + halo, height);
+    return { x0, y0, x1 - x0, y1 - y0 };
+}
+
+/* ============================================================
+   Procedure: MakeTile
+   ------------------------------------------------------------
+   Description:
+   Lays out a tile of the given channels and region in a
+   scratch buffer (planes one after another).
+   ============================================================ */
+static TileBuf MakeTile(float* memory, int channels, const Rect& r)
+{
+    TileBuf t = {};
+    t.channels = channels;
+    t.x0 = r.x0;
+    t.y0 = r.y0;
+    t.width = r.w;
+    t.height = r.h;
+    t.stride = r.w;
+    for (int c = 0; c < channels; c++)
+        t.planes[c] = memory + (size_t)c * r.w * r.h;
+    return t;
+}
+
+/* ============================================================
+   Procedure: CopyRegion
+   ------------------------------------------------------------
+   Description:
+   Copies the region of dst (all channels) from src. Both must
+   cover dst's rectangle.
+   ============================================================ */
+static void CopyRegion(const TileBuf& src, TileBuf& dst)
+{
+    for (int c = 0; c < dst.channels; c++)
+        for (int y = dst.y0; y < dst.y0 + dst.height; y++)
+            std::memcpy(dst.Row(c, y),
+                src.Row(c, y) + (dst.x0 - src.x0),
+                (size_t)dst.width * sizeof(float));
+}
+
+/* ============================================================
+   Procedure: StageGraph constructor
+   ------------------------------------------------------------
+   Input parameters:
+   width, height  - Image size in pixels (> 0)
+   sourceChannels - Channels produced by the source (1..4)
+   source         - Loader for source regions
+   ============================================================ */
+StageGraph::StageGraph(int width, int height, int sourceChannels, StageSource source)
+    : width(width), height(height), sourceChannels(sourceChannels),
+      regionWidth(width), regionHeight(height), tileSize(TileSize()),
+      source(std::move(source))
+{
+}
+
+/* ============================================================
+   Procedure: StageGraph::SetRegion
+   ------------------------------------------------------------
+   Description:
+   Sets the rectangle the sink receives. Only the last fused
+   sweep is restricted to it; its tiles still load the halo the
+   stages need from the full image.
+
+   Input parameters:
+   x0, y0        - Top left pixel (clipped to the image)
+   width, height - Size in pixels (clipped to the image)
+   ============================================================ */
+void StageGraph::SetRegion(int x0, int y0, int w, int h)
+{
+    Rect r = GrowRect({ x0, y0, w, h }, 0, width, height);
+    regionX0 = r.x0;
+    regionY0 = r.y0;
+    regionWidth = std::max(r.w, 0);
+    regionHeight = std::max(r.h, 0);
+}
+
+/* ============================================================
+   Procedure: StageGraph::AddStage / SetSink
+   ------------------------------------------------------------
+   Description:
+   Appends a stage to the chain / sets the consumer of the
+   final stage output.
+   ============================================================ */
+void StageGraph::AddStage(Stage stage)
+{
+    stages.push_back(std::move(stage));
+}
+
+void StageGraph::SetSink(StageSink s)
+{
+    sink = std::move(s);
+}
+
+/* ============================================================
+   Procedure: StageGraph::SetTileFilter
+   ------------------------------------------------------------
+   Description:
+   Sets the predicate the sink sweep asks before loading each
+   tile. It runs on the worker threads, right before the tile
+   would be loaded, so work it does on the source region (e.g.
+   hashing it) shares the cache with the tile load.
+   ============================================================ */
+void StageGraph::SetTileFilter(StageTileFilter filter)
+{
+    tileFilter = std::move(filter);
+}
+
+/* ============================================================
+   Procedure: StageGraph::SetTileSize
+   ------------------------------------------------------------
+   Description:
+   Sets the output tile size of fused loops. Graphs already
+   constructed keep the size they took.
+
+   Input parameters:
+   tileWidth, tileHeight - Tile size in pixels (ignored if <= 0)
+   ============================================================ */
+void StageGraph::SetTileSize(int tileWidth, int tileHeight)
+{
+    StageTileSize size = gTileSize.load();
+    StageTileSize next;
+    do
+    {
+        next.width = tileWidth > 0 ? tileWidth : size.width;
+        next.height = tileHeight > 0 ? tileHeight : size.height;
+    } while (!gTileSize.compare_exchange_weak(size, next));
+}
+
+StageTileSize StageGraph::TileSize()
+{
+    return gTileSize.load();
+}
+
+/* ============================================================
+   Procedure: StageGraph::AcquireImage / ReleaseImage
+   ------------------------------------------------------------
+   Description:
+   Full-size intermediate images. A released image is reused by
+   the next request with the same channel count, so a chain of
+   global stages needs at most two of them.
+   ============================================================ */
+StageGraph::Image* StageGraph::AcquireImage(int channels)
+{
+    for (size_t i = 0; i < freeImages.size(); i++)
+    {
+        if (freeImages[i]->channels == channels)
+        {
+            Image* image = freeImages[i];
+            freeImages.erase(freeImages.begin() + i);
+            return image;
+        }
+    }
+
+    Image* image = new Image();
+    image->channels = channels;
+    image->data.resize((size_t)channels * width * height);
+    allImages.push_back(image);
+
+    liveBytes += (long long)image->data.size() * sizeof(float);
+    return image;
+}
+
+void StageGraph::ReleaseImage(Image* image)
+{
+    if (image)
+        freeImages.push_back(image);
+}
+
+/* ============================================================
+   Procedure: StageGraph::RunFused
+   ------------------------------------------------------------
+   Description:
+   One tiled sweep over the image running stages [first, last)
+   back to back. For each output tile the region every stage
+   must produce is computed backwards (grown by the radius of
+   the stages after it), the source region is loaded, and each
+   stage writes into the other scratch buffer (or in place for
+   pointwise stages that keep the channel count).
+
+   Input parameters:
+   first, last - Stage range (may be empty: plain copy)
+   input       - Intermediate image to read, or nullptr for the source
+
+   Output parameters:
+   output      - Intermediate image to write, or nullptr for the sink
+   ============================================================ */
+void StageGraph::RunFused(size_t first, size_t last, const Image* input, Image* output)
+{
+    int inChannels = input ? input->channels : sourceChannels;
+
+    int halo = 0;
+    int maxChannels = inChannels;
+    for (size_t s = first; s < last; s++)
+    {
+        halo += stages[s].radius;
+        maxChannels = std::max(maxChannels, stages[s].channels);
+    }
+
+    // The sink sweep covers the region, sweeps into images all of it
+    Rect area = { 0, 0, width, height };
+    if (!output)
+        area = { regionX0, regionY0, regionWidth, regionHeight };
+    if (area.w <= 0 || area.h <= 0)
+        return;
+
+    int tileW = std::min(tileSize.width, area.w);
+    int tileH = std::min(tileSize.height, area.h);
+    int tilesX = (area.w + tileW - 1) / tileW;
+    int tilesY = (area.h + tileH - 1) / tileH;
+    size_t scratchFloats = (size_t)(tileW + 2 * halo) * (tileH + 2 * halo) * maxChannels;
+
+    ThreadPool& pool = ThreadPool::Instance();
+    long long scratchBytes = (long long)scratchFloats * sizeof(float) * 2 * pool.ThreadCount();
+    peakBytes = std::max(peakBytes, liveBytes + scratchBytes);
+
+    TileBuf inView = {};
+    if (input)
+        inView = MakeTile(const_cast<float*>(input->data.data()), input->channels, { 0, 0, width, height });
+
+    pool.ParallelFor(tilesX * tilesY, [&](int t)
+    {
+        thread_local std::vector<float> scratch[2];
+        for (auto& s : scratch)
+            if (s.size() < scratchFloats)
+                s.resize(scratchFloats);
+
+        // Region each stage must produce, from the output tile backwards
+        size_t count = last - first;
+        std::vector<Rect> need(count + 1);
+        need[count] = { area.x0 + (t % tilesX) * tileW, area.y0 + (t / tilesX) * tileH, 0, 0 };
+        need[count].w = std::min(tileW, area.x0 + area.w - need[count].x0);
+        need[count].h = std::min(tileH, area.y0 + area.h - need[count].y0);
+        for (size_t s = count; s > 0; s--)
+            need[s - 1] = GrowRect(need[s], stages[first + s - 1].radius, width, height);
+
+        if (tileFilter && !input && !output &&
+            !tileFilter(t, need[0].x0, need[0].y0, need[0].w, need[0].h))
+            return;
+
+        // Load
+        int which = 0;
+        TileBuf cur = MakeTile(scratch[which].data(), inChannels, need[0]);
+        if (input)
+            CopyRegion(inView, cur);
+        else
+            source(cur);
+
+        // Stages
+        for (size_t s = 0; s < count; s++)
+        {
+            const Stage& stage = stages[first + s];
+            if (stage.radius == 0 && stage.channels == cur.channels)
+            {
+                stage.run(cur, cur);
+            }
+            else
+            {
+                which ^= 1;
+                TileBuf next = MakeTile(scratch[which].data(), stage.channels, need[s + 1]);
+                stage.run(cur, next);
+                cur = next;
+            }
+        }
+
+        // Store
+        if (output)
+        {
+            TileBuf outView = MakeTile(output->data.data(), output->channels, { 0, 0, width, height });
+            TileBuf region = outView;
+            region.x0 = cur.x0;
+            region.y0 = cur.y0;
+            region.width = cur.width;
+            region.height = cur.height;
+            for (int c = 0; c < region.channels; c++)
+                region.planes[c] = outView.Row(c, cur.y0) + cur.x0;
+
+            CopyRegion(cur, region);
+        }
+        else
+        {
+            sink(cur);
+        }
+    });
+
+    passes++;
+}
+
+/* ============================================================
+   Procedure: StageGraph::Run
+   ------------------------------------------------------------
+   Description:
+   Splits the chain at global stages and runs each part: a
+   fused sweep up to the global stage into an intermediate
+   image, the global stage on whole images, and so on until
+   the last fused sweep writes to the sink.
+
+   Output parameters:
+   Returns false if no sink has been set.
+   ============================================================ */
+bool StageGraph::Run()
+{
+    if (!sink)
+        return false;
+
+    passes = 0;
+    peakBytes = 0;
+
+    Image* input = nullptr;
+    size_t i = 0;
+
+    for (;;)
+    {
+        size_t j = i;
+        while (j < stages.size() && !stages[j].global)
+            j++;
+
+        if (j == stages.size())
+        {
+            RunFused(i, j, input, nullptr);
+            ReleaseImage(input);
+            break;
+        }
+
+        // Materialize the input of the global stage
+        Image* mid = input;
+        if (j > i || !input)
+        {
+            int channels = j > i ? stages[j - 1].channels : sourceChannels;
+            mid = AcquireImage(channels);
+            RunFused(i, j, input, mid);
+            ReleaseImage(input);
+        }
+
+        Image* out = AcquireImage(stages[j].channels);
+        peakBytes = std::max(peakBytes, liveBytes);
+
+        TileBuf inView = MakeTile(mid->data.data(), mid->channels, { 0, 0, width, height });
+        TileBuf outView = MakeTile(out->data.data(), out->channels, { 0, 0, width, height });
+        stages[j].run(inView, outView);
+        passes++;
+
+        ReleaseImage(mid);
+        input = out;
+        i = j + 1;
+    }
+
+    for (Image* image : allImages)
+        delete image;
+    allImages.clear();
+    freeImages.clear();
+    liveBytes = 0;
+
+    return true;
+}
+
+/* ============================================================
+   Procedure: StageGraph::InterleavedRGBSource
+   ------------------------------------------------------------
+   Description:
+   Source that deinterleaves a region of an RGBRGB... float
+   image straight into the tile (copy + deinterleave + concat
+   in one step).
+   ============================================================ */
+StageSource StageGraph::InterleavedRGBSource(const float* rgb, int width)
+{
+    return [rgb, width](TileBuf& out)
+    {
+        for (int y = out.y0; y < out.y0 + out.height; y++)
+        {
+            const float* src = rgb + ((size_t)y * width + out.x0) * 3;
+            DeinterleaveRGB(src, out.width, out.Row(0, y), out.Row(1, y), out.Row(2, y));
+        }
+    };
+}
+
+/* ============================================================
+   Procedure: StageGraph::BGRA8Sink
+   ------------------------------------------------------------
+   Description:
+   Sink that interleaves, gamma encodes and quantizes a tile
+   into a BGRA8 image in one step. Streaming stores pay off
+   for outputs much larger than the cache. Clip counts are
+   gathered per tile and merged once per tile.
+   ============================================================ */
+StageSink StageGraph::BGRA8Sink(unsigned char* bgra, int width, bool stream, QualityTotal* quality)
+{
+    return [bgra, width, stream, quality](const TileBuf& in)
+    {
+        QualityAccum tile;
+        for (int y = in.y0; y < in.y0 + in.height; y++)
+        {
+            unsigned char* dst = bgra + ((size_t)y * width + in.x0) * 4;
+            StoreBGRA8(in.Row(0, y), in.Row(1, y), in.Row(2, y), in.width, dst, stream,
+                quality ? &tile : nullptr, DitherAt(in.x0, y));
+        }
+        if (quality)
+            quality->Add(tile);
+    };
+}
@@ -0,0 +1,136 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct QualityTotal;
+
+// Rectangle of planar float channels in image coordinates.
+// Plane c, pixel (x, y) is planes[c][(y - y0) * stride + (x - x0)].
+struct TileBuf
+{
+	float* planes[4];
+	int channels;
+	int x0;
+	int y0;
+	int width;
+	int height;
+	int stride;
+
+	float* Row(int c, int y) const { return planes[c] + (size_t)(y - y0) * stride; }
+};
+
+// One processing step of the CPU pipeline
+struct Stage
+{
+	std::string name;
+	// Channels written by the stage (input channels = previous stage's)
+	int channels = 3;
+	// Neighbourhood radius read around each output pixel (0 = pointwise)
+	int radius = 0;
+	// Needs the whole image at once (e.g. large blurs, reductions)
+	bool global = false;
+	// Produces the out region from in (in covers out grown by radius, clipped
+	// to the image). Pointwise stages with unchanged channel count get in == out.
+	std::function<void(const TileBuf& in, TileBuf& out)> run;
+};
+
+// Output tile size of fused loops
+struct StageTileSize
+{
+	int width;
+	int height;
+};
+
+// Fills a region of the source image into planar channels
+using StageSource = std::function<void(TileBuf& out)>;
+
+// Consumes a finished region of the last stage
+using StageSink = std::function<void(const TileBuf& in)>;
+
+// Decides whether an output tile is computed at all. Gets the tile's
+// index in the sweep and the source rectangle it reads (the tile
+// grown by the halo of the stages); false skips the tile.
+using StageTileFilter = std::function<bool(int tile, int x0, int y0, int width, int height)>;
+
+// Runs a chain of stages. Consecutive non-global stages are fused
+// into one tiled loop over the image: each tile is loaded once,
+// passed through every stage in cache-sized scratch buffers (grown
+// by the halo the following stages need) and written once. Global
+// stages split the chain; the full-size buffers around them are
+// pooled and reused as soon as their last reader has finished.
+class StageGraph
+{
+public:
+	StageGraph(int width, int height, int sourceChannels, StageSource source);
+
+	void AddStage(Stage stage);
+	void SetSink(StageSink sink);
+
+	// Restricts the output of Run to a rectangle (default: the whole
+	// image). Halos are still read from outside it, so a region of a
+	// local stage matches the same pixels of a full run. Stages up to
+	// the last global one always run on the whole image.
+	void SetRegion(int x0, int y0, int width, int height);
+
+	// Lets the filter skip output tiles whose result the sink already
+	// has. Applies when the sink sweep reads the source, i.e. to
+	// chains without global stages.
+	void SetTileFilter(StageTileFilter filter);
+
+	// Runs the whole chain; returns false if no sink was set
+	bool Run();
+
+	// Full-image sweeps of the last Run (fused loops + global stages)
+	int Passes() const { return passes; }
+	// Peak bytes of scratch and intermediate images during the last Run
+	long long PeakBytes() const { return peakBytes; }
+
+	// Tile size used by the fused loops (defaults 256 x 16). Graphs
+	// take it when constructed, so a change affects later graphs only.
+	static void SetTileSize(int width, int height);
+	static StageTileSize TileSize();
+
+	// Source reading interleaved RGB floats (RGBRGB...)
+	static StageSource InterleavedRGBSource(const float* rgb, int width);
+	// Sink writing gamma-encoded BGRA8 (LinearRGBToBitmap layout),
+	// with non-temporal stores if stream is set; counts clipped
+	// channels into quality if given
+	static StageSink BGRA8Sink(unsigned char* bgra, int width, bool stream = false,
+		QualityTotal* quality = nullptr);
+
+private:
+	struct Image
+	{
+		std::vector<float> data;
+		int channels = 0;
+	};
+
+	void RunFused(size_t first, size_t last, const Image* input, Image* output);
+	Image* AcquireImage(int channels);
+	void ReleaseImage(Image* image);
+
+	int width;
+	int height;
+	int sourceChannels;
+	int regionX0 = 0;
+	int regionY0 = 0;
+	int regionWidth;
+	int regionHeight;
+	StageTileSize tileSize;
+	StageSource source;
+	StageSink sink;
+	StageTileFilter tileFilter;
+	std::vector<Stage> stages;
+
+	std::vector<Image*> freeImages;
+	std::vector<Image*> allImages;
+	long long liveBytes = 0;
+	long long peakBytes = 0;
+	int passes = 0;
+};
+
+#endif
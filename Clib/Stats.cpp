@@ -0,0 +1,321 @@
+// ============================================================
+// File: Stats.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Library-wide statistics. Modules report events through the
+// Stats* helpers; callers read a snapshot with GetHDRStats.
+// ============================================================
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Stats.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gStatsMutex
+ * Protects gStats; events can arrive from any thread.
+ */
+static std::mutex gStatsMutex;
+
+/*
+ * gStats
+ * Current counters.
+ */
+static HDRStats gStats = {};
+
+/*
+ * gQualityEnabled
+ * Renders gather quality counters (EnableQualityStats).
+ * Range: default false
+ */
+static std::atomic<bool> gQualityEnabled{ false };
+
+/*
+ * gQuality / gQualityValid
+ * Quality counters of the last render, protected by gStatsMutex.
+ */
+static HDRQualityStats gQuality = {};
+static bool gQualityValid = false;
+
+/* ============================================================
+   Procedure: StatsNowMs
+   ------------------------------------------------------------
+   Description:
+   Returns a monotonic timestamp in milliseconds.
+   ============================================================ */
+double StatsNowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+/* ============================================================
+   Procedure: StatsWarmUpStarted
+   ------------------------------------------------------------
+   Description:
+   Marks the OpenGL warm-up as running.
+   ============================================================ */
+void StatsWarmUpStarted()
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.warmUpState = HDR_WARMUP_RUNNING;
+    gStats.warmUpMs = 0.0;
+}
+
+/* ============================================================
+   Procedure: StatsWarmUpFinished
+   ------------------------------------------------------------
+   Description:
+   Stores the warm-up result.
+
+   Input parameters:
+   ok - true if the context and shaders were created
+   ms - Time from WarmUpGLAsync to completion
+   ============================================================ */
+void StatsWarmUpFinished(bool ok, double ms)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.warmUpState = ok ? HDR_WARMUP_DONE : HDR_WARMUP_FAILED;
+    gStats.warmUpMs = ms;
+}
+
+/* ============================================================
+   Procedure: StatsGpuPool
+   ------------------------------------------------------------
+   Description:
+   Stores the GL texture pool usage.
+
+   Input parameters:
+   textures    - Textures held by the pool
+   bytes       - GPU memory held by the pool
+   allocations - Textures created since start-up
+   ============================================================ */
+void StatsGpuPool(int textures, long long bytes, long long allocations)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.gpuPoolTextures = textures;
+    gStats.gpuPoolBytes = bytes;
+    gStats.gpuAllocations = allocations;
+}
+
+/* ============================================================
+   Procedure: StatsCpuRun
+   ------------------------------------------------------------
+   Description:
+   Stores the shape of the last CPU pipeline run.
+
+   Input parameters:
+   passes    - Full-image sweeps
+   peakBytes - Peak scratch + intermediate memory
+   ============================================================ */
+void StatsCpuRun(int passes, long long peakBytes)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.cpuPasses = passes;
+    gStats.cpuPeakBytes = peakBytes;
+}
+
+/* ============================================================
+   Procedure: StatsSplit
+   ------------------------------------------------------------
+   Description:
+   Stores the last CPU+GPU split frame.
+
+   Input parameters:
+   gpuShare - Updated GPU row fraction estimate
+   gpuRows  - Rows rendered by the GPU
+   gpuMs    - GPU busy time
+   cpuMs    - CPU busy time
+   ============================================================ */
+void StatsSplit(double gpuShare, int gpuRows, double gpuMs, double cpuMs)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.splitGpuShare = gpuShare;
+    gStats.splitGpuRows = gpuRows;
+    gStats.splitGpuMs = gpuMs;
+    gStats.splitCpuMs = cpuMs;
+}
+
+/* ============================================================
+   Procedure: StatsCache
+   ------------------------------------------------------------
+   Description:
+   Stores the render cache counters.
+   ============================================================ */
+void StatsCache(long long hits, long long misses, int entries, long long bytes)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.cacheHits = hits;
+    gStats.cacheMisses = misses;
+    gStats.cacheEntries = entries;
+    gStats.cacheBytes = bytes;
+}
+
+/* ============================================================
+   Procedure: StatsSpeculationRender
+   ------------------------------------------------------------
+   Description:
+   Counts a speculative render. Time of a cancelled render is
+   wasted right away; a completed one only if it is evicted
+   unused (StatsSpeculationWasted).
+
+   Input parameters:
+   completed - true if the render reached the cache
+   ms        - Time spent on it
+   ============================================================ */
+void StatsSpeculationRender(bool completed, double ms)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    if (completed)
+    {
+        gStats.specRenders++;
+    }
+    else
+    {
+        gStats.specCancelled++;
+        gStats.specWastedMs += ms;
+    }
+}
+
+/* ============================================================
+   Procedure: StatsSpeculationHit / StatsSpeculationWasted
+   ============================================================ */
+void StatsSpeculationHit()
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.specHits++;
+}
+
+void StatsSpeculationWasted(double ms)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.specWastedMs += ms;
+}
+
+/* ============================================================
+   Procedure: StatsTiles
+   ------------------------------------------------------------
+   Description:
+   Stores the tile cache counters.
+   ============================================================ */
+void StatsTiles(long long hits, long long misses, long long coalesced, int entries, long long bytes)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.tileHits = hits;
+    gStats.tileMisses = misses;
+    gStats.tileCoalesced = coalesced;
+    gStats.tileEntries = entries;
+    gStats.tileBytes = bytes;
+}
+
+/* ============================================================
+   Procedure: StatsSequence
+   ============================================================ */
+void StatsSequence(long long skipped, long long rendered)
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStats.seqTilesSkipped += skipped;
+    gStats.seqTilesRendered += rendered;
+}
+
+/* ============================================================
+   Procedure: StatsQualityEnabled / StatsQuality
+   ------------------------------------------------------------
+   Description:
+   StatsQuality converts merged counters into HDRQualityStats
+   and keeps them as the last render's. Luminance figures stay
+   0 if no pixel was finite.
+   ============================================================ */
+bool StatsQualityEnabled()
+{
+    return gQualityEnabled;
+}
+
+void StatsQuality(const QualityAccum& quality)
+{
+    HDRQualityStats stats = {};
+    stats.pixels = quality.pixels;
+    stats.nonFinite = quality.nonFinite;
+    for (int c = 0; c < 3; c++)
+    {
+        stats.clipHigh[c] = quality.clipHigh[c];
+        stats.clipLow[c] = quality.clipLow[c];
+    }
+
+    long long finite = quality.pixels - quality.nonFinite;
+    if (finite > 0 && quality.minIn <= quality.maxIn)
+    {
+        stats.lumMinIn = quality.minIn;
+        stats.lumMaxIn = quality.maxIn;
+        stats.lumMeanIn = quality.sumIn / finite;
+        stats.lumMinOut = quality.minOut;
+        stats.lumMaxOut = quality.maxOut;
+        stats.lumMeanOut = quality.sumOut / finite;
+    }
+
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gQuality = stats;
+    gQualityValid = true;
+}
+
+/* ============================================================
+   Procedure: EnableQualityStats
+   ------------------------------------------------------------
+   Description:
+   Turns quality counters on or off for following CPU, split
+   and GL renders. They are gathered in the same pass as the
+   tone mapping (GL: one extra reduction over the output).
+
+   Input parameters:
+   enable - true to gather counters (default off)
+   ============================================================ */
+extern "C" __declspec(dllexport) void EnableQualityStats(bool enable)
+{
+    gQualityEnabled = enable;
+}
+
+/* ============================================================
+   Procedure: GetQualityStats
+   ------------------------------------------------------------
+   Description:
+   Copies the quality counters of the last render made with
+   counters enabled. Cache hits do not render and keep them.
+
+   Output parameters:
+   stats - Receives the counters
+   Returns false if no such render has happened yet.
+   ============================================================ */
+extern "C" __declspec(dllexport) bool GetQualityStats(HDRQualityStats* stats)
+{
+    if (!stats)
+        return false;
+
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    *stats = gQuality;
+    return gQualityValid;
+}
+
+/* ============================================================
+   Procedure: GetHDRStats
+   ------------------------------------------------------------
+   Description:
+   Copies the current statistics into a caller-owned struct.
+
+   Output parameters:
+   stats - Receives the snapshot (ignored if nullptr)
+   ============================================================ */
+extern "C" __declspec(dllexport) void GetHDRStats(HDRStats* stats)
+{
+    if (!stats)
+        return;
+
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    *stats = gStats;
+}
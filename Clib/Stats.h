@@ -0,0 +1,46 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "HDR.h"
+#include "Kernels.h"
+
+// Returns a monotonic timestamp in milliseconds.
+double StatsNowMs();
+
+// Records the start and the result of the OpenGL warm-up.
+void StatsWarmUpStarted();
+void StatsWarmUpFinished(bool ok, double ms);
+
+// Records the state of the GL texture pool after a render.
+void StatsGpuPool(int textures, long long bytes, long long allocations);
+
+// Records the pass count and peak memory of a CPU pipeline run.
+void StatsCpuRun(int passes, long long peakBytes);
+
+// Records the outcome of a CPU+GPU split frame.
+void StatsSplit(double gpuShare, int gpuRows, double gpuMs, double cpuMs);
+
+// Records the render cache counters.
+void StatsCache(long long hits, long long misses, int entries, long long bytes);
+
+// Records a finished or cancelled speculative render.
+void StatsSpeculationRender(bool completed, double ms);
+
+// Records a cache hit on a speculative render / a speculative
+// render evicted before it was used.
+void StatsSpeculationHit();
+void StatsSpeculationWasted(double ms);
+
+// Records the tile cache counters.
+void StatsTiles(long long hits, long long misses, long long coalesced, int entries, long long bytes);
+
+// Adds the tiles a sequence frame skipped / tone mapped.
+void StatsSequence(long long skipped, long long rendered);
+
+// True if renders should gather quality counters.
+bool StatsQualityEnabled();
+
+// Stores the quality counters of the last render.
+void StatsQuality(const QualityAccum& quality);
+
+#endif
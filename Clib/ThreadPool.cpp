@@ -0,0 +1,155 @@
+// ============================================================
+// File: ThreadPool.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Worker threads for the native CPU pipeline. ParallelFor
+// hands out indices (tiles, row bands) dynamically, so fast
+// threads take over work from slow ones.
+// ============================================================
+#include <atomic>
+#include "ThreadPool.h"
+
+/* ============================================================
+   Procedure: ThreadPool::Instance
+   ------------------------------------------------------------
+   Description:
+   Returns the process-wide pool. One thread less than the
+   hardware count is started because the caller also works.
+   ============================================================ */
+ThreadPool& ThreadPool::Instance()
+{
+    static ThreadPool pool((int)std::thread::hardware_concurrency() - 1);
+    return pool;
+}
+
+/* ============================================================
+   Procedure: ThreadPool constructor / destructor
+   ------------------------------------------------------------
+   Description:
+   Starts / joins the worker threads.
+
+   Input parameters:
+   threads - Number of workers (< 0 treated as 0)
+   ============================================================ */
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back([this] { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+
+    for (std::thread& t : workers)
+        t.join();
+}
+
+/* ============================================================
+   Procedure: ThreadPool::ThreadCount
+   ------------------------------------------------------------
+   Description:
+   Returns the threads ParallelFor uses: the workers plus the
+   caller, limited by SetMaxThreads.
+   ============================================================ */
+int ThreadPool::ThreadCount() const
+{
+    int all = (int)workers.size() + 1;
+    int limit = maxThreads;
+    return limit > 0 && limit < all ? limit : all;
+}
+
+/* ============================================================
+   Procedure: ThreadPool::WorkerLoop
+   ------------------------------------------------------------
+   Description:
+   Executes queued jobs until the pool is destroyed.
+   ============================================================ */
+void ThreadPool::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+/* ============================================================
+   Procedure: ThreadPool::ParallelFor
+   ------------------------------------------------------------
+   Description:
+   Calls fn for every index in [0, count). Indices are taken
+   from a shared counter by the workers and the calling thread.
+   Must not be nested inside another ParallelFor.
+
+   Input parameters:
+   count - Number of work items (>= 0)
+   fn    - Work item callback; must be thread-safe
+   ============================================================ */
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& fn)
+{
+    if (count <= 0)
+        return;
+
+    int helpers = ThreadCount() - 1;
+    if (helpers > count - 1)
+        helpers = count - 1;
+
+    if (helpers <= 0)
+    {
+        for (int i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    std::atomic<int> active(helpers);
+    std::mutex doneMutex;
+    std::condition_variable doneCond;
+
+    auto drain = [&]
+    {
+        for (int i = next++; i < count; i = next++)
+            fn(i);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int h = 0; h < helpers; h++)
+        {
+            jobs.push_back([&]
+            {
+                drain();
+
+                // Decrement under the lock so the caller cannot return
+                // (and destroy doneCond) between the decrement and notify
+                std::lock_guard<std::mutex> doneLock(doneMutex);
+                if (--active == 0)
+                    doneCond.notify_one();
+            });
+        }
+    }
+    cond.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCond.wait(lock, [&] { return active.load() == 0; });
+}
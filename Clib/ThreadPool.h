@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by all CPU kernels
+class ThreadPool
+{
+public:
+	// Process-wide pool sized to the hardware thread count
+	static ThreadPool& Instance();
+
+	explicit ThreadPool(int threads);
+	~ThreadPool();
+
+	// Runs fn(0..count-1) on the workers and the calling thread; returns when all are done
+	void ParallelFor(int count, const std::function<void(int)>& fn);
+
+	// Number of threads taking part in ParallelFor (workers + caller)
+	int ThreadCount() const;
+
+	// Limits ParallelFor to at most threads participants (0 = all)
+	void SetMaxThreads(int threads) { maxThreads = threads; }
+	int MaxThreads() const { return maxThreads; }
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool stopping = false;
+	std::atomic<int> maxThreads{ 0 };
+};
+
+#endif
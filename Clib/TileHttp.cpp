@@ -0,0 +1,432 @@
+// ============================================================
+// File: TileHttp.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Local HTTP front end of the lazy tile server, for trying the
+// pyramid in a Deep Zoom viewer (e.g. OpenSeadragon pointed at
+// http://127.0.0.1:<port>/image.dzi). Connections are served by
+// a fixed set of worker threads, so simultaneous requests for
+// one tile exercise the request coalescing of the tile cache
+// while a burst of connections cannot start unbounded threads.
+// Reads and writes time out, and stopping shuts down the
+// connections being served, so an idle client (a browser's
+// preconnect socket) cannot hold the server open. Listens on
+// the loopback interface only.
+// ============================================================
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "HDR.h"
+#include "TileServer.h"
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+static const int kShutdownBoth = SD_BOTH;
+#else
+using SocketHandle = int;
+static const SocketHandle INVALID_SOCKET = -1;
+static const int kShutdownBoth = SHUT_RDWR;
+static int closesocket(SocketHandle s) { return close(s); }
+#endif
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Connection worker threads
+static const int kWorkers = 8;
+
+// Accepted connections waiting for a worker; more are refused
+static const size_t kMaxPending = 256;
+
+// Read / write timeout of a connection (ms)
+static const int kSocketTimeoutMs = 5000;
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gHttpMutex / gHttpCond
+ * Protect the server state; workers wait on gHttpCond for
+ * pending connections.
+ */
+static std::mutex gHttpMutex;
+static std::condition_variable gHttpCond;
+
+/*
+ * gListenSocket / gAcceptThread
+ * Listening socket and the thread accepting on it.
+ */
+static SocketHandle gListenSocket = INVALID_SOCKET;
+static std::thread gAcceptThread;
+
+/*
+ * gHttpStopping
+ * Set by TileServerStop; the accept loop polls it.
+ */
+static std::atomic<bool> gHttpStopping{ false };
+
+/*
+ * gWorkers
+ * Connection worker threads (kWorkers while running).
+ */
+static std::vector<std::thread> gWorkers;
+
+/*
+ * gPending / gActive
+ * Accepted connections waiting for a worker, and those being
+ * served; TileServerStop closes the first and shuts down the
+ * second. Guarded by gHttpMutex.
+ */
+static std::deque<SocketHandle> gPending;
+static std::unordered_set<SocketHandle> gActive;
+
+/*
+ * gHttpSource / gHttpExposure / gHttpWhitePoint
+ * Source served and the settings used when a request has no
+ * exposure / whitePoint query parameter.
+ */
+static int gHttpSource = 0;
+static float gHttpExposure = 1.0f;
+static float gHttpWhitePoint = 4.0f;
+
+/* ============================================================
+   Procedure: SetSocketTimeouts
+   ------------------------------------------------------------
+   Description:
+   Limits every recv and send on a connection to
+   kSocketTimeoutMs, so a client that stops talking releases
+   its worker.
+   ============================================================ */
+static void SetSocketTimeouts(SocketHandle s)
+{
+#ifdef _WIN32
+    DWORD timeout = kSocketTimeoutMs;
+#else
+    timeval timeout = { kSocketTimeoutMs / 1000, (kSocketTimeoutMs % 1000) * 1000 };
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+/* ============================================================
+   Procedure: SendAll
+   ============================================================ */
+static bool SendAll(SocketHandle s, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t chunk = size < ((size_t)1 << 20) ? size : ((size_t)1 << 20);
+        int n = send(s, data, (int)chunk, 0);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* ============================================================
+   Procedure: SendResponse
+   ------------------------------------------------------------
+   Description:
+   Writes a complete HTTP/1.1 response and asks the client to
+   close the connection.
+   ============================================================ */
+static void SendResponse(SocketHandle s, const char* status, const char* type,
+    const void* body, size_t size)
+{
+    char header[256];
+    int n = std::snprintf(header, sizeof(header),
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: close\r\n\r\n", status, type, size);
+
+    if (SendAll(s, header, (size_t)n) && size > 0)
+        SendAll(s, (const char*)body, size);
+}
+
+/* ============================================================
+   Procedure: QueryFloat
+   ------------------------------------------------------------
+   Description:
+   Value of name=<float> in a query string, or fallback.
+   ============================================================ */
+static float QueryFloat(const std::string& query, const char* name, float fallback)
+{
+    std::string key = std::string(name) + "=";
+    size_t pos = 0;
+    while ((pos = query.find(key, pos)) != std::string::npos)
+    {
+        if (pos == 0 || query[pos - 1] == '&')
+            return (float)std::atof(query.c_str() + pos + key.size());
+        pos += key.size();
+    }
+    return fallback;
+}
+
+/* ============================================================
+   Procedure: HandleConnection
+   ------------------------------------------------------------
+   Description:
+   Serves one request:
+     GET /image.dzi                              - descriptor
+     GET /image_files/<level>/<col>_<row>.png    - tile
+   with optional ?exposure=<f>&whitePoint=<f> on tiles.
+   ============================================================ */
+static void HandleConnection(SocketHandle s)
+{
+    // Only the request line is needed; it fits the first read
+    char buffer[2048];
+    int n = recv(s, buffer, sizeof(buffer) - 1, 0);
+    if (n > 0)
+    {
+        buffer[n] = '\0';
+
+        char method[8] = {};
+        char target[1024] = {};
+        std::sscanf(buffer, "%7s %1023s", method, target);
+
+        std::string path = target;
+        std::string query;
+        size_t mark = path.find('?');
+        if (mark != std::string::npos)
+        {
+            query = path.substr(mark + 1);
+            path = path.substr(0, mark);
+        }
+
+        int level, col, row;
+        char tail[8] = {};
+
+        if (std::strcmp(method, "GET") != 0)
+        {
+            SendResponse(s, "405 Method Not Allowed", "text/plain", "", 0);
+        }
+        else if (path == "/image.dzi")
+        {
+            std::string xml = TileServerDescriptor(gHttpSource);
+            if (xml.empty())
+                SendResponse(s, "404 Not Found", "text/plain", "", 0);
+            else
+                SendResponse(s, "200 OK", "application/xml", xml.data(), xml.size());
+        }
+        else if (std::sscanf(path.c_str(), "/image_files/%d/%d_%d.%4s", &level, &col, &row, tail) == 4 &&
+            std::strcmp(tail, "png") == 0)
+        {
+            float exposure = QueryFloat(query, "exposure", gHttpExposure);
+            float whitePoint = QueryFloat(query, "whitePoint", gHttpWhitePoint);
+
+            TileBlobPtr tile = TileServerEncoded(gHttpSource, level, col, row, exposure, whitePoint);
+            if (tile)
+                SendResponse(s, "200 OK", "image/png", tile->png.data(), tile->png.size());
+            else
+                SendResponse(s, "404 Not Found", "text/plain", "", 0);
+        }
+        else
+        {
+            SendResponse(s, "404 Not Found", "text/plain", "", 0);
+        }
+    }
+}
+
+/* ============================================================
+   Procedure: WorkerLoop
+   ------------------------------------------------------------
+   Description:
+   Serves pending connections until the server stops. A
+   connection is listed in gActive while it is served, so Stop
+   can shut it down; it is closed only after leaving the list.
+   ============================================================ */
+static void WorkerLoop()
+{
+    for (;;)
+    {
+        SocketHandle client;
+        {
+            std::unique_lock<std::mutex> lock(gHttpMutex);
+            gHttpCond.wait(lock, [] { return gHttpStopping || !gPending.empty(); });
+            if (gHttpStopping)
+                return;
+
+            client = gPending.front();
+            gPending.pop_front();
+            gActive.insert(client);
+        }
+
+        HandleConnection(client);
+
+        {
+            std::lock_guard<std::mutex> lock(gHttpMutex);
+            gActive.erase(client);
+        }
+        closesocket(client);
+    }
+}
+
+/* ============================================================
+   Procedure: AcceptLoop
+   ------------------------------------------------------------
+   Description:
+   Accepts connections until stopped, polling the stop flag
+   every 100 ms, and queues each for the workers. With
+   kMaxPending connections already waiting a new one is
+   refused with 503.
+   ============================================================ */
+static void AcceptLoop()
+{
+    while (!gHttpStopping)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(gListenSocket, &readable);
+        timeval timeout = { 0, 100000 };
+
+        if (select((int)gListenSocket + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+            continue;
+
+        SocketHandle client = accept(gListenSocket, nullptr, nullptr);
+        if (client == INVALID_SOCKET)
+            continue;
+
+        SetSocketTimeouts(client);
+
+        {
+            std::lock_guard<std::mutex> lock(gHttpMutex);
+            if (gPending.size() < kMaxPending)
+            {
+                gPending.push_back(client);
+                gHttpCond.notify_one();
+                continue;
+            }
+        }
+
+        SendResponse(client, "503 Service Unavailable", "text/plain", "", 0);
+        closesocket(client);
+    }
+}
+
+/* ============================================================
+   Procedure: TileServerStart
+   ------------------------------------------------------------
+   Description:
+   Serves a tile source over HTTP on 127.0.0.1. Replaces a
+   server that is already running.
+
+   Input parameters:
+   source     - Id from TileSourceOpen
+   port       - TCP port
+   exposure   - Default exposure of tile requests
+   whitePoint - Default white point of tile requests
+
+   Output parameters:
+   Returns false if the port could not be opened.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool TileServerStart(int source, int port, float exposure, float whitePoint)
+{
+    TileServerStop();
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        return false;
+#endif
+
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET)
+        return false;
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(s, (sockaddr*)&address, sizeof(address)) != 0 || listen(s, 64) != 0)
+    {
+        closesocket(s);
+        return false;
+    }
+
+    gListenSocket = s;
+    gHttpSource = source;
+    gHttpExposure = exposure;
+    gHttpWhitePoint = whitePoint;
+    gHttpStopping = false;
+    for (int i = 0; i < kWorkers; i++)
+        gWorkers.emplace_back(WorkerLoop);
+    gAcceptThread = std::thread(AcceptLoop);
+    return true;
+}
+
+/* ============================================================
+   Procedure: TileServerStop
+   ------------------------------------------------------------
+   Description:
+   Stops accepting, closes connections still waiting, shuts
+   down those being served (their recv or send returns at
+   once) and waits for the workers, then closes the listening
+   socket. Does nothing if no server is running.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void TileServerStop()
+{
+    if (!gAcceptThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(gHttpMutex);
+        gHttpStopping = true;
+        gHttpCond.notify_all();
+    }
+    gAcceptThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(gHttpMutex);
+        for (SocketHandle client : gPending)
+            closesocket(client);
+        gPending.clear();
+
+        for (SocketHandle client : gActive)
+            shutdown(client, kShutdownBoth);
+    }
+
+    for (std::thread& worker : gWorkers)
+        worker.join();
+    gWorkers.clear();
+
+    closesocket(gListenSocket);
+    gListenSocket = INVALID_SOCKET;
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
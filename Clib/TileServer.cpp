@@ -0,0 +1,731 @@
+// ============================================================
+// File: TileServer.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Lazy Deep Zoom tile evaluation. Instead of tone mapping a
+// whole panorama up front, a tile of any level and any setting
+// is computed when it is requested: a full resolution cell is
+// tone mapped from the source, a coarser cell is averaged from
+// its four cells one level up (the same linear-light pyramid
+// ExportDeepZoom writes). Cells and encoded tiles stay in an
+// LRU cache and concurrent requests for one tile share a single
+// computation.
+// ============================================================
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "HDR.h"
+#include "DeepZoom.h"
+#include "Dither.h"
+#include "Grade.h"
+#include "Hash.h"
+#include "Kernels.h"
+#include "Lut.h"
+#include "Png.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "TileServer.h"
+#include "Tune.h"
+
+// The key is hashed as raw bytes, so it must not have padding
+static_assert(sizeof(TileKey) == 28, "TileKey must be tightly packed");
+
+/* ============================================================
+   TileSource
+   ------------------------------------------------------------
+   A registered image. The pixels stay owned by the caller and
+   must live until TileSourceClose returns.
+   ============================================================ */
+struct TileSource
+{
+    int id = 0;
+    const float* linearRGB = nullptr;
+    int tileSize = 0;
+    int overlap = 0;
+    int maxLevel = 0;
+    std::vector<int> levelWidth;
+    std::vector<int> levelHeight;
+    int users = 0;
+};
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gSourceMutex / gSourceCond
+ * Protect the source table and the users counts; Close waits
+ * on gSourceCond until a source is no longer used.
+ */
+static std::mutex gSourceMutex;
+static std::condition_variable gSourceCond;
+
+/*
+ * gSources
+ * Open sources by id.
+ */
+static std::unordered_map<int, std::shared_ptr<TileSource>> gSources;
+
+/*
+ * gNextSource
+ * Id of the next opened source.
+ * Range: > 0
+ */
+static int gNextSource = 1;
+
+/*
+ * gParallelMutex
+ * Held by the one request whose cells are computed with the
+ * thread pool; concurrent requests compute theirs serially.
+ * Pool jobs then only ever wait on cells of a finer level
+ * being computed by a running thread, never on a pool job
+ * queued behind them, so requests cannot deadlock.
+ */
+static std::mutex gParallelMutex;
+
+/* ============================================================
+   SourceLease
+   ------------------------------------------------------------
+   Keeps a source open for the duration of one request.
+   ============================================================ */
+class SourceLease
+{
+public:
+    explicit SourceLease(int id)
+    {
+        std::lock_guard<std::mutex> lock(gSourceMutex);
+        auto it = gSources.find(id);
+        if (it != gSources.end())
+        {
+            source = it->second;
+            source->users++;
+        }
+    }
+
+    ~SourceLease()
+    {
+        if (!source)
+            return;
+
+        std::lock_guard<std::mutex> lock(gSourceMutex);
+        source->users--;
+        gSourceCond.notify_all();
+    }
+
+    const TileSource& operator*() const { return *source; }
+    const TileSource* operator->() const { return source.get(); }
+    explicit operator bool() const { return source != nullptr; }
+
+private:
+    std::shared_ptr<TileSource> source;
+};
+
+/* ============================================================
+   Procedure: TileCache::Instance
+   ============================================================ */
+TileCache& TileCache::Instance()
+{
+    static TileCache cache;
+    return cache;
+}
+
+/* ============================================================
+   Procedure: KeyHash / KeyEqual
+   ============================================================ */
+size_t TileCache::KeyHash::operator()(const TileKey& key) const
+{
+    return (size_t)HashBytes(&key, sizeof(key));
+}
+
+bool TileCache::KeyEqual::operator()(const TileKey& a, const TileKey& b) const
+{
+    return std::memcmp(&a, &b, sizeof(TileKey)) == 0;
+}
+
+/* ============================================================
+   Procedure: TileCache::GetOrCompute
+   ------------------------------------------------------------
+   Description:
+   Looks a tile up; on a miss the first caller computes it
+   without holding the lock while later callers of the same
+   key wait for that result (counted as coalesced).
+
+   A failed computation is unregistered and its exception
+   handed to the waiters, so the key can be computed again.
+   The result is only cached if no Clear detached the job
+   while it ran; otherwise it may be based on a grade or LUT
+   that no longer applies.
+
+   Input parameters:
+   key     - Tile identity
+   compute - Produces the tile (may return nullptr)
+
+   Output parameters:
+   Returns the tile, shared with the cache.
+   ============================================================ */
+TileBlobPtr TileCache::GetOrCompute(const TileKey& key, const std::function<TileBlobPtr()>& compute)
+{
+    std::shared_ptr<Pending> job;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            entries.splice(entries.begin(), entries, it->second);
+            hits++;
+            Publish();
+            return it->second->blob;
+        }
+
+        auto running = pending.find(key);
+        if (running != pending.end())
+        {
+            std::shared_ptr<Pending> other = running->second;
+            coalesced++;
+            Publish();
+            cond.wait(lock, [&] { return other->done; });
+            if (other->error)
+                std::rethrow_exception(other->error);
+            return other->blob;
+        }
+
+        job = std::make_shared<Pending>();
+        pending[key] = job;
+        misses++;
+        Publish();
+    }
+
+    TileBlobPtr blob;
+    try
+    {
+        blob = compute();
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->error = std::current_exception();
+            job->done = true;
+            auto it = pending.find(key);
+            if (it != pending.end() && it->second == job)
+                pending.erase(it);
+        }
+        cond.notify_all();
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->blob = blob;
+        job->done = true;
+
+        auto it = pending.find(key);
+        bool current = it != pending.end() && it->second == job;
+        if (current)
+            pending.erase(it);
+
+        if (current && blob && blob->Bytes() <= budget && index.find(key) == index.end())
+        {
+            entries.push_front({ key, blob });
+            index[key] = entries.begin();
+            bytesUsed += blob->Bytes();
+            EvictToBudget();
+        }
+        Publish();
+    }
+    cond.notify_all();
+
+    return blob;
+}
+
+void TileCache::SetBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    EvictToBudget();
+    Publish();
+}
+
+void TileCache::Clear(int source)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Running jobs finish for their waiters but are not cached,
+    // and later requests start a fresh computation
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        if (source < 0 || it->first.source == source)
+            it = pending.erase(it);
+        else
+            ++it;
+    }
+
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (source < 0 || it->key.source == source)
+        {
+            bytesUsed -= it->blob->Bytes();
+            index.erase(it->key);
+            it = entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    Publish();
+}
+
+/* ============================================================
+   Procedure: TileCache::EvictToBudget / Publish
+   ------------------------------------------------------------
+   Description:
+   Drops least recently used tiles over the budget / pushes
+   the counters to HDRStats. Called with the mutex held.
+   ============================================================ */
+void TileCache::EvictToBudget()
+{
+    while (bytesUsed > budget && !entries.empty())
+    {
+        Entry& last = entries.back();
+        bytesUsed -= last.blob->Bytes();
+        index.erase(last.key);
+        entries.pop_back();
+    }
+}
+
+void TileCache::Publish()
+{
+    StatsTiles(hits, misses, coalesced, (int)entries.size(), (long long)bytesUsed);
+}
+
+/* ============================================================
+   Procedure: CellCount
+   ------------------------------------------------------------
+   Description:
+   Number of tile cells along an axis of a level.
+   ============================================================ */
+static int CellCount(int pixels, int tileSize)
+{
+    return (pixels + tileSize - 1) / tileSize;
+}
+
+static TileBlobPtr CoreTile(const TileSource& s, int level, int col, int row,
+    float exposure, float whitePoint, bool parallel);
+
+/* ============================================================
+   Procedure: ToneMapCell
+   ------------------------------------------------------------
+   Description:
+   Tone maps one full resolution cell from the source, rows in
+   parallel unless already inside a parallel loop.
+   ============================================================ */
+static TileBlobPtr ToneMapCell(const TileSource& s, int col, int row,
+    float exposure, float whitePoint, bool parallel)
+{
+    int width = s.levelWidth[s.maxLevel];
+    int x0 = col * s.tileSize;
+    int y0 = row * s.tileSize;
+
+    auto blob = std::make_shared<TileBlob>();
+    blob->width = std::min(s.tileSize, width - x0);
+    blob->height = std::min(s.tileSize, s.levelHeight[s.maxLevel] - y0);
+    blob->planar.resize((size_t)blob->width * blob->height * 3);
+
+    ColorGrade grade = GetColorGrade();
+    std::shared_ptr<const CubeLut> lut = GetCubeLut();
+    auto mapRow = [&](int y)
+    {
+        int w = blob->width;
+        float* r = blob->planar.data() + (size_t)y * w * 3;
+        DeinterleaveRGB(s.linearRGB + ((size_t)(y0 + y) * width + x0) * 3, w, r, r + w, r + 2 * w);
+        ToneMapPlanar(r, r + w, r + 2 * w, w, exposure, whitePoint, nullptr, grade, lut.get());
+    };
+
+    if (parallel)
+        ThreadPool::Instance().ParallelFor(blob->height, mapRow);
+    else
+        for (int y = 0; y < blob->height; y++)
+            mapRow(y);
+
+    return blob;
+}
+
+/* ============================================================
+   Procedure: AverageCell
+   ------------------------------------------------------------
+   Description:
+   Builds a cell from the (up to) four cells covering it one
+   level up with a 2x2 box filter, repeating the last column /
+   row at odd edges like ExportDeepZoom.
+
+   A top-level request first computes the cells a few levels
+   up in parallel (enough for every thread), so the serial
+   recursion that follows finds them in the cache.
+   ============================================================ */
+static TileBlobPtr AverageCell(const TileSource& s, int level, int col, int row,
+    float exposure, float whitePoint, bool parallel)
+{
+    int ts = s.tileSize;
+    int up = level + 1;
+
+    std::vector<TileBlobPtr> prefetched;
+    if (parallel)
+    {
+        int threads = ThreadPool::Instance().ThreadCount();
+        int depth = 1;
+        while (level + depth < s.maxLevel && (1 << (2 * depth)) < 2 * threads)
+            depth++;
+
+        int d = level + depth;
+        int c0 = col << depth;
+        int r0 = row << depth;
+        int c1 = std::min((col + 1) << depth, CellCount(s.levelWidth[d], ts));
+        int r1 = std::min((row + 1) << depth, CellCount(s.levelHeight[d], ts));
+        int cols = c1 - c0;
+
+        prefetched.resize((size_t)cols * (r1 - r0));
+        ThreadPool::Instance().ParallelFor((int)prefetched.size(), [&](int i)
+        {
+            prefetched[i] = CoreTile(s, d, c0 + i % cols, r0 + i / cols, exposure, whitePoint, false);
+        });
+    }
+
+    int upWidth = s.levelWidth[up];
+    int upHeight = s.levelHeight[up];
+
+    TileBlobPtr cells[2][2] = {};
+    for (int dy = 0; dy < 2; dy++)
+        for (int dx = 0; dx < 2; dx++)
+            if ((2 * col + dx) * ts < upWidth && (2 * row + dy) * ts < upHeight)
+                cells[dy][dx] = CoreTile(s, up, 2 * col + dx, 2 * row + dy, exposure, whitePoint, false);
+
+    auto blob = std::make_shared<TileBlob>();
+    blob->width = std::min(ts, s.levelWidth[level] - col * ts);
+    blob->height = std::min(ts, s.levelHeight[level] - row * ts);
+    blob->planar.resize((size_t)blob->width * blob->height * 3);
+
+    // Source cell (0/1) and position inside it of each sample
+    // column; x0 is the left sample, x1 the right one
+    int w = blob->width;
+    std::vector<int> cellX0(w), cellX1(w), localX0(w), localX1(w);
+    for (int x = 0; x < w; x++)
+    {
+        int X0 = 2 * (col * ts + x);
+        int X1 = std::min(X0 + 1, upWidth - 1);
+        cellX0[x] = X0 / ts - 2 * col;
+        cellX1[x] = X1 / ts - 2 * col;
+        localX0[x] = X0 % ts;
+        localX1[x] = X1 % ts;
+    }
+
+    for (int y = 0; y < blob->height; y++)
+    {
+        int Y0 = 2 * (row * ts + y);
+        int Y1 = std::min(Y0 + 1, upHeight - 1);
+        int cellY0 = Y0 / ts - 2 * row;
+        int cellY1 = Y1 / ts - 2 * row;
+
+        for (int c = 0; c < 3; c++)
+        {
+            float* out = blob->planar.data() + ((size_t)y * 3 + c) * w;
+
+            // Channel c of one row of the cells above
+            auto rowOf = [&](int cy, int cx, int Y) -> const float*
+            {
+                const TileBlob& cell = *cells[cy][cx];
+                return cell.planar.data() + ((size_t)(Y % ts) * 3 + c) * cell.width;
+            };
+
+            for (int x = 0; x < w; x++)
+            {
+                float a = rowOf(cellY0, cellX0[x], Y0)[localX0[x]];
+                float b = rowOf(cellY0, cellX1[x], Y0)[localX1[x]];
+                float e = rowOf(cellY1, cellX0[x], Y1)[localX0[x]];
+                float f = rowOf(cellY1, cellX1[x], Y1)[localX1[x]];
+                out[x] = 0.25f * (a + b + e + f);
+            }
+        }
+    }
+
+    return blob;
+}
+
+/* ============================================================
+   Procedure: CoreTile
+   ------------------------------------------------------------
+   Description:
+   Returns the linear tone mapped pixels of one cell, from the
+   cache or computed on demand.
+
+   Input parameters:
+   s          - Source
+   level      - Pyramid level
+   col, row   - Cell index
+   exposure   - Exposure multiplier
+   whitePoint - White point
+   parallel   - Caller is not inside a ParallelFor
+   ============================================================ */
+static TileBlobPtr CoreTile(const TileSource& s, int level, int col, int row,
+    float exposure, float whitePoint, bool parallel)
+{
+    TileKey key = { s.id, level, col, row, exposure, whitePoint, TILE_KIND_CORE };
+    return TileCache::Instance().GetOrCompute(key, [&]
+    {
+        if (level == s.maxLevel)
+            return ToneMapCell(s, col, row, exposure, whitePoint, parallel);
+        return AverageCell(s, level, col, row, exposure, whitePoint, parallel);
+    });
+}
+
+/* ============================================================
+   Procedure: EncodeTile
+   ------------------------------------------------------------
+   Description:
+   Assembles a tile with its overlap from the cells it touches
+   (the neighbours are usually requested next anyway), gamma
+   encodes it and writes a PNG identical to the file
+   ExportDeepZoom produces for the same tile.
+   ============================================================ */
+static TileBlobPtr EncodeTile(const TileSource& s, int level, int col, int row,
+    float exposure, float whitePoint)
+{
+    int ts = s.tileSize;
+    int width = s.levelWidth[level];
+    int height = s.levelHeight[level];
+
+    int x0 = std::max(0, col * ts - s.overlap);
+    int x1 = std::min(width, (col + 1) * ts + s.overlap);
+    int y0 = std::max(0, row * ts - s.overlap);
+    int y1 = std::min(height, (row + 1) * ts + s.overlap);
+    int tw = x1 - x0;
+    int th = y1 - y0;
+
+    int c0 = x0 / ts;
+    int c1 = (x1 - 1) / ts;
+    int r0 = y0 / ts;
+    int r1 = (y1 - 1) / ts;
+
+    // Center cell first: its computation prefetches in parallel
+    // (when no other request is using the pool)
+    std::vector<TileBlobPtr> cells((size_t)(c1 - c0 + 1) * (r1 - r0 + 1));
+    auto cellAt = [&](int c, int r) -> TileBlobPtr&
+    {
+        return cells[(size_t)(r - r0) * (c1 - c0 + 1) + (c - c0)];
+    };
+
+    {
+        std::unique_lock<std::mutex> parallelLock(gParallelMutex, std::try_to_lock);
+        bool parallel = parallelLock.owns_lock();
+
+        cellAt(col, row) = CoreTile(s, level, col, row, exposure, whitePoint, parallel);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                if (!cellAt(c, r))
+                    cellAt(c, r) = CoreTile(s, level, c, r, exposure, whitePoint, parallel);
+    }
+
+    std::vector<unsigned char> bgra((size_t)ts * 4);
+    std::vector<unsigned char> rgb((size_t)tw * th * 3);
+
+    for (int y = y0; y < y1; y++)
+    {
+        unsigned char* dst = rgb.data() + (size_t)(y - y0) * tw * 3;
+
+        for (int c = c0; c <= c1; c++)
+        {
+            const TileBlob& cell = *cellAt(c, y / ts);
+            int sx0 = std::max(x0, c * ts);
+            int sx1 = std::min(x1, c * ts + cell.width);
+            int n = sx1 - sx0;
+
+            const float* r = cell.planar.data() + (size_t)(y % ts) * 3 * cell.width + (sx0 - c * ts);
+            StoreBGRA8(r, r + cell.width, r + 2 * cell.width, n, bgra.data(), false, nullptr, DitherAt(sx0, y));
+
+            for (int x = 0; x < n; x++)
+            {
+                dst[3 * x + 0] = bgra[4 * x + 2];
+                dst[3 * x + 1] = bgra[4 * x + 1];
+                dst[3 * x + 2] = bgra[4 * x + 0];
+            }
+            dst += (size_t)n * 3;
+        }
+    }
+
+    auto blob = std::make_shared<TileBlob>();
+    blob->width = tw;
+    blob->height = th;
+    blob->png = EncodePNG(rgb.data(), tw, th, 3);
+    return blob;
+}
+
+/* ============================================================
+   Procedure: TileServerEncoded
+   ------------------------------------------------------------
+   Description:
+   Returns the PNG of one tile, from the cache or computed on
+   demand. Used by TileServerGetTile and the HTTP front end,
+   so an allocation failure is returned as no tile instead of
+   escaping into an HTTP worker or across the DLL boundary.
+   ============================================================ */
+TileBlobPtr TileServerEncoded(int source, int level, int col, int row, float exposure, float whitePoint)
+{
+    SourceLease s(source);
+    if (!s || level < 0 || level > s->maxLevel || col < 0 || row < 0 ||
+        col >= CellCount(s->levelWidth[level], s->tileSize) ||
+        row >= CellCount(s->levelHeight[level], s->tileSize))
+        return nullptr;
+
+    TileKey key = { source, level, col, row, exposure, whitePoint, TILE_KIND_PNG };
+    try
+    {
+        return TileCache::Instance().GetOrCompute(key, [&]
+        {
+            return EncodeTile(*s, level, col, row, exposure, whitePoint);
+        });
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+/* ============================================================
+   Procedure: TileServerDescriptor
+   ============================================================ */
+std::string TileServerDescriptor(int source)
+{
+    SourceLease s(source);
+    if (!s)
+        return std::string();
+    return DziDescriptor(s->levelWidth[s->maxLevel], s->levelHeight[s->maxLevel], s->tileSize, s->overlap);
+}
+
+/* ============================================================
+   Procedure: TileSourceOpen
+   ------------------------------------------------------------
+   Description:
+   Registers an image for lazy tile serving. Nothing is
+   computed until a tile is requested.
+
+   Input parameters:
+   linearRGB - Linear RGB float data (RGBRGB...), owned by the
+               caller until TileSourceClose
+   width     - Image width in pixels (> 0)
+   height    - Image height in pixels (> 0)
+   tileSize  - Tile edge without overlap (e.g. 254)
+   overlap   - Pixels shared with each neighbour (< tileSize)
+
+   Output parameters:
+   Returns the source id (> 0), or 0 on invalid arguments.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int TileSourceOpen(const float* linearRGB, int width, int height, int tileSize, int overlap)
+{
+    if (!linearRGB || width <= 0 || height <= 0 || tileSize <= 0 || overlap < 0 || overlap >= tileSize)
+        return 0;
+
+    TuneEnsureLoaded();
+
+    auto source = std::make_shared<TileSource>();
+    source->linearRGB = linearRGB;
+    source->tileSize = tileSize;
+    source->overlap = overlap;
+    source->maxLevel = DziMaxLevel(width, height);
+    source->levelWidth.resize(source->maxLevel + 1);
+    source->levelHeight.resize(source->maxLevel + 1);
+
+    for (int k = source->maxLevel; k >= 0; k--)
+    {
+        bool top = k == source->maxLevel;
+        source->levelWidth[k] = top ? width : (source->levelWidth[k + 1] + 1) / 2;
+        source->levelHeight[k] = top ? height : (source->levelHeight[k + 1] + 1) / 2;
+    }
+
+    std::lock_guard<std::mutex> lock(gSourceMutex);
+    source->id = gNextSource++;
+    gSources[source->id] = source;
+    return source->id;
+}
+
+/* ============================================================
+   Procedure: TileSourceClose
+   ------------------------------------------------------------
+   Description:
+   Unregisters a source, waits for requests still using it and
+   drops its cached tiles. The image buffer may be freed after
+   this returns.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void TileSourceClose(int source)
+{
+    {
+        std::unique_lock<std::mutex> lock(gSourceMutex);
+        auto it = gSources.find(source);
+        if (it == gSources.end())
+            return;
+
+        std::shared_ptr<TileSource> s = it->second;
+        gSources.erase(it);
+        gSourceCond.wait(lock, [&] { return s->users == 0; });
+    }
+
+    TileCache::Instance().Clear(source);
+}
+
+/* ============================================================
+   Procedure: TileServerGetTile
+   ------------------------------------------------------------
+   Description:
+   Returns one Deep Zoom tile as a PNG file, computing only the
+   cells it needs.
+
+   Input parameters:
+   source     - Id from TileSourceOpen
+   level      - Pyramid level (0 = 1x1)
+   col, row   - Tile index
+   exposure   - Exposure multiplier
+   whitePoint - White point
+   capacity   - Size of png in bytes
+
+   Output parameters:
+   png        - Receives the file if it fits
+   Returns the file size (copied only if <= capacity), or -1
+   for an invalid source or tile.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int TileServerGetTile(int source, int level, int col, int row,
+    float exposure, float whitePoint, unsigned char* png, int capacity)
+{
+    TileBlobPtr tile = TileServerEncoded(source, level, col, row, exposure, whitePoint);
+    if (!tile)
+        return -1;
+
+    int size = (int)tile->png.size();
+    if (png && size <= capacity)
+        std::memcpy(png, tile->png.data(), tile->png.size());
+    return size;
+}
+
+/* ============================================================
+   Procedure: TileCacheSetBudget / TileCacheClear
+   ------------------------------------------------------------
+   Input parameters:
+   bytes - Maximum bytes of cached tiles (default 256 MB)
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void TileCacheSetBudget(long long bytes)
+{
+    if (bytes >= 0)
+        TileCache::Instance().SetBudget((size_t)bytes);
+}
+
+extern "C" __declspec(dllexport)
+void TileCacheClear()
+{
+    TileCache::Instance().Clear(-1);
+}
@@ -0,0 +1,115 @@
+#ifndef TILE_SERVER_H
+#define TILE_SERVER_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Identity of a cached tile. Core tiles are the linear, tone
+// mapped pixels of one tile cell without overlap; encoded tiles
+// are the PNG a viewer receives (with overlap).
+struct TileKey
+{
+	int source;
+	int level;
+	int col;
+	int row;
+	float exposure;
+	float whitePoint;
+	int kind;
+};
+
+enum TileKind
+{
+	TILE_KIND_CORE = 0,
+	TILE_KIND_PNG = 1
+};
+
+// Pixels or file of one tile; immutable once published
+struct TileBlob
+{
+	int width = 0;
+	int height = 0;
+	// Core: planar rows (R, G, B runs of width floats per row)
+	std::vector<float> planar;
+	// Encoded: PNG file contents
+	std::vector<unsigned char> png;
+
+	size_t Bytes() const { return planar.size() * sizeof(float) + png.size(); }
+};
+
+using TileBlobPtr = std::shared_ptr<const TileBlob>;
+
+// LRU cache of tiles under a byte budget. A tile requested while
+// another thread is computing it waits for that result instead of
+// computing it again.
+class TileCache
+{
+public:
+	static TileCache& Instance();
+
+	// Returns the cached tile, or runs compute once for all
+	// concurrent callers of the same key and caches its result.
+	// An exception of compute is rethrown to every such caller.
+	TileBlobPtr GetOrCompute(const TileKey& key, const std::function<TileBlobPtr()>& compute);
+
+	void SetBudget(size_t bytes);
+	// Drops all tiles of a source (all sources if source < 0);
+	// computations already running are not cached when done
+	void Clear(int source);
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const TileKey& key) const;
+	};
+
+	struct KeyEqual
+	{
+		bool operator()(const TileKey& a, const TileKey& b) const;
+	};
+
+	struct Entry
+	{
+		TileKey key;
+		TileBlobPtr blob;
+	};
+
+	// A tile being computed; waiters block on cond until done
+	struct Pending
+	{
+		TileBlobPtr blob;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	void EvictToBudget();
+	void Publish();
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::list<Entry> entries;
+	std::unordered_map<TileKey, std::list<Entry>::iterator, KeyHash, KeyEqual> index;
+	std::unordered_map<TileKey, std::shared_ptr<Pending>, KeyHash, KeyEqual> pending;
+	size_t bytesUsed = 0;
+	size_t budget = (size_t)256 << 20;
+	long long hits = 0;
+	long long misses = 0;
+	long long coalesced = 0;
+};
+
+// Returns the PNG of one Deep Zoom tile of a source, computing
+// only what is needed (nullptr for an invalid source or tile, or
+// when memory for it runs out).
+TileBlobPtr TileServerEncoded(int source, int level, int col, int row, float exposure, float whitePoint);
+
+// Returns the .dzi descriptor of a source (empty if invalid).
+std::string TileServerDescriptor(int source);
+
+#endif
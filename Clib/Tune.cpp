@@ -0,0 +1,378 @@
+// ============================================================
+// File: Tune.cpp
+// Author: Jakub Hanusiak
+// Date: 5 sem, 2026-01-21
+// Topic: Tone Mapping
+//
+// Description:
+// Per-machine tune profiles. The best tile size, thread count
+// and kernel settings differ between CPUs; the Bench autotune
+// command measures them and stores them in an ini file with one
+// section per CPU model. The library applies the section of the
+// CPU it runs on before its first CPU render.
+// ============================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "HDR.h"
+#include "Kernels.h"
+#include "StageGraph.h"
+#include "ThreadPool.h"
+#include "Tune.h"
+
+/* ============================================================
+   Global variables
+   ============================================================ */
+
+/*
+ * gTuneMutex
+ * Serializes profile changes and file access.
+ */
+static std::mutex gTuneMutex;
+
+/*
+ * gTuneApplied
+ * Set once a profile has been loaded or set explicitly; the
+ * automatic load is skipped after that.
+ */
+static std::atomic<bool> gTuneApplied{ false };
+
+// Profiles by CPU model, in file order
+using ProfileList = std::vector<std::pair<std::string, HDRTuneProfile>>;
+
+/* ============================================================
+   Procedure: CpuModel
+   ------------------------------------------------------------
+   Description:
+   Returns the CPU brand string (CPUID 0x80000002..4) without
+   surrounding spaces, or "unknown".
+   ============================================================ */
+static std::string CpuModel()
+{
+    unsigned int regs[12] = {};
+
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] < 0x80000004)
+        return "unknown";
+    for (int i = 0; i < 3; i++)
+    {
+        __cpuid(info, 0x80000002 + i);
+        std::memcpy(regs + 4 * i, info, sizeof(info));
+    }
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000004)
+        return "unknown";
+    for (unsigned int i = 0; i < 3; i++)
+        __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2], &regs[4 * i + 3]);
+#endif
+
+    char brand[49] = {};
+    std::memcpy(brand, regs, 48);
+
+    std::string model = brand;
+    size_t first = model.find_first_not_of(' ');
+    size_t last = model.find_last_not_of(' ');
+    if (first == std::string::npos)
+        return "unknown";
+    return model.substr(first, last - first + 1);
+}
+
+/* ============================================================
+   Procedure: TuneDefaultPath
+   ------------------------------------------------------------
+   Description:
+   Returns the per-user profile file path.
+   ============================================================ */
+std::string TuneDefaultPath()
+{
+#ifdef _WIN32
+    const char* appData = std::getenv("LOCALAPPDATA");
+    if (appData && *appData)
+        return std::string(appData) + "\\ToneMapping\\tune_profiles.ini";
+#endif
+    return "tune_profiles.ini";
+}
+
+/* ============================================================
+   Procedure: ReadProfiles
+   ------------------------------------------------------------
+   Description:
+   Parses a profile file. Unknown keys are ignored; missing
+   keys keep the defaults (256 x 16 tiles, all threads, auto
+   kernel, no unroll, no streaming).
+
+   Output parameters:
+   Returns the sections in file order (empty if unreadable).
+   ============================================================ */
+static ProfileList ReadProfiles(const std::string& path)
+{
+    ProfileList profiles;
+
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file)
+        return profiles;
+
+    char line[512];
+    while (std::fgets(line, sizeof(line), file))
+    {
+        std::string text = line;
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r' || text.back() == ' '))
+            text.pop_back();
+
+        if (text.empty() || text[0] == ';' || text[0] == '#')
+            continue;
+
+        if (text[0] == '[' && text.back() == ']')
+        {
+            HDRTuneProfile profile = { 256, 16, 0, HDR_KERNEL_AUTO, 1, 0 };
+            profiles.emplace_back(text.substr(1, text.size() - 2), profile);
+            continue;
+        }
+
+        size_t eq = text.find('=');
+        if (eq == std::string::npos || profiles.empty())
+            continue;
+
+        std::string key = text.substr(0, eq);
+        long long value = std::atoll(text.c_str() + eq + 1);
+        HDRTuneProfile& p = profiles.back().second;
+
+        if (key == "tileWidth") p.tileWidth = (int)value;
+        else if (key == "tileHeight") p.tileHeight = (int)value;
+        else if (key == "threads") p.threads = (int)value;
+        else if (key == "kernelVariant") p.kernelVariant = (int)value;
+        else if (key == "unroll") p.unroll = (int)value;
+        else if (key == "streamThreshold") p.streamThreshold = value;
+    }
+
+    std::fclose(file);
+    return profiles;
+}
+
+/* ============================================================
+   Procedure: WriteProfiles
+   ------------------------------------------------------------
+   Description:
+   Writes all sections to a profile file, creating its
+   directory if needed.
+
+   Output parameters:
+   Returns false if the file could not be written.
+   ============================================================ */
+static bool WriteProfiles(const std::string& path, const ProfileList& profiles)
+{
+#ifdef _WIN32
+    size_t slash = path.find_last_of("\\/");
+    if (slash != std::string::npos)
+        CreateDirectoryA(path.substr(0, slash).c_str(), nullptr);
+#endif
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "; Tone Mapping tune profiles, one section per CPU model (Bench autotune)\n");
+    for (const auto& entry : profiles)
+    {
+        const HDRTuneProfile& p = entry.second;
+        std::fprintf(file, "\n[%s]\n", entry.first.c_str());
+        std::fprintf(file, "tileWidth=%d\n", p.tileWidth);
+        std::fprintf(file, "tileHeight=%d\n", p.tileHeight);
+        std::fprintf(file, "threads=%d\n", p.threads);
+        std::fprintf(file, "kernelVariant=%d\n", p.kernelVariant);
+        std::fprintf(file, "unroll=%d\n", p.unroll);
+        std::fprintf(file, "streamThreshold=%lld\n", p.streamThreshold);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+/* ============================================================
+   Procedure: ApplyProfile
+   ------------------------------------------------------------
+   Description:
+   Pushes a profile into the tile size, thread pool and kernel
+   settings. Called with gTuneMutex held.
+   ============================================================ */
+static void ApplyProfile(const HDRTuneProfile& profile)
+{
+    StageGraph::SetTileSize(profile.tileWidth, profile.tileHeight);
+    ThreadPool::Instance().SetMaxThreads(profile.threads > 0 ? profile.threads : 0);
+
+    KernelConfig config;
+    config.variant = profile.kernelVariant;
+    config.unroll = profile.unroll;
+    config.streamThreshold = profile.streamThreshold;
+    SetKernelConfig(config);
+
+    gTuneApplied = true;
+}
+
+/* ============================================================
+   Procedure: TuneEnsureLoaded
+   ------------------------------------------------------------
+   Description:
+   Applies the profile of this CPU from the default file the
+   first time a CPU render starts. Without a profile the
+   built-in defaults stay in effect.
+   ============================================================ */
+void TuneEnsureLoaded()
+{
+    static std::once_flag once;
+    std::call_once(once, []
+    {
+        if (!gTuneApplied)
+            LoadTuneProfile(nullptr);
+    });
+}
+
+/* ============================================================
+   Procedure: SetTuneProfile / GetTuneProfile
+   ------------------------------------------------------------
+   Description:
+   Applies a profile directly / returns the settings in effect.
+   May run beside a CPU render: graphs already built keep their
+   tile size, and each kernel call reads one kernel config.
+
+   Input parameters:
+   profile - Settings to apply
+
+   Output parameters:
+   profile - Current settings
+   ============================================================ */
+extern "C" __declspec(dllexport)
+void SetTuneProfile(const HDRTuneProfile* profile)
+{
+    if (!profile)
+        return;
+
+    std::lock_guard<std::mutex> lock(gTuneMutex);
+    ApplyProfile(*profile);
+}
+
+extern "C" __declspec(dllexport)
+void GetTuneProfile(HDRTuneProfile* profile)
+{
+    if (!profile)
+        return;
+
+    KernelConfig config = GetKernelConfig();
+    StageTileSize tile = StageGraph::TileSize();
+    profile->tileWidth = tile.width;
+    profile->tileHeight = tile.height;
+    profile->threads = ThreadPool::Instance().MaxThreads();
+    profile->kernelVariant = config.variant;
+    profile->unroll = config.unroll;
+    profile->streamThreshold = config.streamThreshold;
+}
+
+/* ============================================================
+   Procedure: GetCpuModel
+   ------------------------------------------------------------
+   Description:
+   Copies the CPU model name profiles are keyed by.
+
+   Input parameters:
+   size   - Size of buffer in bytes
+
+   Output parameters:
+   buffer - Null-terminated model name (truncated to fit)
+   Returns the full length of the name.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+int GetCpuModel(char* buffer, int size)
+{
+    std::string model = CpuModel();
+    if (buffer && size > 0)
+    {
+        size_t n = std::min(model.size(), (size_t)size - 1);
+        std::memcpy(buffer, model.data(), n);
+        buffer[n] = '\0';
+    }
+    return (int)model.size();
+}
+
+/* ============================================================
+   Procedure: LoadTuneProfile
+   ------------------------------------------------------------
+   Description:
+   Applies the section of this CPU model from a profile file.
+
+   Input parameters:
+   path - Profile file, or nullptr for the default location
+
+   Output parameters:
+   Returns false if the file has no profile for this CPU.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool LoadTuneProfile(const char* path)
+{
+    std::lock_guard<std::mutex> lock(gTuneMutex);
+
+    std::string model = CpuModel();
+    for (const auto& entry : ReadProfiles(path ? path : TuneDefaultPath()))
+    {
+        if (entry.first == model)
+        {
+            ApplyProfile(entry.second);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ============================================================
+   Procedure: SaveTuneProfile
+   ------------------------------------------------------------
+   Description:
+   Stores the settings in effect as the profile of this CPU
+   model, keeping the sections of other models in the file.
+
+   Input parameters:
+   path - Profile file, or nullptr for the default location
+
+   Output parameters:
+   Returns false if the file could not be written.
+   ============================================================ */
+extern "C" __declspec(dllexport)
+bool SaveTuneProfile(const char* path)
+{
+    HDRTuneProfile current;
+    GetTuneProfile(&current);
+
+    std::lock_guard<std::mutex> lock(gTuneMutex);
+
+    std::string file = path ? path : TuneDefaultPath();
+    std::string model = CpuModel();
+    ProfileList profiles = ReadProfiles(file);
+
+    bool found = false;
+    for (auto& entry : profiles)
+    {
+        if (entry.first == model)
+        {
+            entry.second = current;
+            found = true;
+        }
+    }
+    if (!found)
+        profiles.emplace_back(model, current);
+
+    return WriteProfiles(file, profiles);
+}
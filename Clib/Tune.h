@@ -0,0 +1,14 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <string>
+
+// Loads this machine's tune profile on first use (once per process,
+// skipped if a profile was set explicitly).
+void TuneEnsureLoaded();
+
+// Default profile file: %LOCALAPPDATA%\ToneMapping\tune_profiles.ini
+// (tune_profiles.ini in the working directory elsewhere).
+std::string TuneDefaultPath();
+
+#endif
@@ -0,0 +1,142 @@
+#version 330 core
+/* ============================================================
+   Fragment Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Passes of the bloom chain, selected by stage:
+
+    stage 0 - light above the threshold, 2 x 2 means (half size)
+    stage 1 - 2 x 2 means of the level below (next level)
+    stage 2 - Gaussian blur along direction
+    stage 3 - blurred level plus the coarser sum upsampled
+
+   2 x 2 blocks are clipped at the image edges and averaged over
+   the pixels they hold; the blur and the upsampling repeat the
+   edges outwards, as on the CPU (Bloom.cpp).
+   ============================================================ */
+
+/* ============================================================
+   Output variables
+   ============================================================ */
+
+/*
+ * FragColor
+ * Linear RGB of the level.
+ */
+out vec4 FragColor;
+
+/* ============================================================
+   Uniform variables
+   ============================================================ */
+
+/*
+ * tex0
+ * Stage 0: HDR input texture. Later stages: the level read.
+ */
+uniform sampler2D tex0;
+
+/*
+ * tex1
+ * Stage 3: sum of the coarser levels.
+ */
+uniform sampler2D tex1;
+
+/*
+ * stage
+ * Pass to run (see the description).
+ * Range:
+ *  0 .. 3
+ */
+uniform int stage;
+
+/*
+ * threshold
+ * Linear luminance above which light blooms (stage 0).
+ */
+uniform float threshold;
+
+/*
+ * direction
+ * Blur axis: (1, 0) or (0, 1) (stage 2).
+ */
+uniform ivec2 direction;
+
+/*
+ * sigma
+ * Blur standard deviation in pixels of the level (stage 2).
+ */
+uniform float sigma;
+
+/* ============================================================
+   Helper functions
+   ============================================================ */
+
+float luminance(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Light above the threshold, hue kept; nothing from non-finite
+// pixels (the comparison fails for NaN)
+vec3 aboveThreshold(vec3 c)
+{
+    float L = luminance(c);
+    float k = (L - threshold) / max(L, 1.0e-20);
+    return k > 0.0 && L < 3.0e38 ? c * k : vec3(0.0);
+}
+
+/* ============================================================
+   Main fragment shader procedure
+   ============================================================ */
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(tex0, 0);
+
+    if (stage <= 1)
+    {
+        vec3 sum = vec3(0.0);
+        float count = 0.0;
+        for (int dy = 0; dy < 2; dy++)
+        {
+            for (int dx = 0; dx < 2; dx++)
+            {
+                ivec2 q = 2 * p + ivec2(dx, dy);
+                if (q.x >= size.x || q.y >= size.y)
+                    continue;
+
+                vec3 c = texelFetch(tex0, q, 0).rgb;
+                sum += stage == 0 ? aboveThreshold(c) : c;
+                count += 1.0;
+            }
+        }
+        FragColor = vec4(sum / count, 1.0);
+        return;
+    }
+
+    if (stage == 2)
+    {
+        int radius = int(ceil(3.0 * sigma));
+        float scale = -0.5 / (sigma * sigma);
+        vec3 sum = vec3(0.0);
+        float total = 0.0;
+
+        for (int k = -radius; k <= radius; k++)
+        {
+            ivec2 q = clamp(p + direction * k, ivec2(0), size - 1);
+            float w = exp(float(k * k) * scale);
+            sum += texelFetch(tex0, q, 0).rgb * w;
+            total += w;
+        }
+        FragColor = vec4(sum / total, 1.0);
+        return;
+    }
+
+    // Coarse texel centres at (fine + 0.5) / 2; linear filtering
+    // with clamp to edge interpolates them
+    vec2 coarse = gl_FragCoord.xy * 0.5 / vec2(textureSize(tex1, 0));
+    FragColor = vec4(texelFetch(tex0, p, 0).rgb + texture(tex1, coarse).rgb, 1.0);
+}
@@ -0,0 +1,80 @@
+#version 330 core
+/* ============================================================
+   Fragment Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Turns the CLAHE tile histograms into tile curves. Every
+   output texel is one bin edge (x) of one tile (y): the
+   tile's histogram is clipped at the clip limit, the cut
+   counts spread evenly over all bins, and the normalized sum
+   of the bins below the edge is written (as ClipCurve on the
+   CPU).
+   ============================================================ */
+
+/* ============================================================
+   Output variables
+   ============================================================ */
+
+/*
+ * FragColor
+ * Display luminance of the edge, in red.
+ */
+out vec4 FragColor;
+
+/* ============================================================
+   Uniform variables
+   ============================================================ */
+
+/*
+ * tex0
+ * Tile histograms: BINS texels per row, one row per tile.
+ */
+uniform sampler2D tex0;
+
+/*
+ * clipLimit
+ * Largest bin as a multiple of the mean bin.
+ * Range:
+ *  >= 1.0
+ */
+uniform float clipLimit;
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Histogram bins of one tile (kClaheBins)
+const int BINS = 256;
+
+/* ============================================================
+   Main fragment shader procedure
+   ============================================================ */
+void main()
+{
+    int edge = int(gl_FragCoord.x);
+    int tile = int(gl_FragCoord.y);
+
+    float total = 0.0;
+    for (int k = 0; k < BINS; k++)
+        total += texelFetch(tex0, ivec2(k, tile), 0).r;
+
+    float limit = max(1.0, clipLimit * total / float(BINS));
+    float excess = 0.0;
+    float below = 0.0;
+
+    for (int k = 0; k < BINS; k++)
+    {
+        float count = texelFetch(tex0, ivec2(k, tile), 0).r;
+        excess += max(count - limit, 0.0);
+        if (k < edge)
+            below += min(count, limit);
+    }
+
+    float value = total > 0.0
+        ? (below + float(edge) * excess / float(BINS)) / total
+        : float(edge) / float(BINS);
+    FragColor = vec4(value, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+/* ============================================================
+   Fragment Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Histogram scatter of the CLAHE operator: every point adds
+   one to the bin it lands on (additive blending).
+   ============================================================ */
+
+/* ============================================================
+   Output variables
+   ============================================================ */
+
+/*
+ * FragColor
+ * One count.
+ */
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(1.0);
+}
@@ -0,0 +1,118 @@
+#version 330 core
+/* ============================================================
+   Vertex Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Histogram scatter of the CLAHE operator. It is drawn as one
+   point per image pixel without vertex data: each vertex reads
+   its pixel, tone maps and grades it like default.frag and
+   moves its point onto the texel of its bin (x) and tile (y)
+   in the histogram target, where additive blending counts it.
+   ============================================================ */
+
+/* ============================================================
+   Uniform variables
+   ============================================================ */
+
+/*
+ * tex0
+ * HDR input texture.
+ */
+uniform sampler2D tex0;
+
+/*
+ * imageSize
+ * Input size in pixels.
+ */
+uniform ivec2 imageSize;
+
+/*
+ * tiles
+ * CLAHE tile grid (columns, rows).
+ * Range:
+ *  >= 1
+ */
+uniform ivec2 tiles;
+
+/*
+ * exposure, whitePoint, gamma
+ * Settings of the base Extended Reinhard curve (as in
+ * default.frag).
+ */
+uniform float exposure;
+uniform float whitePoint;
+uniform float gamma;
+
+/*
+ * grading
+ * Apply the color grade below before binning, as ClaheBins
+ * bins the graded color on the CPU.
+ * Range:
+ *  0 (no grade) or 1
+ */
+uniform int grading;
+
+/*
+ * gradeSlope, gradeOffset, gradePower, gradeSaturation
+ * ASC CDL of the mapped color (as in default.frag).
+ */
+uniform vec3 gradeSlope;
+uniform vec3 gradeOffset;
+uniform vec3 gradePower;
+uniform float gradeSaturation;
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Histogram bins of one tile (kClaheBins)
+const int BINS = 256;
+
+/* ============================================================
+   Helper functions
+   ============================================================ */
+
+float luminance(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+/* ============================================================
+   Main vertex shader procedure
+   ------------------------------------------------------------
+   Description:
+   Places the point of pixel gl_VertexID. Non-finite pixels
+   count as black, as in the CPU version.
+   ============================================================ */
+void main()
+{
+    ivec2 p = ivec2(gl_VertexID % imageSize.x, gl_VertexID / imageSize.x);
+
+    vec3 hdr = texelFetch(tex0, p, 0).rgb;
+    if (any(isnan(hdr)) || any(isinf(hdr)))
+        hdr = vec3(0.0);
+    hdr *= exposure;
+
+    // Base curve, with the CPU kernel's lower clamp
+    float L = luminance(hdr);
+    float Lmapped = (L * (1.0 + L / (whitePoint * whitePoint))) / (1.0 + L);
+    vec3 mapped = max(hdr * (Lmapped / max(L, 0.0001)), vec3(0.0001));
+
+    if (grading != 0)
+    {
+        mapped = pow(max(mapped * gradeSlope + gradeOffset, vec3(1.0e-30)), gradePower);
+        float Lg = luminance(mapped);
+        mapped = max(Lg + gradeSaturation * (mapped - Lg), vec3(0.0001));
+    }
+
+    float encoded = pow(clamp(luminance(mapped), 0.0, 1.0), 1.0 / gamma);
+    int bin = min(int(encoded * float(BINS)), BINS - 1);
+    ivec2 tile = min(p * tiles / imageSize, tiles - 1);
+    int row = tile.y * tiles.x + tile.x;
+
+    vec2 target = (vec2(bin, row) + 0.5) / vec2(BINS, tiles.x * tiles.y);
+    gl_Position = vec4(target * 2.0 - 1.0, 0.0, 1.0);
+}
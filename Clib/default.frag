@@ -75,6 +75,181 @@ uniform float whitePoint;
  */
 uniform float gamma;
 
+/*
+ * invGamma
+ * 1 / gamma, computed on the CPU (kInvGamma), so encoding raises
+ * to the same float exponent as the CPU kernel.
+ */
+uniform float invGamma;
+
+/*
+ * linearOutput
+ * When non-zero the gamma step is skipped and linear tone-mapped
+ * values are written (used for floating-point output formats).
+ * Range:
+ *  0 or 1
+ */
+uniform int linearOutput;
+
+/*
+ * lumaOutput
+ * When non-zero only the mapped luminance is written, into the
+ * red channel (used for single-channel output formats).
+ * Range:
+ *  0 or 1
+ */
+uniform int lumaOutput;
+
+/*
+ * cpuCompatible
+ * When non-zero the output follows the native CPU kernel: color
+ * clamped to the kernel epsilon, and every power (gamma, grade,
+ * LUT, CLAHE) taken with the kernel's log2 / exp2 approximation
+ * (cpuLog2, cpuExp2). Used when GPU and CPU render bands of the
+ * same image, so the bands join without a visible seam.
+ * Range:
+ *  0 or 1
+ */
+uniform int cpuCompatible;
+
+/*
+ * claheTiles
+ * CLAHE tile grid (columns, rows) when the CLAHE operator is
+ * used; (0, 0) for Extended Reinhard alone.
+ */
+uniform ivec2 claheTiles;
+
+/*
+ * claheCurves
+ * CLAHE tile curves (clahe_curve.frag): display luminance at
+ * the CLAHE_BINS + 1 bin edges per row, one row per tile.
+ */
+uniform sampler2D claheCurves;
+
+/*
+ * localTone
+ * When non-zero the local (guided filter) operator is used: the
+ * luminance entering Extended Reinhard is rebuilt from a
+ * compressed base layer and a scaled detail layer.
+ * Range:
+ *  0 or 1
+ */
+uniform int localTone;
+
+/*
+ * guidedMeans
+ * Box means of the guided filter coefficients a and b (red,
+ * green) at every pixel (guided_filter.frag).
+ */
+uniform sampler2D guidedMeans;
+
+/*
+ * localAnchor, localCompression, localDetail, localMinLuminance
+ * log2 luminance kept by the base compression, base and detail
+ * scales, and the luminance floor of the log (as the CPU).
+ */
+uniform float localAnchor;
+uniform float localCompression;
+uniform float localDetail;
+uniform float localMinLuminance;
+
+/*
+ * bloomTex
+ * Sum of the bloom levels (bloom.frag), one texel per
+ * bloomFactor x bloomFactor pixels, in linear RGB.
+ */
+uniform sampler2D bloomTex;
+
+/*
+ * bloomScale, bloomFactor
+ * Factor of the bloom added to the input, and pixels per bloom
+ * texel along each axis.
+ * Range:
+ *  bloomScale >= 0 (0 = no bloom)
+ */
+uniform float bloomScale;
+uniform int bloomFactor;
+
+#ifdef COLOR_GRADE
+/*
+ * gradeSlope, gradeOffset, gradePower, gradeSaturation
+ * ASC CDL of the mapped color (SetColorGrade). Only the variant
+ * compiled with COLOR_GRADE has them; the plain program carries
+ * no grading code at all.
+ */
+uniform vec3 gradeSlope;
+uniform vec3 gradeOffset;
+uniform vec3 gradePower;
+uniform float gradeSaturation;
+#endif
+
+#ifdef CUBE_LUT
+/*
+ * lut3D, lut1D
+ * Lattice (size³ RGB texels, red fastest) and shaper (entries in
+ * rows of LUT_ROW texels) of the output LUT (LoadCubeLut). Only
+ * the variant compiled with CUBE_LUT has them.
+ */
+uniform sampler3D lut3D;
+uniform sampler2D lut1D;
+
+/*
+ * lutSize3D, lutSize1D
+ * Entries along each axis of the tables.
+ * Range:
+ *  0 (no such table) or >= 2
+ */
+uniform int lutSize3D;
+uniform int lutSize1D;
+
+/*
+ * lutScale3D, lutBias3D, lutScale1D, lutBias1D
+ * Map from an input value to its position in texels:
+ * position = value * scale + bias (the input range of the
+ * table onto [0, size - 1]).
+ */
+uniform vec3 lutScale3D;
+uniform vec3 lutBias3D;
+uniform vec3 lutScale1D;
+uniform vec3 lutBias1D;
+#endif
+
+/*
+ * ditherTex
+ * 64x64 blue-noise tile (one float per texel, in (0, 1)),
+ * repeated over the image by pixel position.
+ */
+uniform sampler2D ditherTex;
+
+/*
+ * outputLevels
+ * Largest code of the output format. Values are truncated to a
+ * code like the CPU kernel truncates, so both backends write
+ * the same codes (and count the same crushed channels).
+ * Range:
+ *  0 (floating point), 255 for 8-bit formats, 1023 for RGB10A2
+ */
+uniform float outputLevels;
+
+/*
+ * ditherLevels
+ * Largest code of the output format when dithering is on: the
+ * noise is added before quantization to that many steps.
+ * Range:
+ *  0 (off), 255 for 8-bit formats, 1023 for RGB10A2
+ */
+uniform float ditherLevels;
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+// Histogram bins of one CLAHE tile (kClaheBins)
+const int CLAHE_BINS = 256;
+
+// Shaper entries per texture row (kLutShaperRow)
+const int LUT_ROW = 1024;
+
 /* ============================================================
    Helper functions
    ============================================================ */
@@ -95,6 +270,136 @@ float luminance(vec3 c)
     return dot(c, vec3(0.2126, 0.7152, 0.0722));
 }
 
+/*
+ * cpuLog2, cpuExp2
+ * log2 (x > 0) and exp2 as the CPU kernel approximates them
+ * (Log2AVX / Exp2AVX in Kernels.cpp): the same range reductions
+ * and polynomials. The built-in pow rounds differently, which
+ * moved values lying at a code step to the neighbouring code.
+ * What remains is GPU float rounding (no fused multiply-add in
+ * GLSL 3.30, division to 2.5 ulp): a value within about 1e-6
+ * of a step can still land one code away (Bench seam).
+ */
+vec3 cpuLog2(vec3 x)
+{
+    ivec3 bits = floatBitsToInt(x);
+    vec3 e = vec3((bits >> 23) - 127);
+    vec3 m = intBitsToFloat((bits & 0x007fffff) | 0x3f800000);
+
+    // Move m into [sqrt(.5), sqrt(2))
+    vec3 big = vec3(greaterThan(m, vec3(1.41421356)));
+    m *= 1.0 - 0.5 * big;
+    e += big;
+
+    vec3 t = (m - 1.0) / (m + 1.0);
+    vec3 t2 = t * t;
+
+    vec3 p = vec3(1.0 / 9.0);
+    p = p * t2 + 1.0 / 7.0;
+    p = p * t2 + 1.0 / 5.0;
+    p = p * t2 + 1.0 / 3.0;
+    p = p * t2 + 1.0;
+
+    // log2(x) = 2*t*p / ln(2) + e
+    return (t * p) * (2.0 / 0.69314718) + e;
+}
+
+vec3 cpuExp2(vec3 y)
+{
+    y = clamp(y, -126.0, 127.0);
+
+    vec3 n = roundEven(y);
+    vec3 z = (y - n) * 0.69314718;
+
+    vec3 p = vec3(1.0 / 720.0);
+    p = p * z + 1.0 / 120.0;
+    p = p * z + 1.0 / 24.0;
+    p = p * z + 1.0 / 6.0;
+    p = p * z + 0.5;
+    p = p * z + 1.0;
+    p = p * z + 1.0;
+
+    return p * intBitsToFloat((ivec3(n) + 127) << 23);
+}
+
+/*
+ * powMatched
+ * x^p for x > 0: as the CPU kernel computes it when cpuCompatible
+ * is set, the built-in pow otherwise.
+ */
+vec3 powMatched(vec3 x, vec3 p)
+{
+    if (cpuCompatible != 0)
+        return cpuExp2(cpuLog2(x) * p);
+    return pow(x, p);
+}
+
+/*
+ * claheCurve
+ * Value of one tile's CLAHE curve between edges k and k + 1.
+ */
+float claheCurve(ivec2 tile, int k, float f)
+{
+    int row = tile.y * claheTiles.x + tile.x;
+    float a = texelFetch(claheCurves, ivec2(k, row), 0).r;
+    float b = texelFetch(claheCurves, ivec2(k + 1, row), 0).r;
+    return mix(a, b, f);
+}
+
+#ifdef CUBE_LUT
+/*
+ * shaper
+ * Entry i of the shaper, from its row of the folded texture.
+ */
+vec3 shaper(int i)
+{
+    return texelFetch(lut1D, ivec2(i % LUT_ROW, i / LUT_ROW), 0).rgb;
+}
+
+/*
+ * cubeLut
+ * Output LUT of a gamma encoded color, as the CPU kernel applies
+ * it: shaper by linear interpolation, then the lattice by
+ * tetrahedral interpolation (4 texels: the cell origin, one step
+ * along the largest fraction, steps along all but the smallest,
+ * the far corner).
+ */
+vec3 cubeLut(vec3 c)
+{
+    if (lutSize1D > 0)
+    {
+        vec3 x = clamp(c * lutScale1D + lutBias1D, 0.0, float(lutSize1D - 1));
+        ivec3 i = min(ivec3(floor(x)), lutSize1D - 2);
+        vec3 f = x - vec3(i);
+        c = vec3(mix(shaper(i.r).r, shaper(i.r + 1).r, f.r),
+                 mix(shaper(i.g).g, shaper(i.g + 1).g, f.g),
+                 mix(shaper(i.b).b, shaper(i.b + 1).b, f.b));
+    }
+
+    if (lutSize3D > 0)
+    {
+        vec3 x = clamp(c * lutScale3D + lutBias3D, 0.0, float(lutSize3D - 1));
+        ivec3 base = min(ivec3(floor(x)), lutSize3D - 2);
+        vec3 f = x - vec3(base);
+
+        ivec3 first = f.r > f.g ? (f.r > f.b ? ivec3(1, 0, 0) : ivec3(0, 0, 1))
+                                : (f.g > f.b ? ivec3(0, 1, 0) : ivec3(0, 0, 1));
+        ivec3 last = f.g > f.b ? (f.r > f.b ? ivec3(0, 0, 1) : ivec3(1, 0, 0))
+                               : (f.r > f.g ? ivec3(0, 1, 0) : ivec3(1, 0, 0));
+
+        float f1 = max(max(f.r, f.g), f.b);
+        float f3 = min(min(f.r, f.g), f.b);
+        float f2 = max(min(f.r, f.g), min(max(f.r, f.g), f.b));
+
+        c = texelFetch(lut3D, base, 0).rgb * (1.0 - f1)
+          + texelFetch(lut3D, base + first, 0).rgb * (f1 - f2)
+          + texelFetch(lut3D, base + ivec3(1) - last, 0).rgb * (f2 - f3)
+          + texelFetch(lut3D, base + ivec3(1), 0).rgb * f3;
+    }
+    return c;
+}
+#endif
+
 /* ============================================================
    Main fragment shader procedure
    ------------------------------------------------------------
@@ -122,6 +427,17 @@ void main()
      */
     vec3 hdr = texture(tex0, texCoord).rgb;
 
+    /*
+     * Bloom: light spread around the highlights, added in linear
+     * space before exposure. The bloom texel centres lie at
+     * (pixel + 0.5) / bloomFactor; linear filtering interpolates.
+     */
+    if (bloomScale > 0.0)
+    {
+        vec2 bloomCoord = gl_FragCoord.xy / (float(bloomFactor) * vec2(textureSize(bloomTex, 0)));
+        hdr += bloomScale * texture(bloomTex, bloomCoord).rgb;
+    }
+
     // Apply exposure scaling
     hdr *= exposure;
 
@@ -130,14 +446,28 @@ void main()
      */
     float L = luminance(hdr);
 
+    /*
+     * Local operator: base layer = filtered log luminance,
+     * detail = the rest; the base is compressed around the
+     * anchor and the luminance rebuilt before the curve.
+     */
+    float Lin = L;
+    if (localTone != 0)
+    {
+        float I = log2(L > localMinLuminance ? min(L, 3.0e38) : localMinLuminance);
+        vec2 ab = texelFetch(guidedMeans, ivec2(gl_FragCoord.xy), 0).rg;
+        float base = ab.x * I + ab.y;
+        Lin = exp2(localAnchor + localCompression * (base - localAnchor) + localDetail * (I - base));
+    }
+
     /*
      * Extended Reinhard tone mapping:
      * Lmapped = (L * (1 + L / wp²)) / (1 + L)
      *
      * Compresses highlights while preserving midtones.
      */
-    float Lmapped = (L * (1.0 + L / (whitePoint * whitePoint))) /
-                    (1.0 + L);
+    float Lmapped = (Lin * (1.0 + Lin / (whitePoint * whitePoint))) /
+                    (1.0 + Lin);
 
     /*
      * Re-scale RGB color based on luminance mapping.
@@ -146,11 +476,89 @@ void main()
      */
     vec3 mapped = hdr * (Lmapped / max(L, 0.0001));
 
+    // Same lower clamp as the CPU kernel
+    if (cpuCompatible != 0)
+        mapped = max(mapped, vec3(0.0001));
+
+#ifdef COLOR_GRADE
+    /*
+     * Color grade, as the CPU kernel applies it:
+     * out = max(in * slope + offset, 0)^power per channel,
+     * then saturation around the luminance.
+     */
+    mapped = powMatched(max(mapped * gradeSlope + gradeOffset, vec3(1.0e-30)), gradePower);
+    float Lg = luminance(mapped);
+    mapped = Lg + gradeSaturation * (mapped - Lg);
+    if (cpuCompatible != 0)
+        mapped = max(mapped, vec3(0.0001));
+#endif
+
+    /*
+     * CLAHE: the gamma encoded luminance of the mapped color is
+     * looked up in the curves of the four nearest tile centres
+     * and blended by distance; the color is scaled to the result
+     * (same steps as ClahePlanar on the CPU).
+     */
+    if (claheTiles.x > 0)
+    {
+        float Lm = luminance(mapped);
+        float pos = powMatched(vec3(clamp(Lm, 1.0e-30, 1.0)), vec3(invGamma)).x * float(CLAHE_BINS);
+        int k = min(int(pos), CLAHE_BINS - 1);
+        float f = pos - float(k);
+
+        vec2 t = clamp(texCoord * vec2(claheTiles) - 0.5, vec2(0.0), vec2(claheTiles - 1));
+        ivec2 t0 = ivec2(t);
+        ivec2 t1 = min(t0 + 1, claheTiles - 1);
+        vec2 w = t - vec2(t0);
+
+        float top = mix(claheCurve(t0, k, f), claheCurve(ivec2(t1.x, t0.y), k, f), w.x);
+        float bottom = mix(claheCurve(ivec2(t0.x, t1.y), k, f), claheCurve(t1, k, f), w.x);
+        float display = mix(top, bottom, w.y);
+
+        float Ld = powMatched(vec3(max(display, 1.0e-30)), vec3(gamma)).x;
+        mapped = max(mapped * (Ld / max(Lm, 0.0001)), vec3(0.0001));
+    }
+
+#ifdef CUBE_LUT
+    /*
+     * Output LUT, last of the color steps: it takes gamma encoded
+     * values in [0, 1], and its result is decoded again so the
+     * steps below write it as they would any mapped color.
+     */
+    vec3 encoded = powMatched(clamp(mapped, 1.0e-30, 1.0), vec3(invGamma));
+    mapped = powMatched(max(cubeLut(encoded), vec3(1.0e-30)), vec3(gamma));
+#endif
+
+    /*
+     * Luminance-only output: replace the color by the mapped
+     * luminance so a single-channel target keeps just that.
+     */
+    if (lumaOutput != 0)
+        mapped = vec3(luminance(mapped));
+
     /*
      * Apply gamma correction to convert from linear space
      * to display (non-linear) space.
      */
-    mapped = pow(mapped, vec3(1.0 / gamma));
+    if (linearOutput == 0)
+        mapped = powMatched(clamp(mapped, 1.0e-30, 1.0), vec3(invGamma));
+
+    /*
+     * The framebuffer rounds to the nearest 8-bit value, the CPU
+     * truncates: pre-truncate so both give the same code.
+     */
+    if (ditherLevels > 0.0)
+    {
+        /*
+         * Dithered output: the noise of this pixel is added before
+         * truncating to a code, as the CPU kernel does; the result
+         * is an exact code, so the framebuffer keeps it.
+         */
+        float noise = texelFetch(ditherTex, ivec2(gl_FragCoord.xy) & 63, 0).r;
+        mapped = floor(clamp(mapped, 0.0, 1.0) * ditherLevels + noise) / ditherLevels;
+    }
+    else if (outputLevels > 0.0)
+        mapped = floor(clamp(mapped, 0.0, 1.0) * outputLevels) / outputLevels;
 
     // Output final color with full opacity
     FragColor = vec4(mapped, 1.0);
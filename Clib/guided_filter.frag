@@ -0,0 +1,133 @@
+#version 330 core
+/* ============================================================
+   Fragment Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Passes of the guided filter of the local tone mapping
+   operator, selected by stage:
+
+    stage 0 - log2 luminance I of the exposed input and I²
+    stage 1 - box mean of both channels along direction
+    stage 2 - box mean along direction, then the guided filter
+              coefficients a = var / (var + edge), b = m (1 - a)
+              from the means of I and I²
+
+   A box filter is a stage 1 pass along x followed by a stage 1
+   or 2 pass along y. Windows are clipped at the image edges
+   and divided by the pixels they hold, as on the CPU.
+   ============================================================ */
+
+/* ============================================================
+   Output variables
+   ============================================================ */
+
+/*
+ * FragColor
+ * Two values per pixel in red and green.
+ */
+out vec4 FragColor;
+
+/* ============================================================
+   Uniform variables
+   ============================================================ */
+
+/*
+ * tex0
+ * Stage 0: HDR input texture. Later stages: the previous pass.
+ */
+uniform sampler2D tex0;
+
+/*
+ * stage
+ * Pass to run (see the description).
+ * Range:
+ *  0, 1 or 2
+ */
+uniform int stage;
+
+/*
+ * direction
+ * Box filter axis: (1, 0) or (0, 1).
+ */
+uniform ivec2 direction;
+
+/*
+ * radius
+ * Box filter radius in pixels.
+ * Range:
+ *  >= 1
+ */
+uniform int radius;
+
+/*
+ * exposure
+ * Exposure multiplier (stage 0).
+ */
+uniform float exposure;
+
+/*
+ * minLuminance
+ * Luminance floor of the log (stage 0).
+ */
+uniform float minLuminance;
+
+/*
+ * edge
+ * Edge threshold as a log2 luminance variance (stage 2).
+ */
+uniform float edge;
+
+/* ============================================================
+   Helper functions
+   ============================================================ */
+
+float luminance(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+/* ============================================================
+   Main fragment shader procedure
+   ============================================================ */
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+
+    if (stage == 0)
+    {
+        float L = luminance(texelFetch(tex0, p, 0).rgb) * exposure;
+
+        // The comparison is false for NaN, which takes the floor
+        float I = log2(L > minLuminance ? min(L, 3.0e38) : minLuminance);
+        FragColor = vec4(I, I * I, 0.0, 1.0);
+        return;
+    }
+
+    ivec2 size = textureSize(tex0, 0);
+    vec2 sum = vec2(0.0);
+    float count = 0.0;
+
+    for (int k = -radius; k <= radius; k++)
+    {
+        ivec2 q = p + direction * k;
+        if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+            continue;
+        sum += texelFetch(tex0, q, 0).rg;
+        count += 1.0;
+    }
+
+    vec2 mean = sum / count;
+
+    if (stage == 2)
+    {
+        float var = max(mean.y - mean.x * mean.x, 0.0);
+        float a = var / (var + edge);
+        FragColor = vec4(a, mean.x - a * mean.x, 0.0, 1.0);
+        return;
+    }
+
+    FragColor = vec4(mean, 0.0, 1.0);
+}
@@ -0,0 +1,196 @@
+#version 330 core
+/* ============================================================
+   Fragment Shader (OpenGL 3.3 Core)
+   Author: Jakub Hanusiak
+   Date: 5 sem, 2026-01-21
+   Topic: Tone Mapping
+
+   Description:
+   Parallel reduction of the render quality counters. Every
+   output texel summarizes an 8x8 block of its source. A block
+   takes four RGBA32F texels side by side, one per group:
+
+    group 0 - clipped high R, G, B, non-finite pixels
+    group 1 - clipped low R, G, B, finite pixels
+    group 2 - sum of L in, sum of L out, min L in, max L in
+    group 3 - min L out, max L out, 0, 0
+
+   The first level reads the HDR input and the tone mapped
+   output pixels; later levels combine blocks of the level
+   before until one block is left.
+   ============================================================ */
+
+/* ============================================================
+   Output variables
+   ============================================================ */
+
+/*
+ * FragColor
+ * One group of the counters of a block.
+ */
+out vec4 FragColor;
+
+/* ============================================================
+   Uniform variables
+   ============================================================ */
+
+/*
+ * tex0
+ * First level: HDR input texture. Later levels: the previous
+ * reduction level.
+ */
+uniform sampler2D tex0;
+
+/*
+ * tex1
+ * First level: tone mapped output texture (unused later).
+ */
+uniform sampler2D tex1;
+
+/*
+ * firstLevel
+ * Non-zero when reading pixels instead of blocks.
+ * Range:
+ *  0 or 1
+ */
+uniform int firstLevel;
+
+/*
+ * srcSize
+ * Source size in pixels (first level) or blocks (later).
+ */
+uniform ivec2 srcSize;
+
+/*
+ * exposure, whitePoint
+ * Settings of the render, to recompute scene and mapped
+ * luminance exactly as the tone mapping pass did.
+ */
+uniform float exposure;
+uniform float whitePoint;
+
+/*
+ * lumaOutput
+ * When non-zero the output holds luminance in red only; it is
+ * counted for all three channels.
+ * Range:
+ *  0 or 1
+ */
+uniform int lumaOutput;
+
+/*
+ * clipLowLevel
+ * Output value below which a channel counts as crushed: that of
+ * 8-bit code kClipLowCode + 1 in the output's own encoding, so
+ * black (floored to code 3 on the CPU) is crushed on both
+ * backends.
+ */
+uniform float clipLowLevel;
+
+/* ============================================================
+   Constants
+   ============================================================ */
+
+const int BLOCK = 8;
+const float BIG = 3.0e38;
+
+// Half an 8-bit step: values closer to 1 quantize to 255
+const float HALF_STEP = 0.5 / 255.0;
+
+/* ============================================================
+   Helper functions
+   ============================================================ */
+
+float luminance(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+/*
+ * identity
+ * Neutral value of a group for Combine.
+ */
+vec4 identity(int group)
+{
+    if (group == 2)
+        return vec4(0.0, 0.0, BIG, -BIG);
+    if (group == 3)
+        return vec4(BIG, -BIG, 0.0, 0.0);
+    return vec4(0.0);
+}
+
+/*
+ * combine
+ * Merges two partial results of a group: counts and sums add,
+ * minima and maxima fold.
+ */
+vec4 combine(vec4 a, vec4 b, int group)
+{
+    if (group == 2)
+        return vec4(a.xy + b.xy, min(a.z, b.z), max(a.w, b.w));
+    if (group == 3)
+        return vec4(min(a.x, b.x), max(a.y, b.y), 0.0, 0.0);
+    return a + b;
+}
+
+/*
+ * pixelStats
+ * Counters of one group for a single pixel.
+ */
+vec4 pixelStats(ivec2 p, int group)
+{
+    vec3 hdr = texelFetch(tex0, p, 0).rgb * exposure;
+    vec3 mapped = texelFetch(tex1, p, 0).rgb;
+    if (lumaOutput != 0)
+        mapped = mapped.rrr;
+
+    bool finite = !any(isnan(hdr)) && !any(isinf(hdr));
+
+    if (group == 0)
+        return vec4(step(vec3(1.0 - HALF_STEP), mapped), finite ? 0.0 : 1.0);
+    if (group == 1)
+        return vec4(vec3(lessThan(mapped, vec3(clipLowLevel))), finite ? 1.0 : 0.0);
+
+    if (!finite)
+        return identity(group);
+
+    float L = luminance(hdr);
+    float Lmapped = (L * (1.0 + L / (whitePoint * whitePoint))) / (1.0 + L);
+
+    if (group == 2)
+        return vec4(L, Lmapped, L, L);
+    return vec4(Lmapped, Lmapped, 0.0, 0.0);
+}
+
+/* ============================================================
+   Main fragment shader procedure
+   ------------------------------------------------------------
+   Description:
+   Folds the 8x8 source block of this texel's group, skipping
+   positions past the edge of the source.
+   ============================================================ */
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    int group = texel.x % 4;
+    ivec2 block = ivec2(texel.x / 4, texel.y) * BLOCK;
+
+    vec4 acc = identity(group);
+
+    for (int j = 0; j < BLOCK; j++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            ivec2 s = block + ivec2(i, j);
+            if (s.x >= srcSize.x || s.y >= srcSize.y)
+                continue;
+
+            vec4 v = firstLevel != 0
+                ? pixelStats(s, group)
+                : texelFetch(tex0, ivec2(s.x * 4 + group, s.y), 0);
+            acc = combine(acc, v, group);
+        }
+    }
+
+    FragColor = acc;
+}
@@ -52,15 +52,25 @@ std::string get_file_contents(const char* filename)
 // Handles loading, compilation, linking, and cleanup.
 //
 // Parameters:
-// vertexFile   - Path to the vertex shader source
-// fragmentFile - Path to the fragment shader source
+// vertexFile      - Path to the vertex shader source
+// fragmentFile    - Path to the fragment shader source
+// fragmentDefines - Lines inserted after the fragment
+//                   shader's #version line (may be
+//                   nullptr), to compile a variant
 // ----------------------------------------------------
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const char* fragmentDefines)
 {
     // Load shader source code from files
     std::string vertexCode = get_file_contents(vertexFile);
     std::string fragmentCode = get_file_contents(fragmentFile);
 
+    // #version must stay the first line
+    if (fragmentDefines)
+    {
+        size_t line = fragmentCode.find('\n');
+        fragmentCode.insert(line == std::string::npos ? fragmentCode.size() : line + 1, fragmentDefines);
+    }
+
     // Convert source strings to C-style strings
     const char* vertexSource = vertexCode.c_str();
     const char* fragmentSource = fragmentCode.c_str();
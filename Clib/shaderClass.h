@@ -15,8 +15,10 @@ class Shader
 public:
 	// Reference ID of the Shader Program
 	GLuint ID;
-	// Constructor that build the Shader Program from 2 different shaders
-	Shader(const char* vertexFile, const char* fragmentFile);
+	// Constructor that build the Shader Program from 2 different shaders,
+	// optionally with lines (e.g. #define) added after the fragment
+	// shader's #version line
+	Shader(const char* vertexFile, const char* fragmentFile, const char* fragmentDefines = nullptr);
 
 	// Activates the Shader Program
 	void Activate();
@@ -15,9 +15,11 @@ using Microsoft.Win32;
 using System;
 using System.ComponentModel;
 using System.Diagnostics;
+using System.IO;
 using System.Linq;
 using System.Runtime.InteropServices;
 using System.Threading;
+using System.Threading.Tasks;
 using System.Windows;
 using System.Windows.Input;
 using System.Windows.Media;
@@ -64,6 +66,472 @@ internal partial class ToneMapGL
     // Releases GLFW and OpenGL resources
     [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
     public static extern void CleanupGLFW();
+
+    // Starts context creation, shader compile and a first draw
+    // on the native GL thread; returns immediately
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void WarmUpGLAsync();
+
+    // Copies the native library statistics
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void GetHDRStats(out HDRStats stats);
+
+    // Turns quality counters of native renders on or off
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void EnableQualityStats([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    // Copies the quality counters of the last native render;
+    // false if there was none
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool GetQualityStats(out HDRQualityStats stats);
+
+    // Turns blue-noise dithering of 8-bit native output on or off
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void EnableDither([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    // Sets the CLAHE clip limit and tiles along the longer side
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void SetCLAHEParams(float clipLimit, int tiles);
+
+    // Sets the local operator's filter radius, edge threshold,
+    // base compression and detail gain
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void SetLocalToneParams(int radius, float edge, float compression, float detail);
+
+    // Sets the bloom threshold, intensity (0 = off) and radius
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void SetBloomParams(float threshold, float intensity, float radius);
+
+    // Sets the ASC CDL slope, offset and power (null = identity)
+    // and the saturation applied after the tone curve
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void SetColorGrade(float[] slope, float[] offset, float[] power, float saturation);
+
+    // Loads a .cube LUT applied to native output (null = none);
+    // false if the file cannot be read or parsed
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool LoadCubeLut(string path);
+}
+
+// ============================================================
+// Native library statistics (mirrors HDRStats in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRStats
+{
+    // 0 none, 1 running, 2 done, 3 failed
+    public int WarmUpState;
+
+    // Warm-up duration in milliseconds
+    public double WarmUpMs;
+
+    // GL texture pool: textures held, bytes held, textures created
+    public int GpuPoolTextures;
+    public long GpuPoolBytes;
+    public long GpuAllocations;
+
+    // Last native CPU run: full-image passes and peak memory
+    public int CpuPasses;
+    public long CpuPeakBytes;
+
+    // Last CPU+GPU split frame
+    public double SplitGpuShare;
+    public int SplitGpuRows;
+    public double SplitGpuMs;
+    public double SplitCpuMs;
+
+    // Render cache counters
+    public long CacheHits;
+    public long CacheMisses;
+    public int CacheEntries;
+    public long CacheBytes;
+
+    // Speculative pre-rendering: renders completed, renders
+    // cancelled, cache hits they served, time spent for nothing
+    public long SpecRenders;
+    public long SpecCancelled;
+    public long SpecHits;
+    public double SpecWastedMs;
+
+    // Lazy tile server cache: hits, tiles computed, requests
+    // that waited for a tile already being computed, size
+    public long TileHits;
+    public long TileMisses;
+    public long TileCoalesced;
+    public int TileEntries;
+    public long TileBytes;
+
+    // Sequence frames: tiles kept from the previous frame because
+    // their input was unchanged, tiles tone mapped
+    public long SeqTilesSkipped;
+    public long SeqTilesRendered;
+}
+
+// ============================================================
+// Request latency distribution (mirrors HDRLatencyStats in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRLatencyStats
+{
+    // Requests recorded / slower than SloMs
+    public long Count;
+    public long OverSlo;
+
+    // Submission to output ready, in milliseconds
+    public double P50Ms;
+    public double P95Ms;
+    public double P99Ms;
+    public double MaxMs;
+    public double MeanMs;
+    public double SloMs;
+}
+
+// ============================================================
+// Render quality counters (mirrors HDRQualityStats in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRQualityStats
+{
+    // Pixels rendered / pixels with NaN or infinite input
+    public long Pixels;
+    public long NonFinite;
+
+    // Output channels R, G, B at full scale / at zero
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public long[] ClipHigh;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public long[] ClipLow;
+
+    // Luminance before (exposed scene) and after mapping
+    public double LumMinIn;
+    public double LumMaxIn;
+    public double LumMeanIn;
+    public double LumMinOut;
+    public double LumMaxOut;
+    public double LumMeanOut;
+}
+
+// ============================================================
+// Luminance estimate (mirrors HDRExposureEstimate in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRExposureEstimate
+{
+    // Geometric mean luminance and its 95% interval
+    public float LogAverage;
+    public float LogAverageLow;
+    public float LogAverageHigh;
+
+    // Luminance at the requested rank and its 95% interval
+    public float Percentile;
+    public float PercentileLow;
+    public float PercentileHigh;
+
+    // Exposure mapping LogAverage to middle grey
+    public float Exposure;
+
+    // Pixels read / 1 if every pixel was read
+    public long Samples;
+    public int FullPass;
+}
+
+// ============================================================
+// Metering result (mirrors HDRMeterResult in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRMeterResult
+{
+    // Metered luminance / luminance of the brightest 1%
+    public float Luminance;
+    public float Highlight;
+
+    // Exposure putting Luminance on middle grey
+    public float Exposure;
+}
+
+// ============================================================
+// Batch file entry (mirrors HDRBatchImage in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct HDRBatchImage
+{
+    public int Width;
+    public int Height;
+
+    // Geometric mean / brightest 1% luminance
+    public float LogAverage;
+    public float Highlight;
+
+    // Exposure to tone map with
+    public float Exposure;
+
+    // 1 if the file was read
+    public int Status;
+}
+
+// ============================================================
+// Render cache key (mirrors RenderCacheKey in HDR.h)
+// ============================================================
+[StructLayout(LayoutKind.Sequential)]
+internal struct RenderCacheKey
+{
+    // HashLinearRGB of the unboosted image
+    public ulong ImageHash;
+    public int Width;
+    public int Height;
+
+    // Render settings
+    public float Boost;
+    public float Exposure;
+    public float WhitePoint;
+
+    // HDROperator, HDRBackend and HDROutputFormat values
+    public int Op;
+    public int Backend;
+    public int Format;
+}
+
+// ============================================================
+// Native render cache interface
+// ============================================================
+internal static class RenderCacheNative
+{
+    // Backend values of RenderCacheKey.Backend
+    public const int BackendGL = 0;
+    public const int BackendCpu = 1;
+    public const int BackendSplit = 2;
+    public const int BackendAsm = 3;
+
+    // Operator values of RenderCacheKey.Op
+    public const int OperatorReinhard = 0;
+    public const int OperatorClahe = 1;
+    public const int OperatorLocal = 2;
+
+    // Results of ToneMapCached
+    public const int CacheFailed = 0;
+    public const int CacheRendered = 1;
+    public const int CacheHit = 2;
+
+    // Content hash of a linear RGB image (count = number of floats)
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern ulong HashLinearRGB(float[] linearRGB, long count);
+
+    // --------------------------------------------------------
+    // ToneMapCached
+    //
+    // Description:
+    // Returns the render described by key from the cache, or
+    // renders it with the key's backend (GL, CPU or split)
+    // and caches it.
+    //
+    // Parameters:
+    // key       - Render identity and settings
+    // linearRGB - Boosted linear RGB float array [RGBRGB...]
+    // output    - Output buffer (width * height * 4 for BGRA8)
+    //
+    // Output:
+    // Returns CacheHit or CacheRendered with output written,
+    // or CacheFailed with output untouched (e.g. no OpenGL)
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int ToneMapCached(
+        ref RenderCacheKey key,
+        float[] linearRGB,
+        byte[] output
+    );
+
+    // Copies a cached render into output; false on a miss
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool RenderCacheLookup(ref RenderCacheKey key, byte[] output, long bytes);
+
+    // Stores a render made outside the native library
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void RenderCacheStore(ref RenderCacheKey key, byte[] data, long bytes);
+
+    // Drops all cached renders
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void RenderCacheClear();
+
+    // Records a request served outside the native library (ASM)
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void RecordLatency(
+        int backend,
+        [MarshalAs(UnmanagedType.I1)] bool cacheHit,
+        double ms
+    );
+
+    // Copies the latency distribution of a backend (cacheHit 0/1)
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool GetLatencyStats(int backend, int cacheHit, out HDRLatencyStats stats);
+
+    // --------------------------------------------------------
+    // SpeculateNext
+    //
+    // Description:
+    // Reports a slider change. The native library pre-renders
+    // the shown settings and the values the drag is likely to
+    // reach next into the cache on a low-priority thread.
+    // Every real request cancels this work.
+    //
+    // Parameters:
+    // key            - Current settings, backend and format
+    // linearRGB      - Boosted linear RGB float array
+    // exposureStep   - Exposure slider tick size
+    // whitePointStep - White point slider tick size
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void SpeculateNext(
+        ref RenderCacheKey key,
+        float[] linearRGB,
+        float exposureStep,
+        float whitePointStep
+    );
+}
+
+// ============================================================
+// Native compressed image store interface
+// ============================================================
+internal static class ImageStoreNative
+{
+    // --------------------------------------------------------
+    // ImageStoreCreate
+    //
+    // Description:
+    // Keeps a linear RGB image as FP16, LZ4-compressed tiles.
+    // Finite values are clamped to the FP16 range (65504).
+    //
+    // Parameters:
+    // linearRGB - Linear RGB float array [RGBRGB...]
+    // width     - Image width in pixels (> 0)
+    // height    - Image height in pixels (> 0)
+    //
+    // Output:
+    // Returns the store id (> 0), or 0 on invalid arguments
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int ImageStoreCreate(float[] linearRGB, int width, int height);
+
+    // Frees a store
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void ImageStoreRelease(int store);
+
+    // Compressed size of a store in bytes
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern long ImageStoreBytes(int store);
+
+    // Decompresses a store into linearRGB, multiplied by scale
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool ImageStoreRead(int store, float[] linearRGB, float scale);
+}
+
+// ============================================================
+// Native auto-exposure interface
+// ============================================================
+internal static class ExposureNative
+{
+    // --------------------------------------------------------
+    // EstimateExposure
+    //
+    // Description:
+    // Measures the log-average and a percentile luminance from
+    // a sample of the pixels, reading all of them only when the
+    // sample is not certain enough.
+    //
+    // Parameters:
+    // linearRGB  - Linear RGB float array [RGBRGB...]
+    // width      - Image width in pixels (> 0)
+    // height     - Image height in pixels (> 0)
+    // percentile - Rank of the percentile figure [0, 1]
+    // tolerance  - Accepted interval half-width in stops
+    //
+    // Output:
+    // estimate holds the figures and the suggested exposure
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool EstimateExposure(
+        float[] linearRGB,
+        int width,
+        int height,
+        float percentile,
+        float tolerance,
+        out HDRExposureEstimate estimate
+    );
+
+    // Builds the luminance pyramid metering works on (0 = failed)
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int LuminancePyramidCreate(float[] linearRGB, int width, int height);
+
+    // Frees a luminance pyramid
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void LuminancePyramidRelease(int pyramid);
+
+    // --------------------------------------------------------
+    // MeterExposure
+    //
+    // Description:
+    // Meters an image from its luminance pyramid without
+    // reading the image again.
+    //
+    // Parameters:
+    // pyramid    - Id from LuminancePyramidCreate
+    // mode       - HDRMeteringMode value (0 matrix, 1 centre,
+    //              2 spot, 3 highlight priority)
+    // x, y       - Spot / centre position, fractions of the size
+    // radius     - Spot radius / centre sigma, fraction of the
+    //              longer side (<= 0 = default)
+    // whitePoint - White point of the tone map
+    //
+    // Output:
+    // result holds the metered luminance and exposure
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool MeterExposure(
+        int pyramid,
+        int mode,
+        float x,
+        float y,
+        float radius,
+        float whitePoint,
+        out HDRMeterResult result
+    );
+}
+
+// ============================================================
+// Native batch tone mapping interface
+// ============================================================
+internal static class BatchNative
+{
+    // Phase one: luminance of every file, decoded in parallel
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int BatchAnalyze(string[] paths, int count, [In, Out] HDRBatchImage[] images);
+
+    // Consistent exposures: the median image gets exposure, the
+    // others move towards its brightness by strength [0, 1]
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void BatchSolveExposure(
+        [In, Out] HDRBatchImage[] images,
+        int count,
+        float exposure,
+        float strength,
+        float whitePoint
+    );
+
+    // Phase two: tone maps every file into a PNG
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern int BatchToneMap(
+        string[] paths,
+        string[] outputs,
+        HDRBatchImage[] images,
+        int count,
+        float whitePoint
+    );
 }
 
 // ============================================================
@@ -96,6 +564,59 @@ internal static class ToneMapAsm
     );
 }
 
+// ============================================================
+// Native C++ CPU tone mapping interface
+// ============================================================
+internal static class ToneMapCpu
+{
+    // --------------------------------------------------------
+    // ToneMapCPU
+    //
+    // Description:
+    // Tone maps an HDR linear RGB image on the CPU. Loading,
+    // tone mapping and gamma/quantization run fused in one
+    // tiled, multithreaded pass.
+    //
+    // Parameters:
+    // linearRGB  - Input linear RGB float array [RGBRGB...]
+    // width      - Image width in pixels (> 0)
+    // height     - Image height in pixels (> 0)
+    // outputBGRA - Output buffer for BGRA image (byte array)
+    // exposure   - Exposure multiplier (> 0.0)
+    // whitePoint - Reinhard white point (> 0.0)
+    //
+    // Output:
+    // outputBGRA array is filled with tone-mapped image data
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void ToneMapCPU(
+        float[] linearRGB,
+        int width,
+        int height,
+        byte[] outputBGRA,
+        float exposure,
+        float whitePoint
+    );
+
+    // --------------------------------------------------------
+    // ToneMapSplit
+    //
+    // Description:
+    // Same as ToneMapCPU, but row bands are shared between the
+    // GPU and the CPU, which work at the same time. The split
+    // adapts to the measured speed of both.
+    // --------------------------------------------------------
+    [DllImport("Clib.dll", CallingConvention = CallingConvention.Cdecl)]
+    public static extern void ToneMapSplit(
+        float[] linearRGB,
+        int width,
+        int height,
+        byte[] outputBGRA,
+        float exposure,
+        float whitePoint
+    );
+}
+
 // ============================================================
 // Main WPF application window
 // ============================================================
@@ -107,8 +628,11 @@ namespace wpftesting
         // Private fields
         // ----------------------------------------------------
 
-        // Original linear RGB image (HDR, linear space)
-        private float[] _linearRGB;
+        // Original linear RGB image (HDR, linear space), kept
+        // compressed in the native image store (0 = none). The
+        // image is decoded from 8-bit sRGB, so FP16 (11-bit
+        // mantissa) holds it without a visible loss
+        private int _linearStore;
 
         // Boosted version of the image (for HDR exaggeration)
         private float[] _boostedlinearRGB;
@@ -116,6 +640,19 @@ namespace wpftesting
         // Loaded image bitmap (for display and metadata)
         private BitmapImage _bitmap;
 
+        // Content hash of the original image (render cache key)
+        private ulong _imageHash;
+
+        // Boost factor applied to _boostedlinearRGB
+        private float _hdrBoost = 1.0f;
+
+        // Luminance pyramid of the original image (0 = none)
+        private int _meterPyramid;
+
+        // Spot / centre metering position, fractions of the size
+        private float _meterX = 0.5f;
+        private float _meterY = 0.5f;
+
         // ----------------------------------------------------
         // Constructor
         // ----------------------------------------------------
@@ -123,6 +660,9 @@ namespace wpftesting
         {
             InitializeComponent();
             Console.WriteLine(Environment.CurrentDirectory);
+
+            // Pay GL start-up cost in the background, not on first Generate
+            ToneMapGL.WarmUpGLAsync();
         }
 
         // ----------------------------------------------------
@@ -132,6 +672,8 @@ namespace wpftesting
         // ----------------------------------------------------
         private void Window_Closing(object sender, CancelEventArgs e)
         {
+            ImageStoreNative.ImageStoreRelease(_linearStore);
+            ExposureNative.LuminancePyramidRelease(_meterPyramid);
             ToneMapGL.CleanupGLFW();
         }
 
@@ -157,29 +699,32 @@ namespace wpftesting
         private void BoostImage()
         {
             float hdrBoost;
-
-            // Create a copy to preserve original data
-            _boostedlinearRGB = _linearRGB.ToArray();
-
-            if (float.TryParse(
+            bool parsed = float.TryParse(
                 ColourBoostBox.Text,
                 System.Globalization.NumberStyles.Float,
                 System.Globalization.CultureInfo.InvariantCulture,
-                out hdrBoost))
+                out hdrBoost);
+
+            if (!parsed)
+            {
+                hdrBoost = 1.0f;
+            }
+            else if (hdrBoost < 1.0f)
             {
                 // Enforce minimum boost
-                if (hdrBoost < 1.0f)
-                {
-                    hdrBoost = 1.0f;
-                    ColourBoostBox.Text = "1.0";
-                }
+                hdrBoost = 1.0f;
+                ColourBoostBox.Text = "1.0";
+            }
 
-                // Apply boost to all channels
-                for (int i = 0; i < _boostedlinearRGB.Length; i++)
-                {
-                    _boostedlinearRGB[i] *= hdrBoost;
-                }
+            _hdrBoost = hdrBoost;
+
+            // Decompress a boosted copy in one pass; the store
+            // keeps the original data
+            _boostedlinearRGB = new float[_bitmap.PixelWidth * _bitmap.PixelHeight * 3];
+            ImageStoreNative.ImageStoreRead(_linearStore, _boostedlinearRGB, hdrBoost);
 
+            if (parsed)
+            {
                 // Update preview image
                 WriteableBitmap preview =
                     LinearRGBToBitmap(_boostedlinearRGB,
@@ -195,7 +740,7 @@ namespace wpftesting
         // ----------------------------------------------------
         private void ColourBoost_ValueChanged(object sender, KeyEventArgs ek)
         {
-            if (_linearRGB != null &&
+            if (_linearStore != 0 &&
                 _bitmap != null &&
                 ek.Key == Key.Enter)
             {
@@ -203,6 +748,180 @@ namespace wpftesting
             }
         }
 
+        // ----------------------------------------------------
+        // Saturation value change handler
+        //
+        // Sets the saturation of the native color grade; it is
+        // applied inside the tone mapping pass of the next
+        // Generate, with no extra pass over the image
+        // ----------------------------------------------------
+        private void Saturation_ValueChanged(object sender, KeyEventArgs ek)
+        {
+            float saturation;
+            if (ek.Key == Key.Enter && float.TryParse(
+                SaturationBox.Text,
+                System.Globalization.NumberStyles.Float,
+                System.Globalization.CultureInfo.InvariantCulture,
+                out saturation))
+            {
+                ToneMapGL.SetColorGrade(null, null, null, saturation);
+            }
+        }
+
+        // ----------------------------------------------------
+        // Auto exposure button handler
+        //
+        // Sets the exposure slider from the selected metering
+        // mode; every backend reads it
+        // ----------------------------------------------------
+        private void AutoExposure_Click(object sender, RoutedEventArgs e)
+        {
+            if (_boostedlinearRGB == null || _bitmap == null)
+                return;
+
+            if (MeteringBox.SelectedIndex > 0)
+            {
+                // The pyramid is of the unboosted image; boost scales
+                // every luminance, so it divides the exposure
+                if (!ExposureNative.MeterExposure(
+                    _meterPyramid,
+                    MeteringBox.SelectedIndex - 1,
+                    _meterX,
+                    _meterY,
+                    0.0f,
+                    (float)WhitePointSlider.Value,
+                    out HDRMeterResult meter))
+                    return;
+
+                ExposureSlider.Value = Clamp(meter.Exposure / _hdrBoost,
+                    (float)ExposureSlider.Minimum,
+                    (float)ExposureSlider.Maximum);
+                return;
+            }
+
+            if (!ExposureNative.EstimateExposure(
+                _boostedlinearRGB,
+                _bitmap.PixelWidth,
+                _bitmap.PixelHeight,
+                0.99f,
+                0.05f,
+                out HDRExposureEstimate estimate))
+                return;
+
+            ExposureSlider.Value = Clamp(estimate.Exposure,
+                (float)ExposureSlider.Minimum,
+                (float)ExposureSlider.Maximum);
+
+            Console.WriteLine($"Auto exposure: {estimate.Exposure:F3}, log average {estimate.LogAverage:F4} " +
+                              $"[{estimate.LogAverageLow:F4}, {estimate.LogAverageHigh:F4}], " +
+                              $"p99 {estimate.Percentile:F3}, {estimate.Samples} pixels" +
+                              (estimate.FullPass != 0 ? " (full pass)" : ""));
+        }
+
+        // ----------------------------------------------------
+        // Original image click handler
+        //
+        // Moves the spot / centre metering position and meters
+        // again in those modes
+        // ----------------------------------------------------
+        private void OriginalImage_MouseLeftButtonDown(object sender, MouseButtonEventArgs e)
+        {
+            if (OriginalImage.ActualWidth <= 0 || OriginalImage.ActualHeight <= 0)
+                return;
+
+            Point position = e.GetPosition(OriginalImage);
+            _meterX = (float)(position.X / OriginalImage.ActualWidth);
+            _meterY = (float)(position.Y / OriginalImage.ActualHeight);
+
+            if (MeteringBox.SelectedIndex == 2 || MeteringBox.SelectedIndex == 3)
+                AutoExposure_Click(sender, e);
+        }
+
+        // ----------------------------------------------------
+        // Dither check box handler
+        //
+        // Switches blue-noise dithering of native renders; the
+        // next Generate shows the difference
+        // ----------------------------------------------------
+        private void Dither_Changed(object sender, RoutedEventArgs e)
+        {
+            ToneMapGL.EnableDither(DitherCheck.IsChecked == true);
+        }
+
+        // ----------------------------------------------------
+        // Bloom check box handler
+        //
+        // Switches bloom of native renders with the library's
+        // default threshold and radius
+        // ----------------------------------------------------
+        private void Bloom_Changed(object sender, RoutedEventArgs e)
+        {
+            ToneMapGL.SetBloomParams(1.0f, BloomCheck.IsChecked == true ? 0.3f : 0.0f, 0.05f);
+        }
+
+        // ----------------------------------------------------
+        // Stats check box handler
+        //
+        // Clipping / NaN counters cost a reduction pass per
+        // render, so they are gathered only while shown
+        // ----------------------------------------------------
+        private void Quality_Changed(object sender, RoutedEventArgs e)
+        {
+            ToneMapGL.EnableQualityStats(QualityCheck.IsChecked == true);
+        }
+
+        // ----------------------------------------------------
+        // LUT check box handler
+        //
+        // Asks for a .cube file when checked and applies it to
+        // native renders; unchecking (or a cancelled or
+        // unreadable file) removes the LUT
+        // ----------------------------------------------------
+        private void Lut_Changed(object sender, RoutedEventArgs e)
+        {
+            if (LutCheck.IsChecked != true)
+            {
+                ToneMapGL.LoadCubeLut(null);
+                return;
+            }
+
+            OpenFileDialog dialog = new OpenFileDialog
+            {
+                Filter = "Cube LUT|*.cube"
+            };
+
+            if (dialog.ShowDialog() != true || !ToneMapGL.LoadCubeLut(dialog.FileName))
+                LutCheck.IsChecked = false;
+        }
+
+        // ----------------------------------------------------
+        // Exposure / white point slider change handler
+        //
+        // Starts pre-rendering the settings the drag is heading
+        // to, so Generate is likely to find them in the cache
+        // ----------------------------------------------------
+        private void Slider_ValueChanged(object sender, RoutedPropertyChangedEventArgs<double> e)
+        {
+            if (_boostedlinearRGB == null || _bitmap == null)
+                return;
+
+            int backend;
+            if (OpenGLRadio.IsChecked == true)
+                backend = RenderCacheNative.BackendGL;
+            else if (CpuRadio.IsChecked == true)
+                backend = RenderCacheNative.BackendCpu;
+            else
+                return; // ASM renders are not done natively, split ones not bit-exact
+
+            RenderCacheKey key = MakeCacheKey(backend);
+            RenderCacheNative.SpeculateNext(
+                ref key,
+                _boostedlinearRGB,
+                (float)ExposureSlider.TickFrequency,
+                (float)WhitePointSlider.TickFrequency
+            );
+        }
+
         // ----------------------------------------------------
         // InterleavedToPlanar
         //
@@ -289,6 +1008,53 @@ namespace wpftesting
             return wb;
         }
 
+        // ----------------------------------------------------
+        // MakeCacheKey
+        //
+        // Builds the render cache key of the current image and
+        // UI settings for a backend (BGRA8 output). The ASM
+        // backend only has Extended Reinhard.
+        // ----------------------------------------------------
+        private RenderCacheKey MakeCacheKey(int backend)
+        {
+            int op = backend == RenderCacheNative.BackendAsm
+                ? RenderCacheNative.OperatorReinhard
+                : OperatorBox.SelectedIndex;
+
+
+            return new RenderCacheKey
+            {
+                ImageHash = _imageHash,
+                Width = _bitmap.PixelWidth,
+                Height = _bitmap.PixelHeight,
+                Boost = _hdrBoost,
+                Exposure = (float)ExposureSlider.Value,
+                WhitePoint = (float)WhitePointSlider.Value,
+                Op = op,
+                Backend = backend,
+                Format = 0
+            };
+        }
+
+        // ----------------------------------------------------
+        // BGRAToBitmap
+        //
+        // Wraps a BGRA8 pixel buffer in a WPF bitmap
+        // ----------------------------------------------------
+        static WriteableBitmap BGRAToBitmap(byte[] pixels, int width, int height)
+        {
+            WriteableBitmap wb = new WriteableBitmap(
+                width, height, 96, 96, PixelFormats.Bgra32, null);
+
+            wb.WritePixels(
+                new Int32Rect(0, 0, width, height),
+                pixels,
+                width * 4,
+                0);
+
+            return wb;
+        }
+
         // ----------------------------------------------------
         // GenerateOpenGL
         //
@@ -309,20 +1075,22 @@ namespace wpftesting
             byte[] outputByte =
                 new byte[_bitmap.PixelWidth * _bitmap.PixelHeight * 4];
 
-            // Read UI parameters
-            float exposure = (float)ExposureSlider.Value;
-            float whitePoint = (float)WhitePointSlider.Value;
-
-            // Call native OpenGL tone mapping pipeline
-            ToneMapGL.UploadToGL(
+            // Call native OpenGL tone mapping pipeline (or reuse
+            // an earlier render with the same settings)
+            RenderCacheKey key = MakeCacheKey(RenderCacheNative.BackendGL);
+            int result = RenderCacheNative.ToneMapCached(
+                ref key,
                 _boostedlinearRGB,
-                _bitmap.PixelWidth,
-                _bitmap.PixelHeight,
-                outputByte,
-                exposure,
-                whitePoint
+                outputByte
             );
 
+            // Nothing was written; keep the last image on screen
+            if (result == RenderCacheNative.CacheFailed)
+            {
+                TimeValueLabel.Text = "render failed";
+                return;
+            }
+
             // Create WPF bitmap for display
             WriteableBitmap output =
                 new WriteableBitmap(
@@ -346,7 +1114,9 @@ namespace wpftesting
 
             // Stop timing and display result
             swg.Stop();
-            Console.WriteLine($"GPU OpenGL: {swg.ElapsedMilliseconds} ms");
+            ToneMapGL.GetHDRStats(out HDRStats stats);
+            Console.WriteLine($"GPU OpenGL: {swg.ElapsedMilliseconds} ms (warm-up {stats.WarmUpMs:F1} ms, " +
+                $"{(result == RenderCacheNative.CacheHit ? "cache hit" : "rendered")}, cache {stats.CacheHits}/{stats.CacheHits + stats.CacheMisses})");
             TimeValueLabel.Text = $"{swg.ElapsedMilliseconds} ms";
         }
 
@@ -368,6 +1138,24 @@ namespace wpftesting
             // Start CPU timing
             var sw = Stopwatch.StartNew();
 
+            // Reuse an earlier render with the same settings
+            RenderCacheKey key = MakeCacheKey(RenderCacheNative.BackendAsm);
+            long bytes = (long)_bitmap.PixelWidth * _bitmap.PixelHeight * 4;
+            byte[] cachedPixels = new byte[bytes];
+
+            if (RenderCacheNative.RenderCacheLookup(ref key, cachedPixels, bytes))
+            {
+                OutputImage.Source = BGRAToBitmap(
+                    cachedPixels,
+                    _bitmap.PixelWidth,
+                    _bitmap.PixelHeight);
+
+                sw.Stop();
+                RenderCacheNative.RecordLatency(RenderCacheNative.BackendAsm, true, sw.Elapsed.TotalMilliseconds);
+                TimeValueLabel.Text = $"{sw.ElapsedMilliseconds} ms";
+                return;
+            }
+
             // Copy boosted linear RGB data to a temporary array
             float[] temp = _boostedlinearRGB.ToArray();
             float[] r, g, b;
@@ -405,16 +1193,125 @@ namespace wpftesting
             temp = PlanarToInterleaved(combined);
 
             // Create output bitmap and display result
-            OutputImage.Source = LinearRGBToBitmap(
+            WriteableBitmap result = LinearRGBToBitmap(
                 temp,
                 _bitmap.PixelWidth,
                 _bitmap.PixelHeight);
+            OutputImage.Source = result;
+
+            // Keep the pixels for the next request with these settings
+            result.CopyPixels(cachedPixels, _bitmap.PixelWidth * 4, 0);
+            RenderCacheNative.RenderCacheStore(ref key, cachedPixels, bytes);
 
             // Stop timing and display result
             sw.Stop();
+            RenderCacheNative.RecordLatency(RenderCacheNative.BackendAsm, false, sw.Elapsed.TotalMilliseconds);
             TimeValueLabel.Text = $"{sw.ElapsedMilliseconds} ms";
         }
 
+        // ----------------------------------------------------
+        // GenerateNative
+        //
+        // Description:
+        // Performs HDR tone mapping on the CPU in the native
+        // library. The whole pipeline runs as one fused tiled
+        // pass directly on the interleaved linear RGB buffer.
+        // With split set, the GPU renders part of the rows
+        // at the same time.
+        //
+        // Output:
+        // Displays the tone-mapped image and execution time.
+        // ----------------------------------------------------
+        private void GenerateNative(bool split)
+        {
+            // Start CPU timing
+            var sw = Stopwatch.StartNew();
+
+            byte[] outputByte =
+                new byte[_bitmap.PixelWidth * _bitmap.PixelHeight * 4];
+
+            // Render (or reuse an earlier render with the same settings)
+            RenderCacheKey key = MakeCacheKey(
+                split ? RenderCacheNative.BackendSplit : RenderCacheNative.BackendCpu);
+            int result = RenderCacheNative.ToneMapCached(
+                ref key,
+                _boostedlinearRGB,
+                outputByte
+            );
+
+            if (result == RenderCacheNative.CacheFailed)
+            {
+                TimeValueLabel.Text = "render failed";
+                return;
+            }
+
+            WriteableBitmap output =
+                new WriteableBitmap(
+                    _bitmap.PixelWidth,
+                    _bitmap.PixelHeight,
+                    96,
+                    96,
+                    PixelFormats.Bgra32,
+                    null);
+
+            output.WritePixels(
+                new Int32Rect(0, 0, _bitmap.PixelWidth, _bitmap.PixelHeight),
+                outputByte,
+                _bitmap.PixelWidth * 4,
+                0
+            );
+
+            OutputImage.Source = output;
+
+            // Stop timing and display result
+            sw.Stop();
+            TimeValueLabel.Text = $"{sw.ElapsedMilliseconds} ms";
+        }
+
+        // ----------------------------------------------------
+        // Batch_Click
+        //
+        // Description:
+        // Tone maps a set of files with exposures made
+        // consistent across the set. The current exposure
+        // (with the current boost) goes to the median image.
+        //
+        // Output:
+        // Writes <name>_tonemapped.png next to every file.
+        // ----------------------------------------------------
+        private async void Batch_Click(object sender, RoutedEventArgs e)
+        {
+            OpenFileDialog dialog = new OpenFileDialog
+            {
+                Filter = "Image Files|*.jpg;*.jpeg;*.png;*.bmp;*.hdr",
+                Multiselect = true
+            };
+
+            if (dialog.ShowDialog() != true)
+                return;
+
+            string[] paths = dialog.FileNames;
+            string[] outputs = paths
+                .Select(p => Path.Combine(Path.GetDirectoryName(p), Path.GetFileNameWithoutExtension(p) + "_tonemapped.png"))
+                .ToArray();
+
+            // Files are tone mapped without boost, so it goes into the exposure
+            float exposure = (float)ExposureSlider.Value * _hdrBoost;
+            float whitePoint = (float)WhitePointSlider.Value;
+
+            Stopwatch sw = Stopwatch.StartNew();
+            int written = await Task.Run(() =>
+            {
+                HDRBatchImage[] images = new HDRBatchImage[paths.Length];
+                BatchNative.BatchAnalyze(paths, paths.Length, images);
+                BatchNative.BatchSolveExposure(images, images.Length, exposure, 1.0f, whitePoint);
+                return BatchNative.BatchToneMap(paths, outputs, images, images.Length, whitePoint);
+            });
+
+            sw.Stop();
+            TimeValueLabel.Text = $"{written}/{paths.Length} files, {sw.ElapsedMilliseconds} ms";
+        }
+
         // ----------------------------------------------------
         // LoadImage_Click
         //
@@ -477,7 +1374,13 @@ namespace wpftesting
                 }
 
                 // Store linear HDR image
-                _linearRGB = linearRGB;
+                ImageStoreNative.ImageStoreRelease(_linearStore);
+                _linearStore = ImageStoreNative.ImageStoreCreate(linearRGB, width, height);
+                _imageHash = RenderCacheNative.HashLinearRGB(linearRGB, linearRGB.Length);
+                ExposureNative.LuminancePyramidRelease(_meterPyramid);
+                _meterPyramid = ExposureNative.LuminancePyramidCreate(linearRGB, width, height);
+                Console.WriteLine($"Image store: {ImageStoreNative.ImageStoreBytes(_linearStore)} bytes " +
+                                  $"({linearRGB.Length * sizeof(float)} uncompressed)");
 
                 // Apply initial HDR boost and preview
                 BoostImage();
@@ -489,13 +1392,50 @@ namespace wpftesting
         // ----------------------------------------------------
         private void Generate_Click(object sender, RoutedEventArgs e)
         {
-            if (_linearRGB == null)
+            if (_linearStore == 0)
                 return;
 
+            int backend;
             if (OpenGLRadio.IsChecked == true)
+            {
+                backend = RenderCacheNative.BackendGL;
                 GenerateOpenGL();
+            }
+            else if (CpuRadio.IsChecked == true)
+            {
+                backend = RenderCacheNative.BackendCpu;
+                GenerateNative(false);
+            }
+            else if (SplitRadio.IsChecked == true)
+            {
+                backend = RenderCacheNative.BackendSplit;
+                GenerateNative(true);
+            }
             else
+            {
+                backend = RenderCacheNative.BackendAsm;
                 GenerateAsm();
+            }
+
+            // Latency distribution of this backend so far
+            for (int hit = 0; hit < 2; hit++)
+            {
+                if (RenderCacheNative.GetLatencyStats(backend, hit, out HDRLatencyStats lat) && lat.Count > 0)
+                    Console.WriteLine($"  {(hit == 1 ? "cached" : "rendered")}: n={lat.Count} " +
+                        $"p50 {lat.P50Ms:F1} / p95 {lat.P95Ms:F1} / p99 {lat.P99Ms:F1} / max {lat.MaxMs:F1} ms, " +
+                        $"{lat.OverSlo} over {lat.SloMs:F0} ms");
+            }
+
+            // Quality counters of the last native render
+            if (QualityCheck.IsChecked == true && backend != RenderCacheNative.BackendAsm &&
+                ToneMapGL.GetQualityStats(out HDRQualityStats q) && q.Pixels > 0)
+            {
+                double pct = 100.0 / q.Pixels;
+                Console.WriteLine($"  quality: clipped R/G/B {q.ClipHigh[0] * pct:F2}/{q.ClipHigh[1] * pct:F2}/{q.ClipHigh[2] * pct:F2} %, " +
+                    $"crushed {q.ClipLow[0] * pct:F2}/{q.ClipLow[1] * pct:F2}/{q.ClipLow[2] * pct:F2} %, {q.NonFinite} NaN/Inf, " +
+                    $"L in {q.LumMinIn:G3}..{q.LumMaxIn:G3} (mean {q.LumMeanIn:G3}), " +
+                    $"out {q.LumMinOut:G3}..{q.LumMaxOut:G3} (mean {q.LumMeanOut:G3})");
+            }
         }
     }
 }